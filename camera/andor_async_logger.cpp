@@ -0,0 +1,216 @@
+                    /*************************************************
+                     *                                               *
+                     *    IMPLEMENTATION OF ANDOR_AsyncLogger CLASS  *
+                     *                                               *
+                     *************************************************/
+
+
+#include "andor_async_logger.h"
+#include "andor_camera.h"
+
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+
+
+ANDOR_AsyncLogger::ANDOR_AsyncLogger(std::ostream *stream, const size_t capacity, const unsigned int flush_interval,
+                                     std::mutex *stream_mutex):
+    logRecords(capacity ? capacity : 2), logStream(stream), streamMutex(), streamLock(stream_mutex ? stream_mutex : &streamMutex),
+    flushInterval(flush_interval ? flush_interval : 1),
+    steadyOrigin(std::chrono::steady_clock::now()), systemOrigin(std::chrono::system_clock::now()),
+    pushedRecordsNumber(0), writtenRecordsNumber(0), droppedRecordsNumber(0),
+    stopWriter(false), writerSleeping(false), writerMutex(), writerCond(), writtenCond(),
+    writerThread()
+{
+    writerThread = std::thread(&ANDOR_AsyncLogger::writerFunc, this);
+}
+
+
+ANDOR_AsyncLogger::~ANDOR_AsyncLogger()
+{
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        stopWriter = true;
+    }
+    writerCond.notify_one();
+
+    writerThread.join(); // the writer empties the queue before exit
+}
+
+
+bool ANDOR_AsyncLogger::push(const int ident, const AT_H hndl, const int identation, const char *msg, const size_t len)
+{
+    static const char CONTINUATION_MARK[] = "...";
+    const size_t mark_len = sizeof(CONTINUATION_MARK) - 1;
+
+    ANDOR_LogRecord rec;
+
+    rec.ident = ident;
+    rec.hndl = hndl;
+    rec.identation = identation;
+    rec.timestamp = std::chrono::steady_clock::now();
+
+    bool ok = true;
+    size_t pos = 0;
+
+    // a long message is split into parts (at least one record, even for empty message)
+    do {
+        const size_t head = pos ? mark_len : 0;
+        size_t n = len - pos;
+        const bool last = head + n <= ANDOR_ASYNC_LOGGER_MESSAGE_SIZE;
+
+        if ( !last ) {
+            n = ANDOR_ASYNC_LOGGER_MESSAGE_SIZE - head - mark_len;
+
+            // do not split UTF-8 sequence
+            size_t k = n;
+            while ( k && (static_cast<unsigned char>(msg[pos + k]) & 0xC0) == 0x80 ) --k;
+            if ( k ) n = k;
+        }
+
+        rec.length = 0;
+        if ( head ) {
+            std::memcpy(rec.message, CONTINUATION_MARK, mark_len);
+            rec.length = mark_len;
+        }
+
+        std::memcpy(rec.message + rec.length, msg + pos, n);
+        rec.length += n;
+
+        if ( !last ) {
+            std::memcpy(rec.message + rec.length, CONTINUATION_MARK, mark_len);
+            rec.length += mark_len;
+        }
+
+        pos += n;
+
+        if ( logRecords.push(rec) ) {
+            ++pushedRecordsNumber;
+        } else {
+            ++droppedRecordsNumber;
+            ok = false;
+        }
+    } while ( pos < len );
+
+    // do not disturb the writer until a batch is accumulated
+    if ( writerSleeping.load(std::memory_order_relaxed) && logRecords.size() >= logRecords.capacity()/2 ) wakeWriter();
+
+    return ok;
+}
+
+
+bool ANDOR_AsyncLogger::push(const int ident, const AT_H hndl, const int identation, const std::string &msg)
+{
+    return push(ident, hndl, identation, msg.data(), msg.size());
+}
+
+
+void ANDOR_AsyncLogger::flush()
+{
+    size_t target = pushedRecordsNumber;
+
+    wakeWriter();
+
+    std::unique_lock<std::mutex> lock(writerMutex);
+    writtenCond.wait(lock, [this, target]() { return writtenRecordsNumber >= target; });
+}
+
+
+void ANDOR_AsyncLogger::setStream(std::ostream *stream)
+{
+    flush();
+
+    std::lock_guard<std::mutex> lock(*streamLock);
+    logStream = stream;
+}
+
+
+size_t ANDOR_AsyncLogger::writtenRecords() const
+{
+    return writtenRecordsNumber;
+}
+
+
+size_t ANDOR_AsyncLogger::droppedRecords() const
+{
+    return droppedRecordsNumber;
+}
+
+
+                /*  PRIVATE METHODS  */
+
+void ANDOR_AsyncLogger::wakeWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+    }
+    writerCond.notify_one();
+}
+
+
+void ANDOR_AsyncLogger::writerFunc()
+{
+    ANDOR_LogRecord rec;
+    std::string batch, line;
+
+    // timestamp string is re-formatted only when the second changes
+    std::time_t last_sec = -1;
+    char time_str[100] = "";
+
+    for (;;) {
+        size_t n = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(*streamLock);
+
+            while ( n < ANDOR_ASYNC_LOGGER_BATCH_SIZE && logRecords.pop(rec) ) {
+                auto now = systemOrigin + std::chrono::duration_cast<std::chrono::system_clock::duration>(rec.timestamp - steadyOrigin);
+                std::time_t sec = std::chrono::system_clock::to_time_t(now);
+
+                if ( sec != last_sec ) {
+                    struct std::tm buff;
+#ifdef _WIN32
+                    localtime_s(&buff, &sec);
+#else
+                    localtime_r(&sec, &buff); // std::localtime is not thread-safe (synchronous logging uses it)
+#endif
+                    std::strftime(time_str, sizeof(time_str), "%c", &buff);
+                    last_sec = sec;
+                }
+
+                ANDOR_Camera::formatLogLine(line, static_cast<ANDOR_Camera::LOG_IDENTIFICATOR>(rec.ident), rec.hndl,
+                                            time_str, rec.identation, rec.message, rec.length);
+                batch += line;
+                batch += '\n';
+
+                ++n;
+            }
+
+            if ( n && logStream ) {
+                logStream->write(batch.data(), batch.size());
+                logStream->flush();
+            }
+        }
+
+        batch.clear();
+
+        if ( n ) {
+            {
+                std::lock_guard<std::mutex> lock(writerMutex);
+                writtenRecordsNumber += n;
+            }
+            writtenCond.notify_all();
+
+            continue;
+        }
+
+        // the queue is empty here
+        std::unique_lock<std::mutex> lock(writerMutex);
+
+        if ( stopWriter ) break;
+
+        writerSleeping = true;
+        writerCond.wait_for(lock, flushInterval);
+        writerSleeping = false;
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef ANDOR_ASYNC_LOGGER_H
+#define ANDOR_ASYNC_LOGGER_H
+
+#include "../export_decl.h"
+#include "andor_ring_queue.h"
+
+#include <atcore.h>
+
+#include <ostream>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+// for MS compilers: disable multiple warnings about DLL-exports for the STL containers
+#ifdef _MSC_VER
+#pragma warning( disable: 4251 )
+#endif
+
+
+#define ANDOR_ASYNC_LOGGER_MESSAGE_SIZE 224          // maximal message length of one record (the record is 256 bytes)
+#define ANDOR_ASYNC_LOGGER_DEFAULT_CAPACITY 4096     // records in the queue
+#define ANDOR_ASYNC_LOGGER_DEFAULT_FLUSH_INTERVAL 50 // millisecs between writes of an idle queue
+#define ANDOR_ASYNC_LOGGER_BATCH_SIZE 256            // maximal records per write
+
+
+            /*   LOG RECORD   */
+
+//
+//  Compact fixed-size record: it is copied into the queue as is (no allocation).
+//  Longer messages are split into several records (lines): a part which is continued
+//  ends with "..." and the next part starts with "..." (lines of other threads may
+//  come between the parts).
+//
+
+struct ANDOR_LogRecord
+{
+    int ident;       // ANDOR_Camera::LOG_IDENTIFICATOR
+    AT_H hndl;       // device handler at the moment of logging
+    int identation;
+    std::chrono::steady_clock::time_point timestamp;
+    size_t length;
+    char message[ANDOR_ASYNC_LOGGER_MESSAGE_SIZE];
+};
+
+
+            /*   ASYNCHRONOUS LOG WRITER   */
+
+//
+//  Callers push records into a lock-free queue (push never blocks and never touches
+//  the stream), a background thread formats them (the same format as ANDOR_Camera::logToFile)
+//  and writes them by batches with one flush per batch.
+//  The writer wakes up every 'flush_interval' millisecs, or as soon as the queue is
+//  half full, or on flush().
+//
+//  A record is dropped if the queue is full (see droppedRecords()).
+//
+
+class ANDOR_API_WRAPPER_EXPORT ANDOR_AsyncLogger
+{
+public:
+    // 'stream_mutex' guards the stream if it is shared with other writers (e.g. synchronous logging),
+    // nullptr means the logger is the only writer
+    explicit ANDOR_AsyncLogger(std::ostream* stream, const size_t capacity = ANDOR_ASYNC_LOGGER_DEFAULT_CAPACITY,
+                               const unsigned int flush_interval = ANDOR_ASYNC_LOGGER_DEFAULT_FLUSH_INTERVAL,
+                               std::mutex* stream_mutex = nullptr);
+
+    ANDOR_AsyncLogger(const ANDOR_AsyncLogger &other) = delete;
+    ANDOR_AsyncLogger & operator = (const ANDOR_AsyncLogger &other) = delete;
+
+    ~ANDOR_AsyncLogger(); // writes all queued records
+
+    // can be called from any thread. Returns false if the queue is full (the record, or some
+    // parts of a long message, is dropped)
+    bool push(const int ident, const AT_H hndl, const int identation, const char* msg, const size_t len);
+    bool push(const int ident, const AT_H hndl, const int identation, const std::string &msg);
+
+    void flush(); // wait until all records pushed before are written
+
+    void setStream(std::ostream* stream); // write queued records into the old stream and switch to the new one
+
+    size_t writtenRecords() const;
+    size_t droppedRecords() const;
+
+private:
+    ANDOR_RingQueue<ANDOR_LogRecord> logRecords;
+
+    std::ostream* logStream;
+    std::mutex streamMutex;
+    std::mutex* streamLock; // streamMutex or the external one
+
+    std::chrono::milliseconds flushInterval;
+
+    // wall-clock time of record is computed from its monotonic timestamp
+    std::chrono::steady_clock::time_point steadyOrigin;
+    std::chrono::system_clock::time_point systemOrigin;
+
+    std::atomic<size_t> pushedRecordsNumber;
+    std::atomic<size_t> writtenRecordsNumber;
+    std::atomic<size_t> droppedRecordsNumber;
+
+    std::atomic<bool> stopWriter;
+    std::atomic<bool> writerSleeping;
+    std::mutex writerMutex;
+    std::condition_variable writerCond;
+    std::condition_variable writtenCond;
+
+    std::thread writerThread;
+
+    void writerFunc();
+    void wakeWriter();
+};
+
+#endif // ANDOR_ASYNC_LOGGER_H
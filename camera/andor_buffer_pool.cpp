@@ -0,0 +1,180 @@
+                    /****************************************************
+                     *                                                  *
+                     *  IMPLEMENTATION OF ANDOR_ImageBufferPool CLASS   *
+                     *                                                  *
+                     ****************************************************/
+
+
+#include "andor_buffer_pool.h"
+#include "andorsdk_exception.h"
+
+#include <string>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+
+static inline size_t round_up(const size_t val, const size_t granularity)
+{
+    return (val + granularity - 1) / granularity * granularity;
+}
+
+
+ANDOR_ImageBufferPool::ANDOR_ImageBufferPool(const size_t buffers_number, const size_t buffer_size, const int flags):
+    arena(nullptr), arenaBytes(0), slotBytes(0), bufferBytes(buffer_size), poolFlags(flags),
+    hugePages(false), lockedPages(false), buffers()
+{
+    if ( !buffers_number || !buffer_size ) {
+        throw AndorSDK_Exception(AT_ERR_NOMEMORY, "Cannot allocate image buffer pool! Zero number or size of buffers!");
+    }
+
+    slotBytes = round_up(buffer_size, ANDOR_BUFFER_POOL_PAGE_SIZE);
+    arenaBytes = slotBytes*buffers_number;
+
+    void *ptr = nullptr;
+
+#ifdef _WIN32
+    if ( flags & HugePages ) { // requires 'SeLockMemoryPrivilege', so it may fail
+        SIZE_T large_page = GetLargePageMinimum();
+        if ( large_page ) {
+            size_t n_bytes = round_up(arenaBytes, large_page);
+            ptr = VirtualAlloc(NULL, n_bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if ( ptr ) {
+                arenaBytes = n_bytes;
+                hugePages = true;
+            }
+        }
+    }
+
+    if ( ptr == nullptr ) {
+        ptr = VirtualAlloc(NULL, arenaBytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+
+    if ( ptr == nullptr ) {
+        throw AndorSDK_Exception(AT_ERR_NOMEMORY, "Cannot allocate image buffer pool of " +
+                                 std::to_string(arenaBytes) + " bytes!");
+    }
+#else
+    int mmap_flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_POPULATE
+    mmap_flags |= MAP_POPULATE; // pre-fault pages right now
+#endif
+
+#ifdef MAP_HUGETLB
+    if ( flags & HugePages ) { // explicit huge pages (they must be reserved by administrator)
+        size_t n_bytes = round_up(arenaBytes, ANDOR_BUFFER_POOL_HUGE_PAGE_SIZE);
+        ptr = mmap(NULL, n_bytes, PROT_READ | PROT_WRITE, mmap_flags | MAP_HUGETLB, -1, 0);
+        if ( ptr != MAP_FAILED ) {
+            arenaBytes = n_bytes;
+            hugePages = true;
+        } else {
+            ptr = nullptr;
+        }
+    }
+#endif
+
+    if ( ptr == nullptr ) {
+        ptr = mmap(NULL, arenaBytes, PROT_READ | PROT_WRITE, mmap_flags, -1, 0);
+        if ( ptr == MAP_FAILED ) {
+            throw AndorSDK_Exception(AT_ERR_NOMEMORY, "Cannot allocate image buffer pool of " +
+                                     std::to_string(arenaBytes) + " bytes!");
+        }
+#ifdef MADV_HUGEPAGE
+        if ( flags & HugePages ) madvise(ptr, arenaBytes, MADV_HUGEPAGE); // transparent huge pages
+#endif
+    }
+#endif
+
+    arena = static_cast<AT_U8*>(ptr);
+
+    if ( flags & LockedPages ) { // failure is not fatal (e.g. RLIMIT_MEMLOCK is too small)
+#ifdef _WIN32
+        lockedPages = hugePages || VirtualLock(ptr, arenaBytes); // large pages are always non-pageable
+#else
+        lockedPages = mlock(ptr, arenaBytes) == 0;
+#endif
+    }
+
+#if defined(_WIN32) || !defined(MAP_POPULATE)
+    if ( !lockedPages ) std::memset(arena, 0, arenaBytes); // pre-fault pages
+#endif
+
+    buffers.resize(buffers_number);
+    for ( size_t i = 0; i < buffers_number; ++i ) buffers[i] = arena + i*slotBytes;
+}
+
+
+ANDOR_ImageBufferPool::~ANDOR_ImageBufferPool()
+{
+    if ( arena == nullptr ) return;
+
+#ifdef _WIN32
+    if ( lockedPages && !hugePages ) VirtualUnlock(arena, arenaBytes);
+    VirtualFree(arena, 0, MEM_RELEASE);
+#else
+    if ( lockedPages ) munlock(arena, arenaBytes);
+    munmap(arena, arenaBytes);
+#endif
+}
+
+
+AT_U8* ANDOR_ImageBufferPool::buffer(const size_t index) const
+{
+    return buffers[index];
+}
+
+
+size_t ANDOR_ImageBufferPool::bufferIndex(const AT_U8 *ptr) const
+{
+    if ( arena == nullptr || ptr < arena || ptr >= arena + buffers.size()*slotBytes ) return buffers.size();
+
+    size_t offset = ptr - arena;
+
+    return offset % slotBytes ? buffers.size() : offset/slotBytes;
+}
+
+
+size_t ANDOR_ImageBufferPool::buffersNumber() const
+{
+    return buffers.size();
+}
+
+
+size_t ANDOR_ImageBufferPool::bufferSize() const
+{
+    return bufferBytes;
+}
+
+
+size_t ANDOR_ImageBufferPool::slotSize() const
+{
+    return slotBytes;
+}
+
+
+size_t ANDOR_ImageBufferPool::arenaSize() const
+{
+    return arenaBytes;
+}
+
+
+int ANDOR_ImageBufferPool::requestedFlags() const
+{
+    return poolFlags;
+}
+
+
+bool ANDOR_ImageBufferPool::isHugePages() const
+{
+    return hugePages;
+}
+
+
+bool ANDOR_ImageBufferPool::isLocked() const
+{
+    return lockedPages;
+}
@@ -0,0 +1,64 @@
+#ifndef ANDOR_BUFFER_POOL_H
+#define ANDOR_BUFFER_POOL_H
+
+#include "../export_decl.h"
+
+#include <atcore.h>
+
+#include <vector>
+#include <cstddef>
+
+
+#define ANDOR_BUFFER_POOL_PAGE_SIZE 4096              // alignment and granularity of image buffer slots
+#define ANDOR_BUFFER_POOL_HUGE_PAGE_SIZE (2*1024*1024) // granularity of huge-page backed arena
+
+
+            /*   POOL OF IMAGE BUFFERS CARVED FROM ONE CONTIGUOUS PAGE-ALIGNED ARENA   */
+
+//
+//  The arena is obtained directly from OS (mmap/VirtualAlloc), so each buffer
+//  starts at a page boundary and its slot size is a multiple of the page size
+//  (suitable for SDK, SIMD kernels and direct I/O). Pages are pre-faulted at allocation
+//  time and optionally locked in RAM to avoid page-fault jitter during acquisition.
+//  If huge pages are requested but not available the arena falls back to normal pages
+//  (on Linux transparent huge pages are still advised for the region).
+//
+
+class ANDOR_API_WRAPPER_EXPORT ANDOR_ImageBufferPool
+{
+public:
+    enum PoolFlags {DefaultPages = 0, HugePages = 1, LockedPages = 2};
+
+    // throws AndorSDK_Exception(AT_ERR_NOMEMORY) if the arena cannot be allocated
+    ANDOR_ImageBufferPool(const size_t buffers_number, const size_t buffer_size, const int flags = DefaultPages);
+
+    ANDOR_ImageBufferPool(const ANDOR_ImageBufferPool &other) = delete;
+    ANDOR_ImageBufferPool & operator = (const ANDOR_ImageBufferPool &other) = delete;
+
+    ~ANDOR_ImageBufferPool();
+
+    AT_U8* buffer(const size_t index) const;
+    size_t bufferIndex(const AT_U8* ptr) const; // buffersNumber() if the pointer is not a buffer of the pool
+
+    size_t buffersNumber() const;
+    size_t bufferSize() const; // requested size of buffer
+    size_t slotSize() const;   // size of buffer rounded up to page size
+    size_t arenaSize() const;
+
+    int requestedFlags() const;
+    bool isHugePages() const; // arena is backed by explicit huge pages
+    bool isLocked() const;    // arena is locked in RAM
+
+private:
+    AT_U8* arena;
+    size_t arenaBytes;
+    size_t slotBytes;
+    size_t bufferBytes;
+    int poolFlags;
+    bool hugePages;
+    bool lockedPages;
+
+    std::vector<AT_U8*> buffers;
+};
+
+#endif // ANDOR_BUFFER_POOL_H
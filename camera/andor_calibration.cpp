@@ -0,0 +1,315 @@
+                    /*************************************************
+                     *                                               *
+                     *    IMPLEMENTATION OF FRAME CALIBRATION        *
+                     *                                               *
+                     *************************************************/
+
+
+#include "andor_calibration.h"
+#include "andor_fits_writer.h"
+#include "andorsdk_exception.h"
+
+#include <cstdlib>
+#include <cctype>
+#include <sstream>
+#include <algorithm>
+
+
+                /*  ANDOR_MasterFrame STRUCTURE  */
+
+static const char* MASTER_TYPE_NAMES[] = {"BIAS", "DARK", "FLAT"};
+
+
+ANDOR_MasterFrame::ANDOR_MasterFrame():
+    type(MasterBias), width(0), height(0), exposure(0.0), framesNumber(0), data()
+{
+}
+
+
+ANDOR_MasterFrame::ANDOR_MasterFrame(const MasterType master_type, const size_t image_width, const size_t image_height,
+                                     const double exposure_time):
+    type(master_type), width(image_width), height(image_height), exposure(exposure_time), framesNumber(0),
+    data(image_width*image_height, 0.0f)
+{
+}
+
+
+bool ANDOR_MasterFrame::isValid() const
+{
+    return width && height && data.size() == width*height;
+}
+
+
+void ANDOR_MasterFrame::save(const std::string &filename) const
+{
+    if ( !isValid() ) {
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_FORMAT, "Cannot save master frame! Invalid image!");
+    }
+
+    std::ostringstream exp_str;
+    exp_str.precision(15);
+    exp_str << exposure;
+
+    ANDOR_FITSKeywords keywords;
+    keywords["IMAGETYP"] = MASTER_TYPE_NAMES[type];
+    keywords["EXPTIME"] = exp_str.str();
+    keywords["NCOMBINE"] = std::to_string(framesNumber);
+
+    andor_fits_write_image(filename, data.data(), width, height, keywords);
+}
+
+
+void ANDOR_MasterFrame::load(const std::string &filename)
+{
+    ANDOR_FITSKeywords keywords;
+    std::vector<float> image;
+    size_t w, h;
+
+    andor_fits_read_image(filename, image, w, h, keywords);
+
+    std::string type_str = keywords["IMAGETYP"];
+    std::transform(type_str.begin(), type_str.end(), type_str.begin(), ::toupper);
+
+    int t = -1;
+    for ( int i = 0; i < 3; ++i ) {
+        if ( type_str.find(MASTER_TYPE_NAMES[i]) != std::string::npos ) t = i;
+    }
+    if ( t < 0 ) {
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_FORMAT,
+                                 "Unknown type of master frame in '" + filename + "' (IMAGETYP = '" + keywords["IMAGETYP"] + "')");
+    }
+
+    type = MasterType(t);
+    width = w;
+    height = h;
+    exposure = keywords.count("EXPTIME") ? std::atof(keywords["EXPTIME"].c_str()) : 0.0;
+    framesNumber = keywords.count("NCOMBINE") ? std::strtoul(keywords["NCOMBINE"].c_str(), nullptr, 10) : 0;
+    data.swap(image);
+}
+
+
+                /*  ANDOR_FrameCalibrator CLASS  */
+
+ANDOR_FrameCalibrator::ANDOR_FrameCalibrator(const std::shared_ptr<ANDOR_WorkerPool> &pool, const size_t band_rows):
+    workerPool(pool), bandRows(band_rows ? band_rows : 1), calibratorMutex(), imageWidth(0), imageHeight(0),
+    biasData(), darkData(), gainImage(), offsetImage(),
+    darkExposure(0.0), scienceExposure(0.0), offsetValid(false)
+{
+    if ( !workerPool ) workerPool = ANDOR_WorkerPool::defaultPool();
+}
+
+
+void ANDOR_FrameCalibrator::setMasterFrame(const ANDOR_MasterFrame &master)
+{
+    if ( !master.isValid() ) {
+        throw AndorSDK_Exception(AT_ERR_INVALIDSIZE, "Invalid master frame!");
+    }
+
+    std::lock_guard<std::mutex> lock(calibratorMutex);
+
+    if ( imageWidth ) checkSize(master.width, master.height);
+
+    switch ( master.type ) {
+        case ANDOR_MasterFrame::MasterBias:
+            biasData = master.data;
+            break;
+        case ANDOR_MasterFrame::MasterDark:
+            darkData = master.data;
+            darkExposure = master.exposure;
+            break;
+        case ANDOR_MasterFrame::MasterFlat: {
+            double sum = 0.0;
+            for ( float v: master.data ) sum += v;
+            double mean = sum/master.data.size();
+
+            // a new image: running calibrations keep their snapshot of the old one
+            std::shared_ptr<std::vector<float>> gain = std::make_shared<std::vector<float>>(master.data.size());
+            for ( size_t i = 0; i < master.data.size(); ++i ) { // dead pixels are zeroed
+                (*gain)[i] = master.data[i] > 0.0f ? float(mean/master.data[i]) : 0.0f;
+            }
+            gainImage = gain;
+            break;
+        }
+    }
+
+    imageWidth = master.width;
+    imageHeight = master.height;
+    offsetValid = false;
+}
+
+
+void ANDOR_FrameCalibrator::loadMasterFrame(const std::string &filename)
+{
+    ANDOR_MasterFrame master;
+    master.load(filename);
+
+    setMasterFrame(master);
+}
+
+
+void ANDOR_FrameCalibrator::clearMasterFrames()
+{
+    std::lock_guard<std::mutex> lock(calibratorMutex);
+
+    std::vector<float>().swap(biasData);
+    std::vector<float>().swap(darkData);
+    gainImage.reset();
+    offsetImage.reset();
+
+    imageWidth = imageHeight = 0;
+    darkExposure = 0.0;
+    offsetValid = false;
+}
+
+
+bool ANDOR_FrameCalibrator::hasMasterFrame(const ANDOR_MasterFrame::MasterType type) const
+{
+    std::lock_guard<std::mutex> lock(calibratorMutex);
+
+    switch ( type ) {
+        case ANDOR_MasterFrame::MasterBias:
+            return !biasData.empty();
+        case ANDOR_MasterFrame::MasterDark:
+            return !darkData.empty();
+        case ANDOR_MasterFrame::MasterFlat:
+            return gainImage != nullptr;
+    }
+
+    return false;
+}
+
+
+void ANDOR_FrameCalibrator::setExposure(const double exposure)
+{
+    std::lock_guard<std::mutex> lock(calibratorMutex);
+
+    if ( exposure != scienceExposure ) {
+        scienceExposure = exposure;
+        if ( !darkData.empty() ) offsetValid = false;
+    }
+}
+
+
+void ANDOR_FrameCalibrator::setExposure(ANDOR_Camera &camera)
+{
+    setExposure(camera.get<AndorFeature::ExposureTime>());
+}
+
+
+double ANDOR_FrameCalibrator::exposure() const
+{
+    std::lock_guard<std::mutex> lock(calibratorMutex);
+
+    return scienceExposure;
+}
+
+
+void ANDOR_FrameCalibrator::prepare(const ANDOR_FrameGeometry &geometry)
+{
+    image_ptr_t offset, gain;
+
+    snapshot(geometry.width, geometry.height, offset, gain);
+}
+
+
+void ANDOR_FrameCalibrator::calibrate(const ANDOR_Frame &frame, float *dst, const size_t dst_stride)
+{
+    calibrate(frame.data(), frame.geometry(), dst, dst_stride);
+}
+
+
+void ANDOR_FrameCalibrator::calibrate(const AT_U8 *buffer, const ANDOR_FrameGeometry &geometry, float *dst,
+                                      const size_t dst_stride)
+{
+    if ( geometry.encoding == PIXEL_ENCODING_UNKNOWN ) {
+        throw AndorSDK_Exception(AT_ERR_NOTIMPLEMENTED, "Cannot calibrate frame! Unknown pixel encoding!");
+    }
+
+    // the kernel runs without the lock: the snapshot keeps the images alive
+    image_ptr_t offset, gain;
+    snapshot(geometry.width, geometry.height, offset, gain);
+
+    const size_t out_stride = dst_stride ? dst_stride : geometry.width;
+    const float* offset_data = offset->data();
+    const float* gain_data = gain ? gain->data() : nullptr;
+    const size_t n_bands = (geometry.height + bandRows - 1)/bandRows;
+
+    workerPool->parallelFor(n_bands, [&](size_t band) {
+        size_t first = band*bandRows;
+        size_t last = std::min(first + bandRows, geometry.height);
+
+        for ( size_t y = first; y < last; ++y ) {
+            size_t off = y*geometry.width;
+            andor_calibrate_row(buffer + y*geometry.stride, geometry.width, geometry.encoding,
+                                offset_data + off, gain_data ? gain_data + off : nullptr, dst + y*out_stride);
+        }
+    });
+}
+
+
+void ANDOR_FrameCalibrator::calibrate(const ANDOR_Frame &frame, std::vector<float> &dst)
+{
+    ANDOR_FrameGeometry geometry = frame.geometry();
+
+    dst.resize(geometry.width*geometry.height);
+
+    calibrate(frame.data(), geometry, dst.data());
+}
+
+
+                /*  PRIVATE METHODS  */
+
+void ANDOR_FrameCalibrator::snapshot(const size_t width, const size_t height, image_ptr_t &offset, image_ptr_t &gain)
+{
+    std::lock_guard<std::mutex> lock(calibratorMutex);
+
+    if ( imageWidth ) {
+        checkSize(width, height);
+        if ( !offsetValid ) updateOffset(width, height);
+    } else if ( !offsetImage || offsetImage->size() != width*height ) { // no masters: zero offset
+        updateOffset(width, height);
+    }
+
+    offset = offsetImage;
+    gain = gainImage;
+}
+
+
+void ANDOR_FrameCalibrator::checkSize(const size_t width, const size_t height) const
+{
+    if ( width != imageWidth || height != imageHeight ) {
+        throw AndorSDK_Exception(AT_ERR_INVALIDSIZE, "Image size " + std::to_string(width) + "x" +
+                                 std::to_string(height) + " differs from the master frames one (" +
+                                 std::to_string(imageWidth) + "x" + std::to_string(imageHeight) + ")!");
+    }
+}
+
+
+void ANDOR_FrameCalibrator::updateOffset(const size_t width, const size_t height)
+{
+    const size_t n = width*height;
+
+    // a new image: running calibrations keep their snapshot of the old one
+    std::shared_ptr<std::vector<float>> offset = std::make_shared<std::vector<float>>(n, 0.0f);
+
+    const float scale = (!darkData.empty() && darkExposure > 0.0) ? float(scienceExposure/darkExposure) : 1.0f;
+    const size_t chunk = 65536;
+
+    if ( !biasData.empty() || !darkData.empty() ) {
+        float* data = offset->data();
+
+        workerPool->parallelFor((n + chunk - 1)/chunk, [&](size_t k) {
+            size_t first = k*chunk;
+            size_t last = std::min(first + chunk, n);
+
+            for ( size_t i = first; i < last; ++i ) {
+                float v = biasData.empty() ? 0.0f : biasData[i];
+                if ( !darkData.empty() ) v += darkData[i]*scale;
+                data[i] = v;
+            }
+        });
+    }
+
+    offsetImage = offset;
+    offsetValid = true;
+}
@@ -0,0 +1,127 @@
+#ifndef ANDOR_CALIBRATION_H
+#define ANDOR_CALIBRATION_H
+
+#include "../export_decl.h"
+#include "andor_camera.h"
+#include "andor_frame.h"
+#include "andor_worker_pool.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+
+// for MS compilers: disable multiple warnings about DLL-exports for the STL containers
+#ifdef _MSC_VER
+#pragma warning( disable: 4251 )
+#endif
+
+
+#define ANDOR_CALIBRATION_DEFAULT_BAND_ROWS 16 // rows per task of calibration kernel
+
+
+            /*   MASTER CALIBRATION FRAME   */
+
+//
+//  Floating-point image of the full AOI. Dark master is expected to be bias-subtracted
+//  (dark current for 'exposure' seconds), flat master to be bias- and dark-subtracted.
+//  Masters are stored as FITS images (BITPIX = -32) with IMAGETYP ("BIAS", "DARK" or "FLAT"),
+//  EXPTIME and NCOMBINE keywords.
+//
+
+struct ANDOR_API_WRAPPER_EXPORT ANDOR_MasterFrame
+{
+    enum MasterType {MasterBias, MasterDark, MasterFlat};
+
+    ANDOR_MasterFrame();
+    ANDOR_MasterFrame(const MasterType master_type, const size_t image_width, const size_t image_height,
+                      const double exposure_time = 0.0);
+
+    MasterType type;
+    size_t width;
+    size_t height;
+    double exposure;      // exposure time in secs
+    size_t framesNumber;  // number of combined frames
+    std::vector<float> data;
+
+    bool isValid() const; // image is not empty and its size matches width and height
+
+    // throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO or ANDOR_WRAPPER_ERR_FILE_FORMAT)
+    void save(const std::string &filename) const;
+    void load(const std::string &filename);
+};
+
+
+            /*   FUSED FRAME CALIBRATION   */
+
+//
+//  calibrated = (raw - (bias + dark*scale))*gain, scale = ExposureTime/dark.exposure,
+//  gain = mean(flat)/flat.
+//
+//  The offset image (bias + scaled dark) is rebuilt only when exposure time changes, so
+//  each frame is processed by a single SIMD kernel which converts raw Mono12/Mono16
+//  pixels to float, subtracts the offset and multiplies by the gain in one pass
+//  (see andor_calibrate_row). Frames are split into bands of rows on the worker pool.
+//  Missing masters are skipped (a calibrator without masters just converts pixels to float).
+//
+//  The calibrator is thread-safe: frames may be calibrated concurrently (e.g. by the acquisition
+//  thread, see ANDOR_Camera::setFrameCalibrator) while masters or exposure are changed. Each call
+//  takes a snapshot of the offset and gain images, so a running call is not affected by the change.
+//
+
+class ANDOR_API_WRAPPER_EXPORT ANDOR_FrameCalibrator
+{
+public:
+    explicit ANDOR_FrameCalibrator(const std::shared_ptr<ANDOR_WorkerPool> &pool = ANDOR_WorkerPool::defaultPool(),
+                                   const size_t band_rows = ANDOR_CALIBRATION_DEFAULT_BAND_ROWS);
+
+    // all masters must have the same size. Throws AndorSDK_Exception(AT_ERR_INVALIDSIZE) otherwise
+    void setMasterFrame(const ANDOR_MasterFrame &master);
+    void loadMasterFrame(const std::string &filename);
+    void clearMasterFrames();
+
+    bool hasMasterFrame(const ANDOR_MasterFrame::MasterType type) const;
+
+    // exposure time of science frames (scale of dark master)
+    void setExposure(const double exposure);
+    void setExposure(ANDOR_Camera &camera); // read 'ExposureTime' feature
+    double exposure() const;
+
+    // check the image size against the masters and rebuild the offset image in advance
+    // (e.g. before acquisition). Throws AndorSDK_Exception(AT_ERR_INVALIDSIZE) if the size differs
+    void prepare(const ANDOR_FrameGeometry &geometry);
+
+    // output is width*height floats ('dst_stride' is output row length in pixels, 0 means image width).
+    // Throws AndorSDK_Exception(AT_ERR_INVALIDSIZE) if the frame size differs from the masters one
+    void calibrate(const ANDOR_Frame &frame, float* dst, const size_t dst_stride = 0);
+    void calibrate(const AT_U8* buffer, const ANDOR_FrameGeometry &geometry, float* dst, const size_t dst_stride = 0);
+    void calibrate(const ANDOR_Frame &frame, std::vector<float> &dst); // 'dst' is resized
+
+private:
+    typedef std::shared_ptr<const std::vector<float>> image_ptr_t;
+
+    std::shared_ptr<ANDOR_WorkerPool> workerPool;
+    size_t bandRows;
+
+    mutable std::mutex calibratorMutex; // guards all the members below
+
+    size_t imageWidth;   // 0 if there are no masters
+    size_t imageHeight;
+
+    std::vector<float> biasData;
+    std::vector<float> darkData;
+    image_ptr_t gainImage;   // inverse normalized flat (nullptr if there is no flat)
+    image_ptr_t offsetImage; // bias + scaled dark (zeros if there are no masters)
+
+    double darkExposure;
+    double scienceExposure;
+    bool offsetValid;
+
+    // under the lock: check the size and return current offset and gain images
+    void snapshot(const size_t width, const size_t height, image_ptr_t &offset, image_ptr_t &gain);
+
+    void checkSize(const size_t width, const size_t height) const;
+    void updateOffset(const size_t width, const size_t height);
+};
+
+#endif // ANDOR_CALIBRATION_H
@@ -0,0 +1,365 @@
+                /*****************************************************
+                 *                                                   *
+                 *  IMPLEMENTATION OF SDK CALL LATENCY STATISTICS    *
+                 *                                                   *
+                 *****************************************************/
+
+
+#include "andor_call_stats.h"
+#include "andor_camera.h"
+
+#include <atomic>
+#include <mutex>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+
+#define CALL_STATS_FEATURE_SLOTS (AndorFeatureId::FeaturesNumber + 1) // slot 0 is for calls without table feature
+
+
+#define ANDOR_SDK_FUNCTION_NAME(ID, FUNC) #FUNC,
+
+static const char* SDK_FUNCTION_NAMES[] = {
+    ANDOR_SDK_FUNCTION_LIST(ANDOR_SDK_FUNCTION_NAME)
+};
+
+#undef ANDOR_SDK_FUNCTION_NAME
+
+
+static std::atomic<bool> call_stats_enabled(false);
+
+
+            /*  per-thread counters  */
+
+// each block is written by its owner thread only, so an increment is a relaxed load and store
+// (no locked instruction), while a snapshot may read it from other thread
+
+struct ThreadCallStats {
+    std::atomic<uint64_t> calls[ANDOR_SDK_FUNCTIONS_NUMBER];
+    std::atomic<uint64_t> errors[ANDOR_SDK_FUNCTIONS_NUMBER];
+    std::atomic<uint64_t> totalTime[ANDOR_SDK_FUNCTIONS_NUMBER];
+    std::atomic<uint64_t> maxTime[ANDOR_SDK_FUNCTIONS_NUMBER];
+    std::atomic<uint64_t> histogram[ANDOR_SDK_FUNCTIONS_NUMBER][ANDOR_CALL_STATS_HISTOGRAM_BINS];
+
+    std::atomic<uint64_t> featureCalls[ANDOR_SDK_FUNCTIONS_NUMBER][CALL_STATS_FEATURE_SLOTS];
+    std::atomic<uint64_t> featureTime[ANDOR_SDK_FUNCTIONS_NUMBER][CALL_STATS_FEATURE_SLOTS];
+    std::atomic<uint64_t> featureMax[ANDOR_SDK_FUNCTIONS_NUMBER][CALL_STATS_FEATURE_SLOTS];
+
+    bool inUse; // guarded by registry mutex
+};
+
+
+static inline void counter_add(std::atomic<uint64_t> &counter, const uint64_t val)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + val, std::memory_order_relaxed);
+}
+
+
+static inline void counter_max(std::atomic<uint64_t> &counter, const uint64_t val)
+{
+    if ( val > counter.load(std::memory_order_relaxed) ) counter.store(val, std::memory_order_relaxed);
+}
+
+
+static void zero_thread_stats(ThreadCallStats *stats)
+{
+    for ( size_t f = 0; f < ANDOR_SDK_FUNCTIONS_NUMBER; ++f ) {
+        stats->calls[f].store(0, std::memory_order_relaxed);
+        stats->errors[f].store(0, std::memory_order_relaxed);
+        stats->totalTime[f].store(0, std::memory_order_relaxed);
+        stats->maxTime[f].store(0, std::memory_order_relaxed);
+
+        for ( size_t i = 0; i < ANDOR_CALL_STATS_HISTOGRAM_BINS; ++i ) stats->histogram[f][i].store(0, std::memory_order_relaxed);
+
+        for ( size_t i = 0; i < CALL_STATS_FEATURE_SLOTS; ++i ) {
+            stats->featureCalls[f][i].store(0, std::memory_order_relaxed);
+            stats->featureTime[f][i].store(0, std::memory_order_relaxed);
+            stats->featureMax[f][i].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+
+            /*  registry of per-thread blocks (blocks live until the process exit)  */
+
+static std::mutex & registry_mutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+
+static std::vector<ThreadCallStats*> & registry_blocks()
+{
+    static std::vector<ThreadCallStats*> blocks;
+    return blocks;
+}
+
+
+static ThreadCallStats* acquire_thread_stats()
+{
+    std::lock_guard<std::mutex> lock(registry_mutex());
+
+    // re-use a block of exited thread (its counters are kept)
+    for ( ThreadCallStats *stats: registry_blocks() ) {
+        if ( !stats->inUse ) {
+            stats->inUse = true;
+            return stats;
+        }
+    }
+
+    ThreadCallStats *stats = new ThreadCallStats;
+    zero_thread_stats(stats);
+    stats->inUse = true;
+
+    registry_blocks().push_back(stats);
+
+    return stats;
+}
+
+
+struct ThreadCallStatsHolder {
+    ThreadCallStats *stats;
+
+    ThreadCallStatsHolder(): stats(nullptr)
+    {
+    }
+
+    ~ThreadCallStatsHolder()
+    {
+        if ( stats ) {
+            std::lock_guard<std::mutex> lock(registry_mutex());
+            stats->inUse = false;
+        }
+    }
+};
+
+
+static ThreadCallStats* thread_stats()
+{
+    static thread_local ThreadCallStatsHolder holder;
+
+    if ( !holder.stats ) holder.stats = acquire_thread_stats();
+
+    return holder.stats;
+}
+
+
+            /*  log-linear histogram bins  */
+
+static inline unsigned int floor_log2(uint64_t v)
+{
+    unsigned int n = 0;
+
+    if ( v >= (1ULL << 32) ) { v >>= 32; n += 32; }
+    if ( v >= (1ULL << 16) ) { v >>= 16; n += 16; }
+    if ( v >= (1ULL << 8) ) { v >>= 8; n += 8; }
+    if ( v >= (1ULL << 4) ) { v >>= 4; n += 4; }
+    if ( v >= (1ULL << 2) ) { v >>= 2; n += 2; }
+    if ( v >= (1ULL << 1) ) { n += 1; }
+
+    return n;
+}
+
+
+static inline size_t latency_bin(const uint64_t ns)
+{
+    if ( ns < 8 ) return ns;
+
+    unsigned int e = floor_log2(ns);
+    size_t bin = (e - 2)*8 + ((ns >> (e - 3)) & 7);
+
+    return std::min(bin, size_t(ANDOR_CALL_STATS_HISTOGRAM_BINS - 1));
+}
+
+
+static inline uint64_t latency_bin_upper(const size_t bin)
+{
+    if ( bin < 8 ) return bin;
+
+    unsigned int e = bin/8 + 2;
+    uint64_t lower = (8 + bin % 8) << (e - 3);
+
+    return lower + (1ULL << (e - 3)) - 1;
+}
+
+
+                /*  ANDOR_SdkCallStats STRUCTURE  */
+
+ANDOR_SdkCallStats::ANDOR_SdkCallStats():
+    function(ANDOR_SDK_GET_INT), calls(0), errors(0), totalTime(0), maxTime(0), histogram(), features()
+{
+}
+
+
+double ANDOR_SdkCallStats::meanTime() const
+{
+    return calls ? double(totalTime)/calls : 0.0;
+}
+
+
+uint64_t ANDOR_SdkCallStats::percentile(const double p) const
+{
+    uint64_t n = 0;
+    for ( uint64_t v: histogram ) n += v;
+
+    if ( !n ) return 0;
+
+    double q = std::min(std::max(p, 0.0), 100.0);
+
+    uint64_t rank = uint64_t(q/100.0*n + 0.5);
+    if ( rank < 1 ) rank = 1;
+
+    uint64_t count = 0;
+    for ( size_t i = 0; i < histogram.size(); ++i ) {
+        count += histogram[i];
+        if ( count >= rank ) return std::min(latency_bin_upper(i), maxTime);
+    }
+
+    return maxTime;
+}
+
+
+                /*  PUBLIC FUNCTIONS  */
+
+const char* andor_sdk_function_name(const ANDOR_SdkFunction func)
+{
+    if ( func < 0 || func >= ANDOR_SDK_FUNCTIONS_NUMBER ) return "";
+
+    return SDK_FUNCTION_NAMES[func];
+}
+
+
+void andor_call_stats_enable(const bool enable)
+{
+    call_stats_enabled.store(enable, std::memory_order_relaxed);
+}
+
+
+bool andor_call_stats_enabled()
+{
+    return call_stats_enabled.load(std::memory_order_relaxed);
+}
+
+
+void andor_call_stats_record(const ANDOR_SdkFunction func, const int feature_id, const int err, const uint64_t nanosecs)
+{
+    if ( func < 0 || func >= ANDOR_SDK_FUNCTIONS_NUMBER ) return;
+
+    ThreadCallStats *stats = thread_stats();
+
+    size_t slot = (feature_id >= 0 && feature_id < AndorFeatureId::FeaturesNumber) ? feature_id + 1 : 0;
+
+    counter_add(stats->calls[func], 1);
+    if ( err != AT_SUCCESS ) counter_add(stats->errors[func], 1);
+    counter_add(stats->totalTime[func], nanosecs);
+    counter_max(stats->maxTime[func], nanosecs);
+    counter_add(stats->histogram[func][latency_bin(nanosecs)], 1);
+
+    counter_add(stats->featureCalls[func][slot], 1);
+    counter_add(stats->featureTime[func][slot], nanosecs);
+    counter_max(stats->featureMax[func][slot], nanosecs);
+}
+
+
+ANDOR_SdkCallSnapshot andor_call_stats_snapshot()
+{
+    ANDOR_SdkCallSnapshot snapshot;
+
+    std::lock_guard<std::mutex> lock(registry_mutex());
+
+    const std::vector<ThreadCallStats*> &blocks = registry_blocks();
+
+    for ( size_t f = 0; f < ANDOR_SDK_FUNCTIONS_NUMBER; ++f ) {
+        ANDOR_SdkCallStats st;
+        st.function = static_cast<ANDOR_SdkFunction>(f);
+
+        for ( ThreadCallStats *stats: blocks ) {
+            st.calls += stats->calls[f].load(std::memory_order_relaxed);
+        }
+        if ( !st.calls ) continue;
+
+        st.histogram.assign(ANDOR_CALL_STATS_HISTOGRAM_BINS, 0);
+
+        for ( ThreadCallStats *stats: blocks ) {
+            st.errors += stats->errors[f].load(std::memory_order_relaxed);
+            st.totalTime += stats->totalTime[f].load(std::memory_order_relaxed);
+            st.maxTime = std::max(st.maxTime, stats->maxTime[f].load(std::memory_order_relaxed));
+
+            for ( size_t i = 0; i < ANDOR_CALL_STATS_HISTOGRAM_BINS; ++i ) {
+                st.histogram[i] += stats->histogram[f][i].load(std::memory_order_relaxed);
+            }
+        }
+
+        for ( size_t slot = 0; slot < CALL_STATS_FEATURE_SLOTS; ++slot ) {
+            ANDOR_SdkFeatureCallStats fst = {int(slot) - 1, 0, 0, 0};
+
+            for ( ThreadCallStats *stats: blocks ) {
+                fst.calls += stats->featureCalls[f][slot].load(std::memory_order_relaxed);
+                fst.totalTime += stats->featureTime[f][slot].load(std::memory_order_relaxed);
+                fst.maxTime = std::max(fst.maxTime, stats->featureMax[f][slot].load(std::memory_order_relaxed));
+            }
+
+            if ( fst.calls ) st.features.push_back(fst);
+        }
+
+        snapshot.push_back(std::move(st));
+    }
+
+    return snapshot;
+}
+
+
+void andor_call_stats_reset()
+{
+    std::lock_guard<std::mutex> lock(registry_mutex());
+
+    for ( ThreadCallStats *stats: registry_blocks() ) zero_thread_stats(stats);
+}
+
+
+void andor_call_stats_dump(std::ostream &stream)
+{
+    ANDOR_SdkCallSnapshot snapshot = andor_call_stats_snapshot();
+
+    std::ostringstream str;
+    str << std::fixed << std::setprecision(1);
+
+    str << std::left << std::setw(34) << "SDK FUNCTION / FEATURE" << std::right
+        << std::setw(12) << "CALLS" << std::setw(9) << "ERRORS"
+        << std::setw(12) << "MEAN(us)" << std::setw(12) << "P50(us)" << std::setw(12) << "P99(us)"
+        << std::setw(12) << "MAX(us)" << "\n";
+
+    for ( const ANDOR_SdkCallStats &st: snapshot ) {
+        str << std::left << std::setw(34) << andor_sdk_function_name(st.function) << std::right
+            << std::setw(12) << st.calls << std::setw(9) << st.errors
+            << std::setw(12) << st.meanTime()/1000.0
+            << std::setw(12) << st.percentile(50.0)/1000.0 << std::setw(12) << st.percentile(99.0)/1000.0
+            << std::setw(12) << st.maxTime/1000.0 << "\n";
+
+        if ( st.features.size() == 1 && st.features[0].featureId < 0 ) continue; // not a feature function
+
+        for ( const ANDOR_SdkFeatureCallStats &fst: st.features ) {
+            const ANDOR_Camera::AndorFeatureDescriptor *desc = ANDOR_Camera::featureDescriptor(fst.featureId);
+
+            str << "    " << std::left << std::setw(30) << (desc ? desc->narrowName : "<other>") << std::right
+                << std::setw(12) << fst.calls << std::setw(9) << ""
+                << std::setw(12) << (double(fst.totalTime)/fst.calls)/1000.0
+                << std::setw(12) << "" << std::setw(12) << ""
+                << std::setw(12) << fst.maxTime/1000.0 << "\n";
+        }
+    }
+
+    stream << str.str();
+}
+
+
+std::string andor_call_stats_dump()
+{
+    std::ostringstream str;
+
+    andor_call_stats_dump(str);
+
+    return str.str();
+}
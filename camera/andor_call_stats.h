@@ -0,0 +1,147 @@
+#ifndef ANDOR_CALL_STATS_H
+#define ANDOR_CALL_STATS_H
+
+#include "../export_decl.h"
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <chrono>
+#include <cstdint>
+
+// for MS compilers: disable multiple warnings about DLL-exports for the STL containers
+#ifdef _MSC_VER
+#pragma warning( disable: 4251 )
+#endif
+
+
+            /*   LATENCY STATISTICS OF ANDOR SDK FUNCTION CALLS   */
+
+//
+//  Every SDK call made through ANDOR_Camera (feature proxy, typed feature access, commands,
+//  waitBuffer/queueBuffer/flush and the acquisition thread) is timed if the statistics are
+//  enabled (andor_call_stats_enable). For each SDK function the number of calls and errors,
+//  total and maximal latency and a log-linear (HDR-like, 8 sub-bins per power of 2, i.e.
+//  relative error < 12.5%) latency histogram are kept; calls, total and maximal latency are
+//  also kept per SDK feature.
+//
+//  Each thread updates its own counters (relaxed atomics, no locks and no shared cache lines),
+//  the snapshot sums counters of all threads. A thread's counters are re-used by a new thread
+//  after the thread exits.
+//  The cost of enabled statistics is two reads of steady clock per call.
+//
+
+#define ANDOR_CALL_STATS_HISTOGRAM_BINS 320 // covers latencies up to about 2^41 nanosecs
+
+
+#define ANDOR_SDK_FUNCTION_LIST(X) \
+    X(GET_INT, AT_GetInt) \
+    X(SET_INT, AT_SetInt) \
+    X(GET_INT_MIN, AT_GetIntMin) \
+    X(GET_INT_MAX, AT_GetIntMax) \
+    X(GET_FLOAT, AT_GetFloat) \
+    X(SET_FLOAT, AT_SetFloat) \
+    X(GET_FLOAT_MIN, AT_GetFloatMin) \
+    X(GET_FLOAT_MAX, AT_GetFloatMax) \
+    X(GET_BOOL, AT_GetBool) \
+    X(SET_BOOL, AT_SetBool) \
+    X(GET_STRING, AT_GetString) \
+    X(SET_STRING, AT_SetString) \
+    X(GET_STRING_MAX_LENGTH, AT_GetStringMaxLength) \
+    X(GET_ENUM_INDEX, AT_GetEnumIndex) \
+    X(SET_ENUM_INDEX, AT_SetEnumIndex) \
+    X(SET_ENUM_STRING, AT_SetEnumString) \
+    X(GET_ENUM_COUNT, AT_GetEnumCount) \
+    X(GET_ENUM_STRING_BY_INDEX, AT_GetEnumStringByIndex) \
+    X(IS_ENUM_INDEX_IMPLEMENTED, AT_IsEnumIndexImplemented) \
+    X(IS_ENUM_INDEX_AVAILABLE, AT_IsEnumIndexAvailable) \
+    X(IS_IMPLEMENTED, AT_IsImplemented) \
+    X(IS_READABLE, AT_IsReadable) \
+    X(IS_READONLY, AT_IsReadOnly) \
+    X(IS_WRITABLE, AT_IsWritable) \
+    X(COMMAND, AT_Command) \
+    X(WAIT_BUFFER, AT_WaitBuffer) \
+    X(QUEUE_BUFFER, AT_QueueBuffer) \
+    X(FLUSH, AT_Flush)
+
+
+#define ANDOR_SDK_FUNCTION_ID(ID, FUNC) ANDOR_SDK_##ID,
+
+enum ANDOR_SdkFunction {
+    ANDOR_SDK_FUNCTION_LIST(ANDOR_SDK_FUNCTION_ID)
+    ANDOR_SDK_FUNCTIONS_NUMBER
+};
+
+#undef ANDOR_SDK_FUNCTION_ID
+
+
+// statistics of calls of SDK function for a feature
+
+struct ANDOR_API_WRAPPER_EXPORT ANDOR_SdkFeatureCallStats
+{
+    int featureId;       // AndorFeatureId (-1 for features not in the table, e.g. global ones, and for non-feature calls)
+    uint64_t calls;
+    uint64_t totalTime;  // nanosecs
+    uint64_t maxTime;
+};
+
+
+// statistics of calls of SDK function
+
+struct ANDOR_API_WRAPPER_EXPORT ANDOR_SdkCallStats
+{
+    ANDOR_SdkCallStats();
+
+    ANDOR_SdkFunction function;
+    uint64_t calls;
+    uint64_t errors;     // calls returned not AT_SUCCESS
+    uint64_t totalTime;  // nanosecs
+    uint64_t maxTime;
+
+    std::vector<uint64_t> histogram; // ANDOR_CALL_STATS_HISTOGRAM_BINS bins
+    std::vector<ANDOR_SdkFeatureCallStats> features;
+
+    double meanTime() const;                  // nanosecs
+    uint64_t percentile(const double p) const; // upper bound of histogram bin (nanosecs), 'p' is in percents
+};
+
+typedef std::vector<ANDOR_SdkCallStats> ANDOR_SdkCallSnapshot;
+
+
+ANDOR_API_WRAPPER_EXPORT const char* andor_sdk_function_name(const ANDOR_SdkFunction func);
+
+ANDOR_API_WRAPPER_EXPORT void andor_call_stats_enable(const bool enable);
+ANDOR_API_WRAPPER_EXPORT bool andor_call_stats_enabled();
+
+ANDOR_API_WRAPPER_EXPORT void andor_call_stats_record(const ANDOR_SdkFunction func, const int feature_id, const int err,
+                                                      const uint64_t nanosecs);
+
+// functions which were called at least once. Counters are read without stopping the callers,
+// so a snapshot taken during calls is not exactly consistent
+ANDOR_API_WRAPPER_EXPORT ANDOR_SdkCallSnapshot andor_call_stats_snapshot();
+
+// zero all counters (increments of concurrent calls may be lost or may survive the reset)
+ANDOR_API_WRAPPER_EXPORT void andor_call_stats_reset();
+
+// text table: per function counts and latency percentiles, per feature counts and latencies
+ANDOR_API_WRAPPER_EXPORT void andor_call_stats_dump(std::ostream &stream);
+ANDOR_API_WRAPPER_EXPORT std::string andor_call_stats_dump();
+
+
+// call 'call' (a callable returning SDK error code) and record its latency if statistics are enabled
+template<typename CallT>
+inline int andor_timed_sdk_call(const ANDOR_SdkFunction func, const int feature_id, CallT call)
+{
+    if ( !andor_call_stats_enabled() ) return call();
+
+    auto start = std::chrono::steady_clock::now();
+
+    int err = call();
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    andor_call_stats_record(func, feature_id, err, elapsed.count());
+
+    return err;
+}
+
+#endif // ANDOR_CALL_STATS_H
@@ -0,0 +1,158 @@
+                    /******************************************************
+                     *                                                    *
+                     *  IMPLEMENTATION OF ANDOR_CallbackDispatcher CLASS  *
+                     *                                                    *
+                     ******************************************************/
+
+
+#include "andor_callback_dispatcher.h"
+
+
+ANDOR_CallbackDispatcherStats::ANDOR_CallbackDispatcherStats():
+    notifications(0), coalesced(0), dispatched(0), batches(0)
+{
+}
+
+
+ANDOR_CallbackDispatcher::ANDOR_CallbackDispatcher(const dispatch_func_t &dispatch_func, const size_t features_number):
+    dispatchFunc(dispatch_func), featuresNumber(features_number),
+    pendingFeatures(new std::atomic<bool>[features_number]), featureQueue(features_number), queuedFeatures(0),
+    coalescingInterval(0),
+    wakeMutex(), wakeCond(), idleCond(), batchMutex(),
+    stopWorker(false),
+    notificationsNumber(0), coalescedNumber(0), dispatchedNumber(0), batchesNumber(0),
+    workerThread()
+{
+    for ( size_t i = 0; i < featuresNumber; ++i ) pendingFeatures[i].store(false, std::memory_order_relaxed);
+
+    workerThread = std::thread(&ANDOR_CallbackDispatcher::workerFunc, this);
+}
+
+
+ANDOR_CallbackDispatcher::~ANDOR_CallbackDispatcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopWorker = true;
+    }
+    wakeCond.notify_all();
+    idleCond.notify_all();
+
+    workerThread.join();
+}
+
+
+void ANDOR_CallbackDispatcher::setCoalescingInterval(const std::chrono::microseconds interval)
+{
+    coalescingInterval = interval.count() > 0 ? interval.count() : 0;
+}
+
+
+std::chrono::microseconds ANDOR_CallbackDispatcher::getCoalescingInterval() const
+{
+    return std::chrono::microseconds(coalescingInterval.load());
+}
+
+
+void ANDOR_CallbackDispatcher::post(const int feature_id)
+{
+    notificationsNumber.fetch_add(1, std::memory_order_relaxed);
+
+    if ( feature_id < 0 || (size_t)feature_id >= featuresNumber ) return;
+
+    if ( pendingFeatures[feature_id].exchange(true, std::memory_order_acq_rel) ) { // it will be dispatched anyway
+        coalescedNumber.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // counted before the push: the worker must not pop (and subtract) a feature which is not counted yet
+    ++queuedFeatures;
+    featureQueue.push(feature_id); // the feature is not in the queue, so there is a free cell for it
+
+    // the worker thread holds the mutex only to check the queue before waiting
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+    }
+    wakeCond.notify_one();
+}
+
+
+void ANDOR_CallbackDispatcher::flush()
+{
+    if ( std::this_thread::get_id() == workerThread.get_id() ) return; // called from the dispatch function
+
+    std::unique_lock<std::mutex> lock(wakeMutex);
+
+    idleCond.wait(lock, [this]() { return queuedFeatures == 0 || stopWorker; });
+}
+
+
+void ANDOR_CallbackDispatcher::synchronize()
+{
+    if ( std::this_thread::get_id() == workerThread.get_id() ) return;
+
+    std::lock_guard<std::mutex> lock(batchMutex);
+}
+
+
+ANDOR_CallbackDispatcherStats ANDOR_CallbackDispatcher::getStats() const
+{
+    ANDOR_CallbackDispatcherStats stats;
+
+    stats.notifications = notificationsNumber.load(std::memory_order_relaxed);
+    stats.coalesced = coalescedNumber.load(std::memory_order_relaxed);
+    stats.dispatched = dispatchedNumber.load(std::memory_order_relaxed);
+    stats.batches = batchesNumber.load(std::memory_order_relaxed);
+
+    return stats;
+}
+
+
+                /*  PRIVATE METHODS  */
+
+void ANDOR_CallbackDispatcher::workerFunc()
+{
+    std::vector<int> batch;
+    batch.reserve(featuresNumber); // no allocation in the loop
+    int feature_id;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wakeCond.wait(lock, [this]() { return queuedFeatures > 0 || stopWorker; });
+        }
+
+        if ( stopWorker ) break;
+
+        int64_t interval = coalescingInterval;
+        if ( interval > 0 ) std::this_thread::sleep_for(std::chrono::microseconds(interval)); // let a burst come
+
+        {
+            std::lock_guard<std::mutex> lock(batchMutex);
+
+            batch.clear();
+
+            // a feature is unmarked before the dispatch: its next notification is queued again
+            while ( featureQueue.pop(feature_id) ) {
+                pendingFeatures[feature_id].store(false, std::memory_order_release);
+                batch.push_back(feature_id);
+            }
+
+            if ( batch.empty() ) continue; // a post() has counted the feature, but not pushed it yet
+
+            try {
+                dispatchFunc(batch);
+            } catch ( ... ) { // the dispatch function must catch its errors, the thread must not throw anyway
+            }
+
+            dispatchedNumber.fetch_add(batch.size(), std::memory_order_relaxed);
+            batchesNumber.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        {
+            // the counter is checked by flush() under the mutex, so it cannot miss the notification
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            if ( queuedFeatures.fetch_sub(batch.size()) == batch.size() ) idleCond.notify_all();
+        }
+    }
+}
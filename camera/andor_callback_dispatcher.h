@@ -0,0 +1,98 @@
+#ifndef ANDOR_CALLBACK_DISPATCHER_H
+#define ANDOR_CALLBACK_DISPATCHER_H
+
+#include "../export_decl.h"
+#include "andor_ring_queue.h"
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+
+// for MS compilers: disable multiple warnings about DLL-exports for the STL containers
+#ifdef _MSC_VER
+#pragma warning( disable: 4251 )
+#endif
+
+
+struct ANDOR_API_WRAPPER_EXPORT ANDOR_CallbackDispatcherStats
+{
+    ANDOR_CallbackDispatcherStats();
+
+    uint64_t notifications;  // notifications posted by SDK
+    uint64_t coalesced;      // notifications merged into a pending one of the same feature
+    uint64_t dispatched;     // features passed to the dispatch function
+    uint64_t batches;        // calls of the dispatch function
+};
+
+
+            /*   DISPATCHER OF SDK FEATURE CALLBACKS   */
+
+//
+//  SDK calls feature callbacks from its internal thread, so a slow user function stalls SDK.
+//  The dispatcher decouples them: post() (called by SDK thread) only marks the feature as
+//  pending and enqueues its AndorFeatureId into a lock-free queue, a worker thread takes all
+//  queued features at once and passes them to the dispatch function (a batch).
+//
+//  A notification of a feature which is already pending is merged with it (coalescing), so
+//  a burst of notifications results in one call per feature. The feature is unmarked before
+//  the dispatch, i.e. a notification during the dispatch is delivered again. Every feature is
+//  queued at most once, so the queue (of features number capacity) never overflows.
+//  An optional coalescing interval delays the dispatch to collect longer bursts.
+//
+
+class ANDOR_API_WRAPPER_EXPORT ANDOR_CallbackDispatcher
+{
+public:
+    typedef std::function<void(const std::vector<int> &)> dispatch_func_t; // AndorFeatureId of pending features
+
+    ANDOR_CallbackDispatcher(const dispatch_func_t &dispatch_func, const size_t features_number);
+
+    ANDOR_CallbackDispatcher(const ANDOR_CallbackDispatcher &other) = delete;
+    ANDOR_CallbackDispatcher & operator = (const ANDOR_CallbackDispatcher &other) = delete;
+
+    ~ANDOR_CallbackDispatcher(); // stop the worker thread (pending notifications are dropped)
+
+    void setCoalescingInterval(const std::chrono::microseconds interval);
+    std::chrono::microseconds getCoalescingInterval() const;
+
+    void post(const int feature_id); // can be called from any thread, it never calls the dispatch function
+
+    void flush();       // wait until all posted notifications are dispatched
+    void synchronize(); // wait for the batch in progress (it returns immediately if it is called from the dispatch function)
+
+    ANDOR_CallbackDispatcherStats getStats() const;
+
+private:
+    dispatch_func_t dispatchFunc;
+    size_t featuresNumber;
+
+    std::unique_ptr<std::atomic<bool>[]> pendingFeatures;
+    ANDOR_RingQueue<int> featureQueue;
+    std::atomic<size_t> queuedFeatures; // posted, but not dispatched yet
+
+    std::atomic<int64_t> coalescingInterval; // microsecs
+
+    std::mutex wakeMutex;
+    std::condition_variable wakeCond;
+    std::condition_variable idleCond;
+    std::mutex batchMutex; // held by the worker thread during a dispatch
+
+    std::atomic<bool> stopWorker;
+
+    std::atomic<uint64_t> notificationsNumber;
+    std::atomic<uint64_t> coalescedNumber;
+    std::atomic<uint64_t> dispatchedNumber;
+    std::atomic<uint64_t> batchesNumber;
+
+    std::thread workerThread;
+
+    void workerFunc();
+};
+
+#endif // ANDOR_CALLBACK_DISPATCHER_H
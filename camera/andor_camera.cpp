@@ -1,6 +1,10 @@
 #include "andor_camera.h"
+#include "andor_async_logger.h"
+#include "andor_calibration.h"
+#include "andor_worker_pool.h"
 
 #include <locale>
+#include <algorithm>
 #include <codecvt>
 #include <chrono>
 #include <ctime>
@@ -12,27 +16,9 @@
                              *                                   *
                              *************************************/
 
-extern ANDOR_Camera::AndorFeatureNameMap  DEFAULT_ANDOR_SDK_FEATURES; // pre-defined SDK features "name-type" std::map
-
-
                 /*  AUXILIARY NON-MEMBER FUNCTIONS  */
 
 
-static inline AT_U8* allocate_aligned(const size_t buff_size)
-{
-#ifdef _MSC_VER
-#if _MSC_VER > 1800
-        alignas(8) AT_U8* pbuff = new unsigned char[buff_size];
-#else // compile with VS 2013
-        __declspec(align(8))  AT_U8* pbuff = new unsigned char[buff_size];
-#endif
-#else
-        alignas(8) AT_U8* pbuff = new unsigned char[buff_size];
-#endif
-    return pbuff;
-}
-
-
 static inline std::string pointer_to_str(void* ptr)
 {
     char addr[20];
@@ -53,7 +39,11 @@ static std::string time_stamp()
     char time_stamp[100];
 
     struct std::tm buff;
-    buff = *std::localtime(&now_c);
+#ifdef _WIN32
+    localtime_s(&buff, &now_c);
+#else
+    localtime_r(&now_c, &buff); // features may be logged from several threads
+#endif
 
     std::strftime(time_stamp,sizeof(time_stamp),"%c",&buff);
 
@@ -69,6 +59,15 @@ static int AT_EXP_CONV feature_callback(AT_H hndl, const AT_WC* name, void* cont
 
     CallbackContext* _context = (CallbackContext*)context;
 
+    // the dispatcher is enabled: only enqueue the feature (the user function is called by the dispatcher thread)
+    if ( !_context->direct && _context->feature_id >= 0 ) {
+        ANDOR_CallbackDispatcher *dispatcher = _context->dispatcher->load(std::memory_order_acquire);
+        if ( dispatcher ) {
+            dispatcher->post(_context->feature_id);
+            return AT_CALLBACK_SUCCESS;
+        }
+    }
+
     int ret_code = _context->func(andor_string_t(name),_context->user_context);
 
     return ret_code;
@@ -77,55 +76,92 @@ static int AT_EXP_CONV feature_callback(AT_H hndl, const AT_WC* name, void* cont
 
                 /*  STATIC MEMBERS INITIALIZATION   */
 
-std::list<ANDOR_CameraInfo> ANDOR_Camera::foundCameras = std::list<ANDOR_CameraInfo>();
-std::list<int> ANDOR_Camera::openedCameraIndices = std::list<int>();
-size_t ANDOR_Camera::numberOfCreatedObjects = 0;
+// serials of camera objects (0 marks a free thread-local slot, see threadFeature())
+static std::atomic<uint64_t> camera_object_serial(0);
 
-//ANDOR_Camera::AndorFeatureNameMap ANDOR_Camera::ANDOR_SDK_FEATURES = ANDOR_Camera::AndorFeatureNameMap(DEFAULT_ANDOR_SDK_FEATURES);
+#define ANDOR_CAMERA_THREAD_FEATURE_SLOTS 4 // number of cameras a thread can switch between without locking
+
+// existing camera objects by serial: an exiting thread removes its feature proxies from them (see threadFeature())
+static std::mutex live_cameras_mutex;
+static std::unordered_map<uint64_t, ANDOR_Camera*> live_cameras;
+
+std::map<int,AT_H> ANDOR_Camera::openedCameras = std::map<int,AT_H>();
 
 ANDOR_Camera::ANDOR_Feature ANDOR_Camera::DeviceCount(AT_HANDLE_SYSTEM,L"DeviceCount");
 ANDOR_Camera::ANDOR_Feature ANDOR_Camera::SoftwareVersion(AT_HANDLE_SYSTEM,L"SoftwareVersion");
 
+// types of the global features are set once here (not by every camera constructor: the proxies
+// may be read by other threads at that time)
+static const bool global_features_typed = (ANDOR_Camera::DeviceCount.setType(ANDOR_Camera::IntType),
+                                           ANDOR_Camera::SoftwareVersion.setType(ANDOR_Camera::StringType),
+                                           true);
+
 
                 /*  CONSTRUCTOR AND DESTRUCTOR  */
 
+ANDOR_Camera::FeatureProxy::FeatureProxy():
+    feature(), context(), contextVersion(0)
+{
+}
+
+
 ANDOR_Camera::ANDOR_Camera():
     logLevel(LOG_LEVEL_ERROR),
-    lastError(AT_SUCCESS), cameraLog(nullptr), cameraHndl(AT_HANDLE_UNINITIALISED),
-    cameraFeature(),
+    cameraHndl(AT_HANDLE_UNINITIALISED), cameraIndex(-1), lastError(AT_SUCCESS), cameraLog(nullptr), cameraLogMutex(), asyncLogger(),
+    featureCache(), enumMetadata(), featureContext(), featureContextVersion(0), featureProxiesMutex(), featureProxies(),
+    objectSerial(++camera_object_serial), commandNames(), commandNamesMutex(),
     waitBufferThread(),
-    imageBufferAddr(),
+    acquisitionActive(false), acquisitionError(AT_SUCCESS), droppedFramesNumber(0),
+    waitBufferTimeout(ANDOR_CAMERA_DEFAULT_WAIT_BUFFER_TIMEOUT), acquisitionThreadCpu(-1), acquisitionThreadPinned(false),
+    frameGeometry(),
+    readyBuffers(), frameRecycler(), readyBuffersMutex(), readyBuffersCond(),
+    imageBufferPool(), imageBufferAddr(), imageBufferSize(0),
+    imageBufferPoolFlags(ANDOR_ImageBufferPool::DefaultPages),
     maxBuffersNumber(ANDOR_CAMERA_DEFAULT_MAX_BUFFERS_NUMBER), requestedBuffersNumber(0),
-    callbackContextPtr(),
-    ANDOR_SDK_FEATURES(DEFAULT_ANDOR_SDK_FEATURES)
+    frameStatisticsFlags(-1), frameStatisticsEngine(), frameCalibrator(), acquisitionCalibrator(),
+    calibratedImagesNumber(ANDOR_CAMERA_DEFAULT_CALIBRATED_IMAGES), calibratedImages(), exposureSubscribed(false),
+    callbackContextPtr(), callbackContextMutex(),
+    callbackDispatcher(), activeDispatcher(nullptr), dispatchedCallbacks()
 {
     setLogLevel(logLevel); // to initialize or disable extra logging facility
 
-    // if it is the first object initialize ANDOR SDK library and scan currently connected cameras
-    if ( !numberOfCreatedObjects ) {
-        lastError = AT_InitialiseLibrary();
-        if ( lastError != AT_SUCCESS ) return;
-        scanConnectedCameras();
-    }
+    enumMetadata.reset(new ANDOR_EnumMetadataCache([this](const int id, const bool subscribe) {
+        return subscribeFeatureChanges(enumMetadata.get(), id, subscribe);
+    }));
 
+    publishFeatureContext();
 
-    ANDOR_Camera::DeviceCount.setType(ANDOR_Camera::IntType);
-    ANDOR_Camera::SoftwareVersion.setType(ANDOR_Camera::StringType);
+    {
+        std::lock_guard<std::mutex> lock(live_cameras_mutex);
+        live_cameras[objectSerial] = this;
+    }
+
+    // initialize ANDOR SDK library (if it is the first reference and the initialization is not deferred)
+    // and start scan of connected cameras according to the discovery mode (only once)
+    lastError = ANDOR_SdkLibrary::acquire();
+    if ( lastError != AT_SUCCESS ) return;
 
-    ++numberOfCreatedObjects;
+    startDiscovery();
 }
 
 
 
 ANDOR_Camera::~ANDOR_Camera()
 {
-    --numberOfCreatedObjects;
+    {
+        // wait for exiting threads which are removing their proxies right now
+        std::lock_guard<std::mutex> lock(live_cameras_mutex);
+        live_cameras.erase(objectSerial);
+    }
+
+    disconnectFromCamera(); // stop acquisition thread (if it is running) before the library finalization
 
     if ( cameraHndl != AT_HANDLE_UNINITIALISED ) AT_Close(cameraHndl); // !!! DOES ONE NEED IT REALLY (check of cameraHndl)
 
-    if ( !numberOfCreatedObjects ) {
-        AT_FinaliseLibrary();
-    }
+    activeDispatcher = nullptr;
+    callbackDispatcher.reset(); // stop the dispatcher thread before the callback list is destroyed
+
+    ANDOR_SdkLibrary::release(); // finalize the library if it is the last reference
 
 
     // delete callback helper structures if it exist
@@ -140,15 +176,12 @@ ANDOR_Camera::~ANDOR_Camera()
 
 void ANDOR_Camera::setLogLevel(const LOG_LEVEL level)
 {
-    if ( logLevel == LOG_LEVEL_VERBOSE ) { // set extra logging function (logging from SDK function calling)
-        log_func_t log_func = std::bind(
-           static_cast<void(ANDOR_Camera::*)(const ANDOR_Camera::LOG_IDENTIFICATOR, const std::string&, const int)>
-           (&ANDOR_Camera::logToFile), this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3
-                                    );
-        cameraFeature.setLoggingFunc(log_func);
-    } else { // reset logging function to null (no logging from SDK function calling)
-        cameraFeature.setLoggingFunc();
-    }
+    // levels removed at compile time cannot be set
+    logLevel = level < ANDOR_CAMERA_MIN_LOG_LEVEL ? static_cast<LOG_LEVEL>(ANDOR_CAMERA_MIN_LOG_LEVEL) : level;
+
+    publishFeatureContext(); // set or reset extra logging function (logging from SDK function calling)
+
+    if ( !isVerboseLog() ) return;
 
     std::string log_str = "Set logging level to ";
 
@@ -168,9 +201,7 @@ void ANDOR_Camera::setLogLevel(const LOG_LEVEL level)
     }
     log_str += " state!";
 
-    if ( logLevel == LOG_LEVEL_VERBOSE ) logToFile(CAMERA_INFO,log_str);
-
-    logLevel = level;
+    logToFile(CAMERA_INFO,log_str);
 }
 
 
@@ -182,7 +213,9 @@ ANDOR_Camera::LOG_LEVEL ANDOR_Camera::getLogLevel() const
 
 bool ANDOR_Camera::connectToCamera(const int device_index, std::ostream *log_file)
 {
-    if ( lastError != AT_SUCCESS ) { // check error from constructor (ANDOR SDK may not be initialized)!!!
+    lastError = ANDOR_SdkLibrary::ensureInitialised(); // the initialization may be deferred
+
+    if ( lastError != AT_SUCCESS ) {
         logToFile(ANDOR_Camera::CAMERA_ERROR, "IT SEEMS ANDOR SDK WAS NOT INITIALIZED!!! CANNOT OPEN A CONNECTION!!!");
         logToFile(ANDOR_Camera::CAMERA_ERROR, "LAST SDK FUNCTION CALLING RETURNS ERROR CODE: " + std::to_string(lastError));
         return false;
@@ -191,6 +224,8 @@ bool ANDOR_Camera::connectToCamera(const int device_index, std::ostream *log_fil
     disconnectFromCamera();
 
     cameraLog = log_file;
+    std::shared_ptr<ANDOR_AsyncLogger> logger = std::atomic_load(&asyncLogger);
+    if ( logger ) logger->setStream(log_file);
 
     // header of log
     for (int i = 0; i < 5; ++i) logToFile(ANDOR_Camera::BLANK,"");
@@ -207,10 +242,17 @@ bool ANDOR_Camera::connectToCamera(const int device_index, std::ostream *log_fil
     bool ok = true;
     lastError = AT_SUCCESS;
 
+    // a background scan probes (opens) all devices: wait for it, the device is opened by us after
+    if ( getDiscoveryMode() == DISCOVERY_BACKGROUND ) waitDiscovery();
+
     try {
-        int dev_num = ANDOR_Camera::DeviceCount;
-        if ( logLevel == ANDOR_Camera::LOG_LEVEL_VERBOSE ) {
-            logToFile(ANDOR_Camera::CAMERA_INFO, DeviceCount.getLastLogMessage());
+        // own proxy: the static DeviceCount may be read concurrently (e.g. by a scan)
+        ANDOR_Feature device_count(AT_HANDLE_SYSTEM, L"DeviceCount");
+        device_count.setType(ANDOR_Camera::IntType);
+
+        int dev_num = device_count;
+        if ( isVerboseLog() ) { // the global feature has no logging function
+            logToFile(ANDOR_Camera::CAMERA_INFO, "AT_GetInt('DeviceCount', " + std::to_string(AT_HANDLE_SYSTEM) + ", &at64_val)");
         }
 
         log_str = "Number of found cameras: " + std::to_string(dev_num);
@@ -226,16 +268,18 @@ bool ANDOR_Camera::connectToCamera(const int device_index, std::ostream *log_fil
         logToFile(ANDOR_Camera::CAMERA_INFO,log_str,1);
 
         log_str = "AT_Open(" + std::to_string(device_index) + ", &cameraHndl)";
-        if ( logLevel == LOG_LEVEL_VERBOSE ) logToFile(CAMERA_INFO,log_str);
+        if ( isVerboseLog() ) logToFile(CAMERA_INFO,log_str);
 
-        andor_sdk_assert( AT_Open(device_index,&cameraHndl), log_str);
+        andor_sdk_assert( openDevice(device_index,cameraHndl), log_str);
 
 
         log_str = "Connection established! Camera handler is " + std::to_string(cameraHndl);
         logToFile(ANDOR_Camera::CAMERA_INFO,log_str);
 
         // initialize feature (set working camera handler)
-        cameraFeature.setDeviceHndl(cameraHndl);
+        publishFeatureContext();
+
+        cameraIndex = device_index;
 
         return true;
 
@@ -277,10 +321,20 @@ bool ANDOR_Camera::connectToCamera(const ANDOR_Camera::CAMERA_IDENT_TAG ident_ta
     log_str += " tag ...";
     logToFile(ANDOR_Camera::CAMERA_INFO,log_str);
 
+    if ( ident_tag == ANDOR_Camera::SerialNumber ) { // indexed
+        int device_index = findCameraBySerialNumber(tag_str);
+        if ( device_index >= 0 ) {
+            log_str = "The identificator was found! The camera device index is " + std::to_string(device_index);
+            logToFile(ANDOR_Camera::CAMERA_INFO,log_str);
+            return connectToCamera(device_index, log_file);
+        }
+    }
+
     int ok;
 
     // here, I ignore possible errors from access to SDK features!!!
-    for ( ANDOR_CameraInfo info: foundCameras ) {
+    for ( const ANDOR_CameraInfo &info: getFoundCameras() ) {
+        ok = 1; // an empty field does not match
         switch (ident_tag) {
             case ANDOR_Camera::CameraModel:
                 if ( info.cameraModel.empty() ) break;
@@ -330,17 +384,113 @@ void ANDOR_Camera::disconnectFromCamera() // here there is no SDK error processi
 
     logToFile(ANDOR_Camera::CAMERA_INFO, "Try to disconnect from camera ...");
 
+    if ( waitBufferThread.joinable() ) {
+        try {
+            acquisitionStop();
+        } catch ( AndorSDK_Exception &ex ) {
+            logToFile(ex);
+        }
+    }
+
+    // callbacks must be unregistered before AT_Close (enumerated tables belong to the closed camera)
+    std::shared_ptr<ANDOR_FeatureCache> cache = threadFeatureCache();
+    if ( cache ) cache->unsubscribeAll();
+    enumMetadata->clear();
 
-    if ( logLevel == LOG_LEVEL_VERBOSE ) {
+    if ( callbackDispatcher ) callbackDispatcher->flush(); // deliver enqueued callbacks while the camera is open
+
+    if ( isVerboseLog() ) {
         log_str = "AT_Close(" + std::to_string(cameraHndl) + ")";
         logToFile(ANDOR_Camera::CAMERA_INFO,log_str);
     }
 
-    lastError = AT_Close(cameraHndl);
+    lastError = closeDevice(cameraIndex, cameraHndl);
 
     logToFile(ANDOR_Camera::CAMERA_INFO,"Camera disconnected");
 
     cameraHndl = AT_HANDLE_UNINITIALISED;
+    cameraIndex = -1;
+}
+
+
+ANDOR_CameraInfo ANDOR_Camera::getCameraInfo() const
+{
+    for ( const ANDOR_CameraInfo &info: getFoundCameras() ) {
+        if ( info.device_index == cameraIndex ) return info;
+    }
+
+    return ANDOR_CameraInfo();
+}
+
+
+ANDOR_Camera::AndorFeatureSnapshot ANDOR_Camera::getFeatureSnapshot()
+{
+    std::vector<andor_string_t> names;
+
+    for ( int id = 0; id < int(featuresNumber()); ++id ) names.push_back(featureName(id));
+
+    return getFeatureSnapshot(names);
+}
+
+
+ANDOR_Camera::AndorFeatureSnapshot ANDOR_Camera::getFeatureSnapshot(const std::vector<andor_string_t> &feature_names)
+{
+    AndorFeatureSnapshot snapshot;
+
+    if ( cameraHndl == AT_HANDLE_UNINITIALISED ) return snapshot;
+
+    std::wostringstream value;
+    value.precision(15);
+
+    // here, I ignore possible errors from access to SDK features (and unknown names)!!!
+    for ( auto name = feature_names.begin(); name != feature_names.end(); ++name ) {
+        int id = featureId(*name);
+        if ( id < 0 ) continue;
+
+        try {
+            ANDOR_Feature &feature = (*this)[*name];
+
+            ANDOR_FeatureInfo info(feature);
+            if ( !info.isImplemented() || !info.isReadable() ) continue;
+
+            value.str(L"");
+            switch ( featureType(id) ) {
+                case ANDOR_Camera::BoolType: {
+                    bool v = feature;
+                    value << (v ? L"true" : L"false");
+                    break;
+                }
+                case ANDOR_Camera::IntType: {
+                    AT_64 v = feature;
+                    value << v;
+                    break;
+                }
+                case ANDOR_Camera::FloatType: {
+                    double v = feature;
+                    value << v;
+                    break;
+                }
+                case ANDOR_Camera::StringType: {
+                    ANDOR_StringFeature v = feature;
+                    value << v.value();
+                    break;
+                }
+                case ANDOR_Camera::EnumType: {
+                    ANDOR_EnumFeature v = feature;
+                    value << v.value();
+                    break;
+                }
+                default:
+                    continue;
+            }
+
+            snapshot.push_back(std::make_pair(*name, value.str()));
+        } catch ( AndorSDK_Exception &ex ) {
+            continue;
+        }
+    }
+
+    return snapshot;
 }
 
 
@@ -357,7 +507,52 @@ size_t ANDOR_Camera::getMaxBuffersNumber() const
 }
 
 
+void ANDOR_Camera::setImageBufferPoolFlags(const int flags)
+{
+    imageBufferPoolFlags = flags;
+}
+
+
+int ANDOR_Camera::getImageBufferPoolFlags() const
+{
+    return imageBufferPoolFlags;
+}
+
+
+void ANDOR_Camera::setFrameStatistics(const bool enable, const int flags)
+{
+    frameStatisticsFlags = enable ? flags : -1;
+}
+
+
+bool ANDOR_Camera::isFrameStatistics() const
+{
+    return frameStatisticsFlags >= 0;
+}
+
+
+void ANDOR_Camera::setFrameCalibrator(const std::shared_ptr<ANDOR_FrameCalibrator> &calibrator, const size_t images_number)
+{
+    frameCalibrator = calibrator;
+    calibratedImagesNumber = images_number;
+
+    if ( !frameCalibrator || !calibratedImagesNumber ) calibratedImages.reset();
+}
+
+
+std::shared_ptr<ANDOR_FrameCalibrator> ANDOR_Camera::getFrameCalibrator() const
+{
+    return frameCalibrator;
+}
+
+
 void ANDOR_Camera::registerFeatureCallback(andor_string_t feature_name, const callback_func_t &func, void *context)
+{
+    registerCallback(feature_name, func, context, false);
+}
+
+
+void ANDOR_Camera::registerCallback(andor_string_t feature_name, const callback_func_t &func, void *context, const bool direct)
 {
     std::string log_str;
 
@@ -368,30 +563,48 @@ void ANDOR_Camera::registerFeatureCallback(andor_string_t feature_name, const ca
     CallbackContext *_context = new CallbackContext();
 //    callbackContextPtr.push_back(_context);
 
+    _context->feature_name = feature_name;
     _context->func = func;
     _context->user_context = context;
+    _context->feature_id = featureId(feature_name);
+    _context->direct = direct;
+    _context->dispatcher = &activeDispatcher;
+
+    // the list is locked for its modifications only: SDK calls the callback at registration
+    // (feature caches subscribe from the threads which access features)
+    std::list<std::unique_ptr<CallbackContext>>::iterator ctx_it;
+    {
+        std::lock_guard<std::mutex> lock(callbackContextMutex);
+        ctx_it = callbackContextPtr.insert(callbackContextPtr.end(), std::unique_ptr<CallbackContext>(_context));
+    }
 
-    callbackContextPtr.push_back(std::unique_ptr<CallbackContext>(_context));
-
+    // feature caches register callbacks at the first access of features, so the progress is logged at verbose level only
     std::wstring_convert<std::codecvt_utf8<AT_WC>> cvt;
-    log_str = "Try to register '" + cvt.to_bytes(feature_name) +  "'-feature callback function ...";
-    logToFile(ANDOR_Camera::CAMERA_INFO, log_str);
+    if ( isVerboseLog() ) {
+        log_str = "Try to register '" + cvt.to_bytes(feature_name) +  "'-feature callback function ...";
+        logToFile(ANDOR_Camera::CAMERA_INFO, log_str);
+    }
 
-    // get string presentation of user callback function address
-    auto ff = *func.target<int (*)(andor_string_t, void*)>();
-    std::string sptr = pointer_to_str((void*)ff);
+    // get string presentation of user callback function address (if it is a plain function)
+    auto ff = func.target<int (*)(andor_string_t, void*)>();
+    std::string sptr = ff ? pointer_to_str((void*)*ff) : std::string("<functor>");
 
     log_str = "AT_RegisterFeatureCallback(" + std::to_string(cameraHndl) + ", L'" + cvt.to_bytes(feature_name).c_str() +
             "', " + sptr;
 
     log_str += std::string(", ") + pointer_to_str(context) + ")";
 
-    if ( logLevel == LOG_LEVEL_VERBOSE ) logToFile(CAMERA_INFO,log_str);
+    if ( isVerboseLog() ) logToFile(CAMERA_INFO,log_str);
+
+    int err = AT_RegisterFeatureCallback(cameraHndl,feature_name.c_str(),feature_callback,(void*)_context);
+    if ( err != AT_SUCCESS ) {
+        std::lock_guard<std::mutex> lock(callbackContextMutex);
+        callbackContextPtr.erase(ctx_it);
+    }
 
-    andor_sdk_assert( lastError = AT_RegisterFeatureCallback(cameraHndl,feature_name.c_str(),feature_callback,(void*)_context),
-                      log_str);
+    andor_sdk_assert(err, log_str);
 
-    logToFile(ANDOR_Camera::CAMERA_INFO, "The callback function was registered successfully!");
+    if ( isVerboseLog() ) logToFile(ANDOR_Camera::CAMERA_INFO, "The callback function was registered successfully!");
 
 }
 
@@ -405,22 +618,49 @@ void ANDOR_Camera::unregisterFeatureCallback(andor_string_t feature_name, const
     }
 
     std::wstring_convert<std::codecvt_utf8<AT_WC>> cvt;
-    log_str = "Unregistering '" + cvt.to_bytes(feature_name) +  "'-feature callback function ...";
-    logToFile(ANDOR_Camera::CAMERA_INFO, log_str);
+    if ( isVerboseLog() ) {
+        log_str = "Unregistering '" + cvt.to_bytes(feature_name) +  "'-feature callback function ...";
+        logToFile(ANDOR_Camera::CAMERA_INFO, log_str);
+    }
+
+    // SDK context is the helper structure created at registration (it is found by feature name and user context,
+    // std::function objects cannot be compared)
+    std::unique_lock<std::mutex> lock(callbackContextMutex);
+
+    auto it = callbackContextPtr.begin();
+    for ( ; it != callbackContextPtr.end(); ++it ) {
+        if ( (*it)->feature_name == feature_name && (*it)->user_context == context ) break;
+    }
+
+    if ( it == callbackContextPtr.end() ) {
+        lock.unlock();
+        logToFile(ANDOR_Camera::CAMERA_ERROR, "The callback function was not registered!");
+        return;
+    }
 
-    // get string presentation of user callback function address
-    auto ff = *func.target<int (*)(andor_string_t, void*)>();
-    std::string sptr = pointer_to_str((void*)ff);
+    // get string presentation of user callback function address (if it is a plain function)
+    auto ff = func.target<int (*)(andor_string_t, void*)>();
+    std::string sptr = ff ? pointer_to_str((void*)*ff) : std::string("<functor>");
 
     log_str = "AT_UnregisterFeatureCallback(" + std::to_string(cameraHndl) + ", L'" + cvt.to_bytes(feature_name).c_str() +
             "', " + sptr;
     log_str += std::string(", ") + pointer_to_str(context) + ")";
 
-    if ( logLevel == LOG_LEVEL_VERBOSE ) logToFile(CAMERA_INFO,log_str);
+    if ( isVerboseLog() ) logToFile(CAMERA_INFO,log_str);
+
+    bool dispatched = !(*it)->direct;
+
+    int err = AT_UnregisterFeatureCallback(cameraHndl,feature_name.c_str(),feature_callback,(void*)it->get());
+    if ( err == AT_SUCCESS ) callbackContextPtr.erase(it);
+
+    lock.unlock();
 
-    andor_sdk_assert( lastError = AT_UnregisterFeatureCallback(cameraHndl,feature_name.c_str(),feature_callback,context), log_str);
+    // the dispatcher thread may call a copy of the removed callback right now
+    if ( dispatched && callbackDispatcher ) callbackDispatcher->synchronize();
 
-    logToFile(ANDOR_Camera::CAMERA_INFO, "The callback function was unregistered successfully!");
+    andor_sdk_assert(err, log_str);
+
+    if ( isVerboseLog() ) logToFile(ANDOR_Camera::CAMERA_INFO, "The callback function was unregistered successfully!");
 }
 
 
@@ -434,16 +674,14 @@ int ANDOR_Camera::waitBuffer(AT_U8 **ptr, int *ptr_size, unsigned int timeout)
 int ANDOR_Camera::waitBuffer(AT_U8 **ptr, int *ptr_size, unsigned int timeout) noexcept
 #endif
 {
-    std::string log_str;
-
-    log_str = "AT_WaitBuffer(" + std::to_string(cameraHndl) + ", **ptr, *ptr_size, " + std::to_string(timeout);
-    if ( logLevel == LOG_LEVEL_VERBOSE ) logToFile(CAMERA_INFO,log_str);
-
-    int ret_code = AT_WaitBuffer(cameraHndl, ptr, ptr_size, timeout);
-//    andor_sdk_assert( ret_code, log_str);
+    int ret_code = andor_timed_sdk_call(ANDOR_SDK_WAIT_BUFFER, -1,
+                                        [&]() { return AT_WaitBuffer(cameraHndl, ptr, ptr_size, timeout); });
 
-    log_str = "returns: *ptr = " + pointer_to_str(*ptr) + ", ptr_size = " + std::to_string(*ptr_size);
-    if ( logLevel == LOG_LEVEL_VERBOSE ) logToFile(CAMERA_INFO,log_str,1);
+    if ( isVerboseLog() ) {
+        logToFile(CAMERA_INFO, "AT_WaitBuffer(" + std::to_string(cameraHndl) + ", **ptr, *ptr_size, " +
+                  std::to_string(timeout) + ")");
+        logToFile(CAMERA_INFO, "returns: *ptr = " + pointer_to_str(*ptr) + ", ptr_size = " + std::to_string(*ptr_size), 1);
+    }
 
     return ret_code;
 }
@@ -451,344 +689,1244 @@ int ANDOR_Camera::waitBuffer(AT_U8 **ptr, int *ptr_size, unsigned int timeout) n
 
 void ANDOR_Camera::queueBuffer(AT_U8 *ptr, int ptr_size)
 {
+    lastError = andor_timed_sdk_call(ANDOR_SDK_QUEUE_BUFFER, -1,
+                                     [&]() { return AT_QueueBuffer(cameraHndl, ptr, ptr_size); });
+
+    // the message is formatted only if it is needed
+    if ( lastError == AT_SUCCESS && !isVerboseLog() ) return;
+
     std::string log_msg = "AT_QueueBuffer(" + std::to_string(cameraHndl) + ", " + pointer_to_str(ptr) +
                           ", " + std::to_string(ptr_size) + ")";
-    if ( logLevel == ANDOR_Camera::LOG_LEVEL_VERBOSE ) logToFile(ANDOR_Camera::CAMERA_INFO, log_msg);
+    if ( isVerboseLog() ) logToFile(ANDOR_Camera::CAMERA_INFO, log_msg);
 
-    andor_sdk_assert( lastError =  AT_QueueBuffer(cameraHndl, ptr, ptr_size), log_msg);
+    andor_sdk_assert(lastError, log_msg);
 }
 
 
 void ANDOR_Camera::flush()
 {
+    lastError = andor_timed_sdk_call(ANDOR_SDK_FLUSH, -1, [&]() { return AT_Flush(cameraHndl); });
+
+    if ( lastError == AT_SUCCESS && !isVerboseLog() ) return;
+
     std::string log_str = "AT_Flush(" + std::to_string(cameraHndl) + ")";
-    if ( logLevel == ANDOR_Camera::LOG_LEVEL_VERBOSE ) logToFile(ANDOR_Camera::CAMERA_INFO,log_str);
+    if ( isVerboseLog() ) logToFile(ANDOR_Camera::CAMERA_INFO,log_str);
 
-    andor_sdk_assert( lastError = AT_Flush(cameraHndl), log_str );
+    andor_sdk_assert(lastError, log_str);
 }
 
 
-void ANDOR_Camera::logToFile(const LOG_IDENTIFICATOR ident, const std::string &log_str, const int identation)
-{
-    if ( !cameraLog ) return;
-    if ( logLevel == ANDOR_Camera::LOG_LEVEL_QUIET ) return;
-
 
-    std::stringstream str;
+void ANDOR_Camera::acquisitionStart()
+{
+    std::string log_str;
 
-    if ( ident == ANDOR_Camera::BLANK ) {
-        *cameraLog << log_str << std::endl << std::flush;
-        return;
+    if ( cameraHndl == AT_HANDLE_UNINITIALISED ) {
+        throw AndorSDK_Exception(AT_ERR_CONNECTION, "Cannot start acquisition! No connection to device!");
     }
 
-    str << "[" << time_stamp() << "] ";
+    if ( waitBufferThread.joinable() ) acquisitionStop(); // restart
 
-    switch (ident) {
-    case ANDOR_Camera::CAMERA_INFO:
-        str << "[CAMERA INFO";
-        if ( cameraHndl != AT_HANDLE_UNINITIALISED ) { // camera already connected, add device handler identificator
-            str << ", DEVICE HANDLER " << cameraHndl << "]";
-        } else {
-            str << "]";
-        }
-        break;
-    case ANDOR_Camera::SDK_ERROR:
-        str << "[ANDOR SDK ERROR, DEVICE HANDLER " << cameraHndl << "]";
-        break;
-    case ANDOR_Camera::CAMERA_ERROR:
-        str << "[CAMERA ERROR";
-        if ( cameraHndl != AT_HANDLE_UNINITIALISED ) { // camera already connected, add device handler identificator
-            str << ", DEVICE HANDLER " << cameraHndl << "]";
-        } else {
-            str << "]";
-        }
-        break;
-    default: // just ignore
-        break;
+    // buffers still held by consumers cannot be given to SDK again
+    std::shared_ptr<ANDOR_FrameRecycler> recycler = std::atomic_load(&frameRecycler);
+    if ( recycler && recycler->outstanding() ) {
+        log_str = "Cannot start acquisition! " + std::to_string(recycler->outstanding()) +
+                  " image buffers of the previous acquisition are still held by consumers!";
+        throw AndorSDK_Exception(AT_ERR_DEVICEINUSE, log_str);
     }
 
-    std::string tab;
-    if ( identation > 0 ) {
-        tab.resize(ANDOR_CAMERA_LOG_IDENTATION*identation,' ');
+    // drop stale buffers of the previous acquisition before its pool can be released (see allocateImageBuffers).
+    // The mutex fences consumers waiting in popReadyBuffer
+    std::shared_ptr<ANDOR_RingQueue<ANDOR_CapturedBuffer>> ready_buffers = std::atomic_load(&readyBuffers);
+    if ( ready_buffers ) {
+        std::lock_guard<std::mutex> lock(readyBuffersMutex);
+        ANDOR_CapturedBuffer buff;
+        while ( ready_buffers->pop(buff) );
     }
 
-    str << " " << tab << log_str;
+    logToFile(ANDOR_Camera::CAMERA_INFO, "Try to start acquisition ...");
 
-    *cameraLog << str.str() << std::endl << std::flush;
-}
+    // number of image buffers: number of frames for 'Fixed' cycle mode and maximal one otherwise
 
+    ANDOR_EnumFeature cycle_mode = (*this)["CycleMode"];
+    if ( cycle_mode.value() == L"Fixed" ) {
+        AT_64 frame_count = (*this)["FrameCount"];
+        requestedBuffersNumber = frame_count;
+    } else {
+        requestedBuffersNumber = maxBuffersNumber;
+    }
 
-void ANDOR_Camera::logToFile(const LOG_IDENTIFICATOR ident, const char *log_str, const int identation)
-{
-    logToFile(ident,std::string(log_str),identation);
-}
+    AT_64 image_size = (*this)["ImageSizeBytes"];
 
+    allocateImageBuffers(image_size);
 
-void ANDOR_Camera::logToFile(const AndorSDK_Exception &ex, const int identation)
-{
-    std::stringstream str;
-    str << ex.what() << " [ANDOR SDK ERROR CODE: " << ex.getError() << "]";
+    log_str = "Allocated " + std::to_string(imageBufferAddr.size()) + " image buffers of " +
+              std::to_string(imageBufferSize) + " bytes (arena of " + std::to_string(imageBufferPool->arenaSize()) +
+              " bytes";
+    if ( imageBufferPool->isHugePages() ) log_str += ", huge pages";
+    if ( imageBufferPool->isLocked() ) log_str += ", locked";
+    logToFile(ANDOR_Camera::CAMERA_INFO, log_str + ")", 1);
 
-    logToFile(ANDOR_Camera::SDK_ERROR, str.str(), identation);
-}
+    if ( (imageBufferPoolFlags & ANDOR_ImageBufferPool::LockedPages) && !imageBufferPool->isLocked() ) {
+        logToFile(ANDOR_Camera::CAMERA_ERROR, "Cannot lock image buffers in RAM! Continue with pageable ones!", 1);
+    }
 
+    readFrameGeometry();
 
+    flush(); // make sure SDK input/output queues are empty
 
-                    /*  PUBLIC OPERATORS[]  */
+    // hand-off queue (any buffer can be in ready or released queue, so capacity is number of buffers).
+    // A waiting consumer keeps its reference to the replaced queue
+    if ( !ready_buffers || ready_buffers->capacity() < imageBufferAddr.size() ) {
+        std::atomic_store(&readyBuffers, std::make_shared<ANDOR_RingQueue<ANDOR_CapturedBuffer>>(imageBufferAddr.size()));
+    }
 
-ANDOR_Camera::ANDOR_Feature & ANDOR_Camera::operator [](const andor_string_t &feature_name)
-{
-    auto it = ANDOR_SDK_FEATURES.find(feature_name); // check for valid feature name
+    // statistics engine is reused by the following acquisitions (its buffers are allocated once)
+    bool with_statistics = frameStatisticsFlags >= 0;
+    if ( with_statistics && frameGeometry.encoding == PIXEL_ENCODING_UNKNOWN ) {
+        logToFile(ANDOR_Camera::CAMERA_ERROR, "Unsupported pixel encoding! Frame statistics are not computed!", 1);
+        with_statistics = false;
+    }
 
-    if ( it != ANDOR_SDK_FEATURES.end() ) {
-        cameraFeature.setType(it->second);
-        cameraFeature.setName(feature_name);
-        return cameraFeature;
+    if ( !with_statistics ) {
+        frameStatisticsEngine.reset();
+    } else if ( !frameStatisticsEngine || frameStatisticsEngine->flags() != frameStatisticsFlags ) {
+        frameStatisticsEngine.reset(new ANDOR_FrameStatisticsEngine(frameStatisticsFlags));
     }
 
-    cameraFeature.setType(UnknownType);
-    throw AndorSDK_Exception(AT_ERR_NOTIMPLEMENTED,"Unknown ANDOR SDK feature!");
-}
+    // offset image of the calibrator is built here, not on the first frame
+    acquisitionCalibrator = frameCalibrator;
+    if ( acquisitionCalibrator ) {
+        try {
+            if ( frameGeometry.encoding == PIXEL_ENCODING_UNKNOWN ) {
+                throw AndorSDK_Exception(AT_ERR_NOTIMPLEMENTED, "Unsupported pixel encoding!");
+            }
+            acquisitionCalibrator->setExposure(*this);
+            acquisitionCalibrator->prepare(frameGeometry);
+        } catch ( AndorSDK_Exception &ex ) {
+            logToFile(ANDOR_Camera::CAMERA_ERROR, std::string(ex.what()) + " Frames are not calibrated!", 1);
+            acquisitionCalibrator.reset();
+        }
+    }
+    subscribeCalibratorExposure();
+    const size_t calibrated_size = acquisitionCalibrator ? frameGeometry.width*frameGeometry.height : 0;
+
+    // the ring of calibrated images is reallocated only if AOI or number of images were changed
+    // (no frame of the previous acquisition is held here, so its images are not in use)
+    if ( calibrated_size && calibratedImagesNumber ) {
+        if ( !calibratedImages || calibratedImages->size() != calibratedImagesNumber*calibrated_size ) {
+            calibratedImages.reset();
+            calibratedImages = std::make_shared<std::vector<float>>(calibratedImagesNumber*calibrated_size);
+        }
+    }
 
+    // consumers take the recycler concurrently (see popReadyBuffer)
+    std::atomic_store(&frameRecycler, std::make_shared<ANDOR_FrameRecycler>(imageBufferPool, frameGeometry,
+                                                                            with_statistics, calibrated_size,
+                                                                            calibrated_size ? calibratedImages : nullptr));
 
-ANDOR_Camera::ANDOR_Feature & ANDOR_Camera::operator [](const AT_WC* feature_name)
-{
-    return operator [](andor_string_t(feature_name));
-}
+    for ( size_t i = 0; i < imageBufferAddr.size(); ++i ) {
+        queueBuffer(imageBufferAddr[i], imageBufferSize);
+    }
 
+    droppedFramesNumber = 0;
+    acquisitionError = AT_SUCCESS;
+    acquisitionActive = true;
 
+    waitBufferThread = std::thread(&ANDOR_Camera::waitBufferFunc, this);
 
-ANDOR_Camera::ANDOR_Feature & ANDOR_Camera::operator [](const std::string & feature_name)
-{
-    std::wstring_convert<std::codecvt_utf8<AT_WC>> cvt;
+    acquisitionThreadPinned = andor_pin_thread(waitBufferThread, acquisitionThreadCpu);
+    if ( acquisitionThreadCpu >= 0 && !acquisitionThreadPinned ) {
+        logToFile(ANDOR_Camera::CAMERA_ERROR, "Cannot pin acquisition thread to CPU " +
+                  std::to_string(acquisitionThreadCpu) + "!", 1);
+    }
+
+    try {
+        (*this)("AcquisitionStart");
+    } catch ( AndorSDK_Exception &ex ) {
+        acquisitionActive = false;
+        waitBufferThread.join();
+        unsubscribeCalibratorExposure();
+        flush();
+        throw;
+    }
 
-    return operator [](cvt.from_bytes(feature_name));
+    logToFile(ANDOR_Camera::CAMERA_INFO, "Acquisition is started!");
 }
 
 
-ANDOR_Camera::ANDOR_Feature & ANDOR_Camera::operator [](const char* feature_name)
+void ANDOR_Camera::acquisitionStop()
 {
-    std::wstring_convert<std::codecvt_utf8<AT_WC>> cvt;
+    if ( !waitBufferThread.joinable() ) return;
 
-    return operator [](cvt.from_bytes(feature_name));
-}
+    logToFile(ANDOR_Camera::CAMERA_INFO, "Try to stop acquisition ...");
 
+    try {
+        (*this)("AcquisitionStop");
+    } catch ( AndorSDK_Exception &ex ) { // camera may have already finished (e.g. 'Fixed' cycle mode)
+        logToFile(ex, 1);
+    }
 
+    acquisitionActive = false;
+    waitBufferThread.join();
 
-void ANDOR_Camera::operator ()(const andor_string_t & command_name)
-{
-    andor_string_t str = L"AT_Command(" + std::to_wstring(cameraHndl) +
-                         L", " + command_name + L")";
+    unsubscribeCalibratorExposure();
 
-    std::wstring_convert<std::codecvt_utf8<AT_WC>> cnv;
-    std::string log_str = cnv.to_bytes(str);
+    std::atomic_load(&frameRecycler)->deactivate();
 
-    if ( logLevel == ANDOR_Camera::LOG_LEVEL_VERBOSE ) logToFile(ANDOR_Camera::CAMERA_INFO,log_str);
-    andor_sdk_assert( AT_Command(cameraHndl,command_name.c_str()), log_str);
-}
+    // wake up consumers waiting in getImageBuffer
+    {
+        std::lock_guard<std::mutex> lock(readyBuffersMutex);
+    }
+    readyBuffersCond.notify_all();
 
+    flush();
 
-void ANDOR_Camera::operator ()(const AT_WC* command_name)
-{
-    operator ()(andor_string_t(command_name));
+    std::string log_str = "Acquisition is stopped! Number of dropped frames: " + std::to_string(droppedFramesNumber);
+    logToFile(ANDOR_Camera::CAMERA_INFO, log_str);
 }
 
 
-void ANDOR_Camera::operator ()(const std::string & command_name)
+bool ANDOR_Camera::isAcquiring() const
 {
-    std::wstring_convert<std::codecvt_utf8<AT_WC>> cvt;
-
-    operator ()(cvt.from_bytes(command_name));
+    return acquisitionActive;
 }
 
 
-void ANDOR_Camera::operator ()(const char* command_name)
+bool ANDOR_Camera::waitFrame(ANDOR_Frame &frame, unsigned int timeout)
 {
-    operator ()(std::string(command_name));
-}
+    ANDOR_CapturedBuffer buff;
+    std::shared_ptr<ANDOR_FrameRecycler> recycler;
 
+    frame.release();
 
+    if ( !popReadyBuffer(buff, timeout, recycler) ) return false;
 
+    frame = ANDOR_Frame(recycler, buff);
 
-                    /*  PROTECTED METHODS  */
+    return true;
+}
 
-int ANDOR_Camera::scanConnectedCameras()
-{
-    int N = ANDOR_Camera::DeviceCount;
 
-    AT_H hndl;
+bool ANDOR_Camera::getImageBuffer(AT_U8 **ptr, int *ptr_size, unsigned int timeout)
+{
+    ANDOR_CapturedBuffer buff;
+    std::shared_ptr<ANDOR_FrameRecycler> recycler;
 
-    ANDOR_FeatureInfo f_info;
-    ANDOR_StringFeature s_f;
+    if ( !popReadyBuffer(buff, timeout, recycler) ) return false;
 
-    if ( foundCameras.size() ) foundCameras.clear();
+    *ptr = buff.ptr;
+    *ptr_size = buff.size;
 
-    // suppose device indices are continuous sequence from 0 to (DeviceCount-1)
-    for (int i = 0; i < N-1; ++i ) {
-        int err = AT_Open(i,&hndl);
-        if ( err == AT_SUCCESS ) {
-            ANDOR_CameraInfo info;            
-            ANDOR_Feature feature(hndl,L"");
-            feature.setType(ANDOR_Camera::StringType);
+    return true;
+}
 
-            // common info
-            feature.setName(L"CameraName");
-            f_info = feature;
-            if ( f_info.isImplemented() ) {
-                s_f = feature;
-                info.cameraName = s_f.value();
-            }
 
-            feature.setName(L"InterfaceType");
-            f_info = feature;
-            if ( f_info.isImplemented() ) {
-                s_f = feature;
-                info.interfaceType = s_f.value();
-            }
+void ANDOR_Camera::releaseImageBuffer(AT_U8 *ptr)
+{
+    std::shared_ptr<ANDOR_FrameRecycler> recycler = std::atomic_load(&frameRecycler);
 
-            feature.setName(L"FirmwareVersion");
-            f_info = feature;
-            if ( f_info.isImplemented() ) {
-                s_f = feature;
-                info.firmwareVersion = s_f.value();
-            }
+    if ( !recycler || !recycler->release(ptr) ) {
+        std::string log_str = "Cannot release image buffer " + pointer_to_str(ptr) +
+                              "! It is not a held buffer of the current acquisition (or it was already released)!";
+        logToFile(ANDOR_Camera::CAMERA_ERROR, log_str);
+        throw AndorSDK_Exception(AT_ERR_INVALIDHANDLE, log_str);
+    }
+}
 
-            // CMOS
-            feature.setName(L"CameraModel");
-            f_info = feature;
-            if ( f_info.isImplemented() ) {
-                s_f = feature;
-                info.cameraModel = s_f.value();
-            }
 
-            feature.setName(L"SerialNumber");
-            f_info = feature;
-            if ( f_info.isImplemented() ) {
-                s_f = feature;
-                info.serialNumber = s_f.value();
-            }
+ANDOR_FrameGeometry ANDOR_Camera::getFrameGeometry() const
+{
+    return frameGeometry;
+}
 
-            feature.setName(L"ControllerID");
-            f_info = feature;
-            if ( f_info.isImplemented() ) {
-                s_f = feature;
-                info.controllerID = s_f.value();
-            }
 
+size_t ANDOR_Camera::getDroppedFramesNumber() const
+{
+    return droppedFramesNumber;
+}
 
-            // Apogee
-            feature.setName(L"CameraFamily");
-            f_info = feature;
-            if ( f_info.isImplemented() ) {
-                s_f = feature;
-                info.cameraFamily = s_f.value();
-            }
 
-            feature.setName(L"DDR2Type");
-            f_info = feature;
-            if ( f_info.isImplemented() ) {
-                s_f = feature;
-                info.DDR2Type = s_f.value();
+bool ANDOR_Camera::popReadyBuffer(ANDOR_CapturedBuffer &buffer, unsigned int timeout,
+                                  std::shared_ptr<ANDOR_FrameRecycler> &recycler)
+{
+    std::shared_ptr<ANDOR_RingQueue<ANDOR_CapturedBuffer>> ready_buffers = std::atomic_load(&readyBuffers);
+    if ( !ready_buffers ) return false;
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+
+    for (;;) {
+        if ( !ready_buffers->pop(buffer) ) {
+            std::unique_lock<std::mutex> lock(readyBuffersMutex);
+            bool popped = false;
+            auto ready = [&ready_buffers, &buffer, &popped, this]() {
+                ready_buffers = std::atomic_load(&readyBuffers); // the queue may be replaced by a restart
+                popped = ready_buffers->pop(buffer);
+                return popped || !acquisitionActive;
+            };
+
+            if ( timeout == AT_INFINITE ) {
+                readyBuffersCond.wait(lock, ready);
+            } else {
+                if ( !readyBuffersCond.wait_until(lock, deadline, ready) ) return false;
             }
 
-            feature.setName(L"DriverVersion");
-            f_info = feature;
-            if ( f_info.isImplemented() ) {
-                s_f = feature;
-                info.driverVersion = s_f.value();
-            }
+            // acquisition was stopped, but there still may be captured buffers
+            if ( !popped && !ready_buffers->pop(buffer) ) return false;
+        }
 
-            feature.setName(L"MicrocodeVersion");
-            f_info = feature;
-            if ( f_info.isImplemented() ) {
-                s_f = feature;
-                info.microcodeVersion = s_f.value();
-            }
+        // the buffer was pushed after the recycler of its acquisition was stored, so the loaded recycler
+        // is of the same or a later acquisition. A buffer of a previous acquisition is dropped: its SDK
+        // queue was flushed and the buffer may be queued to SDK again (or its arena is unmapped)
+        recycler = std::atomic_load(&frameRecycler);
+        if ( recycler && recycler->generation() == buffer.generation ) break;
+    }
 
-            feature.setName(L"SensorModel");
-            f_info = feature;
-            if ( f_info.isImplemented() ) {
-                s_f = feature;
-                info.sensorModel = s_f.value();
-            }
+    recycler->acquire(buffer.ptr);
 
-            feature.setName(L"SensorType");
-            f_info = feature;
-            if ( f_info.isImplemented() ) {
-                s_f = feature;
-                info.sensorType = s_f.value();
-            }
+    return true;
+}
 
 
-            // geometrical info
-            feature.setName(L"SensorWidth");
-            feature.setType(ANDOR_Camera::IntType);
-            f_info = feature;
-            if ( f_info.isImplemented() ) info.sensorWidth = feature;
+int ANDOR_Camera::getAcquisitionError() const
+{
+    return acquisitionError;
+}
 
-            feature.setName(L"SensorHeight");
-            f_info = feature;
-            if ( f_info.isImplemented() ) info.sensorHeight = feature;
 
-            feature.setName(L"PixelWidth");
-            feature.setType(ANDOR_Camera::FloatType);
-            f_info = feature;
-            if ( f_info.isImplemented() ) info.pixelWidth = feature;
+void ANDOR_Camera::setWaitBufferTimeout(const unsigned int timeout)
+{
+    waitBufferTimeout = timeout;
+}
 
-            feature.setName(L"PixelHeight");
-            f_info = feature;
-            if ( f_info.isImplemented() ) info.pixelHeight = feature;
 
-            info.device_index = i;
+unsigned int ANDOR_Camera::getWaitBufferTimeout() const
+{
+    return waitBufferTimeout;
+}
 
-            foundCameras.push_back(info);
-        }
-        AT_Close(hndl);
-    }
 
-    return N;
+void ANDOR_Camera::setAcquisitionThreadCpu(const int cpu)
+{
+    acquisitionThreadCpu = cpu < 0 ? -1 : cpu;
 }
 
 
+int ANDOR_Camera::getAcquisitionThreadCpu() const
+{
+    return acquisitionThreadCpu;
+}
 
 
-void ANDOR_Camera::logToFile(const ANDOR_Feature &feature, const int identation)
+bool ANDOR_Camera::isAcquisitionThreadPinned() const
 {
-    logToFile(ANDOR_Camera::CAMERA_INFO, feature.getLastLogMessage(), identation);
+    return acquisitionThreadPinned;
 }
 
 
-void ANDOR_Camera::allocateImageBuffers(int imageSizeBytes)
+void ANDOR_Camera::logToFile(const LOG_IDENTIFICATOR ident, const std::string &log_str, const int identation)
 {
-    std::string log_msg;
+#if ANDOR_CAMERA_MIN_LOG_LEVEL >= 2 // quiet: all logging is removed
+    return;
+#endif
 
-    if ( requestedBuffersNumber == 0 ) {
-        log_msg = "Cannot allocate image buffers! The requested number of images is 0!";
-        throw AndorSDK_Exception(AT_ERR_NOMEMORY, log_msg);
+    if ( !cameraLog ) return;
+    if ( logLevel == ANDOR_Camera::LOG_LEVEL_QUIET ) return;
+
+
+    // the logger may be switched off by other thread: keep it alive until the record is pushed
+    std::shared_ptr<ANDOR_AsyncLogger> logger = std::atomic_load(&asyncLogger);
+    if ( logger ) {
+        logger->push(ident, cameraHndl, identation, log_str);
+        return;
     }
 
-    size_t imageBuffersNumber = ( requestedBuffersNumber > maxBuffersNumber ) ? maxBuffersNumber : requestedBuffersNumber;
+    std::string line;
+    formatLogLine(line, ident, cameraHndl, time_stamp().c_str(), identation, log_str.data(), log_str.size());
 
+    std::lock_guard<std::mutex> lock(cameraLogMutex); // features may be accessed (and logged) from several threads
 
-    // try to optimize allocation mechanism: real allocation only if it is needed
-    if ( imageBufferAddr.size() != imageBuffersNumber ) {
-        size_t old_size = imageBufferAddr.size();
-        imageBufferAddr.resize(imageBuffersNumber);
-        if ( imageBufferSize != imageSizeBytes ) {
-            for ( size_t i = 0; i < imageBufferAddr.size(); ++i ) {
-                imageBufferAddr[i] = std::unique_ptr<AT_U8[]>(allocate_aligned(imageSizeBytes));
-            }
+    *cameraLog << line << std::endl << std::flush;
+}
+
+
+void ANDOR_Camera::formatLogLine(std::string &line, const LOG_IDENTIFICATOR ident, const AT_H hndl, const char *time_stamp,
+                                 const int identation, const char *msg, const size_t len)
+{
+    line.clear();
+
+    if ( ident == ANDOR_Camera::BLANK ) {
+        line.append(msg, len);
+        return;
+    }
+
+    line += "[";
+    line += time_stamp;
+    line += "] ";
+
+    switch (ident) {
+    case ANDOR_Camera::CAMERA_INFO:
+        line += "[CAMERA INFO";
+        if ( hndl != AT_HANDLE_UNINITIALISED ) { // camera already connected, add device handler identificator
+            line += ", DEVICE HANDLER " + std::to_string(hndl) + "]";
         } else {
-            for ( size_t i = old_size; i < imageBufferAddr.size(); ++i ) {
-                imageBufferAddr[i] = std::unique_ptr<AT_U8[]>(allocate_aligned(imageSizeBytes));
-            }
+            line += "]";
+        }
+        break;
+    case ANDOR_Camera::SDK_ERROR:
+        line += "[ANDOR SDK ERROR, DEVICE HANDLER " + std::to_string(hndl) + "]";
+        break;
+    case ANDOR_Camera::CAMERA_ERROR:
+        line += "[CAMERA ERROR";
+        if ( hndl != AT_HANDLE_UNINITIALISED ) { // camera already connected, add device handler identificator
+            line += ", DEVICE HANDLER " + std::to_string(hndl) + "]";
+        } else {
+            line += "]";
         }
+        break;
+    default: // just ignore
+        break;
+    }
+
+    line += " ";
+    if ( identation > 0 ) line.append(ANDOR_CAMERA_LOG_IDENTATION*identation, ' ');
+
+    line.append(msg, len);
+}
+
+
+void ANDOR_Camera::setAsyncLogging(const bool enable, const size_t queue_capacity)
+{
+    if ( enable ) {
+        if ( std::atomic_load(&asyncLogger) ) return;
+        std::atomic_store(&asyncLogger, std::make_shared<ANDOR_AsyncLogger>(cameraLog, queue_capacity,
+                                                                       ANDOR_ASYNC_LOGGER_DEFAULT_FLUSH_INTERVAL,
+                                                                       &cameraLogMutex));
+    } else {
+        // queued lines are written by the logger destructor (in the last thread which releases the logger)
+        std::atomic_store(&asyncLogger, std::shared_ptr<ANDOR_AsyncLogger>());
+    }
+}
+
+
+bool ANDOR_Camera::isAsyncLogging() const
+{
+    return std::atomic_load(&asyncLogger) != nullptr;
+}
+
+
+void ANDOR_Camera::flushLog()
+{
+    std::shared_ptr<ANDOR_AsyncLogger> logger = std::atomic_load(&asyncLogger);
+    if ( logger ) logger->flush();
+}
+
+
+void ANDOR_Camera::setFeatureCaching(const bool enable)
+{
+    if ( enable ) {
+        if ( std::atomic_load(&featureCache) ) return;
+
+        // the cache is the context of its SDK callbacks (the member may be already reset when they are unsubscribed)
+        std::shared_ptr<ANDOR_FeatureCache*> self = std::make_shared<ANDOR_FeatureCache*>(nullptr);
+        std::shared_ptr<ANDOR_FeatureCache> cache = std::make_shared<ANDOR_FeatureCache>(
+                    [this, self](const int id, const bool subscribe) {
+            return subscribeFeatureChanges(*self, id, subscribe);
+        });
+        *self = cache.get();
+
+        std::shared_ptr<ANDOR_FeatureCache> none;
+        if ( !std::atomic_compare_exchange_strong(&featureCache, &none, cache) ) return; // enabled concurrently
+        publishFeatureContext();
     } else {
-        if ( imageBufferSize != imageSizeBytes ) {
-            for ( size_t i = 0; i < imageBufferAddr.size(); ++i ) {
-                imageBufferAddr[i] = std::unique_ptr<AT_U8[]>(allocate_aligned(imageSizeBytes));
+        std::shared_ptr<ANDOR_FeatureCache> cache = std::atomic_exchange(&featureCache, std::shared_ptr<ANDOR_FeatureCache>());
+        if ( !cache ) return;
+
+        // threads in the middle of a call keep the cache alive (it is destroyed with the last
+        // reference and its destructor unsubscribes notifications subscribed after this call)
+        publishFeatureContext();
+        cache->unsubscribeAll();
+    }
+}
+
+
+bool ANDOR_Camera::isFeatureCaching() const
+{
+    return std::atomic_load(&featureCache) != nullptr;
+}
+
+
+void ANDOR_Camera::setFeatureCachePolicy(const int feature_id, const ANDOR_FeatureCache::CachePolicy policy,
+                                         const unsigned int ttl)
+{
+    std::shared_ptr<ANDOR_FeatureCache> cache = threadFeatureCache();
+    if ( !cache ) {
+        throw AndorSDK_Exception(AT_ERR_NOTINITIALISED, "Cannot set feature cache policy! The cache is disabled!");
+    }
+
+    cache->setPolicy(feature_id, policy, ttl);
+}
+
+
+void ANDOR_Camera::invalidateFeatureCache()
+{
+    std::shared_ptr<ANDOR_FeatureCache> cache = threadFeatureCache();
+    if ( cache ) cache->invalidateAll();
+}
+
+
+ANDOR_FeatureCacheStats ANDOR_Camera::getFeatureCacheStats() const
+{
+    std::shared_ptr<ANDOR_FeatureCache> cache = std::atomic_load(&featureCache);
+    return cache ? cache->getStats() : ANDOR_FeatureCacheStats();
+}
+
+
+void ANDOR_Camera::resetFeatureCacheStats()
+{
+    std::shared_ptr<ANDOR_FeatureCache> cache = threadFeatureCache();
+    if ( cache ) cache->resetStats();
+}
+
+
+void ANDOR_Camera::setCallbackDispatching(const bool enable, const std::chrono::microseconds coalescing_interval)
+{
+    if ( enable ) {
+        if ( !callbackDispatcher ) {
+            callbackDispatcher.reset(new ANDOR_CallbackDispatcher([this](const std::vector<int> &feature_ids) {
+                dispatchFeatureCallbacks(feature_ids);
+            }, featuresNumber()));
+        }
+        callbackDispatcher->setCoalescingInterval(coalescing_interval);
+        activeDispatcher.store(callbackDispatcher.get(), std::memory_order_release);
+    } else {
+        if ( !activeDispatcher ) return;
+        activeDispatcher = nullptr; // the next notifications are direct calls
+        callbackDispatcher->flush(); // deliver the enqueued ones
+    }
+}
+
+
+bool ANDOR_Camera::isCallbackDispatching() const
+{
+    return activeDispatcher != nullptr;
+}
+
+
+void ANDOR_Camera::flushFeatureCallbacks()
+{
+    if ( callbackDispatcher ) callbackDispatcher->flush();
+}
+
+
+ANDOR_CallbackDispatcherStats ANDOR_Camera::getCallbackDispatcherStats() const
+{
+    return callbackDispatcher ? callbackDispatcher->getStats() : ANDOR_CallbackDispatcherStats();
+}
+
+
+void ANDOR_Camera::logToFile(const LOG_IDENTIFICATOR ident, const char *log_str, const int identation)
+{
+    logToFile(ident,std::string(log_str),identation);
+}
+
+
+void ANDOR_Camera::logToFile(const AndorSDK_Exception &ex, const int identation)
+{
+    std::stringstream str;
+    str << ex.what() << " [ANDOR SDK ERROR CODE: " << ex.getError() << "]";
+
+    logToFile(ANDOR_Camera::SDK_ERROR, str.str(), identation);
+}
+
+
+
+                    /*  PUBLIC OPERATORS[]  */
+
+ANDOR_Camera::ANDOR_Feature & ANDOR_Camera::operator [](const andor_string_t &feature_name)
+{
+    return selectFeature(featureId(feature_name)); // check for valid feature name
+}
+
+
+ANDOR_Camera::ANDOR_Feature & ANDOR_Camera::operator [](const AT_WC* feature_name)
+{
+    return selectFeature(featureId(feature_name));
+}
+
+
+// feature names are ASCII strings, so narrow name is resolved directly (no conversion to wide string)
+
+ANDOR_Camera::ANDOR_Feature & ANDOR_Camera::operator [](const std::string & feature_name)
+{
+    return selectFeature(featureId(feature_name));
+}
+
+
+ANDOR_Camera::ANDOR_Feature & ANDOR_Camera::operator [](const char* feature_name)
+{
+    return selectFeature(featureId(feature_name));
+}
+
+
+ANDOR_Camera::ANDOR_Feature & ANDOR_Camera::operator [](const int feature_id)
+{
+    return selectFeature(feature_id);
+}
+
+
+
+void ANDOR_Camera::operator ()(const andor_string_t & command_name)
+{
+    runCommand(command_name.c_str());
+}
+
+
+void ANDOR_Camera::operator ()(const AT_WC* command_name)
+{
+    runCommand(command_name);
+}
+
+
+void ANDOR_Camera::operator ()(const std::string & command_name)
+{
+    runCommand(internCommandName(command_name.c_str()), command_name.c_str());
+}
+
+
+void ANDOR_Camera::operator ()(const char* command_name)
+{
+    runCommand(internCommandName(command_name), command_name);
+}
+
+
+
+                    /*  TYPED ACCESS TO SDK FEATURES  */
+
+template<typename CallT>
+void ANDOR_Camera::featureCall(const ANDOR_SdkFunction sdk_func, const int id, CallT call)
+{
+    // the result is not stored into 'lastError': features may be accessed from several threads
+    int err = andor_timed_sdk_call(sdk_func, id, call);
+
+    // the message is formatted only if it is needed
+    if ( err == AT_SUCCESS && !isVerboseLog() ) return;
+
+    std::string log_str = std::string(andor_sdk_function_name(sdk_func)) + "('" + featureDescriptor(id)->narrowName +
+                          "', " + std::to_string(cameraHndl) + ", ...)";
+
+    if ( isVerboseLog() ) logToFile(ANDOR_Camera::CAMERA_INFO, log_str);
+
+    andor_sdk_assert(err, log_str);
+}
+
+
+template<typename T, typename CallT>
+void ANDOR_Camera::cachedFeatureRead(const ANDOR_SdkFunction sdk_func, const int id, T &val, CallT call)
+{
+    unsigned int token = 0;
+
+    std::shared_ptr<ANDOR_FeatureCache> cache = threadFeatureCache(); // alive for the whole call
+
+    if ( cache && cache->lookup(id, val, token) ) return;
+
+    featureCall(sdk_func, id, call);
+
+    if ( cache ) cache->store(id, token, val);
+}
+
+
+const ANDOR_EnumMetadata* ANDOR_Camera::enumTable(const int id)
+{
+    const ANDOR_EnumMetadata* table = enumMetadata->table(id);
+
+    if ( table ) return table;
+
+    ANDOR_EnumMetadata new_table;
+    int count;
+    AT_WC str[ANDOR_SDK_ENUM_FEATURE_STRLEN];
+    AT_BOOL flag;
+
+    featureCall(ANDOR_SDK_GET_ENUM_COUNT, id, [&]() { return AT_GetEnumCount(cameraHndl, featureName(id), &count); });
+
+    for ( int i = 0; i < count; ++i ) {
+        featureCall(ANDOR_SDK_GET_ENUM_STRING_BY_INDEX, id,
+                    [&]() { return AT_GetEnumStringByIndex(cameraHndl, featureName(id), i, str, ANDOR_SDK_ENUM_FEATURE_STRLEN); });
+        new_table.values.push_back(str);
+
+        featureCall(ANDOR_SDK_IS_ENUM_INDEX_IMPLEMENTED, id,
+                    [&]() { return AT_IsEnumIndexImplemented(cameraHndl, featureName(id), i, &flag); });
+        if ( flag ) new_table.implemented.push_back(i);
+    }
+
+    return enumMetadata->setTable(id, std::move(new_table));
+}
+
+
+void ANDOR_Camera::getFeatureValue(const int id, bool &val, FeatureTypeTag<BoolType>)
+{
+    AT_BOOL flag;
+
+    cachedFeatureRead(ANDOR_SDK_GET_BOOL, id, flag, [&]() { return AT_GetBool(cameraHndl, featureName(id), &flag); });
+
+    val = flag == AT_TRUE;
+}
+
+
+void ANDOR_Camera::getFeatureValue(const int id, AT_64 &val, FeatureTypeTag<IntType>)
+{
+    cachedFeatureRead(ANDOR_SDK_GET_INT, id, val, [&]() { return AT_GetInt(cameraHndl, featureName(id), &val); });
+}
+
+
+void ANDOR_Camera::getFeatureValue(const int id, double &val, FeatureTypeTag<FloatType>)
+{
+    cachedFeatureRead(ANDOR_SDK_GET_FLOAT, id, val, [&]() { return AT_GetFloat(cameraHndl, featureName(id), &val); });
+}
+
+
+void ANDOR_Camera::getFeatureValue(const int id, andor_string_t &val, FeatureTypeTag<StringType>)
+{
+    int len;
+
+    featureCall(ANDOR_SDK_GET_STRING_MAX_LENGTH, id,
+                [&]() { return AT_GetStringMaxLength(cameraHndl, featureName(id), &len); });
+
+    if ( !len ) {
+        val.clear();
+        throw AndorSDK_Exception(AT_ERR_NULL_MAXSTRINGLENGTH,"Length of string feature value is 0!");
+    }
+
+    std::vector<AT_WC> str(len);
+
+    featureCall(ANDOR_SDK_GET_STRING, id, [&]() { return AT_GetString(cameraHndl, featureName(id), str.data(), len); });
+
+    val = str.data();
+}
+
+
+void ANDOR_Camera::getFeatureValue(const int id, andor_string_t &val, FeatureTypeTag<EnumType>)
+{
+    andor_enum_index_t index = getFeatureEnumIndex(id);
+
+    const ANDOR_EnumMetadata* table = enumTable(id);
+
+    if ( index >= 0 && (size_t)index < table->values.size() ) { // no SDK call
+        val = table->values[index];
+        return;
+    }
+
+    AT_WC str[ANDOR_SDK_ENUM_FEATURE_STRLEN];
+
+    featureCall(ANDOR_SDK_GET_ENUM_STRING_BY_INDEX, id,
+                [&]() { return AT_GetEnumStringByIndex(cameraHndl, featureName(id), index, str, ANDOR_SDK_ENUM_FEATURE_STRLEN); });
+
+    val = str;
+}
+
+
+void ANDOR_Camera::setFeatureValue(const int id, const bool &val, FeatureTypeTag<BoolType>)
+{
+    invalidateCachedFeature(id);
+
+    featureCall(ANDOR_SDK_SET_BOOL, id,
+                [&]() { return AT_SetBool(cameraHndl, featureName(id), val ? AT_TRUE : AT_FALSE); });
+}
+
+
+void ANDOR_Camera::setFeatureValue(const int id, const AT_64 &val, FeatureTypeTag<IntType>)
+{
+    invalidateCachedFeature(id);
+
+    featureCall(ANDOR_SDK_SET_INT, id, [&]() { return AT_SetInt(cameraHndl, featureName(id), val); });
+}
+
+
+void ANDOR_Camera::setFeatureValue(const int id, const double &val, FeatureTypeTag<FloatType>)
+{
+    invalidateCachedFeature(id);
+
+    featureCall(ANDOR_SDK_SET_FLOAT, id, [&]() { return AT_SetFloat(cameraHndl, featureName(id), val); });
+}
+
+
+void ANDOR_Camera::setFeatureValue(const int id, const andor_string_t &val, FeatureTypeTag<StringType>)
+{
+    invalidateCachedFeature(id);
+
+    featureCall(ANDOR_SDK_SET_STRING, id, [&]() { return AT_SetString(cameraHndl, featureName(id), val.c_str()); });
+}
+
+
+void ANDOR_Camera::setFeatureValue(const int id, const andor_string_t &val, FeatureTypeTag<EnumType>)
+{
+    int index = enumTable(id)->index(val.c_str());
+
+    if ( index >= 0 ) { // SDK does not compare strings
+        setFeatureEnumIndex(id, index);
+        return;
+    }
+
+    invalidateCachedFeature(id);
+
+    featureCall(ANDOR_SDK_SET_ENUM_STRING, id,
+                [&]() { return AT_SetEnumString(cameraHndl, featureName(id), val.c_str()); });
+}
+
+
+andor_enum_index_t ANDOR_Camera::getFeatureEnumIndex(const int id)
+{
+    andor_enum_index_t index;
+
+    cachedFeatureRead(ANDOR_SDK_GET_ENUM_INDEX, id, index,
+                      [&]() { return AT_GetEnumIndex(cameraHndl, featureName(id), &index); });
+
+    return index;
+}
+
+
+void ANDOR_Camera::setFeatureEnumIndex(const int id, const andor_enum_index_t index)
+{
+    invalidateCachedFeature(id);
+
+    featureCall(ANDOR_SDK_SET_ENUM_INDEX, id, [&]() { return AT_SetEnumIndex(cameraHndl, featureName(id), index); });
+}
+
+
+
+
+                    /*  PROTECTED METHODS  */
+
+// acquisition thread function: return released buffers to SDK, wait for the next one and hand it off to consumers
+
+void ANDOR_Camera::waitBufferFunc()
+{
+    AT_U8* ptr;
+    int ptr_size;
+    int err;
+    ANDOR_CapturedBuffer buff;
+    size_t frame_number = 0;
+    std::shared_ptr<ANDOR_FrameRecycler> recycler = std::atomic_load(&frameRecycler);
+    std::shared_ptr<ANDOR_RingQueue<ANDOR_CapturedBuffer>> ready_buffers = std::atomic_load(&readyBuffers);
+    ANDOR_FrameStatistics* stats;
+    float* calibrated;
+
+    while ( acquisitionActive ) {
+        // requeue buffers before waiting, so SDK never runs out of them because of a slow hand-off
+        while ( recycler->popReleased(ptr) ) {
+            err = andor_timed_sdk_call(ANDOR_SDK_QUEUE_BUFFER, -1,
+                                       [&]() { return AT_QueueBuffer(cameraHndl, ptr, imageBufferSize); });
+            if ( err != AT_SUCCESS ) acquisitionError = err;
+        }
+
+        err = andor_timed_sdk_call(ANDOR_SDK_WAIT_BUFFER, -1,
+                                   [&]() { return AT_WaitBuffer(cameraHndl, &ptr, &ptr_size, waitBufferTimeout); });
+
+        if ( err == AT_ERR_TIMEDOUT ) continue;
+
+        if ( err == AT_ERR_NODATA ) { // all buffers are held by consumers: wait for released ones
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        if ( err != AT_SUCCESS ) {
+            acquisitionError = err;
+            logToFile(ANDOR_Camera::SDK_ERROR, "AT_WaitBuffer returns error code " + std::to_string(err) +
+                      " in acquisition thread! Stop the thread!");
+            break;
+        }
+
+        buff.ptr = ptr;
+        buff.size = ptr_size;
+        buff.number = frame_number++;
+        buff.timestamp = std::chrono::steady_clock::now();
+        buff.statistics = nullptr;
+        buff.generation = recycler->generation();
+
+        // statistics are computed while the buffer is owned by the thread (the slot belongs to the buffer)
+        stats = frameStatisticsEngine ? recycler->statistics(ptr) : nullptr;
+        if ( stats ) {
+            try {
+                frameStatisticsEngine->compute(ptr, recycler->geometry(), *stats);
+                stats->number = buff.number;
+                stats->timestamp = buff.timestamp;
+                buff.statistics = stats;
+            } catch ( ... ) { // e.g. std::bad_alloc: the frame is handed off without statistics
+            }
+        }
+
+        // the same for calibrated image (the kernel runs on the worker pool, so it keeps up with the camera)
+        buff.calibrated = nullptr;
+        // (the image is owned by the buffer until it is released, no free image means no calibration)
+        calibrated = acquisitionCalibrator ? recycler->takeCalibrated(ptr) : nullptr;
+        if ( calibrated ) {
+            try {
+                acquisitionCalibrator->calibrate(ptr, recycler->geometry(), calibrated);
+                buff.calibrated = calibrated;
+            } catch ( ... ) { // e.g. masters of other size were set: the frame is handed off without calibration
+                recycler->dropCalibrated(ptr);
             }
         }
+
+        if ( ready_buffers->push(buff) ) {
+            {
+                std::lock_guard<std::mutex> lock(readyBuffersMutex);
+            }
+            readyBuffersCond.notify_one();
+        } else { // consumers are too slow: drop the frame and give the buffer back to SDK immediately
+            ++droppedFramesNumber;
+            recycler->dropCalibrated(ptr);
+            err = andor_timed_sdk_call(ANDOR_SDK_QUEUE_BUFFER, -1,
+                                       [&]() { return AT_QueueBuffer(cameraHndl, ptr, ptr_size); });
+            if ( err != AT_SUCCESS ) acquisitionError = err;
+        }
+    }
+
+    acquisitionActive = false;
+
+    {
+        std::lock_guard<std::mutex> lock(readyBuffersMutex);
+    }
+    readyBuffersCond.notify_all();
+}
+
+
+void ANDOR_Camera::readFrameGeometry()
+{
+    AT_64 val = (*this)["AOIWidth"];
+    frameGeometry.width = val;
+
+    val = (*this)["AOIHeight"];
+    frameGeometry.height = val;
+
+    ANDOR_EnumFeature encoding = (*this)["PixelEncoding"];
+    frameGeometry.encoding = andor_pixel_encoding(encoding.value().c_str());
+
+    try {
+        val = (*this)["AOIStride"];
+        frameGeometry.stride = val;
+    } catch ( AndorSDK_Exception &ex ) { // not implemented (e.g. Apogee cameras): rows are not padded
+        frameGeometry.stride = andor_row_bytes(frameGeometry.width, frameGeometry.encoding);
+    }
+
+    std::string log_str = "Frame geometry: " + std::to_string(frameGeometry.width) + "x" +
+                          std::to_string(frameGeometry.height) + " pixels, stride " +
+                          std::to_string(frameGeometry.stride) + " bytes, encoding '" + encoding.value_to_string() + "'";
+    logToFile(ANDOR_Camera::CAMERA_INFO, log_str, 1);
+}
+
+
+void ANDOR_Camera::logToFile(const ANDOR_Feature &feature, const int identation)
+{
+    logToFile(ANDOR_Camera::CAMERA_INFO, feature.getLastLogMessage(), identation);
+}
+
+
+ANDOR_Camera::ANDOR_Feature & ANDOR_Camera::selectFeature(const int id)
+{
+    const AndorFeatureDescriptor* desc = featureDescriptor(id);
+
+    ANDOR_Feature &feature = threadFeature();
+
+    if ( desc ) {
+        feature.setType(desc->type);
+        feature.setName(desc->name, desc->narrowName, id);
+        return feature;
+    }
+
+    feature.setType(UnknownType);
+    throw AndorSDK_Exception(AT_ERR_NOTIMPLEMENTED,"Unknown ANDOR SDK feature!");
+}
+
+
+ANDOR_Camera::ANDOR_Feature & ANDOR_Camera::threadFeature()
+{
+    return threadProxy().feature;
+}
+
+
+std::shared_ptr<ANDOR_FeatureCache> ANDOR_Camera::threadFeatureCache()
+{
+    return threadProxy().context->featureCache;
+}
+
+
+void ANDOR_Camera::invalidateCachedFeature(const int id)
+{
+    std::shared_ptr<ANDOR_FeatureCache> cache = threadFeatureCache();
+    if ( cache ) cache->invalidate(id);
+}
+
+
+ANDOR_Camera::FeatureProxy & ANDOR_Camera::threadProxy()
+{
+    struct Slot {
+        uint64_t serial;
+        FeatureProxy *proxy;
+    };
+
+    // object serial is checked instead of its address: a new object may be placed at the address of destroyed one
+    static thread_local Slot slots[ANDOR_CAMERA_THREAD_FEATURE_SLOTS] = {};
+    static thread_local size_t next_slot = 0;
+
+    // the registry entries of the thread are erased at the thread exit (the camera may be destroyed already)
+    struct ProxiesReclaimer {
+        std::vector<uint64_t> serials;
+
+        void add(const uint64_t serial)
+        {
+            std::lock_guard<std::mutex> lock(live_cameras_mutex);
+
+            // serials of destroyed cameras are dropped: the list is bounded by the number of existing cameras
+            serials.erase(std::remove_if(serials.begin(), serials.end(), [](const uint64_t s) {
+                return live_cameras.find(s) == live_cameras.end();
+            }), serials.end());
+
+            serials.push_back(serial);
+        }
+
+        ~ProxiesReclaimer()
+        {
+            const std::thread::id id = std::this_thread::get_id();
+
+            std::lock_guard<std::mutex> lock(live_cameras_mutex);
+            for ( const uint64_t serial: serials ) {
+                auto it = live_cameras.find(serial);
+                if ( it == live_cameras.end() ) continue;
+
+                std::lock_guard<std::mutex> proxies_lock(it->second->featureProxiesMutex);
+                it->second->featureProxies.erase(id);
+            }
+        }
+    };
+
+    static thread_local ProxiesReclaimer reclaimer;
+
+    FeatureProxy* proxy = nullptr;
+
+    for ( Slot &slot: slots ) {
+        if ( slot.serial == objectSerial ) {
+            proxy = slot.proxy;
+            break;
+        }
+    }
+
+    if ( !proxy ) {
+        bool created = false;
+        {
+            std::lock_guard<std::mutex> lock(featureProxiesMutex);
+
+            std::unique_ptr<FeatureProxy> &registered = featureProxies[std::this_thread::get_id()];
+            if ( !registered ) {
+                registered.reset(new FeatureProxy());
+                created = true;
+            }
+            proxy = registered.get();
+        }
+
+        if ( created ) reclaimer.add(objectSerial);
+
+        Slot &slot = slots[next_slot];
+        next_slot = (next_slot + 1) % ANDOR_CAMERA_THREAD_FEATURE_SLOTS;
+
+        slot.serial = objectSerial;
+        slot.proxy = proxy;
+    }
+
+    // only the owner thread configures its proxy, so a proxy is never changed while it calls SDK
+    uint64_t version = featureContextVersion.load(std::memory_order_acquire);
+    if ( proxy->contextVersion != version ) {
+        proxy->context = std::atomic_load(&featureContext);
+        proxy->contextVersion = version;
+
+        proxy->feature.setDeviceHndl(proxy->context->deviceHndl);
+        proxy->feature.setLoggingFunc(proxy->context->loggingFunc);
+        proxy->feature.setFeatureCache(proxy->context->featureCache.get());
+        proxy->feature.setEnumMetadata(proxy->context->enumMetadata);
+    }
+
+    return *proxy;
+}
+
+
+void ANDOR_Camera::publishFeatureContext()
+{
+    std::shared_ptr<FeatureContext> context = std::make_shared<FeatureContext>();
+
+    context->deviceHndl = cameraHndl;
+    if ( logLevel == LOG_LEVEL_VERBOSE ) { // extra logging function (logging from SDK function calling)
+        context->loggingFunc = std::bind(
+           static_cast<void(ANDOR_Camera::*)(const ANDOR_Camera::LOG_IDENTIFICATOR, const std::string&, const int)>
+           (&ANDOR_Camera::logToFile), this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3
+                                    );
+    }
+    context->featureCache = std::atomic_load(&featureCache);
+    context->enumMetadata = enumMetadata.get();
+
+    std::lock_guard<std::mutex> lock(featureProxiesMutex);
+
+    std::atomic_store(&featureContext, std::shared_ptr<const FeatureContext>(context));
+    featureContextVersion.fetch_add(1, std::memory_order_release);
+}
+
+
+void ANDOR_Camera::dispatchFeatureCallbacks(const std::vector<int> &feature_ids)
+{
+    // callbacks are copied and called without the lock: a callback may access features,
+    // and the thread which reads a feature may subscribe the caches to SDK callbacks
+    dispatchedCallbacks.clear();
+    {
+        std::lock_guard<std::mutex> lock(callbackContextMutex);
+        for ( const int id: feature_ids ) {
+            for ( auto &ctx: callbackContextPtr ) {
+                if ( !ctx->direct && ctx->feature_id == id ) dispatchedCallbacks.push_back(*ctx);
+            }
+        }
+    }
+
+    for ( CallbackContext &ctx: dispatchedCallbacks ) {
+        try {
+            ctx.func(ctx.feature_name, ctx.user_context);
+        } catch ( AndorSDK_Exception &ex ) {
+            logToFile(ex);
+        } catch ( ... ) { // the dispatcher thread must keep working
+            logToFile(ANDOR_Camera::CAMERA_ERROR, "Feature callback function threw an exception!");
+        }
+    }
+
+    dispatchedCallbacks.clear(); // do not keep copies of user functions
+}
+
+
+void ANDOR_Camera::subscribeCalibratorExposure()
+{
+    if ( !acquisitionCalibrator ) return;
+
+    // the calibrator is thread-safe, so the dark master is rescaled by the callback thread while frames
+    // are calibrated (the callback keeps its own reference to the calibrator)
+    std::shared_ptr<ANDOR_FrameCalibrator> calibrator = acquisitionCalibrator;
+    try {
+        registerCallback(L"ExposureTime", [this, calibrator](andor_string_t, void*) {
+            try {
+                calibrator->setExposure(*this);
+            } catch ( AndorSDK_Exception &ex ) {
+                logToFile(ex);
+            }
+            return AT_CALLBACK_SUCCESS;
+        }, calibrator.get(), false);
+        exposureSubscribed = true;
+    } catch ( AndorSDK_Exception &ex ) {
+        logToFile(ANDOR_Camera::CAMERA_ERROR, std::string(ex.what()) +
+                  " Exposure time changes are not applied to frame calibration!", 1);
+    }
+}
+
+
+void ANDOR_Camera::unsubscribeCalibratorExposure()
+{
+    if ( !exposureSubscribed ) return;
+
+    exposureSubscribed = false;
+    try {
+        unregisterFeatureCallback(L"ExposureTime", nullptr, acquisitionCalibrator.get());
+    } catch ( AndorSDK_Exception &ex ) {
+        logToFile(ex);
+    }
+}
+
+
+template<typename CacheT>
+bool ANDOR_Camera::subscribeFeatureChanges(CacheT *cache, const int id, const bool subscribe)
+{
+    if ( cameraHndl == AT_HANDLE_UNINITIALISED || cache == nullptr ) return false;
+
+    try {
+        if ( subscribe ) {
+            registerCallback(featureName(id), [cache, id](andor_string_t, void*) {
+                cache->notifyChange(id);
+                return AT_CALLBACK_SUCCESS;
+            }, cache, true);
+        } else {
+            unregisterFeatureCallback(featureName(id), nullptr, cache);
+        }
+    } catch ( AndorSDK_Exception &ex ) { // e.g. the feature is not implemented
+        logToFile(ex);
+        return false;
+    }
+
+    return true;
+}
+
+
+const AT_WC* ANDOR_Camera::internCommandName(const char *command_name)
+{
+    if ( command_name == nullptr ) return nullptr;
+
+    std::lock_guard<std::mutex> lock(commandNamesMutex);
+
+    // there are a few SDK commands, so linear search is enough
+    for ( auto &name: commandNames ) {
+        if ( name.first == command_name ) return name.second.c_str();
+    }
+
+    std::wstring_convert<std::codecvt_utf8<AT_WC>> cvt;
+
+    commandNames.push_back(std::make_pair(std::string(command_name), cvt.from_bytes(command_name)));
+
+    return commandNames.back().second.c_str();
+}
+
+
+void ANDOR_Camera::runCommand(const AT_WC *command_name, const char *narrow_name)
+{
+    int err = andor_timed_sdk_call(ANDOR_SDK_COMMAND, -1, [&]() { return AT_Command(cameraHndl, command_name); });
+
+    // the message is formatted only if it is needed
+    if ( err == AT_SUCCESS && !isVerboseLog() ) return;
+
+    std::string log_str = "AT_Command(" + std::to_string(cameraHndl) + ", ";
+    if ( narrow_name ) {
+        log_str += narrow_name;
+    } else if ( command_name ) {
+        std::wstring_convert<std::codecvt_utf8<AT_WC>> cnv;
+        log_str += cnv.to_bytes(command_name);
+    }
+    log_str += ")";
+
+    if ( isVerboseLog() ) logToFile(ANDOR_Camera::CAMERA_INFO,log_str);
+    andor_sdk_assert(err, log_str);
+}
+
+
+void ANDOR_Camera::allocateImageBuffers(int imageSizeBytes)
+{
+    std::string log_msg;
+
+    if ( requestedBuffersNumber == 0 ) {
+        log_msg = "Cannot allocate image buffers! The requested number of images is 0!";
+        throw AndorSDK_Exception(AT_ERR_NOMEMORY, log_msg);
+    }
+
+    size_t imageBuffersNumber = ( requestedBuffersNumber > maxBuffersNumber ) ? maxBuffersNumber : requestedBuffersNumber;
+
+
+    // real allocation only if it is needed (the previous pool stays alive while frames refer to it)
+    if ( !imageBufferPool || (imageBufferPool->buffersNumber() != imageBuffersNumber) ||
+         (imageBufferPool->bufferSize() != (size_t)imageSizeBytes) ||
+         (imageBufferPool->requestedFlags() != imageBufferPoolFlags) ) {
+
+        // release the old arena first, so the old and new ones are not mapped together. It is called by
+        // acquisitionStart after stale ready buffers were dropped and when no buffer is held by consumers.
+        // A consumer which has just popped a stale buffer either rejects it (the recycler is reset here,
+        // see popReadyBuffer) or has taken the old recycler, which keeps the old arena mapped until the frame is released
+        std::atomic_store(&frameRecycler, std::shared_ptr<ANDOR_FrameRecycler>());
+        imageBufferAddr.clear();
+        imageBufferPool.reset();
+
+        imageBufferPool = std::make_shared<ANDOR_ImageBufferPool>(imageBuffersNumber, imageSizeBytes, imageBufferPoolFlags);
+
+        imageBufferAddr.resize(imageBuffersNumber);
+        for ( size_t i = 0; i < imageBuffersNumber; ++i ) imageBufferAddr[i] = imageBufferPool->buffer(i);
     }
 
     imageBufferSize = imageSizeBytes;
@@ -3,6 +3,15 @@
 
 #include "../export_decl.h"
 #include "andorsdk_exception.h"
+#include "andor_ring_queue.h"
+#include "andor_frame.h"
+#include "andor_frame_stats.h"
+#include "andor_feature_list.h"
+#include "andor_call_stats.h"
+#include "andor_feature_cache.h"
+#include "andor_enum_metadata.h"
+#include "andor_sdk_library.h"
+#include "andor_callback_dispatcher.h"
 
 #include <atcore.h>
 
@@ -10,12 +19,18 @@
 #include <list>
 #include <vector>
 #include <map>
+#include <deque>
+#include <unordered_map>
 #include <utility>
 #include <iostream>
 #include <sstream>
 #include <functional>
 #include <thread>
 #include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
 
 // for MS compilers: disable multiple warnings about DLL-exports for the STL containers
 // (and many others C++11 defined classes, e.g., thread)
@@ -34,10 +49,22 @@ typedef int andor_enum_index_t; // type for ANDOR SDK enumerated feature index
 
 #define ANDOR_CAMERA_LOG_IDENTATION 3
 
+// compile-time minimal logging level (values of ANDOR_Camera::LOG_LEVEL: 0 - verbose, 1 - error, 2 - quiet).
+// Logging of lesser level is removed from the code (and ANDOR_Camera::setLogLevel cannot set it)
+#ifndef ANDOR_CAMERA_MIN_LOG_LEVEL
+#define ANDOR_CAMERA_MIN_LOG_LEVEL 0
+#endif
+
 const int ANDOR_SDK_ENUM_FEATURE_STRLEN = 30; // maximal length of string for enumerated feature
 
 #define ANDOR_CAMERA_DEFAULT_MAX_BUFFERS_NUMBER 50 // default maximum buffers number to be allocated for reading data
 
+#define ANDOR_CAMERA_DEFAULT_WAIT_BUFFER_TIMEOUT 100 // default timeout (in millisecs) of AT_WaitBuffer in acquisition thread
+
+#define ANDOR_CAMERA_DEFAULT_LOG_QUEUE_CAPACITY 4096 // default number of records in the queue of asynchronous logger
+
+#define ANDOR_CAMERA_DEFAULT_CALIBRATED_IMAGES 4 // default number of calibrated images in flight (see setFrameCalibrator)
+
 struct ANDOR_CameraInfo;      // just forward declaration
 class ANDOR_FeatureInfo;
 class NonNumericFeatureValue;
@@ -45,6 +72,8 @@ struct ANDOR_StringFeature;
 struct ANDOR_EnumFeature;
 class ANDOR_EnumFeatureInfo;
 struct CallbackContext;
+class ANDOR_AsyncLogger;
+class ANDOR_FrameCalibrator;
 
 
                     /************************************/
@@ -71,6 +100,18 @@ public:
 
     typedef std::map<andor_string_t,AndorFeatureType> AndorFeatureNameMap;
 
+    // an entry of the compile-time table of valid SDK features (see andor_feature_list.h)
+
+    struct AndorFeatureDescriptor {
+        const AT_WC* name;
+        const char* narrowName; // the same name as char string (names are ASCII)
+        AndorFeatureType type;
+    };
+
+    // type for snapshot of camera state: list of pairs <"NAME","VALUE">
+
+    typedef std::vector<std::pair<andor_string_t,andor_string_t>> AndorFeatureSnapshot;
+
     // type for feature callback function ( it differs from SDK defintion!!!)
     // such a definition allows use of class member as a callback function (see implementation of registerFeatureCallback method)
     // the first arg is feature name, the second one is pointer to context
@@ -114,6 +155,8 @@ protected:
 
         void setName(const andor_string_t &name);
         void setName(const AT_WC* name);
+        // no conversion (and no allocation for known name length), 'id' is AndorFeatureId
+        void setName(const AT_WC* name, const char* narrow_name, const int id);
 
         void setDeviceHndl(const AT_H hndl);
         AT_H getDeviceHndl() const;
@@ -121,18 +164,26 @@ protected:
         void setType(const AndorFeatureType &type);
         AndorFeatureType getType() const;
 
+        // the message of the last SDK function calling. NOTE: it is formatted only if logging function
+        // is set or an SDK error occured!
         std::string getLastLogMessage() const;
 
         // see declaration of 'log_func_t' type above
         void setLoggingFunc(const log_func_t &func = nullptr);
 
+        // values of numeric features are read through the cache if it is set (nullptr - no cache)
+        void setFeatureCache(ANDOR_FeatureCache* cache);
+
+        // strings and indices of enumerated features are taken from the metadata cache if it is set
+        void setEnumMetadata(ANDOR_EnumMetadataCache* metadata);
+
 
                  // get feature value operators
 
         template<typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
         operator T()
         {
-            T ret_val;
+            T ret_val = T(); // string and unknown features have no numeric value
             switch ( featureType ) {
                 case ANDOR_Camera::IntType: {
                     getInt();
@@ -240,6 +291,8 @@ protected:
         AT_H deviceHndl;
         AT_WC* featureName;
         andor_string_t featureNameStr;
+        std::string featureNameLog; // UTF-8 name for log messages
+        int featureIndex;           // AndorFeatureId (-1 if the feature is not in the table)
         AndorFeatureType featureType;
         union {
             AT_64 at64_val;  // integer feature
@@ -253,6 +306,9 @@ protected:
 
         log_func_t loggingFunc;
 
+        ANDOR_FeatureCache* featureCache;
+        ANDOR_EnumMetadataCache* enumMetadata;
+
 
         void setInt(const AT_64 val);
         void setFloat(const double val);
@@ -267,6 +323,9 @@ protected:
         std::pair<double,double> getFloatMinMax();
         std::vector<andor_string_t> getEnumInfo(std::vector<andor_enum_index_t> &imIdx, std::vector<andor_enum_index_t> &aIdx);
 
+        void readEnumTable(ANDOR_EnumMetadata &table); // strings and implemented indices from SDK
+        const ANDOR_EnumMetadata* getEnumTable();      // from the metadata cache (nullptr if it is not set)
+
         void getInt();
         void getFloat();
         void getBool();
@@ -284,6 +343,16 @@ protected:
         template<typename... T>
         void formatLogMessage(const char* sdk_func, T... args);
 
+        // call SDK function ('call' returns its result), check the result (throw AndorSDK_Exception)
+        // and format the log message lazily ('args' are arguments of SDK function for the message)
+        template<typename CallT, typename... T>
+        void checkSdkCall(const ANDOR_SdkFunction sdk_func, CallT call, T... args);
+
+        // the same as checkSdkCall but the value 'val' (read by 'call') is served from the feature cache
+        // (if it is set and the cached value is valid) or stored into it
+        template<typename ValT, typename CallT, typename... T>
+        void cachedSdkRead(ValT &val, const ANDOR_SdkFunction sdk_func, CallT call, T... args);
+
         // helper methods for logging
         template<typename T1, typename... T2>
         inline void logHelper(T1 first, T2... last);
@@ -323,18 +392,124 @@ public:
     void queueBuffer(AT_U8* ptr, int ptr_size);
     void flush();
 
-    virtual void acquisitionStart(){}
-    virtual void acquisitionStop(){}
+            /*  acquisition engine  */
+
+    // start/stop acquisition thread (AT_WaitBuffer -> hand-off -> AT_QueueBuffer loop)
+    virtual void acquisitionStart();
+    virtual void acquisitionStop();
+
+    bool isAcquiring() const;
+
+    // get the next captured frame (returns false if no frame arrived within 'timeout' millisecs
+    // or acquisition was stopped). The image buffer is re-queued when the frame handle is destroyed
+    bool waitFrame(ANDOR_Frame &frame, unsigned int timeout = AT_INFINITE);
+
+    // get the next captured image buffer (returns false if no buffer arrived within 'timeout' millisecs
+    // or acquisition was stopped). The buffer must be returned back by releaseImageBuffer
+    bool getImageBuffer(AT_U8** ptr, int *ptr_size, unsigned int timeout = AT_INFINITE);
+    // throws AndorSDK_Exception(AT_ERR_INVALIDHANDLE) if 'ptr' is not a held buffer of the current acquisition
+    void releaseImageBuffer(AT_U8* ptr);
+
+    ANDOR_FrameGeometry getFrameGeometry() const; // image geometry of the current (last) acquisition
+
+    size_t getDroppedFramesNumber() const; // number of frames dropped due to full queue of captured buffers
+    int getAcquisitionError() const;       // last SDK error from acquisition thread
+
+    void setWaitBufferTimeout(const unsigned int timeout);
+    unsigned int getWaitBufferTimeout() const;
+
+    // CPU of the acquisition thread (AT_WaitBuffer, re-queuing of buffers, frame statistics and calibration,
+    // hand-off to consumers). -1 - no pinning (the default). It takes effect at the next acquisitionStart.
+    // Data-parallel kernels of statistics and calibration still run on their worker pools
+    void setAcquisitionThreadCpu(const int cpu);
+    int getAcquisitionThreadCpu() const;
+    bool isAcquisitionThreadPinned() const; // the thread of the current (last) acquisition is pinned
 
     void setMaxBuffersNumber(const size_t num);
     size_t getMaxBuffersNumber() const;
 
+    // allocation policy of image buffer pool (see ANDOR_ImageBufferPool::PoolFlags)
+    void setImageBufferPoolFlags(const int flags);
+    int getImageBufferPoolFlags() const;
+
+    // pixel statistics of every frame (see ANDOR_FrameStatisticsEngine) computed by the acquisition
+    // thread before the hand-off and published with the frame handle (see ANDOR_Frame::statistics).
+    // It takes effect at the next acquisitionStart
+    void setFrameStatistics(const bool enable, const int flags = ANDOR_FrameStatisticsEngine::Histogram);
+    bool isFrameStatistics() const;
+
+    // calibration of every frame (see ANDOR_FrameCalibrator) by the acquisition thread before the hand-off.
+    // The calibrated image is published with the frame handle (see ANDOR_Frame::calibrated) and it is owned
+    // by the frame until the buffer is released. There are 'images_number' float images only (they are allocated
+    // once and reused by the following acquisitions): if all of them are held, frames are handed off
+    // without calibrated image (ANDOR_Frame::calibrated() is nullptr), a consumer can calibrate such a frame itself.
+    // Exposure time of the calibrator is set from the camera at acquisitionStart and then follows
+    // 'ExposureTime' changes during acquisition (via feature callback).
+    // It takes effect at the next acquisitionStart (nullptr disables calibration)
+    void setFrameCalibrator(const std::shared_ptr<ANDOR_FrameCalibrator> &calibrator,
+                            const size_t images_number = ANDOR_CAMERA_DEFAULT_CALIBRATED_IMAGES);
+    std::shared_ptr<ANDOR_FrameCalibrator> getFrameCalibrator() const;
+
             /* operator[] for accessing Andor SDK features (const and non-const versions) */
 
+    // Every thread has its own feature proxy, so the operators (as well as typed access below)
+    // can be used concurrently from several threads (e.g. telemetry and control ones).
+    // The returned reference must not be passed to other thread. Connection, disconnection,
+    // change of log level and switching of the feature cache must not run concurrently with feature access
+
     ANDOR_Feature& operator[](const andor_string_t &feature_name);
     ANDOR_Feature& operator[](const AT_WC* feature_name);
     ANDOR_Feature& operator[](const std::string &feature_name);
     ANDOR_Feature& operator[](const char* feature_name);
+    ANDOR_Feature& operator[](const int feature_id); // AndorFeatureId (resolved once)
+
+            /*  typed access to Andor SDK features  */
+
+    // F is a tag from AndorFeature namespace (see below), e.g.:
+    //    double exp_time = camera.get<AndorFeature::ExposureTime>();
+    //    camera.set<AndorFeature::CycleMode>(L"Fixed");
+    // The feature name and type are resolved at compile time (no name lookup and no type switch),
+    // so a value of wrong type is a compilation error. For enumerated features get/set work with
+    // string value, getIndex/setIndex - with index
+
+    template<typename F>
+    typename F::value_type get()
+    {
+        typename F::value_type val;
+        getFeatureValue(F::id, val, FeatureTypeTag<F::type>());
+        return val;
+    }
+
+    template<typename F>
+    void set(const typename F::value_type &val)
+    {
+        setFeatureValue(F::id, val, FeatureTypeTag<F::type>());
+    }
+
+    template<typename F>
+    andor_enum_index_t getIndex()
+    {
+        static_assert(F::type == EnumType, "getIndex() is only for enumerated features!");
+        return getFeatureEnumIndex(F::id);
+    }
+
+    template<typename F>
+    void setIndex(const andor_enum_index_t index)
+    {
+        static_assert(F::type == EnumType, "setIndex() is only for enumerated features!");
+        setFeatureEnumIndex(F::id, index);
+    }
+
+            /*  table of valid Andor SDK features  */
+
+    static size_t featuresNumber();
+    static int featureId(const AT_WC* feature_name); // -1 if the name is unknown (bisection, no allocations)
+    static int featureId(const andor_string_t &feature_name);
+    static int featureId(const char* feature_name);
+    static int featureId(const std::string &feature_name);
+    static const AndorFeatureDescriptor* featureDescriptor(const int id); // nullptr if the ID is invalid
+    static const AT_WC* featureName(const int id);    // nullptr if the ID is invalid
+    static AndorFeatureType featureType(const int id); // UnknownType if the ID is invalid
 
             /*  operator() - wrapper to AT_Command  */
 
@@ -345,10 +520,42 @@ public:
 
             /* Andor SDK global features */
 
+    // the proxies are shared by all threads (like any ANDOR_Feature object they must not be used
+    // concurrently): a thread reading them concurrently should use its own proxy,
+    // e.g. ANDOR_Feature(AT_HANDLE_SYSTEM, L"DeviceCount") (the class uses only its own ones)
     static ANDOR_Feature DeviceCount;
     static ANDOR_Feature SoftwareVersion;
 
-    static std::list<ANDOR_CameraInfo> getFoundCameras() {return foundCameras;}
+            /* discovery of connected cameras */
+
+    // DISCOVERY_EAGER - the first constructor scans cameras (the default),
+    // DISCOVERY_BACKGROUND - the first constructor starts the scan in a background thread,
+    // DISCOVERY_ON_DEMAND - cameras are scanned at the first request of the results,
+    // DISCOVERY_DISABLED - no scan (connection by device index only, until rescanConnectedCameras() call).
+    // The mode must be set before the first object creation
+    enum DISCOVERY_MODE {DISCOVERY_EAGER, DISCOVERY_BACKGROUND, DISCOVERY_ON_DEMAND, DISCOVERY_DISABLED};
+
+    static void setDiscoveryMode(const DISCOVERY_MODE mode);
+    static DISCOVERY_MODE getDiscoveryMode();
+
+    static void waitDiscovery();         // wait for (or perform an on-demand) scan
+    static int rescanConnectedCameras(); // returns number of devices
+
+    // the methods below wait for the discovery
+    static std::list<ANDOR_CameraInfo> getFoundCameras();
+
+    static int findCameraBySerialNumber(const andor_string_t &serial_number); // device index (-1 if not found)
+
+    // file to persist results of camera discovery between runs (empty name - no persistence).
+    // It must be set before the first object creation (discovery is performed by the first constructor)
+    static void setDiscoveryCacheFile(const std::string &filename);
+    static std::string getDiscoveryCacheFile();
+
+    ANDOR_CameraInfo getCameraInfo() const; // info of connected camera
+
+    // read values of all implemented and readable features (a value is formatted as a string)
+    AndorFeatureSnapshot getFeatureSnapshot();
+    AndorFeatureSnapshot getFeatureSnapshot(const std::vector<andor_string_t> &feature_names); // only given features
 
            /*  logging methods */
 
@@ -356,9 +563,56 @@ public:
     void logToFile(const LOG_IDENTIFICATOR ident, const char *log_str, const int identation = 0); // general logging
     void logToFile(const AndorSDK_Exception &ex, const int identation = 0); // SDK error logging
 
+    // asynchronous logging: the caller only pushes a record into a lock-free queue, a background thread
+    // formats and writes records by batches (see ANDOR_AsyncLogger). A line is lost if the queue is full.
+    // It can be switched while other threads are logging (they keep a reference to the logger they use)
+    void setAsyncLogging(const bool enable, const size_t queue_capacity = ANDOR_CAMERA_DEFAULT_LOG_QUEUE_CAPACITY);
+    bool isAsyncLogging() const;
+    void flushLog(); // wait until all queued lines are written (no-op for synchronous logging)
+
+           /*  cache of feature values  */
+
+    // opt-in cache of values of numeric features and indices of enumerated ones (see ANDOR_FeatureCache):
+    // reads through operator[] and get<F>/getIndex<F> are served from memory until SDK notifies
+    // a change of the feature (or time-to-live expires for polled features, e.g. SensorTemperature)
+    void setFeatureCaching(const bool enable);
+    bool isFeatureCaching() const;
+
+    // 'feature_id' is AndorFeatureId, 'ttl' is in millisecs (only for TimeToLive policy)
+    void setFeatureCachePolicy(const int feature_id, const ANDOR_FeatureCache::CachePolicy policy,
+                               const unsigned int ttl = ANDOR_FEATURE_CACHE_DEFAULT_TTL);
+    void invalidateFeatureCache();
+
+    ANDOR_FeatureCacheStats getFeatureCacheStats() const; // empty statistics if the cache is disabled
+    void resetFeatureCacheStats();
+
+           /*  dispatching of feature callbacks  */
+
+    // callbacks registered by registerFeatureCallback are called by a dispatcher thread instead of
+    // SDK internal thread (see ANDOR_CallbackDispatcher): SDK thread only enqueues the feature, repeated
+    // notifications of a pending feature are coalesced into one call. 'coalescing_interval' delays
+    // the dispatch to collect a burst of notifications. Callbacks must not register/unregister callbacks
+    // (unregisterFeatureCallback waits for the dispatch in progress, except for a call from a callback)
+    void setCallbackDispatching(const bool enable,
+                                const std::chrono::microseconds coalescing_interval = std::chrono::microseconds(0));
+    bool isCallbackDispatching() const;
+    void flushFeatureCallbacks(); // wait until all enqueued callbacks are called (no-op for direct calls)
+
+    ANDOR_CallbackDispatcherStats getCallbackDispatcherStats() const; // empty statistics if it was never enabled
+
+    // format log line (without new-line character)
+    static void formatLogLine(std::string &line, const LOG_IDENTIFICATOR ident, const AT_H hndl, const char* time_stamp,
+                              const int identation, const char* msg, const size_t len);
+
 
 protected:
-    LOG_LEVEL logLevel;
+    std::atomic<LOG_LEVEL> logLevel; // may be changed while other threads log
+
+    // true if verbose logging is compiled and enabled (it is constant false for ANDOR_CAMERA_MIN_LOG_LEVEL > 0)
+    bool isVerboseLog() const
+    {
+        return ANDOR_CAMERA_MIN_LOG_LEVEL <= LOG_LEVEL_VERBOSE && logLevel == LOG_LEVEL_VERBOSE && cameraLog;
+    }
 
     AT_H cameraHndl;
     int cameraIndex;
@@ -366,44 +620,233 @@ protected:
     int lastError;
 
     std::ostream *cameraLog;
+    std::mutex cameraLogMutex; // synchronous logging
+
+    std::shared_ptr<ANDOR_AsyncLogger> asyncLogger; // accessed by std::atomic_load/atomic_store
+
+    // accessed by std::atomic_load/atomic_store only. Readers take the cache of their context (see threadFeatureCache),
+    // so the cache may be disabled while other threads use it
+    std::shared_ptr<ANDOR_FeatureCache> featureCache;
+
+    std::unique_ptr<ANDOR_EnumMetadataCache> enumMetadata; // always enabled (see ANDOR_EnumMetadataCache)
+
+    // camera state used by the feature proxies. It is immutable: a new context is published on every change
+    // (log level, connection, caching) and a proxy is reconfigured from it by its own thread on the next access
+    // (the proxy keeps the context, so the cache it uses is alive until then)
+    struct FeatureContext {
+        AT_H deviceHndl;
+        log_func_t loggingFunc;
+        std::shared_ptr<ANDOR_FeatureCache> featureCache;
+        ANDOR_EnumMetadataCache* enumMetadata;
+    };
+
+    std::shared_ptr<const FeatureContext> featureContext; // accessed by std::atomic_load/atomic_store only
+    std::atomic<uint64_t> featureContextVersion;          // incremented after a context is published
 
-    ANDOR_Feature cameraFeature;
+    struct FeatureProxy {
+        FeatureProxy();
+
+        ANDOR_Feature feature;
+        std::shared_ptr<const FeatureContext> context;
+        uint64_t contextVersion;
+    };
+
+    // feature proxies of threads (see operator[]): the proxy of calling thread is found via thread-local
+    // slots without locking, the registry is locked only at the first access of a thread and at its exit
+    // (the proxy of exited thread is removed). The mutex also serializes publishing of contexts
+    std::mutex featureProxiesMutex;
+    std::unordered_map<std::thread::id, std::unique_ptr<FeatureProxy>> featureProxies;
+    const uint64_t objectSerial; // unique identificator of the object (it is never reused, unlike the address)
+
+    FeatureProxy& threadProxy();    // the proxy of calling thread (reconfigured if a new context was published)
+    ANDOR_Feature& threadFeature();
+    std::shared_ptr<ANDOR_FeatureCache> threadFeatureCache(); // the cache of the current context (nullptr if disabled)
+    void invalidateCachedFeature(const int id);
+    void publishFeatureContext();   // publish the current device handle, logging function and caches
 
     void logToFile(const ANDOR_Feature &feature, const int identation = 0); // SDK function calling logging
 
+    ANDOR_Feature& selectFeature(const int id); // set name and type of the feature proxy of calling thread
+
+    // command names converted from narrow strings once (pairs <"NARROW NAME","WIDE NAME">).
+    // std::deque: growth does not move the elements, so returned wide names stay valid
+    std::deque<std::pair<std::string,andor_string_t>> commandNames;
+    std::mutex commandNamesMutex;
+
+    const AT_WC* internCommandName(const char* command_name);
+    void runCommand(const AT_WC* command_name, const char* narrow_name = nullptr);
+
 
     std::thread waitBufferThread;
 
     void waitBufferFunc();
 
-    // vector of pointers to image buffers
-    std::vector<std::unique_ptr<AT_U8[]>> imageBufferAddr;
+    std::atomic<bool> acquisitionActive;
+    std::atomic<int> acquisitionError;
+    std::atomic<size_t> droppedFramesNumber;
+    unsigned int waitBufferTimeout;
+    int acquisitionThreadCpu;
+    bool acquisitionThreadPinned;
+
+    ANDOR_FrameGeometry frameGeometry;
+    void readFrameGeometry();
+
+    // queues of image buffers: captured by acquisition thread and returned back by consumers
+    // both are accessed by std::atomic_load/atomic_store only (consumers may wait while acquisitionStart replaces them)
+    std::shared_ptr<ANDOR_RingQueue<ANDOR_CapturedBuffer>> readyBuffers;
+    std::shared_ptr<ANDOR_FrameRecycler> frameRecycler;
+
+    // 'recycler' is the recycler of acquisition of the popped buffer (buffers of previous acquisitions are dropped)
+    bool popReadyBuffer(ANDOR_CapturedBuffer &buffer, unsigned int timeout, std::shared_ptr<ANDOR_FrameRecycler> &recycler);
+
+    std::mutex readyBuffersMutex;
+    std::condition_variable readyBuffersCond;
+
+    // vector of pointers to image buffers (slots of the pool arena)
+    std::shared_ptr<ANDOR_ImageBufferPool> imageBufferPool;
+    std::vector<AT_U8*> imageBufferAddr;
     size_t imageBufferSize;
+    int imageBufferPoolFlags;
 
     size_t maxBuffersNumber;
     size_t requestedBuffersNumber;
 
+    int frameStatisticsFlags; // -1 if frame statistics are disabled
+    std::unique_ptr<ANDOR_FrameStatisticsEngine> frameStatisticsEngine; // used by acquisition thread only
+
+    std::shared_ptr<ANDOR_FrameCalibrator> frameCalibrator;
+    std::shared_ptr<ANDOR_FrameCalibrator> acquisitionCalibrator; // used by acquisition thread only
+    size_t calibratedImagesNumber;
+    std::shared_ptr<std::vector<float>> calibratedImages; // storage of ANDOR_FrameRecycler ring (reused by acquisitions)
+    bool exposureSubscribed; // 'ExposureTime' callback of acquisitionCalibrator is registered
+
+    void subscribeCalibratorExposure();
+    void unsubscribeCalibratorExposure();
+
     void allocateImageBuffers(int imageSizeBytes);  // allocate image buffers
 
 
 //    std::list<CallbackContext*> callbackContextPtr;
     std::list<std::unique_ptr<CallbackContext>>  callbackContextPtr;
+    std::mutex callbackContextMutex;
+
+    // the dispatcher lives until destruction (SDK thread may still hold it after disabling),
+    // activeDispatcher is nullptr if dispatching is disabled (it is read by feature_callback)
+    std::unique_ptr<ANDOR_CallbackDispatcher> callbackDispatcher;
+    std::atomic<ANDOR_CallbackDispatcher*> activeDispatcher;
+    std::vector<CallbackContext> dispatchedCallbacks; // callbacks of a batch (dispatcher thread only)
+
+    // 'direct' callbacks are always called by SDK thread (e.g. cache invalidation must be synchronous)
+    void registerCallback(andor_string_t feature_name, const callback_func_t &func, void *context, const bool direct);
+    void dispatchFeatureCallbacks(const std::vector<int> &feature_ids); // dispatch function of callbackDispatcher
 
                 /*  static class members and methods  */
 
     static std::list<ANDOR_CameraInfo> foundCameras;
-    static std::list<int> openedCameraIndices;
-    static size_t numberOfCreatedObjects;
+    static std::map<int,AT_H> openedCameras; // device index -> handle of connected camera (under discovery lock)
+
+    static std::unordered_map<andor_string_t,int> serialNumberIndex; // device index by serial number
+    static std::string discoveryCacheFile;
+
+    static int scanConnectedCameras(); // it must be called under discovery lock (see andor_camera_discovery.cpp)
+    static void startDiscovery();      // called by constructor: start scan according to the discovery mode (once)
+
+    // open and read info of device (it is thread-safe). If 'cached' info is given and the device has
+    // the same serial number, the info is taken from it. A device connected by camera object is not
+    // opened again: its info is read via the handle of connection ('opened_hndl')
+    static bool probeCamera(const int device_index, ANDOR_CameraInfo &info, const ANDOR_CameraInfo* cached,
+                            const AT_H opened_hndl = AT_HANDLE_UNINITIALISED);
+
+    // AT_Open/AT_Close under discovery lock (a scan never probes the device in the meantime)
+    static int openDevice(const int device_index, AT_H &hndl);
+    static int closeDevice(const int device_index, const AT_H hndl);
+
+                /*  typed access helpers (see get<F>/set<F>)  */
+
+    template<AndorFeatureType T>
+    struct FeatureTypeTag {};
+
+    void getFeatureValue(const int id, bool &val, FeatureTypeTag<BoolType>);
+    void getFeatureValue(const int id, AT_64 &val, FeatureTypeTag<IntType>);
+    void getFeatureValue(const int id, double &val, FeatureTypeTag<FloatType>);
+    void getFeatureValue(const int id, andor_string_t &val, FeatureTypeTag<StringType>);
+    void getFeatureValue(const int id, andor_string_t &val, FeatureTypeTag<EnumType>);
+
+    void setFeatureValue(const int id, const bool &val, FeatureTypeTag<BoolType>);
+    void setFeatureValue(const int id, const AT_64 &val, FeatureTypeTag<IntType>);
+    void setFeatureValue(const int id, const double &val, FeatureTypeTag<FloatType>);
+    void setFeatureValue(const int id, const andor_string_t &val, FeatureTypeTag<StringType>);
+    void setFeatureValue(const int id, const andor_string_t &val, FeatureTypeTag<EnumType>);
+
+    andor_enum_index_t getFeatureEnumIndex(const int id);
+    void setFeatureEnumIndex(const int id, const andor_enum_index_t index);
 
-//    static AndorFeatureNameMap ANDOR_SDK_FEATURES;
-    AndorFeatureNameMap ANDOR_SDK_FEATURES;
+    // call (and time) SDK function, log (verbose level) and check its result ('call' returns the result)
+    template<typename CallT>
+    void featureCall(const ANDOR_SdkFunction sdk_func, const int id, CallT call);
 
-    static int scanConnectedCameras(); // scan connected cameras when the first object will be created
+    // the same as featureCall but the value 'val' (read by 'call') is served from/stored into the feature cache
+    template<typename T, typename CallT>
+    void cachedFeatureRead(const ANDOR_SdkFunction sdk_func, const int id, T &val, CallT call);
+
+    // register/unregister SDK callback which calls cache->notifyChange(id) ('cache' is also the callback context)
+    template<typename CacheT>
+    bool subscribeFeatureChanges(CacheT* cache, const int id, const bool subscribe);
+
+    // table of enumerated feature for typed access (read from SDK once per connection)
+    const ANDOR_EnumMetadata* enumTable(const int id);
 
 }; // end of ANDOR_Camera class declaration
 
 
 
+            /*   COMPILE-TIME SDK FEATURE IDENTIFICATORS AND TAGS   */
+
+//
+//  AndorFeatureId::NAME is an index of feature in the table of valid features,
+//  AndorFeature::NAME is a tag type for ANDOR_Camera::get<F>/set<F> methods
+//
+
+namespace AndorFeatureId {
+
+#define ANDOR_FEATURE_ID(NAME, TYPE) NAME,
+
+enum : int {
+    ANDOR_SDK_FEATURE_LIST(ANDOR_FEATURE_ID)
+    FeaturesNumber
+};
+
+#undef ANDOR_FEATURE_ID
+
+}
+
+
+template<ANDOR_Camera::AndorFeatureType T> struct ANDOR_FeatureValueType;
+
+template<> struct ANDOR_FeatureValueType<ANDOR_Camera::BoolType> { typedef bool type; };
+template<> struct ANDOR_FeatureValueType<ANDOR_Camera::IntType> { typedef AT_64 type; };
+template<> struct ANDOR_FeatureValueType<ANDOR_Camera::FloatType> { typedef double type; };
+template<> struct ANDOR_FeatureValueType<ANDOR_Camera::StringType> { typedef andor_string_t type; };
+template<> struct ANDOR_FeatureValueType<ANDOR_Camera::EnumType> { typedef andor_string_t type; };
+
+
+namespace AndorFeature {
+
+#define ANDOR_FEATURE_TAG(NAME, TYPE) \
+    struct NAME { \
+        static const int id = AndorFeatureId::NAME; \
+        static const ANDOR_Camera::AndorFeatureType type = ANDOR_Camera::TYPE; \
+        typedef ANDOR_FeatureValueType<ANDOR_Camera::TYPE>::type value_type; \
+    };
+
+ANDOR_SDK_FEATURE_LIST(ANDOR_FEATURE_TAG)
+
+#undef ANDOR_FEATURE_TAG
+
+}
+
+
+
             /*   DECLARATION OF CLASS FOR ANDOR FEATURE INFO   */
 
 class ANDOR_API_WRAPPER_EXPORT ANDOR_FeatureInfo
@@ -568,8 +1011,13 @@ struct ANDOR_API_WRAPPER_EXPORT ANDOR_CameraInfo
 
 // helper struct to pass user context into feature callback function
 struct CallbackContext {
+    andor_string_t feature_name;
     ANDOR_Camera::callback_func_t func;
     void *user_context;
+
+    int feature_id;  // AndorFeatureId (-1 if the name is unknown: the callback is called directly)
+    bool direct;     // never dispatched (internal subscriptions)
+    std::atomic<ANDOR_CallbackDispatcher*> *dispatcher; // the camera active dispatcher
 };
 
 
@@ -0,0 +1,477 @@
+#include "andor_camera.h"
+
+#include <locale>
+#include <codecvt>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+                             /**************************************
+                             *    DISCOVERY OF CONNECTED CAMERAS   *
+                             ***************************************/
+
+//
+//  Cameras are opened and probed concurrently (one thread per device). Only string features
+//  and sensor geometry are read (a feature which is not implemented just leaves its field empty).
+//
+//  The result may be persisted (see ANDOR_Camera::setDiscoveryCacheFile): at the next start
+//  a cached camera is revalidated by its serial number only (one feature read instead of
+//  the full probe). A camera with other serial number at the same device index, or without
+//  serial number, is probed again.
+//
+//  The scan is performed once per process according to the discovery mode: by the first
+//  constructor (eager), by a background thread started by the first constructor, or at the first
+//  request of the results (on demand). The background thread holds a reference of SDK library,
+//  so the library is not finalized during the scan even if all camera objects are destroyed.
+//  Results (foundCameras and serialNumberIndex) are guarded by the discovery mutex.
+//
+//  Camera objects open and close devices under the discovery mutex too (see openDevice), so
+//  a scan never opens a device which is being connected. A connected device is not opened
+//  by a scan: its info is kept from the previous scan or read via the handle of the connection.
+//
+
+#define ANDOR_DISCOVERY_CACHE_SIGNATURE "ANDOR_CAMERA_DISCOVERY_CACHE 1"
+
+
+                /*  AUXILIARY NON-MEMBER FUNCTIONS  */
+
+struct ANDOR_CameraInfoStringField {
+    const AT_WC* name;
+    andor_string_t ANDOR_CameraInfo::*field;
+};
+
+static const ANDOR_CameraInfoStringField ANDOR_CAMERA_INFO_STRING_FIELDS[] = {
+    // CMOS and Apogee cameras common string features
+    {L"CameraName", &ANDOR_CameraInfo::cameraName},
+    {L"InterfaceType", &ANDOR_CameraInfo::interfaceType},
+    {L"FirmwareVersion", &ANDOR_CameraInfo::firmwareVersion},
+
+    // CMOS cameras implemented string features
+    {L"CameraModel", &ANDOR_CameraInfo::cameraModel},
+    {L"SerialNumber", &ANDOR_CameraInfo::serialNumber},
+    {L"ControllerID", &ANDOR_CameraInfo::controllerID},
+
+    // Apogee cameras implemented string features
+    {L"CameraFamily", &ANDOR_CameraInfo::cameraFamily},
+    {L"DDR2Type", &ANDOR_CameraInfo::DDR2Type},
+    {L"DriverVersion", &ANDOR_CameraInfo::driverVersion},
+    {L"MicrocodeVersion", &ANDOR_CameraInfo::microcodeVersion},
+    {L"SensorModel", &ANDOR_CameraInfo::sensorModel},
+    {L"SensorType", &ANDOR_CameraInfo::sensorType}
+};
+
+
+// cache file line: device index, string fields (UTF-8, tab-separated), sensor geometry
+
+static void write_cached_info(std::ostream &file, const ANDOR_CameraInfo &info)
+{
+    std::wstring_convert<std::codecvt_utf8<AT_WC>> cvt;
+
+    file << info.device_index;
+
+    for ( const ANDOR_CameraInfoStringField &f: ANDOR_CAMERA_INFO_STRING_FIELDS ) {
+        std::string str = cvt.to_bytes(info.*(f.field));
+        for ( char &c: str ) if ( c == '\t' || c == '\n' ) c = ' ';
+        file << '\t' << str;
+    }
+
+    file << '\t' << info.sensorWidth << '\t' << info.sensorHeight << '\t'
+         << std::setprecision(17) << info.pixelWidth << '\t' << info.pixelHeight << '\n';
+}
+
+
+static bool read_cached_info(const std::string &line, ANDOR_CameraInfo &info)
+{
+    std::wstring_convert<std::codecvt_utf8<AT_WC>> cvt;
+    std::vector<std::string> fields;
+    std::stringstream ss(line);
+    std::string field;
+
+    while ( std::getline(ss, field, '\t') ) fields.push_back(field);
+
+    const size_t n_str = sizeof(ANDOR_CAMERA_INFO_STRING_FIELDS)/sizeof(ANDOR_CameraInfoStringField);
+
+    if ( fields.size() != n_str + 5 ) return false;
+
+    try {
+        info.device_index = std::stoi(fields[0]);
+
+        for ( size_t i = 0; i < n_str; ++i ) {
+            info.*(ANDOR_CAMERA_INFO_STRING_FIELDS[i].field) = cvt.from_bytes(fields[i+1]);
+        }
+
+        info.sensorWidth = std::stoll(fields[n_str+1]);
+        info.sensorHeight = std::stoll(fields[n_str+2]);
+        info.pixelWidth = std::stod(fields[n_str+3]);
+        info.pixelHeight = std::stod(fields[n_str+4]);
+    } catch ( ... ) { // std::invalid_argument, std::out_of_range, std::range_error
+        return false;
+    }
+
+    return true;
+}
+
+
+static std::vector<ANDOR_CameraInfo> read_discovery_cache(const std::string &filename)
+{
+    std::vector<ANDOR_CameraInfo> cached;
+
+    if ( filename.empty() ) return cached;
+
+    std::ifstream file(filename);
+    std::string line;
+
+    if ( !std::getline(file, line) || line != ANDOR_DISCOVERY_CACHE_SIGNATURE ) return cached;
+
+    while ( std::getline(file, line) ) {
+        ANDOR_CameraInfo info;
+        if ( read_cached_info(line, info) ) cached.push_back(info);
+    }
+
+    return cached;
+}
+
+
+struct ANDOR_DiscoveryState {
+    enum STATE {NOT_STARTED, RUNNING, DONE};
+
+    ANDOR_DiscoveryState(): mutex(), finished(), state(NOT_STARTED), worker() {}
+
+    ~ANDOR_DiscoveryState() { // at exit: a scan of the background thread may still be in progress
+        if ( worker.joinable() ) worker.join();
+    }
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    STATE state;
+    std::thread worker;
+};
+
+
+// function-local static: it is constructed after the SDK library state (the first constructor
+// acquires the library reference before the discovery start), so it is destroyed before it
+
+static ANDOR_DiscoveryState & discovery_state()
+{
+    static ANDOR_DiscoveryState state;
+    return state;
+}
+
+static std::atomic<int> discovery_mode(ANDOR_Camera::DISCOVERY_EAGER);
+
+
+static void write_discovery_cache(const std::string &filename, const std::list<ANDOR_CameraInfo> &cameras)
+{
+    if ( filename.empty() ) return;
+
+    std::ofstream file(filename, std::ios::trunc);
+
+    if ( !file ) return; // the cache is an optimization only
+
+    file << ANDOR_DISCOVERY_CACHE_SIGNATURE << '\n';
+
+    for ( const ANDOR_CameraInfo &info: cameras ) write_cached_info(file, info);
+}
+
+
+
+                /*  STATIC MEMBERS INITIALIZATION   */
+
+std::list<ANDOR_CameraInfo> ANDOR_Camera::foundCameras = std::list<ANDOR_CameraInfo>();
+std::unordered_map<andor_string_t,int> ANDOR_Camera::serialNumberIndex = std::unordered_map<andor_string_t,int>();
+std::string ANDOR_Camera::discoveryCacheFile = std::string();
+
+
+
+                /*  ANDOR_Camera STATIC METHODS OF CAMERA DISCOVERY  */
+
+void ANDOR_Camera::setDiscoveryCacheFile(const std::string &filename)
+{
+    discoveryCacheFile = filename;
+}
+
+
+std::string ANDOR_Camera::getDiscoveryCacheFile()
+{
+    return discoveryCacheFile;
+}
+
+
+void ANDOR_Camera::setDiscoveryMode(const DISCOVERY_MODE mode)
+{
+    discovery_mode = mode;
+}
+
+
+ANDOR_Camera::DISCOVERY_MODE ANDOR_Camera::getDiscoveryMode()
+{
+    return static_cast<DISCOVERY_MODE>(discovery_mode.load());
+}
+
+
+void ANDOR_Camera::startDiscovery()
+{
+    ANDOR_DiscoveryState &st = discovery_state();
+    std::lock_guard<std::mutex> lock(st.mutex);
+
+    if ( st.state != ANDOR_DiscoveryState::NOT_STARTED ) return;
+
+    switch ( getDiscoveryMode() ) {
+        case DISCOVERY_EAGER:
+            scanConnectedCameras();
+            st.state = ANDOR_DiscoveryState::DONE;
+            break;
+        case DISCOVERY_BACKGROUND:
+            ANDOR_SdkLibrary::acquire(); // the reference is released by the thread
+            st.state = ANDOR_DiscoveryState::RUNNING;
+            try {
+                st.worker = std::thread([&st]() {
+                    {
+                        std::lock_guard<std::mutex> lock(st.mutex);
+                        try {
+                            scanConnectedCameras();
+                        } catch ( ... ) { // e.g. std::bad_alloc: the thread must not throw
+                        }
+                        st.state = ANDOR_DiscoveryState::DONE;
+                    }
+                    st.finished.notify_all();
+                    ANDOR_SdkLibrary::release();
+                });
+            } catch ( std::system_error & ) { // the thread cannot be started: scan on demand
+                st.state = ANDOR_DiscoveryState::NOT_STARTED;
+                ANDOR_SdkLibrary::release();
+            }
+            break;
+        default: // DISCOVERY_ON_DEMAND, DISCOVERY_DISABLED
+            break;
+    }
+}
+
+
+void ANDOR_Camera::waitDiscovery()
+{
+    ANDOR_DiscoveryState &st = discovery_state();
+    std::unique_lock<std::mutex> lock(st.mutex);
+
+    if ( st.state == ANDOR_DiscoveryState::NOT_STARTED ) {
+        if ( getDiscoveryMode() == DISCOVERY_DISABLED ) return;
+
+        scanConnectedCameras();
+        st.state = ANDOR_DiscoveryState::DONE;
+        return;
+    }
+
+    st.finished.wait(lock, [&st]() { return st.state == ANDOR_DiscoveryState::DONE; });
+
+    // the thread has finished its scan, it only releases the library reference (no discovery lock)
+    if ( st.worker.joinable() ) st.worker.join();
+}
+
+
+int ANDOR_Camera::rescanConnectedCameras()
+{
+    waitDiscovery(); // do not overlap a background scan
+
+    ANDOR_DiscoveryState &st = discovery_state();
+    std::lock_guard<std::mutex> lock(st.mutex);
+
+    int N = scanConnectedCameras();
+    st.state = ANDOR_DiscoveryState::DONE;
+
+    return N;
+}
+
+
+std::list<ANDOR_CameraInfo> ANDOR_Camera::getFoundCameras()
+{
+    waitDiscovery();
+
+    std::lock_guard<std::mutex> lock(discovery_state().mutex);
+
+    return foundCameras;
+}
+
+
+int ANDOR_Camera::findCameraBySerialNumber(const andor_string_t &serial_number)
+{
+    waitDiscovery();
+
+    std::lock_guard<std::mutex> lock(discovery_state().mutex);
+
+    auto it = serialNumberIndex.find(serial_number);
+
+    return it == serialNumberIndex.end() ? -1 : it->second;
+}
+
+
+int ANDOR_Camera::openDevice(const int device_index, AT_H &hndl)
+{
+    std::lock_guard<std::mutex> lock(discovery_state().mutex);
+
+    int err = AT_Open(device_index, &hndl);
+    if ( err == AT_SUCCESS ) openedCameras[device_index] = hndl;
+
+    return err;
+}
+
+
+int ANDOR_Camera::closeDevice(const int device_index, const AT_H hndl)
+{
+    std::lock_guard<std::mutex> lock(discovery_state().mutex);
+
+    openedCameras.erase(device_index);
+
+    return AT_Close(hndl);
+}
+
+
+bool ANDOR_Camera::probeCamera(const int device_index, ANDOR_CameraInfo &info, const ANDOR_CameraInfo *cached,
+                               const AT_H opened_hndl)
+{
+    AT_H hndl = opened_hndl;
+    const bool own_hndl = opened_hndl == AT_HANDLE_UNINITIALISED;
+
+    info = ANDOR_CameraInfo(); // features which cannot be read keep default (empty or zero) values
+
+    if ( own_hndl && AT_Open(device_index, &hndl) != AT_SUCCESS ) return false;
+
+    ANDOR_Feature feature(hndl, L"");
+    ANDOR_StringFeature s_f;
+
+    // read a feature and ignore SDK error (e.g. the feature is not implemented for the camera)
+    auto read_string = [&](const AT_WC* name, andor_string_t &val) {
+        try {
+            feature.setName(name);
+            feature.setType(ANDOR_Camera::StringType);
+            s_f = feature;
+            val = s_f.value();
+            return true;
+        } catch ( AndorSDK_Exception & ) {
+            return false;
+        }
+    };
+
+    try {
+        andor_string_t serial_number;
+
+        if ( cached && !cached->serialNumber.empty() && read_string(L"SerialNumber", serial_number) &&
+             serial_number == cached->serialNumber ) { // the same camera: the cached info is still valid
+            info = *cached;
+        } else {
+            for ( const ANDOR_CameraInfoStringField &f: ANDOR_CAMERA_INFO_STRING_FIELDS ) {
+                read_string(f.name, info.*(f.field));
+            }
+
+            // geometrical info (a value is assigned only after successful read)
+            AT_64 int_val = 0;
+            double float_val = 0.0;
+
+            feature.setType(ANDOR_Camera::IntType);
+            feature.setName(L"SensorWidth");
+            try { int_val = feature; info.sensorWidth = int_val; } catch ( AndorSDK_Exception & ) {}
+
+            feature.setName(L"SensorHeight");
+            try { int_val = feature; info.sensorHeight = int_val; } catch ( AndorSDK_Exception & ) {}
+
+            feature.setType(ANDOR_Camera::FloatType);
+            feature.setName(L"PixelWidth");
+            try { float_val = feature; info.pixelWidth = float_val; } catch ( AndorSDK_Exception & ) {}
+
+            feature.setName(L"PixelHeight");
+            try { float_val = feature; info.pixelHeight = float_val; } catch ( AndorSDK_Exception & ) {}
+        }
+    } catch ( ... ) { // e.g. std::bad_alloc: the thread must not throw
+        if ( own_hndl ) AT_Close(hndl);
+        return false;
+    }
+
+    info.device_index = device_index;
+
+    if ( own_hndl ) AT_Close(hndl);
+
+    return true;
+}
+
+
+int ANDOR_Camera::scanConnectedCameras()
+{
+    int N = 0;
+
+    if ( ANDOR_SdkLibrary::ensureInitialised() != AT_SUCCESS ) return 0; // the initialization may be deferred
+
+    // own proxy: the static DeviceCount may be read concurrently by other threads
+    ANDOR_Feature device_count(AT_HANDLE_SYSTEM, L"DeviceCount");
+    device_count.setType(ANDOR_Camera::IntType);
+
+    try {
+        N = device_count;
+    } catch ( AndorSDK_Exception & ) {
+        N = 0;
+    }
+
+    std::list<ANDOR_CameraInfo> previous; // info of connected devices is reused
+    previous.swap(foundCameras);
+    serialNumberIndex.clear();
+
+    if ( N <= 0 ) return 0;
+
+    std::vector<ANDOR_CameraInfo> cached = read_discovery_cache(discoveryCacheFile);
+
+    auto cached_info = [&cached](const int device_index) -> const ANDOR_CameraInfo* {
+        for ( const ANDOR_CameraInfo &info: cached ) {
+            if ( info.device_index == device_index ) return &info;
+        }
+        return nullptr;
+    };
+
+    // suppose device indices are continuous sequence from 0 to (DeviceCount-1)
+    std::vector<ANDOR_CameraInfo> infos(N);
+    std::unique_ptr<bool[]> opened(new bool[N]);
+
+    // connected devices (the map is not changed during the scan: it is guarded by the discovery lock)
+    auto probe = [&](const int i) {
+        auto conn = openedCameras.find(i);
+        if ( conn == openedCameras.end() ) {
+            opened[i] = probeCamera(i, infos[i], cached_info(i));
+            return;
+        }
+
+        for ( const ANDOR_CameraInfo &info: previous ) {
+            if ( info.device_index == i ) {
+                infos[i] = info;
+                opened[i] = true;
+                return;
+            }
+        }
+
+        opened[i] = probeCamera(i, infos[i], cached_info(i), conn->second);
+    };
+
+    if ( N == 1 ) {
+        probe(0);
+    } else { // USB round trips of different devices overlap
+        std::vector<std::thread> threads;
+
+        for ( int i = 0; i < N; ++i ) {
+            threads.emplace_back(probe, i);
+        }
+
+        for ( std::thread &th: threads ) th.join();
+    }
+
+    for ( int i = 0; i < N; ++i ) {
+        if ( !opened[i] ) continue;
+
+        foundCameras.push_back(infos[i]);
+
+        if ( !infos[i].serialNumber.empty() ) serialNumberIndex[infos[i].serialNumber] = i;
+    }
+
+    write_discovery_cache(discoveryCacheFile, foundCameras);
+
+    return N;
+}
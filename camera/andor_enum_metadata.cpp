@@ -0,0 +1,134 @@
+                    /*******************************************************
+                     *                                                     *
+                     *    IMPLEMENTATION OF ANDOR_EnumMetadataCache CLASS  *
+                     *                                                     *
+                     *******************************************************/
+
+
+#include "andor_enum_metadata.h"
+#include "andor_camera.h"
+
+
+int ANDOR_EnumMetadata::index(const AT_WC *value) const
+{
+    if ( value == nullptr ) return -1;
+
+    // enumerated features have a few values, so linear search is enough
+    for ( size_t i = 0; i < values.size(); ++i ) {
+        if ( values[i] == value ) return i;
+    }
+
+    return -1;
+}
+
+
+ANDOR_EnumMetadataCache::Entry::Entry():
+    mutex(), table(), published(nullptr), subscribed(false), hasAvailability(false), version(0), changes(0), available()
+{
+}
+
+
+ANDOR_EnumMetadataCache::ANDOR_EnumMetadataCache(const subscribe_func_t &subscribe_func):
+    entries(), entriesNumber(ANDOR_Camera::featuresNumber()), subscribeFunc(subscribe_func)
+{
+    entries = std::unique_ptr<Entry[]>(new Entry[entriesNumber]);
+}
+
+
+ANDOR_EnumMetadataCache::~ANDOR_EnumMetadataCache()
+{
+    clear();
+}
+
+
+const ANDOR_EnumMetadata* ANDOR_EnumMetadataCache::table(const int feature_id) const
+{
+    if ( feature_id < 0 || (size_t)feature_id >= entriesNumber ) return nullptr;
+
+    return entries[feature_id].published.load(std::memory_order_acquire);
+}
+
+
+const ANDOR_EnumMetadata* ANDOR_EnumMetadataCache::setTable(const int feature_id, ANDOR_EnumMetadata &&table)
+{
+    if ( feature_id < 0 || (size_t)feature_id >= entriesNumber ) return nullptr;
+
+    Entry &entry = entries[feature_id];
+
+    std::lock_guard<std::mutex> lock(entry.mutex);
+
+    if ( entry.table ) return entry.table.get(); // a reader may already use it, so it is not replaced
+
+    entry.table.reset(new ANDOR_EnumMetadata(std::move(table)));
+    entry.hasAvailability = false;
+    entry.published.store(entry.table.get(), std::memory_order_release);
+
+    // SDK calls the callback at registration, so 'changes' is read after it (see availability())
+    if ( !entry.subscribed && subscribeFunc ) entry.subscribed = subscribeFunc(feature_id, true);
+
+    return entry.table.get();
+}
+
+
+bool ANDOR_EnumMetadataCache::availability(const int feature_id, std::vector<int> &available,
+                                           unsigned int &token) const
+{
+    if ( feature_id < 0 || (size_t)feature_id >= entriesNumber ) return false;
+
+    Entry &entry = entries[feature_id];
+
+    std::lock_guard<std::mutex> lock(entry.mutex);
+
+    if ( !entry.subscribed ) return false;
+
+    token = entry.changes.load(std::memory_order_acquire);
+
+    if ( !entry.hasAvailability || entry.version != token ) return false;
+
+    available = entry.available;
+
+    return true;
+}
+
+
+void ANDOR_EnumMetadataCache::setAvailability(const int feature_id, const unsigned int token,
+                                              const std::vector<int> &available)
+{
+    if ( feature_id < 0 || (size_t)feature_id >= entriesNumber ) return;
+
+    Entry &entry = entries[feature_id];
+
+    std::lock_guard<std::mutex> lock(entry.mutex);
+
+    if ( !entry.subscribed ) return;
+
+    entry.available = available;
+    entry.version = token; // it differs from 'changes' if a notification came during the reading
+    entry.hasAvailability = true;
+}
+
+
+void ANDOR_EnumMetadataCache::notifyChange(const int feature_id)
+{
+    if ( feature_id < 0 || (size_t)feature_id >= entriesNumber ) return;
+
+    entries[feature_id].changes.fetch_add(1, std::memory_order_release);
+}
+
+
+void ANDOR_EnumMetadataCache::clear()
+{
+    for ( size_t i = 0; i < entriesNumber; ++i ) {
+        Entry &entry = entries[i];
+
+        std::lock_guard<std::mutex> lock(entry.mutex);
+
+        if ( entry.subscribed && subscribeFunc ) subscribeFunc(i, false);
+
+        entry.subscribed = false;
+        entry.published.store(nullptr, std::memory_order_relaxed);
+        entry.table.reset();
+        entry.hasAvailability = false;
+        entry.available.clear();
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef ANDOR_ENUM_METADATA_H
+#define ANDOR_ENUM_METADATA_H
+
+#include "../export_decl.h"
+
+#include <atcore.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+// for MS compilers: disable multiple warnings about DLL-exports for the STL containers
+#ifdef _MSC_VER
+#pragma warning( disable: 4251 )
+#endif
+
+
+// string<->index table of enumerated feature
+
+struct ANDOR_API_WRAPPER_EXPORT ANDOR_EnumMetadata
+{
+    std::vector<std::basic_string<AT_WC>> values; // strings by index
+    std::vector<int> implemented;                 // implemented indices
+
+    int index(const AT_WC* value) const; // -1 if there is no such string
+};
+
+
+            /*   CACHE OF METADATA OF ENUMERATED SDK FEATURES   */
+
+//
+//  Strings and implemented indices of an enumerated feature do not change while a camera
+//  is connected, so they are read from SDK once (at the first use of the feature).
+//  Availability of indices depends on other features: it is kept until SDK notifies
+//  a change of the feature (the callback is registered via 'subscribe' function given by
+//  the camera object when the table is stored), or it is read every time if SDK refused
+//  the callback registration.
+//  Notifications (from SDK thread) only increment an atomic counter of the feature.
+//  A stored table is immutable and it is published atomically, so it is read without locking;
+//  availability is guarded by a lock of the feature. The tables are valid until clear() call,
+//  which must not run concurrently with other methods (it is called at the camera disconnection).
+//
+
+class ANDOR_API_WRAPPER_EXPORT ANDOR_EnumMetadataCache
+{
+public:
+    // subscribe (the second argument is true) or unsubscribe change notifications of feature
+    // (the first argument is AndorFeatureId). Returns false if SDK refused
+    typedef std::function<bool(const int, const bool)> subscribe_func_t;
+
+    explicit ANDOR_EnumMetadataCache(const subscribe_func_t &subscribe_func);
+
+    ANDOR_EnumMetadataCache(const ANDOR_EnumMetadataCache &other) = delete;
+    ANDOR_EnumMetadataCache & operator = (const ANDOR_EnumMetadataCache &other) = delete;
+
+    ~ANDOR_EnumMetadataCache(); // unsubscribe all notifications
+
+    const ANDOR_EnumMetadata* table(const int feature_id) const; // nullptr if the table was not stored yet
+    // if other thread has already stored the table of the feature, the stored one is returned
+    const ANDOR_EnumMetadata* setTable(const int feature_id, ANDOR_EnumMetadata &&table);
+
+    // returns true and cached available indices, or returns false and a token to be passed to setAvailability()
+    bool availability(const int feature_id, std::vector<int> &available, unsigned int &token) const;
+    void setAvailability(const int feature_id, const unsigned int token, const std::vector<int> &available);
+
+    void notifyChange(const int feature_id); // can be called from any thread (SDK callback)
+
+    void clear(); // unsubscribe and drop all tables (e.g. before the camera disconnection)
+
+private:
+    struct Entry {
+        Entry();
+
+        std::mutex mutex; // guards all fields except 'published' and 'changes'
+
+        std::unique_ptr<ANDOR_EnumMetadata> table;
+        std::atomic<const ANDOR_EnumMetadata*> published; // the same as 'table'
+
+        bool subscribed;
+
+        bool hasAvailability;
+        unsigned int version;              // 'changes' at the moment of reading of the stored availability
+        std::atomic<unsigned int> changes; // incremented by notifications
+        std::vector<int> available;
+    };
+
+    std::unique_ptr<Entry[]> entries;
+    size_t entriesNumber;
+
+    subscribe_func_t subscribeFunc;
+};
+
+#endif // ANDOR_ENUM_METADATA_H
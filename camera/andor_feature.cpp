@@ -10,6 +10,7 @@
 //#include <typeinfo>
 #include <locale>
 #include <codecvt>
+#include <cwchar>
 
 
 static andor_string_t trim_str(const andor_string_t &str)
@@ -23,9 +24,47 @@ static andor_string_t trim_str(const andor_string_t &str)
 }
 
 
+// append UTF-8 representation of wide string (it is used instead of std::wstring_convert,
+// which constructs a conversion facet on each call)
+static void append_utf8(std::string &str, const AT_WC* wstr, size_t len)
+{
+    for ( size_t i = 0; i < len; ++i ) {
+        unsigned long c = static_cast<unsigned long>(wstr[i]);
+
+        if ( c < 0x80 ) {
+            str.push_back(char(c));
+            continue;
+        }
+
+        // UTF-16 surrogate pair (AT_WC is 16-bit on Windows)
+        if ( c >= 0xD800 && c < 0xDC00 && (i+1) < len ) {
+            unsigned long c2 = static_cast<unsigned long>(wstr[i+1]);
+            if ( c2 >= 0xDC00 && c2 < 0xE000 ) {
+                c = 0x10000 + ((c - 0xD800) << 10) + (c2 - 0xDC00);
+                ++i;
+            }
+        }
+
+        if ( c < 0x800 ) {
+            str.push_back(char(0xC0 | (c >> 6)));
+        } else if ( c < 0x10000 ) {
+            str.push_back(char(0xE0 | (c >> 12)));
+            str.push_back(char(0x80 | ((c >> 6) & 0x3F)));
+        } else {
+            str.push_back(char(0xF0 | ((c >> 18) & 0x07)));
+            str.push_back(char(0x80 | ((c >> 12) & 0x3F)));
+            str.push_back(char(0x80 | ((c >> 6) & 0x3F)));
+        }
+        str.push_back(char(0x80 | (c & 0x3F)));
+    }
+}
+
+
 ANDOR_Camera::ANDOR_Feature::ANDOR_Feature():
-    deviceHndl(AT_HANDLE_UNINITIALISED), featureName(nullptr), featureNameStr(andor_string_t()),
-    featureType(UnknownType), logMessageStream(), loggingFunc(nullptr), at_string()
+    deviceHndl(AT_HANDLE_UNINITIALISED), featureName(nullptr), featureNameStr(andor_string_t()), featureNameLog(),
+    featureIndex(-1),
+    featureType(UnknownType), at64_val(0), at_string(), logMessageStream(), loggingFunc(nullptr), featureCache(nullptr),
+    enumMetadata(nullptr)
 {
 
 }
@@ -69,12 +108,38 @@ void ANDOR_Camera::ANDOR_Feature::setName(const andor_string_t &name)
     // If the 'name' is not valid name then an error will occur after SDK function calling
     featureNameStr = name;
     featureName = (AT_WC*) featureNameStr.c_str();
+
+    featureNameLog.clear();
+    append_utf8(featureNameLog, featureNameStr.c_str(), featureNameStr.size());
+
+    featureIndex = ANDOR_Camera::featureId(featureNameStr);
 }
 
 
 void ANDOR_Camera::ANDOR_Feature::setName(const AT_WC *name)
 {
-    setName(andor_string_t(name));
+    if ( name == nullptr ) {
+        setName(andor_string_t());
+    } else {
+        featureNameStr.assign(name); // re-use already allocated storage
+        featureName = (AT_WC*) featureNameStr.c_str();
+
+        featureNameLog.clear();
+        append_utf8(featureNameLog, featureNameStr.c_str(), featureNameStr.size());
+
+        featureIndex = ANDOR_Camera::featureId(featureNameStr);
+    }
+}
+
+
+void ANDOR_Camera::ANDOR_Feature::setName(const AT_WC *name, const char *narrow_name, const int id)
+{
+    featureNameStr.assign(name);
+    featureName = (AT_WC*) featureNameStr.c_str();
+
+    featureNameLog.assign(narrow_name);
+
+    featureIndex = id;
 }
 
 
@@ -96,6 +161,18 @@ AT_H ANDOR_Camera::ANDOR_Feature::getDeviceHndl() const
 }
 
 
+void ANDOR_Camera::ANDOR_Feature::setFeatureCache(ANDOR_FeatureCache *cache)
+{
+    featureCache = cache;
+}
+
+
+void ANDOR_Camera::ANDOR_Feature::setEnumMetadata(ANDOR_EnumMetadataCache *metadata)
+{
+    enumMetadata = metadata;
+}
+
+
 void ANDOR_Camera::ANDOR_Feature::setType(const AndorFeatureType &type)
 {
     featureType = type;
@@ -179,9 +256,8 @@ void ANDOR_Camera::ANDOR_Feature::getInt()
         throw AndorSDK_Exception(AT_ERR_NOTIMPLEMENTED,"Feature type missmatch>>>!");
     }
 
-    formatLogMessage("AT_GetInt","&at64_val");
-
-    andor_sdk_assert( AT_GetInt(deviceHndl,featureName,&at64_val), logMessageStream.str());
+    cachedSdkRead( at64_val, ANDOR_SDK_GET_INT, [&]() { return AT_GetInt(deviceHndl,featureName,&at64_val); },
+                   "&at64_val");
 }
 
 
@@ -191,9 +267,8 @@ void ANDOR_Camera::ANDOR_Feature::getFloat()
         throw AndorSDK_Exception(AT_ERR_NOTIMPLEMENTED,"Feature type missmatch!");
     }
 
-    formatLogMessage("AT_GetFloat","&at_float");
-
-    andor_sdk_assert( AT_GetFloat(deviceHndl,featureName,&at_float), logMessageStream.str());
+    cachedSdkRead( at_float, ANDOR_SDK_GET_FLOAT, [&]() { return AT_GetFloat(deviceHndl,featureName,&at_float); },
+                   "&at_float");
 }
 
 
@@ -205,9 +280,7 @@ void ANDOR_Camera::ANDOR_Feature::getBool()
 
     AT_BOOL flag;
 
-    formatLogMessage("AT_GetBool","&flag");
-
-    andor_sdk_assert( AT_GetBool(deviceHndl,featureName,&flag), logMessageStream.str());
+    cachedSdkRead( flag, ANDOR_SDK_GET_BOOL, [&]() { return AT_GetBool(deviceHndl,featureName,&flag); }, "&flag");
 
     at_bool = flag == AT_TRUE ? true : false;
 }
@@ -221,9 +294,8 @@ void ANDOR_Camera::ANDOR_Feature::getString()
 
     int len;
 
-    formatLogMessage("AT_GetStringMaxLength","&len");
-
-    andor_sdk_assert( AT_GetStringMaxLength(deviceHndl,featureName,&len), logMessageStream.str());
+    checkSdkCall( ANDOR_SDK_GET_STRING_MAX_LENGTH, [&]() { return AT_GetStringMaxLength(deviceHndl,featureName,&len); },
+                  "&len");
 
     if ( len ) {
         AT_WC* str;
@@ -234,9 +306,7 @@ void ANDOR_Camera::ANDOR_Feature::getString()
                                      " (bad_alloc what(): " + ex.what() + ")");
         }
 
-        formatLogMessage("AT_GetString","str",len);
-
-        andor_sdk_assert( AT_GetString(deviceHndl,featureName,str,len), logMessageStream.str());
+        checkSdkCall( ANDOR_SDK_GET_STRING, [&]() { return AT_GetString(deviceHndl,featureName,str,len); }, "str",len);
 
         at_string = str;
 
@@ -254,9 +324,8 @@ void ANDOR_Camera::ANDOR_Feature::getEnumIndex()
         throw AndorSDK_Exception(AT_ERR_NOTIMPLEMENTED,"Feature type missmatch!");
     }
 
-    formatLogMessage("AT_GetEnumIndex","&at_index");
-
-    andor_sdk_assert( AT_GetEnumIndex(deviceHndl,featureName,&at_index), logMessageStream.str());
+    cachedSdkRead( at_index, ANDOR_SDK_GET_ENUM_INDEX,
+                   [&]() { return AT_GetEnumIndex(deviceHndl,featureName,&at_index); }, "&at_index");
 }
 
 
@@ -268,12 +337,18 @@ void ANDOR_Camera::ANDOR_Feature::getEnumString()
 
     getEnumIndex();
 
-    AT_WC str[ANDOR_SDK_ENUM_FEATURE_STRLEN];
+    const ANDOR_EnumMetadata* table = getEnumTable();
 
-    formatLogMessage("AT_GetEnumStringByIndex",at_index,"str",ANDOR_SDK_ENUM_FEATURE_STRLEN);
+    if ( table && at_index >= 0 && (size_t)at_index < table->values.size() ) { // no SDK call
+        at_string = table->values[at_index];
+        return;
+    }
+
+    AT_WC str[ANDOR_SDK_ENUM_FEATURE_STRLEN];
 
-    andor_sdk_assert( AT_GetEnumStringByIndex(deviceHndl,featureName,at_index,str,ANDOR_SDK_ENUM_FEATURE_STRLEN),
-                      logMessageStream.str());
+    checkSdkCall( ANDOR_SDK_GET_ENUM_STRING_BY_INDEX,
+                  [&]() { return AT_GetEnumStringByIndex(deviceHndl,featureName,at_index,str,ANDOR_SDK_ENUM_FEATURE_STRLEN); },
+                  at_index,"str",ANDOR_SDK_ENUM_FEATURE_STRLEN);
 
     at_string = str;
 }
@@ -289,11 +364,10 @@ std::pair<AT_64,AT_64> ANDOR_Camera::ANDOR_Feature::getIntMinMax()
 
     std::pair<AT_64,AT_64> val(0,0);
 
-    formatLogMessage("AT_GetIntMin","&min_val");
-    andor_sdk_assert( AT_GetIntMin(deviceHndl,featureName,&val.first), logMessageStream.str());
+    checkSdkCall( ANDOR_SDK_GET_INT_MIN, [&]() { return AT_GetIntMin(deviceHndl,featureName,&val.first); }, "&min_val");
 
-    formatLogMessage("AT_GetIntMax","&max_val");
-    andor_sdk_assert( AT_GetIntMax(deviceHndl,featureName,&val.second), logMessageStream.str());
+    checkSdkCall( ANDOR_SDK_GET_INT_MAX, [&]() { return AT_GetIntMax(deviceHndl,featureName,&val.second); },
+                  "&max_val");
 
     return val;
 }
@@ -307,57 +381,96 @@ std::pair<double,double> ANDOR_Camera::ANDOR_Feature::getFloatMinMax()
 
     std::pair<double,double> val(0,0);
 
-    formatLogMessage("AT_GetFloatMin","&min_val");
-    andor_sdk_assert( AT_GetFloatMin(deviceHndl,featureName,&val.first), logMessageStream.str());
+    checkSdkCall( ANDOR_SDK_GET_FLOAT_MIN, [&]() { return AT_GetFloatMin(deviceHndl,featureName,&val.first); },
+                  "&min_val");
 
-    formatLogMessage("AT_GetFloatMax","&max_val");
-    andor_sdk_assert( AT_GetFloatMax(deviceHndl,featureName,&val.second), logMessageStream.str());
+    checkSdkCall( ANDOR_SDK_GET_FLOAT_MAX, [&]() { return AT_GetFloatMax(deviceHndl,featureName,&val.second); },
+                  "&max_val");
 
     return val;
 }
 
 
-std::vector<andor_string_t> ANDOR_Camera::ANDOR_Feature::getEnumInfo(std::vector<andor_enum_index_t> &imIdx,
-                                                                     std::vector<andor_enum_index_t> &aIdx)
+void ANDOR_Camera::ANDOR_Feature::readEnumTable(ANDOR_EnumMetadata &table)
 {
     int count;
     AT_WC str[ANDOR_SDK_ENUM_FEATURE_STRLEN];
     AT_BOOL flag;
 
-    std::vector<andor_string_t> vals;
+    table.values.clear();
+    table.implemented.clear();
 
-    formatLogMessage("AT_GetEnumCount","&count");
-    andor_sdk_assert( AT_GetEnumCount(deviceHndl, featureName, &count), logMessageStream.str() );
+    checkSdkCall( ANDOR_SDK_GET_ENUM_COUNT, [&]() { return AT_GetEnumCount(deviceHndl, featureName, &count); },
+                  "&count");
 
-    if ( !count ) return vals;
+    for ( int i = 0; i < count; ++i ) {
+        checkSdkCall( ANDOR_SDK_GET_ENUM_STRING_BY_INDEX,
+                      [&]() { return AT_GetEnumStringByIndex(deviceHndl,featureName,i,str,ANDOR_SDK_ENUM_FEATURE_STRLEN); },
+                      i,"str",ANDOR_SDK_ENUM_FEATURE_STRLEN);
 
-    aIdx.clear();
-    imIdx.clear();
+        table.values.push_back(str);
 
-    for ( int i = 0; i < count; ++i ) {
-        formatLogMessage("AT_GetEnumStringByIndex",i,"str",ANDOR_SDK_ENUM_FEATURE_STRLEN);
+        checkSdkCall( ANDOR_SDK_IS_ENUM_INDEX_IMPLEMENTED,
+                      [&]() { return AT_IsEnumIndexImplemented(deviceHndl,featureName,i,&flag); },
+                      i,"&flag");
 
-        andor_sdk_assert( AT_GetEnumStringByIndex(deviceHndl,featureName,i,str,ANDOR_SDK_ENUM_FEATURE_STRLEN),
-                          logMessageStream.str());
+        if ( flag ) table.implemented.push_back(i);
+    }
+}
+
+
+const ANDOR_EnumMetadata* ANDOR_Camera::ANDOR_Feature::getEnumTable()
+{
+    if ( enumMetadata == nullptr ) return nullptr;
+
+    const ANDOR_EnumMetadata* table = enumMetadata->table(featureIndex);
+
+    if ( table == nullptr && featureIndex >= 0 ) { // read once per connection
+        ANDOR_EnumMetadata new_table;
+        readEnumTable(new_table);
+        table = enumMetadata->setTable(featureIndex, std::move(new_table));
+    }
+
+    return table;
+}
+
+
+std::vector<andor_string_t> ANDOR_Camera::ANDOR_Feature::getEnumInfo(std::vector<andor_enum_index_t> &imIdx,
+                                                                     std::vector<andor_enum_index_t> &aIdx)
+{
+    AT_BOOL flag;
+
+    std::vector<andor_string_t> vals;
 
-        vals.push_back(str);
+    const ANDOR_EnumMetadata* table = getEnumTable();
 
-        formatLogMessage("AT_IsEnumIndexImplemented",i,"&flag");
+    if ( table ) {
+        vals = table->values;
+        imIdx = table->implemented;
+    } else {
+        ANDOR_EnumMetadata new_table;
+        readEnumTable(new_table);
+        vals = std::move(new_table.values);
+        imIdx = std::move(new_table.implemented);
+    }
 
-        andor_sdk_assert( AT_IsEnumIndexImplemented(deviceHndl,featureName,i,&flag),
-                          logMessageStream.str());
+    if ( vals.empty() ) return vals;
 
-        if ( flag ) { // if it is not implemented then it is not available too
-            imIdx.push_back(i);
+    // availability is cached until SDK notifies a change of the feature
+    unsigned int token = 0;
 
-            formatLogMessage("AT_IsEnumIndexAvailable",i,"&flag");
+    if ( !enumMetadata || !enumMetadata->availability(featureIndex, aIdx, token) ) {
+        aIdx.clear();
 
-            andor_sdk_assert( AT_IsEnumIndexAvailable(deviceHndl,featureName,i,&flag),
-                              logMessageStream.str());
+        for ( andor_enum_index_t i: imIdx ) { // if it is not implemented then it is not available too
+            checkSdkCall( ANDOR_SDK_IS_ENUM_INDEX_AVAILABLE,
+                          [&]() { return AT_IsEnumIndexAvailable(deviceHndl,featureName,i,&flag); },
+                          i,"&flag");
 
             if ( flag ) aIdx.push_back(i);
         }
 
+        if ( enumMetadata ) enumMetadata->setAvailability(featureIndex, token, aIdx);
     }
 
     getEnumIndex(); // get current index
@@ -371,34 +484,24 @@ void ANDOR_Camera::ANDOR_Feature::getFeatureInfo(bool *is_impl, bool *is_read, b
 {
     AT_BOOL flag;
 
-    std::string log_msg;
-
     if ( is_impl == nullptr || is_read == nullptr || is_readonly == nullptr || is_write == nullptr ) return;
 
-    formatLogMessage("AT_IsImplemented","&flag");
-
-    andor_sdk_assert( AT_IsImplemented(deviceHndl,featureName,&flag), log_msg);
+    checkSdkCall( ANDOR_SDK_IS_IMPLEMENTED, [&]() { return AT_IsImplemented(deviceHndl,featureName,&flag); }, "&flag");
 
     *is_impl = flag == AT_TRUE ? true : false;
 
 
-    formatLogMessage("AT_IsReadable","&flag");
-
-    andor_sdk_assert( AT_IsReadable(deviceHndl,featureName,&flag), log_msg);
+    checkSdkCall( ANDOR_SDK_IS_READABLE, [&]() { return AT_IsReadable(deviceHndl,featureName,&flag); }, "&flag");
 
     *is_read = flag == AT_TRUE ? true : false;
 
 
-    formatLogMessage("AT_IsReadOnly","&flag");
-
-    andor_sdk_assert( AT_IsReadOnly(deviceHndl,featureName,&flag), log_msg);
+    checkSdkCall( ANDOR_SDK_IS_READONLY, [&]() { return AT_IsReadOnly(deviceHndl,featureName,&flag); }, "&flag");
 
     *is_readonly = flag == AT_TRUE ? true : false;
 
 
-    formatLogMessage("AT_IsWritable","&flag");
-
-    andor_sdk_assert( AT_IsWritable(deviceHndl,featureName,&flag), log_msg);
+    checkSdkCall( ANDOR_SDK_IS_WRITABLE, [&]() { return AT_IsWritable(deviceHndl,featureName,&flag); }, "&flag");
 
     *is_write = flag == AT_TRUE ? true : false;
 }
@@ -459,9 +562,9 @@ void ANDOR_Camera::ANDOR_Feature::setInt(const AT_64 val)
         throw AndorSDK_Exception(AT_ERR_NOTIMPLEMENTED,"Feature type missmatch!");
     }
 
-    formatLogMessage("AT_SetInt",val);
+    if ( featureCache ) featureCache->invalidate(featureIndex);
 
-    andor_sdk_assert( AT_SetInt(deviceHndl,featureName,val), logMessageStream.str());
+    checkSdkCall( ANDOR_SDK_SET_INT, [&]() { return AT_SetInt(deviceHndl,featureName,val); }, val);
 
     at64_val = val;
 }
@@ -473,9 +576,9 @@ void ANDOR_Camera::ANDOR_Feature::setFloat(const double val)
         throw AndorSDK_Exception(AT_ERR_NOTIMPLEMENTED,"Feature type missmatch!");
     }
 
-    formatLogMessage("AT_SetFloat",val);
+    if ( featureCache ) featureCache->invalidate(featureIndex);
 
-    andor_sdk_assert( AT_SetFloat(deviceHndl,featureName,val), logMessageStream.str());
+    checkSdkCall( ANDOR_SDK_SET_FLOAT, [&]() { return AT_SetFloat(deviceHndl,featureName,val); }, val);
 
     at_float = val;
 }
@@ -489,9 +592,9 @@ void ANDOR_Camera::ANDOR_Feature::setBool(const bool val)
 
     AT_BOOL flag = val ? AT_TRUE : AT_FALSE;
 
-    formatLogMessage("AT_SetBool",flag);
+    if ( featureCache ) featureCache->invalidate(featureIndex);
 
-    andor_sdk_assert( AT_SetBool(deviceHndl,featureName,flag), logMessageStream.str());
+    checkSdkCall( ANDOR_SDK_SET_BOOL, [&]() { return AT_SetBool(deviceHndl,featureName,flag); }, flag);
 
     at_bool = val;
 }
@@ -503,9 +606,9 @@ void ANDOR_Camera::ANDOR_Feature::setString(const andor_string_t &val)
         throw AndorSDK_Exception(AT_ERR_NOTIMPLEMENTED,"Feature type missmatch!");
     }
 
-    formatLogMessage("AT_SetString",val);
+    if ( featureCache ) featureCache->invalidate(featureIndex);
 
-    andor_sdk_assert( AT_SetString(deviceHndl,featureName,val.c_str()), logMessageStream.str());
+    checkSdkCall( ANDOR_SDK_SET_STRING, [&]() { return AT_SetString(deviceHndl,featureName,val.c_str()); }, val);
 
     at_string = val;
 }
@@ -523,9 +626,21 @@ void ANDOR_Camera::ANDOR_Feature::setEnumString(const andor_string_t &val)
         throw AndorSDK_Exception(AT_ERR_NOTIMPLEMENTED,"Feature type missmatch!");
     }
 
-    formatLogMessage("AT_SetEnumString",val);
+    // SDK compares strings by itself for AT_SetEnumString, so the index is found in the cached table
+    // (unknown string is passed to SDK as is to get its error)
+    const ANDOR_EnumMetadata* table = getEnumTable();
+    int index = table ? table->index(val.c_str()) : -1;
+
+    if ( index >= 0 ) {
+        setEnumIndex(index);
+        at_string = val;
+        return;
+    }
+
+    if ( featureCache ) featureCache->invalidate(featureIndex);
 
-    andor_sdk_assert( AT_SetEnumString(deviceHndl,featureName,val.c_str()), logMessageStream.str());
+    checkSdkCall( ANDOR_SDK_SET_ENUM_STRING, [&]() { return AT_SetEnumString(deviceHndl,featureName,val.c_str()); },
+                  val);
 
     at_string = val;
 }
@@ -542,9 +657,9 @@ void ANDOR_Camera::ANDOR_Feature::setEnumIndex(const andor_enum_index_t val)
         throw AndorSDK_Exception(AT_ERR_NOTIMPLEMENTED,"Feature type missmatch!");
     }
 
-    formatLogMessage("AT_SetEnumIndex",val);
+    if ( featureCache ) featureCache->invalidate(featureIndex);
 
-    andor_sdk_assert( AT_SetEnumIndex(deviceHndl,featureName,val), logMessageStream.str());
+    checkSdkCall( ANDOR_SDK_SET_ENUM_INDEX, [&]() { return AT_SetEnumIndex(deviceHndl,featureName,val); }, val);
 
     at_index = val;
 }
@@ -603,7 +718,7 @@ void ANDOR_Camera::ANDOR_Feature::formatLogMessage(const std::string &sdk_func,
 {
     logMessageStream.str("");  // clear string stream
     logMessageStream << sdk_func << "(";  // print SDK function name
-    logHelper(featureNameStr); // print feature name
+    logHelper(featureNameLog); // print feature name
     logMessageStream << ", ";
     logHelper(deviceHndl);     // print device handler
     logMessageStream << ", ";
@@ -621,6 +736,44 @@ void ANDOR_Camera::ANDOR_Feature::formatLogMessage(const char* sdk_func, T... ar
 }
 
 
+// the SDK function is called (and timed, see andor_call_stats.h),
+// the message is formatted only if it will be consumed: by logging function (verbose level)
+// or by exception in the case of SDK error
+template<typename CallT, typename... T>
+void ANDOR_Camera::ANDOR_Feature::checkSdkCall(const ANDOR_SdkFunction sdk_func, CallT call, T... args)
+{
+    // global features (e.g. DeviceCount) may be read before any connection (deferred initialization).
+    // If the initialization fails the call returns AT_ERR_NOTINITIALISED
+    if ( deviceHndl == AT_HANDLE_SYSTEM ) ANDOR_SdkLibrary::ensureInitialised();
+
+    int err = andor_timed_sdk_call(sdk_func, featureIndex, call);
+
+#if ANDOR_CAMERA_MIN_LOG_LEVEL > 0
+    if ( err == AT_SUCCESS ) return;
+#else
+    if ( err == AT_SUCCESS && !loggingFunc ) return;
+#endif
+
+    formatLogMessage(andor_sdk_function_name(sdk_func), args...);
+
+    andor_sdk_assert(err, logMessageStream.str());
+}
+
+
+// a cache hit does not call SDK function (so nothing is logged)
+template<typename ValT, typename CallT, typename... T>
+void ANDOR_Camera::ANDOR_Feature::cachedSdkRead(ValT &val, const ANDOR_SdkFunction sdk_func, CallT call, T... args)
+{
+    unsigned int token = 0;
+
+    if ( featureCache && featureCache->lookup(featureIndex, val, token) ) return;
+
+    checkSdkCall(sdk_func, call, args...);
+
+    if ( featureCache ) featureCache->store(featureIndex, token, val);
+}
+
+
 template<typename T1, typename... T2>
 void ANDOR_Camera::ANDOR_Feature::logHelper(T1 first, T2... last)
 {
@@ -647,13 +800,18 @@ void ANDOR_Camera::ANDOR_Feature::logHelper(const char *str)
 
 void ANDOR_Camera::ANDOR_Feature::logHelper(const andor_string_t &wstr)
 {
-    std::wstring_convert<std::codecvt_utf8<AT_WC>> str;
-    logMessageStream << "'" << str.to_bytes(wstr) << "'";
+    std::string str;
+    append_utf8(str, wstr.c_str(), wstr.size());
+
+    logMessageStream << "'" << str << "'";
 }
 
 void ANDOR_Camera::ANDOR_Feature::logHelper(const AT_WC *wstr)
 {
-    logHelper(andor_string_t(wstr));
+    std::string str;
+    if ( wstr ) append_utf8(str, wstr, std::wcslen(wstr));
+
+    logMessageStream << "'" << str << "'";
 }
 
 
@@ -0,0 +1,324 @@
+                    /**************************************************
+                     *                                                *
+                     *    IMPLEMENTATION OF ANDOR_FeatureCache CLASS  *
+                     *                                                *
+                     **************************************************/
+
+
+#include "andor_feature_cache.h"
+#include "andor_camera.h"
+
+
+//
+//  Default policies: features which are changed by device itself and SDK does not notify
+//  about are polled (time-to-live), event counters and the timestamp clock are never cached,
+//  as well as features which depend on a selector feature (their values are different for
+//  different selector values while SDK notifies about the selector change only).
+//  All other numeric and enumerated features are cached until SDK notifies a change.
+//
+
+static const int ANDOR_FEATURE_CACHE_POLLED[] = {
+    AndorFeatureId::CameraAcquiring,
+    AndorFeatureId::CameraPresent,
+    AndorFeatureId::CoolerPower,
+    AndorFeatureId::HeatSinkTemperature,
+    AndorFeatureId::InputVoltage,
+    AndorFeatureId::SensorTemperature,
+    AndorFeatureId::TemperatureStatus
+};
+
+static const int ANDOR_FEATURE_CACHE_NOT_CACHED[] = {
+    AndorFeatureId::BufferOverflowEvent,
+    AndorFeatureId::EventEnable,
+    AndorFeatureId::EventsMissedEvent,
+    AndorFeatureId::ExposureEndEvent,
+    AndorFeatureId::ExposureStartEvent,
+    AndorFeatureId::IOControl,
+    AndorFeatureId::IODirection,
+    AndorFeatureId::IOInvert,
+    AndorFeatureId::IOState,
+    AndorFeatureId::MultitrackBinned,
+    AndorFeatureId::MultitrackEnd,
+    AndorFeatureId::MultitrackStart,
+    AndorFeatureId::RowNExposureEndEvent,
+    AndorFeatureId::RowNExposureStartEvent,
+    AndorFeatureId::TimestampClock
+};
+
+
+            /*  ANDOR_FeatureCacheStats  */
+
+ANDOR_FeatureCacheStats::ANDOR_FeatureCacheStats():
+    hits(0), misses(0), invalidations(0), expirations(0), features()
+{
+}
+
+
+double ANDOR_FeatureCacheStats::hitRatio() const
+{
+    uint64_t reads = hits + misses;
+
+    return reads ? double(hits)/reads : 0.0;
+}
+
+
+            /*  ANDOR_FeatureCache  */
+
+ANDOR_FeatureCache::Entry::Entry():
+    mutex(), policy(NoCache), ttl(std::chrono::milliseconds(ANDOR_FEATURE_CACHE_DEFAULT_TTL)),
+    subscribed(false), subscriptionFailed(false),
+    kind(NoValue), version(0), changes(0), timestamp(),
+    intValue(0), floatValue(0.0), indexValue(0),
+    hits(0), misses(0), expirations(0), invalidationsBase(0)
+{
+}
+
+
+ANDOR_FeatureCache::ANDOR_FeatureCache(const subscribe_func_t &subscribe_func):
+    entries(), entriesNumber(ANDOR_Camera::featuresNumber()), subscribeFunc(subscribe_func)
+{
+    entries = std::unique_ptr<Entry[]>(new Entry[entriesNumber]);
+
+    for ( size_t i = 0; i < entriesNumber; ++i ) {
+        if ( ANDOR_Camera::featureType(i) != ANDOR_Camera::StringType ) entries[i].policy = UntilChanged;
+    }
+
+    for ( int id: ANDOR_FEATURE_CACHE_POLLED ) entries[id].policy = TimeToLive;
+    for ( int id: ANDOR_FEATURE_CACHE_NOT_CACHED ) entries[id].policy = NoCache;
+}
+
+
+ANDOR_FeatureCache::~ANDOR_FeatureCache()
+{
+    unsubscribeAll();
+}
+
+
+void ANDOR_FeatureCache::setPolicy(const int feature_id, const CachePolicy policy, const unsigned int ttl)
+{
+    if ( feature_id < 0 || (size_t)feature_id >= entriesNumber ) {
+        throw AndorSDK_Exception(AT_ERR_NOTIMPLEMENTED, "Unknown ANDOR SDK feature to set cache policy!");
+    }
+
+    if ( ANDOR_Camera::featureType(feature_id) == ANDOR_Camera::StringType && policy != NoCache ) {
+        throw AndorSDK_Exception(AT_ERR_NOTIMPLEMENTED, "Values of string features are not cached!");
+    }
+
+    Entry &entry = entries[feature_id];
+
+    std::lock_guard<std::mutex> lock(entry.mutex);
+
+    entry.policy = policy;
+    entry.ttl = std::chrono::milliseconds(ttl);
+
+    ++entry.changes; // drop the stored value
+}
+
+
+ANDOR_FeatureCache::CachePolicy ANDOR_FeatureCache::getPolicy(const int feature_id) const
+{
+    if ( feature_id < 0 || (size_t)feature_id >= entriesNumber ) return NoCache;
+
+    std::lock_guard<std::mutex> lock(entries[feature_id].mutex);
+
+    return entries[feature_id].policy;
+}
+
+
+bool ANDOR_FeatureCache::lookup(const int feature_id, AT_64 &val, unsigned int &token)
+{
+    return lookupValue(feature_id, IntValue, &Entry::intValue, val, token);
+}
+
+
+bool ANDOR_FeatureCache::lookup(const int feature_id, double &val, unsigned int &token)
+{
+    return lookupValue(feature_id, FloatValue, &Entry::floatValue, val, token);
+}
+
+
+bool ANDOR_FeatureCache::lookup(const int feature_id, int &val, unsigned int &token)
+{
+    return lookupValue(feature_id, IndexValue, &Entry::indexValue, val, token);
+}
+
+
+void ANDOR_FeatureCache::store(const int feature_id, const unsigned int token, const AT_64 val)
+{
+    storeValue(feature_id, IntValue, &Entry::intValue, token, val);
+}
+
+
+void ANDOR_FeatureCache::store(const int feature_id, const unsigned int token, const double val)
+{
+    storeValue(feature_id, FloatValue, &Entry::floatValue, token, val);
+}
+
+
+void ANDOR_FeatureCache::store(const int feature_id, const unsigned int token, const int val)
+{
+    storeValue(feature_id, IndexValue, &Entry::indexValue, token, val);
+}
+
+
+void ANDOR_FeatureCache::invalidate(const int feature_id)
+{
+    if ( feature_id < 0 || (size_t)feature_id >= entriesNumber ) return;
+
+    entries[feature_id].changes.fetch_add(1, std::memory_order_release);
+}
+
+
+void ANDOR_FeatureCache::invalidateAll()
+{
+    for ( size_t i = 0; i < entriesNumber; ++i ) entries[i].changes.fetch_add(1, std::memory_order_release);
+}
+
+
+void ANDOR_FeatureCache::notifyChange(const int feature_id)
+{
+    invalidate(feature_id);
+}
+
+
+void ANDOR_FeatureCache::unsubscribeAll()
+{
+    for ( size_t i = 0; i < entriesNumber; ++i ) {
+        Entry &entry = entries[i];
+
+        std::lock_guard<std::mutex> lock(entry.mutex);
+
+        if ( entry.subscribed && subscribeFunc ) subscribeFunc(i, false);
+
+        entry.subscribed = false;
+        entry.subscriptionFailed = false;
+        entry.kind = NoValue;
+    }
+}
+
+
+ANDOR_FeatureCacheStats ANDOR_FeatureCache::getStats() const
+{
+    ANDOR_FeatureCacheStats stats;
+
+    for ( size_t i = 0; i < entriesNumber; ++i ) {
+        const Entry &entry = entries[i];
+
+        std::lock_guard<std::mutex> lock(entry.mutex);
+
+        if ( !entry.hits && !entry.misses ) continue;
+
+        ANDOR_FeatureCacheEntryStats es;
+
+        es.featureId = i;
+        es.hits = entry.hits;
+        es.misses = entry.misses;
+        es.invalidations = entry.changes.load(std::memory_order_relaxed) - entry.invalidationsBase;
+        es.expirations = entry.expirations;
+
+        stats.hits += es.hits;
+        stats.misses += es.misses;
+        stats.invalidations += es.invalidations;
+        stats.expirations += es.expirations;
+
+        stats.features.push_back(es);
+    }
+
+    return stats;
+}
+
+
+void ANDOR_FeatureCache::resetStats()
+{
+    for ( size_t i = 0; i < entriesNumber; ++i ) {
+        Entry &entry = entries[i];
+
+        std::lock_guard<std::mutex> lock(entry.mutex);
+
+        entry.hits = 0;
+        entry.misses = 0;
+        entry.expirations = 0;
+        entry.invalidationsBase = entry.changes.load(std::memory_order_relaxed);
+    }
+}
+
+
+                /*  PRIVATE METHODS  */
+
+ANDOR_FeatureCache::Entry* ANDOR_FeatureCache::entry(const int feature_id)
+{
+    if ( feature_id < 0 || (size_t)feature_id >= entriesNumber ) return nullptr;
+
+    return entries.get() + feature_id;
+}
+
+
+bool ANDOR_FeatureCache::isCacheable(const Entry &entry)
+{
+    if ( entry.policy == NoCache ) return false;
+    if ( entry.policy == UntilChanged && entry.subscriptionFailed ) return false;
+
+    return true;
+}
+
+
+template<typename T>
+bool ANDOR_FeatureCache::lookupValue(const int feature_id, const ValueKind kind, T Entry::*value, T &val,
+                                     unsigned int &token)
+{
+    Entry* entry = this->entry(feature_id);
+
+    if ( entry == nullptr ) return false;
+
+    std::lock_guard<std::mutex> lock(entry->mutex);
+
+    if ( !isCacheable(*entry) ) return false;
+
+    if ( entry->policy == UntilChanged && !entry->subscribed ) {
+        // SDK calls the callback at registration, so 'changes' is read after it.
+        // The callback only increments 'changes', so it is safe to call SDK under the entry lock
+        if ( subscribeFunc && subscribeFunc(feature_id, true) ) {
+            entry->subscribed = true;
+            entry->invalidationsBase = entry->changes.load(std::memory_order_relaxed);
+        } else {
+            entry->subscriptionFailed = true;
+            return false;
+        }
+    }
+
+    token = entry->changes.load(std::memory_order_acquire);
+
+    if ( entry->kind == kind && entry->version == token ) {
+        if ( entry->policy != TimeToLive || (std::chrono::steady_clock::now() - entry->timestamp) < entry->ttl ) {
+            val = (*entry).*value;
+            ++entry->hits;
+            return true;
+        }
+
+        ++entry->expirations;
+    }
+
+    ++entry->misses;
+
+    return false;
+}
+
+
+template<typename T>
+void ANDOR_FeatureCache::storeValue(const int feature_id, const ValueKind kind, T Entry::*value,
+                                    const unsigned int token, const T val)
+{
+    Entry* entry = this->entry(feature_id);
+
+    if ( entry == nullptr ) return;
+
+    std::lock_guard<std::mutex> lock(entry->mutex);
+
+    if ( !isCacheable(*entry) ) return;
+
+    (*entry).*value = val;
+    entry->kind = kind;
+    entry->version = token; // it differs from 'changes' if a notification came during the reading
+
+    if ( entry->policy == TimeToLive ) entry->timestamp = std::chrono::steady_clock::now();
+}
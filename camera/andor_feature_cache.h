@@ -0,0 +1,160 @@
+#ifndef ANDOR_FEATURE_CACHE_H
+#define ANDOR_FEATURE_CACHE_H
+
+#include "../export_decl.h"
+
+#include <atcore.h>
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <cstdint>
+
+// for MS compilers: disable multiple warnings about DLL-exports for the STL containers
+#ifdef _MSC_VER
+#pragma warning( disable: 4251 )
+#endif
+
+
+#define ANDOR_FEATURE_CACHE_DEFAULT_TTL 1000 // default time-to-live (in millisecs) of polled features
+
+
+// hit/miss statistics of a cached feature
+
+struct ANDOR_API_WRAPPER_EXPORT ANDOR_FeatureCacheEntryStats
+{
+    int featureId;           // AndorFeatureId
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t invalidations;  // notifications of SDK and writes through the camera object
+    uint64_t expirations;    // misses due to expired time-to-live
+};
+
+
+// statistics of the feature value cache (totals and features which were read at least once)
+
+struct ANDOR_API_WRAPPER_EXPORT ANDOR_FeatureCacheStats
+{
+    ANDOR_FeatureCacheStats();
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t invalidations;
+    uint64_t expirations;
+
+    std::vector<ANDOR_FeatureCacheEntryStats> features;
+
+    double hitRatio() const; // 0 if there was no read
+};
+
+
+            /*   CACHE OF SDK FEATURE VALUES   */
+
+//
+//  Values of numeric features (integer, floating-point and boolean ones) and indices of
+//  enumerated features are kept per feature (AndorFeatureId). A value is served from memory
+//  according to the feature policy:
+//
+//    UntilChanged - until SDK notifies a change of the feature (AT_RegisterFeatureCallback,
+//                   the callback is registered at the first read of the feature via
+//                   'subscribe' function given by the camera object),
+//    TimeToLive   - for a given time (features which are changed by device itself and
+//                   SDK does not notify about, e.g. temperatures),
+//    NoCache      - every read calls SDK.
+//
+//  A write through the camera object invalidates the feature value.
+//  Notifications (from SDK thread) only increment an atomic counter of the feature; a value
+//  read by SDK is stored as valid only if no notification came during the reading.
+//  All methods are thread-safe: every feature has its own lock (held for a copy of the value,
+//  or for the callback registration at the first read), so readers of different features
+//  do not block each other.
+//
+
+class ANDOR_API_WRAPPER_EXPORT ANDOR_FeatureCache
+{
+public:
+    enum CachePolicy {NoCache, UntilChanged, TimeToLive};
+
+    // subscribe (the second argument is true) or unsubscribe change notifications of feature
+    // (the first argument is AndorFeatureId). Returns false if SDK refused
+    typedef std::function<bool(const int, const bool)> subscribe_func_t;
+
+    explicit ANDOR_FeatureCache(const subscribe_func_t &subscribe_func);
+
+    ANDOR_FeatureCache(const ANDOR_FeatureCache &other) = delete;
+    ANDOR_FeatureCache & operator = (const ANDOR_FeatureCache &other) = delete;
+
+    ~ANDOR_FeatureCache(); // unsubscribe all notifications
+
+    void setPolicy(const int feature_id, const CachePolicy policy,
+                   const unsigned int ttl = ANDOR_FEATURE_CACHE_DEFAULT_TTL);
+    CachePolicy getPolicy(const int feature_id) const;
+
+    // returns true and the cached value, or returns false (miss) and a token to be passed to store()
+    bool lookup(const int feature_id, AT_64 &val, unsigned int &token);
+    bool lookup(const int feature_id, double &val, unsigned int &token);
+    bool lookup(const int feature_id, int &val, unsigned int &token); // boolean value or enumerated index
+
+    void store(const int feature_id, const unsigned int token, const AT_64 val);
+    void store(const int feature_id, const unsigned int token, const double val);
+    void store(const int feature_id, const unsigned int token, const int val);
+
+    void invalidate(const int feature_id);
+    void invalidateAll();
+
+    void notifyChange(const int feature_id); // can be called from any thread (SDK callback)
+
+    void unsubscribeAll(); // e.g. before the camera disconnection (values are invalidated)
+
+    ANDOR_FeatureCacheStats getStats() const;
+    void resetStats();
+
+private:
+    enum ValueKind {NoValue, IntValue, FloatValue, IndexValue};
+
+    struct Entry {
+        Entry();
+
+        mutable std::mutex mutex; // guards all fields except 'changes'
+
+        CachePolicy policy;
+        std::chrono::steady_clock::duration ttl;
+
+        bool subscribed;
+        bool subscriptionFailed;
+
+        ValueKind kind;
+        unsigned int version;              // 'changes' at the moment of reading of the stored value
+        std::atomic<unsigned int> changes; // incremented by notifications and writes
+        std::chrono::steady_clock::time_point timestamp;
+
+        AT_64 intValue;
+        double floatValue;
+        int indexValue;
+
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t expirations;
+        uint64_t invalidationsBase; // 'changes' at the last reset of statistics
+    };
+
+    std::unique_ptr<Entry[]> entries;
+    size_t entriesNumber;
+
+    subscribe_func_t subscribeFunc;
+
+    Entry* entry(const int feature_id); // nullptr if the feature is unknown
+
+    static bool isCacheable(const Entry &entry); // it must be called under the entry lock
+
+    template<typename T>
+    bool lookupValue(const int feature_id, const ValueKind kind, T Entry::*value, T &val, unsigned int &token);
+
+    template<typename T>
+    void storeValue(const int feature_id, const ValueKind kind, T Entry::*value, const unsigned int token, const T val);
+};
+
+#endif // ANDOR_FEATURE_CACHE_H
@@ -0,0 +1,152 @@
+#ifndef ANDOR_FEATURE_LIST_H
+#define ANDOR_FEATURE_LIST_H
+
+
+                             /**************************************
+                             *    ANDOR SDK FEATURES DEFINITIONS   *
+                             ***************************************/
+
+//
+//  Names and types correspond to ANDOR SDK version 3.11
+//
+//  The list is an X-macro: ANDOR_SDK_FEATURE_LIST(X) expands X(NAME, TYPE) for each feature,
+//  where TYPE is a name of ANDOR_Camera::AndorFeatureType enumerator. It generates the feature
+//  table, feature IDs and typed feature tags (see andor_camera.h).
+//
+//  NOTE: entries must be sorted by name in code-unit order (as wcscmp does, i.e. upper-case
+//        letters go first) since the feature table is searched by bisection!
+//
+
+#ifdef ANDOR_CAMERA_DEPRECATED_ENABLED
+#define ANDOR_SDK_DEPRECATED_FEATURE(X, NAME, TYPE) X(NAME, TYPE)
+#else
+#define ANDOR_SDK_DEPRECATED_FEATURE(X, NAME, TYPE)
+#endif
+
+
+#define ANDOR_SDK_FEATURE_LIST(X) \
+    X(AOIBinning, EnumType) \
+    X(AOIHBin, IntType) \
+    X(AOIHeight, IntType) \
+    X(AOILayout, EnumType) \
+    X(AOILeft, IntType) \
+    X(AOIStride, IntType) \
+    X(AOITop, IntType) \
+    X(AOIVBin, IntType) \
+    X(AOIWidth, IntType) \
+    X(AccumulateCount, BoolType) \
+    X(AlternatingReadoutDirection, BoolType) \
+    X(AuxOutSourceTwo, EnumType) \
+    X(AuxiliaryOutSource, EnumType) \
+    X(BackoffTemperatureOffset, FloatType) \
+    X(Baseline, IntType) \
+    X(BitDepth, EnumType) \
+    X(BufferOverflowEvent, IntType) \
+    X(BytesPerPixel, FloatType) \
+    X(CameraAcquiring, BoolType) \
+    X(CameraFamily, StringType) \
+    X(CameraMemory, IntType) \
+    X(CameraModel, StringType) \
+    X(CameraName, StringType) \
+    X(CameraPresent, BoolType) \
+    X(ColourFilter, EnumType) \
+    X(ControllerID, StringType) \
+    X(CoolerPower, FloatType) \
+    X(CycleMode, EnumType) \
+    X(DDR2Type, StringType) \
+    X(DeviceCount, IntType) \
+    X(DeviceVideoIndex, IntType) \
+    X(DisableShutter, BoolType) \
+    X(DriverVersion, StringType) \
+    X(ElectronicShutteringMode, EnumType) \
+    X(EventEnable, BoolType) \
+    X(EventSelector, EnumType) \
+    X(EventsMissedEvent, IntType) \
+    X(ExposedPixelHeight, IntType) \
+    X(ExposureEndEvent, IntType) \
+    X(ExposureStartEvent, IntType) \
+    X(ExposureTime, FloatType) \
+    X(ExternalIOReadout, BoolType) \
+    X(ExternalTriggerDelay, FloatType) \
+    X(FanSpeed, EnumType) \
+    X(FastAOIFrameRateEnable, BoolType) \
+    X(FirmwareVersion, StringType) \
+    X(ForceShutterOpen, BoolType) \
+    X(FrameCount, IntType) \
+    X(FrameInterval, FloatType) \
+    X(FrameIntervalTiming, BoolType) \
+    X(FrameRate, FloatType) \
+    X(FullAOIControl, BoolType) \
+    X(HeatSinkTemperature, FloatType) \
+    X(IOControl, EnumType) \
+    X(IODirection, EnumType) \
+    X(IOInvert, BoolType) \
+    X(IOSelector, EnumType) \
+    X(IOState, BoolType) \
+    X(IRPreFlashEnable, BoolType) \
+    X(ImageSizeBytes, IntType) \
+    X(InputVoltage, FloatType) \
+    X(InterfaceType, StringType) \
+    X(KeepCleanEnable, BoolType) \
+    X(KeepCleanPostExposureEnable, BoolType) \
+    X(LineScanSpeed, FloatType) \
+    X(MaxInterfaceTransferRate, FloatType) \
+    X(MetadataEnable, BoolType) \
+    X(MetadataFrame, BoolType) \
+    X(MetadataTimestamp, BoolType) \
+    X(MicrocodeVersion, StringType) \
+    X(MultitrackBinned, BoolType) \
+    X(MultitrackCount, IntType) \
+    X(MultitrackEnd, IntType) \
+    X(MultitrackSelector, IntType) \
+    X(MultitrackStart, IntType) \
+    X(Overlap, BoolType) \
+    X(PixelEncoding, EnumType) \
+    X(PixelHeight, FloatType) \
+    X(PixelReadoutRate, EnumType) \
+    X(PixelWidth, FloatType) \
+    X(PortSelector, IntType) \
+    ANDOR_SDK_DEPRECATED_FEATURE(X, PreAmpGain, EnumType) \
+    ANDOR_SDK_DEPRECATED_FEATURE(X, PreAmpGainChannel, EnumType) \
+    ANDOR_SDK_DEPRECATED_FEATURE(X, PreAmpGainControl, EnumType) \
+    ANDOR_SDK_DEPRECATED_FEATURE(X, PreAmpGainSelector, EnumType) \
+    X(PreAmpGainValue, IntType) \
+    X(PreAmpOffsetValue, IntType) \
+    X(ReadoutTime, FloatType) \
+    X(RollingShutterGlobalClear, BoolType) \
+    X(RowNExposureEndEvent, IntType) \
+    X(RowNExposureStartEvent, IntType) \
+    X(RowReadTime, FloatType) \
+    X(ScanSpeedControlEnable, BoolType) \
+    X(SensorCooling, BoolType) \
+    X(SensorHeight, IntType) \
+    X(SensorModel, StringType) \
+    X(SensorReadoutMode, EnumType) \
+    X(SensorTemperature, FloatType) \
+    X(SensorType, EnumType) \
+    X(SensorWidth, IntType) \
+    X(SerialNumber, StringType) \
+    X(ShutterAmpControl, BoolType) \
+    X(ShutterMode, EnumType) \
+    X(ShutterOutputMode, EnumType) \
+    X(ShutterState, BoolType) \
+    X(ShutterStrobePeriod, FloatType) \
+    X(ShutterStrobePosition, FloatType) \
+    X(ShutterTransferTime, FloatType) \
+    X(SimplePreAmpGainControl, EnumType) \
+    X(SoftwareVersion, StringType) \
+    X(SpuriousNoiseFilter, BoolType) \
+    X(StaticBlemishCorrection, BoolType) \
+    ANDOR_SDK_DEPRECATED_FEATURE(X, TargetSensorTemperature, FloatType) \
+    X(TemperatureControl, EnumType) \
+    X(TemperatureStatus, EnumType) \
+    X(TimestampClock, IntType) \
+    X(TimestampClockFrequency, IntType) \
+    X(TransmitFrames, BoolType) \
+    X(TriggerMode, EnumType) \
+    X(UsbDeviceId, IntType) \
+    X(UsbProductId, IntType) \
+    X(VerticallyCentreAOI, BoolType)
+
+
+#endif // ANDOR_FEATURE_LIST_H
@@ -0,0 +1,743 @@
+                    /*************************************************
+                     *                                               *
+                     *    IMPLEMENTATION OF ANDOR_FITSWriter CLASS   *
+                     *                                               *
+                     *************************************************/
+
+
+#include "andor_fits_writer.h"
+#include "andor_metadata.h"
+#include "andorsdk_exception.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <ctime>
+#include <sstream>
+#include <locale>
+#include <codecvt>
+#include <memory>
+
+
+                /*  HELPER FUNCTIONS TO FORMAT HEADER CARDS  */
+
+enum FITSValueKind {FITS_STRING, FITS_NUMBER, FITS_LOGICAL};
+
+struct FITSFeatureKeyword {
+    const char* keyword;
+    const AT_WC* feature;
+    FITSValueKind kind;
+    const char* comment;
+};
+
+
+// camera features written into header (if implemented by camera)
+
+static const FITSFeatureKeyword FITS_FEATURE_KEYWORDS[] = {
+    {"EXPTIME",  L"ExposureTime", FITS_NUMBER, "exposure time [s]"},
+    {"CCD-TEMP", L"SensorTemperature", FITS_NUMBER, "sensor temperature [C]"},
+    {"SET-TEMP", L"TargetSensorTemperature", FITS_NUMBER, "target sensor temperature [C]"},
+    {"COOLING",  L"SensorCooling", FITS_LOGICAL, "sensor cooling is on"},
+    {"PIXENC",   L"PixelEncoding", FITS_STRING, "SDK pixel encoding"},
+    {"BITDEPTH", L"BitDepth", FITS_STRING, "digitization"},
+    {"GAINMODE", L"SimplePreAmpGainControl", FITS_STRING, "pre-amplifier gain mode"},
+    {"READRATE", L"PixelReadoutRate", FITS_STRING, "pixel readout rate"},
+    {"SHUTTER",  L"ElectronicShutteringMode", FITS_STRING, "electronic shuttering mode"},
+    {"TRIGMODE", L"TriggerMode", FITS_STRING, "trigger mode"},
+    {"CYCLMODE", L"CycleMode", FITS_STRING, "acquisition cycle mode"},
+    {"FRAMERAT", L"FrameRate", FITS_NUMBER, "frame rate [Hz]"},
+    {"XBINNING", L"AOIHBin", FITS_NUMBER, "horizontal binning"},
+    {"YBINNING", L"AOIVBin", FITS_NUMBER, "vertical binning"},
+    {"AOILEFT",  L"AOILeft", FITS_NUMBER, "AOI left pixel (1-based)"},
+    {"AOITOP",   L"AOITop", FITS_NUMBER, "AOI top pixel (1-based)"},
+    {"TSFREQ",   L"TimestampClockFrequency", FITS_NUMBER, "metadata timestamp clock frequency [Hz]"}
+};
+
+
+static std::string fits_card(const std::string &keyword, const std::string &value, const std::string &comment)
+{
+    std::string card = keyword;
+    card.resize(8, ' ');
+
+    if ( !value.empty() ) {
+        card += "= " + value;
+        if ( !comment.empty() ) card += " / " + comment;
+    }
+
+    for ( size_t i = 0; i < card.size(); ++i ) { // header must be printable ASCII
+        if ( card[i] < 32 || card[i] > 126 ) card[i] = '?';
+    }
+
+    card.resize(ANDOR_FITS_CARD_SIZE, ' ');
+
+    return card;
+}
+
+
+static std::string fits_string_value(const std::string &str)
+{
+    std::string value = "'";
+
+    for ( size_t i = 0; i < str.size() && value.size() < 68; ++i ) {
+        if ( str[i] == '\'' ) value += '\''; // quote is doubled
+        value += str[i];
+    }
+    if ( value.size() < 9 ) value.resize(9, ' '); // at least 8 characters between quotes
+
+    return value + "'";
+}
+
+
+static std::string fits_fixed_value(const std::string &str) // right-justified to column 30
+{
+    return str.size() < 20 ? std::string(20 - str.size(), ' ') + str : str;
+}
+
+
+template<typename T>
+static std::string fits_number_card(const std::string &keyword, const T value, const std::string &comment)
+{
+    std::ostringstream str;
+    str.precision(15);
+    str << value;
+
+    return fits_card(keyword, fits_fixed_value(str.str()), comment);
+}
+
+
+static std::string fits_logical_card(const std::string &keyword, const bool value, const std::string &comment)
+{
+    return fits_card(keyword, fits_fixed_value(value ? "T" : "F"), comment);
+}
+
+
+static std::string fits_string_card(const std::string &keyword, const std::string &value, const std::string &comment)
+{
+    return fits_card(keyword, fits_string_value(value), comment);
+}
+
+
+static std::string fits_string_card(const std::string &keyword, const andor_string_t &value, const std::string &comment)
+{
+    std::wstring_convert<std::codecvt_utf8<AT_WC>> cvt;
+
+    return fits_string_card(keyword, cvt.to_bytes(value), comment);
+}
+
+
+static std::string fits_end_of_header(const std::string &cards)
+{
+    std::string header = cards + fits_card("END", "", "");
+
+    size_t n = header.size() % ANDOR_FITS_BLOCK_SIZE;
+    if ( n ) header.resize(header.size() + ANDOR_FITS_BLOCK_SIZE - n, ' ');
+
+    return header;
+}
+
+
+static std::string fits_date(const std::chrono::system_clock::time_point &tp)
+{
+    std::time_t t = std::chrono::system_clock::to_time_t(tp);
+    long long msec = std::chrono::duration_cast<std::chrono::milliseconds>(tp.time_since_epoch()).count() % 1000;
+    if ( msec < 0 ) msec += 1000;
+
+    struct std::tm buff;
+#ifdef _WIN32
+    gmtime_s(&buff, &t);
+#else
+    gmtime_r(&t, &buff);
+#endif
+
+    char str[32];
+    std::strftime(str, sizeof(str), "%Y-%m-%dT%H:%M:%S", &buff);
+
+    char msec_str[8];
+    std::snprintf(msec_str, sizeof(msec_str), ".%03d", int(msec));
+
+    return std::string(str) + msec_str;
+}
+
+
+static inline size_t fits_padded_size(const size_t size)
+{
+    return (size + ANDOR_FITS_BLOCK_SIZE - 1) / ANDOR_FITS_BLOCK_SIZE * ANDOR_FITS_BLOCK_SIZE;
+}
+
+
+
+                /*  CONSTRUCTOR AND DESTRUCTOR  */
+
+ANDOR_FITSWriter::ANDOR_FITSWriter(const size_t encoders_number, const size_t queue_length):
+    fitsFile(nullptr), fileName(), fitsLayout(DataCube), fitsGeometry(), fitsBitpix(16),
+    frameDataSize(0), naxis3CardPos(-1), cameraCards(),
+    utcOrigin(), steadyOrigin(),
+    encodersNumber(encoders_number ? encoders_number : 1), encoderThreads(),
+    encodeQueue(queue_length), encodeQueueMutex(), encodeQueueCond(),
+    writeMutex(), writeTurnCond(), nextWriteSequence(0),
+    writerActive(false), nextSequence(0), writtenFrames(0), failedFrames(0), lastErrno(0)
+{
+}
+
+
+ANDOR_FITSWriter::~ANDOR_FITSWriter()
+{
+    try {
+        close();
+    } catch ( AndorSDK_Exception &ex ) { // nothing to do in destructor
+    }
+}
+
+
+                /*  PUBLIC METHODS  */
+
+std::vector<andor_string_t> ANDOR_FITSWriter::headerFeatures()
+{
+    std::vector<andor_string_t> names;
+
+    for ( const FITSFeatureKeyword &key: FITS_FEATURE_KEYWORDS ) names.push_back(key.feature);
+
+    return names;
+}
+
+
+void ANDOR_FITSWriter::open(const std::string &filename, ANDOR_Camera &camera, const FITSLayout layout)
+{
+    open(filename, camera.getFrameGeometry(), camera.getCameraInfo(), camera.getFeatureSnapshot(headerFeatures()), layout);
+}
+
+
+void ANDOR_FITSWriter::open(const std::string &filename, const ANDOR_FrameGeometry &geometry, const ANDOR_CameraInfo &info,
+                            const ANDOR_Camera::AndorFeatureSnapshot &features, const FITSLayout layout)
+{
+    close();
+
+    if ( geometry.encoding == PIXEL_ENCODING_UNKNOWN || !geometry.width || !geometry.height ) {
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_FORMAT, "Cannot open FITS writer! Unknown image geometry!");
+    }
+
+    fileName = filename;
+    fitsLayout = layout;
+    fitsGeometry = geometry;
+    fitsBitpix = (geometry.encoding == PIXEL_ENCODING_MONO32) ? 32 : 16;
+    frameDataSize = geometry.width*geometry.height*fitsBitpix/8;
+
+    utcOrigin = std::chrono::system_clock::now();
+    steadyOrigin = std::chrono::steady_clock::now();
+
+    // keywords common for all HDUs
+
+    cameraCards = fits_string_card("DATE", fits_date(utcOrigin), "UTC date of file creation");
+    cameraCards += fits_string_card("ORIGIN", "ANDOR_API_WRAPPER", "");
+
+    if ( !info.cameraModel.empty() ) cameraCards += fits_string_card("INSTRUME", info.cameraModel, "camera model");
+    if ( !info.cameraName.empty() ) cameraCards += fits_string_card("CAMNAME", info.cameraName, "camera name");
+    if ( !info.serialNumber.empty() ) cameraCards += fits_string_card("SERIALNO", info.serialNumber, "camera serial number");
+    if ( !info.firmwareVersion.empty() ) cameraCards += fits_string_card("FIRMWARE", info.firmwareVersion, "camera firmware version");
+    if ( !info.interfaceType.empty() ) cameraCards += fits_string_card("INTERFAC", info.interfaceType, "camera interface");
+    if ( !info.sensorModel.empty() ) cameraCards += fits_string_card("DETECTOR", info.sensorModel, "sensor model");
+    if ( info.pixelWidth > 0 ) cameraCards += fits_number_card("XPIXSZ", info.pixelWidth, "pixel width [um]");
+    if ( info.pixelHeight > 0 ) cameraCards += fits_number_card("YPIXSZ", info.pixelHeight, "pixel height [um]");
+
+    std::wstring_convert<std::codecvt_utf8<AT_WC>> cvt;
+
+    for ( const FITSFeatureKeyword &key: FITS_FEATURE_KEYWORDS ) {
+        for ( auto it = features.begin(); it != features.end(); ++it ) {
+            if ( it->first != key.feature ) continue;
+
+            std::string value = cvt.to_bytes(it->second);
+            char* end;
+
+            switch ( key.kind ) {
+                case FITS_NUMBER:
+                    std::strtod(value.c_str(), &end);
+                    if ( !value.empty() && *end == '\0' ) {
+                        cameraCards += fits_card(key.keyword, fits_fixed_value(value), key.comment);
+                    } else {
+                        cameraCards += fits_string_card(key.keyword, value, key.comment);
+                    }
+                    break;
+                case FITS_LOGICAL:
+                    cameraCards += fits_logical_card(key.keyword, value == "true", key.comment);
+                    break;
+                default:
+                    cameraCards += fits_string_card(key.keyword, value, key.comment);
+                    break;
+            }
+            break;
+        }
+    }
+
+    // primary header
+
+    std::string header = fits_logical_card("SIMPLE", true, "conforms to FITS standard");
+    if ( layout == DataCube ) {
+        header += imageCards(0);
+        naxis3CardPos = 5*ANDOR_FITS_CARD_SIZE; // SIMPLE, BITPIX, NAXIS, NAXIS1, NAXIS2, NAXIS3
+    } else {
+        header += fits_number_card("BITPIX", 8, "");
+        header += fits_number_card("NAXIS", 0, "no data in primary HDU");
+        header += fits_logical_card("EXTEND", true, "one IMAGE extension per frame");
+        naxis3CardPos = -1;
+    }
+    header = fits_end_of_header(header + cameraCards);
+
+    fitsFile = std::fopen(filename.c_str(), "wb");
+    if ( fitsFile == nullptr ) {
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO,
+                                 "Cannot create FITS file '" + filename + "' (" + std::strerror(errno) + ")");
+    }
+
+    nextSequence = 0;
+    nextWriteSequence = 0;
+    writtenFrames = 0;
+    failedFrames = 0;
+    lastErrno = 0;
+
+    if ( !writeData(header.data(), header.size()) ) {
+        std::string err = "Cannot write FITS file '" + filename + "' (" + std::strerror(lastErrno) + ")";
+        std::fclose(fitsFile);
+        fitsFile = nullptr;
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO, err);
+    }
+
+    writerActive = true;
+
+    for ( size_t i = 0; i < encodersNumber; ++i ) {
+        encoderThreads.push_back(std::thread(&ANDOR_FITSWriter::encoderFunc, this));
+    }
+}
+
+
+bool ANDOR_FITSWriter::push(ANDOR_Frame &&frame)
+{
+    if ( !writerActive || !frame.isValid() ) return false;
+
+    EncoderItem item;
+    item.frame = std::move(frame);
+    item.sequence = nextSequence++;
+
+    if ( !encodeQueue.push(std::move(item)) ) { // queue is full: give the frame back
+        --nextSequence; // the only producer is the caller
+        frame = std::move(item.frame);
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(encodeQueueMutex);
+    }
+    encodeQueueCond.notify_one();
+
+    return true;
+}
+
+
+void ANDOR_FITSWriter::close()
+{
+    if ( fitsFile == nullptr ) return;
+
+    {   // wait for all enqueued frames
+        std::unique_lock<std::mutex> lock(writeMutex);
+        writeTurnCond.wait(lock, [this]() { return nextWriteSequence == nextSequence; });
+    }
+
+    writerActive = false;
+    {
+        std::lock_guard<std::mutex> lock(encodeQueueMutex);
+    }
+    encodeQueueCond.notify_all();
+
+    for ( size_t i = 0; i < encoderThreads.size(); ++i ) encoderThreads[i].join();
+    encoderThreads.clear();
+
+    bool ok = true;
+
+    if ( fitsLayout == DataCube ) {
+        // pad data to the FITS block and set the actual number of frames
+        size_t data_size = nextSequence*frameDataSize;
+        std::vector<char> pad(fits_padded_size(data_size) - data_size, 0);
+        if ( pad.size() ) ok = writeData(pad.data(), pad.size());
+
+        std::string card = fits_number_card("NAXIS3", size_t(nextSequence), "number of frames");
+        if ( ok ) ok = std::fseek(fitsFile, naxis3CardPos, SEEK_SET) == 0 && writeData(card.data(), card.size());
+        if ( !ok && !lastErrno ) lastErrno = errno;
+    }
+
+    if ( std::fclose(fitsFile) && ok ) {
+        ok = false;
+        lastErrno = errno;
+    }
+    fitsFile = nullptr;
+
+    if ( failedFrames ) {
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO,
+                                 std::to_string(failedFrames) + " frames were not written to '" + fileName + "' (" +
+                                 std::strerror(lastErrno) + ")");
+    }
+
+    if ( !ok ) {
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO,
+                                 "Cannot complete FITS file '" + fileName + "' (" + std::strerror(lastErrno) + ")");
+    }
+}
+
+
+bool ANDOR_FITSWriter::isOpen() const
+{
+    return fitsFile != nullptr;
+}
+
+
+size_t ANDOR_FITSWriter::framesNumber() const
+{
+    return nextSequence;
+}
+
+
+size_t ANDOR_FITSWriter::framesWritten() const
+{
+    return writtenFrames;
+}
+
+
+size_t ANDOR_FITSWriter::failedWrites() const
+{
+    return failedFrames;
+}
+
+
+                /*  PRIVATE METHODS  */
+
+void ANDOR_FITSWriter::encoderFunc()
+{
+    EncoderItem item;
+    std::vector<AT_U8> buff;
+
+    for (;;) {
+        if ( !encodeQueue.pop(item) ) {
+            std::unique_lock<std::mutex> lock(encodeQueueMutex);
+            encodeQueueCond.wait(lock, [this, &item]() { return encodeQueue.pop(item) || !writerActive; });
+            if ( !item.frame.isValid() ) break; // writer is closed and queue is empty
+        }
+
+        bool ok = size_t(item.frame.size()) >= fitsGeometry.stride*fitsGeometry.height;
+        if ( ok ) {
+            encodeFrame(item.frame, buff);
+        } else if ( fitsLayout == DataCube ) { // keep the number of cube frames: write zero image
+            buff.assign(frameDataSize, 0);
+        } else {
+            buff.clear();
+        }
+
+        item.frame.release(); // re-queue SDK buffer right now
+
+        std::unique_lock<std::mutex> lock(writeMutex);
+        writeTurnCond.wait(lock, [this, &item]() { return nextWriteSequence == item.sequence; });
+
+        if ( writeData(buff.data(), buff.size()) && ok ) {
+            ++writtenFrames;
+        } else {
+            ++failedFrames;
+        }
+
+        ++nextWriteSequence;
+        lock.unlock();
+        writeTurnCond.notify_all();
+    }
+}
+
+
+void ANDOR_FITSWriter::encodeFrame(const ANDOR_Frame &frame, std::vector<AT_U8> &buff)
+{
+    std::string header;
+
+    if ( fitsLayout == ImagePerHDU ) {
+        std::chrono::system_clock::time_point utc = utcOrigin +
+                std::chrono::duration_cast<std::chrono::system_clock::duration>(frame.timestamp() - steadyOrigin);
+
+        header = fits_string_card("XTENSION", "IMAGE", "image extension");
+        header += imageCards(0);
+        header += fits_number_card("FRAMENUM", frame.number(), "frame number within acquisition");
+        header += fits_string_card("DATE-OBS", fits_date(utc), "UTC time of frame arrival");
+
+        ANDOR_FrameMetadata metadata;
+        if ( andor_parse_metadata(frame, metadata) && metadata.hasTimestamp ) {
+            header += fits_number_card("TICKS", metadata.timestamp, "metadata timestamp [clock ticks]");
+        }
+
+        header = fits_end_of_header(header);
+    }
+
+    size_t data_size = (fitsLayout == ImagePerHDU) ? fits_padded_size(frameDataSize) : frameDataSize;
+    buff.resize(header.size() + data_size);
+
+    std::memcpy(buff.data(), header.data(), header.size());
+
+    // header size is a multiple of 2880, so rows are aligned to 4 bytes
+    AT_U8* dst = buff.data() + header.size();
+    const AT_U8* src = frame.data();
+
+    for ( size_t y = 0; y < fitsGeometry.height; ++y, src += fitsGeometry.stride ) {
+        if ( fitsBitpix == 32 ) {
+            andor_encode_be_signed(reinterpret_cast<const uint32_t*>(src), fitsGeometry.width, dst);
+            dst += 4*fitsGeometry.width;
+        } else {
+            uint16_t* row = reinterpret_cast<uint16_t*>(dst);
+            andor_unpack_row(src, fitsGeometry.width, fitsGeometry.encoding, row);
+            andor_encode_be_signed(row, fitsGeometry.width, dst); // in place
+            dst += 2*fitsGeometry.width;
+        }
+    }
+
+    std::memset(dst, 0, buff.data() + buff.size() - dst); // padding of HDU data
+}
+
+
+std::string ANDOR_FITSWriter::imageCards(const size_t naxis3) const
+{
+    std::string cards = fits_number_card("BITPIX", fitsBitpix, "signed integers (see BZERO)");
+
+    cards += fits_number_card("NAXIS", fitsLayout == DataCube ? 3 : 2, "");
+    cards += fits_number_card("NAXIS1", fitsGeometry.width, "image width");
+    cards += fits_number_card("NAXIS2", fitsGeometry.height, "image height");
+
+    if ( fitsLayout == DataCube ) {
+        cards += fits_number_card("NAXIS3", naxis3, "number of frames");
+    } else {
+        cards += fits_number_card("PCOUNT", 0, "");
+        cards += fits_number_card("GCOUNT", 1, "");
+    }
+
+    cards += fits_number_card("BZERO", fitsBitpix == 32 ? 2147483648.0 : 32768.0, "unsigned values");
+    cards += fits_number_card("BSCALE", 1, "");
+
+    return cards;
+}
+
+
+bool ANDOR_FITSWriter::writeData(const void *data, const size_t size)
+{
+    if ( std::fwrite(data, 1, size, fitsFile) != size ) {
+        lastErrno = errno;
+        return false;
+    }
+
+    return true;
+}
+
+
+
+                /*  SINGLE-IMAGE FITS FILES  */
+
+// structural keywords are produced by writer itself
+static bool fits_is_structural(const std::string &keyword)
+{
+    return keyword == "SIMPLE" || keyword == "BITPIX" || keyword.compare(0, 5, "NAXIS") == 0 ||
+           keyword == "EXTEND" || keyword == "BZERO" || keyword == "BSCALE" || keyword == "END";
+}
+
+
+static bool fits_is_number(const std::string &str, double &value)
+{
+    if ( str.empty() ) return false;
+
+    char* end;
+    value = std::strtod(str.c_str(), &end);
+
+    while ( *end == ' ' ) ++end;
+
+    return *end == '\0';
+}
+
+
+// value of 'KEYWORD = value / comment' card (quotes of string value are removed)
+static std::string fits_card_value(const std::string &card)
+{
+    if ( card.compare(8, 2, "= ") ) return "";
+
+    size_t pos = card.find_first_not_of(' ', 10);
+    if ( pos == std::string::npos ) return "";
+
+    std::string value;
+
+    if ( card[pos] == '\'' ) {
+        for ( ++pos; pos < card.size(); ++pos ) {
+            if ( card[pos] == '\'' ) {
+                if ( pos + 1 < card.size() && card[pos+1] == '\'' ) { // doubled quote
+                    ++pos;
+                } else {
+                    break;
+                }
+            }
+            value += card[pos];
+        }
+    } else {
+        value = card.substr(pos, card.find('/', pos) - pos);
+    }
+
+    size_t last = value.find_last_not_of(' '); // trailing spaces are not significant
+    value.resize(last == std::string::npos ? 0 : last + 1);
+
+    return value;
+}
+
+
+void andor_fits_write_image(const std::string &filename, const float *data,
+                            const size_t width, const size_t height, const ANDOR_FITSKeywords &keywords)
+{
+    std::string cards = fits_logical_card("SIMPLE", true, "conforms to FITS standard");
+    cards += fits_number_card("BITPIX", -32, "IEEE single precision floating point");
+    cards += fits_number_card("NAXIS", 2, "");
+    cards += fits_number_card("NAXIS1", width, "image width");
+    cards += fits_number_card("NAXIS2", height, "image height");
+
+    double num;
+    for ( auto &kw: keywords ) {
+        if ( fits_is_structural(kw.first) ) continue;
+
+        if ( fits_is_number(kw.second, num) ) {
+            cards += fits_card(kw.first, fits_fixed_value(kw.second), "");
+        } else {
+            cards += fits_string_card(kw.first, kw.second, "");
+        }
+    }
+
+    std::string header = fits_end_of_header(cards);
+
+    std::FILE* file = std::fopen(filename.c_str(), "wb");
+    if ( file == nullptr ) {
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO,
+                                 "Cannot create FITS file '" + filename + "' (" + std::strerror(errno) + ")");
+    }
+
+    bool ok = std::fwrite(header.data(), 1, header.size(), file) == header.size();
+
+    // big-endian IEEE floats, converted by rows
+    std::vector<AT_U8> row(width*4);
+    for ( size_t y = 0; ok && y < height; ++y ) {
+        andor_encode_be_signed(reinterpret_cast<const uint32_t*>(data + y*width), width, row.data());
+        for ( size_t i = 0; i < width; ++i ) row[4*i] ^= 0x80; // no offset for floats: restore sign bit
+        ok = std::fwrite(row.data(), 1, row.size(), file) == row.size();
+    }
+
+    size_t data_size = width*height*4;
+    std::vector<AT_U8> pad(fits_padded_size(data_size) - data_size, 0);
+    if ( ok && !pad.empty() ) ok = std::fwrite(pad.data(), 1, pad.size(), file) == pad.size();
+
+    int err = errno;
+    if ( std::fclose(file) ) ok = false;
+
+    if ( !ok ) {
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO,
+                                 "Cannot write FITS file '" + filename + "' (" + std::strerror(err) + ")");
+    }
+}
+
+
+void andor_fits_read_image(const std::string &filename, std::vector<float> &data,
+                           size_t &width, size_t &height, ANDOR_FITSKeywords &keywords)
+{
+    std::FILE* file = std::fopen(filename.c_str(), "rb");
+    if ( file == nullptr ) {
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO,
+                                 "Cannot open FITS file '" + filename + "' (" + std::strerror(errno) + ")");
+    }
+
+    std::unique_ptr<std::FILE, int(*)(std::FILE*)> file_guard(file, std::fclose);
+
+    keywords.clear();
+
+    // header
+    char block[ANDOR_FITS_BLOCK_SIZE];
+    bool end_found = false;
+    bool first_card = true;
+
+    while ( !end_found ) {
+        if ( std::fread(block, 1, ANDOR_FITS_BLOCK_SIZE, file) != ANDOR_FITS_BLOCK_SIZE ) {
+            throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_FORMAT, "Unexpected end of FITS header in '" + filename + "'!");
+        }
+
+        for ( size_t pos = 0; pos < ANDOR_FITS_BLOCK_SIZE; pos += ANDOR_FITS_CARD_SIZE ) {
+            std::string card(block + pos, ANDOR_FITS_CARD_SIZE);
+            std::string keyword = card.substr(0, card.find_last_not_of(' ', 7) + 1);
+
+            if ( first_card ) {
+                if ( keyword != "SIMPLE" || fits_card_value(card) != "T" ) {
+                    throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_FORMAT, "'" + filename + "' is not a FITS file!");
+                }
+                first_card = false;
+            }
+
+            if ( keyword == "END" ) {
+                end_found = true;
+                break;
+            }
+
+            if ( !keyword.empty() && keyword != "COMMENT" && keyword != "HISTORY" ) {
+                keywords[keyword] = fits_card_value(card);
+            }
+        }
+    }
+
+    double bitpix = 0, naxis = 0, naxis1 = 0, naxis2 = 0, bzero = 0.0, bscale = 1.0;
+
+    if ( !fits_is_number(keywords["BITPIX"], bitpix) || !fits_is_number(keywords["NAXIS"], naxis) || naxis < 2 ||
+         !fits_is_number(keywords["NAXIS1"], naxis1) || !fits_is_number(keywords["NAXIS2"], naxis2) ||
+         naxis1 < 1 || naxis2 < 1 ) {
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_FORMAT, "FITS file '" + filename + "' has no 2D image!");
+    }
+    if ( keywords.count("BZERO") ) fits_is_number(keywords["BZERO"], bzero);
+    if ( keywords.count("BSCALE") ) fits_is_number(keywords["BSCALE"], bscale);
+
+    int bp = int(bitpix);
+    if ( bp != 8 && bp != 16 && bp != 32 && bp != -32 && bp != -64 ) {
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_FORMAT, "Unsupported BITPIX in FITS file '" + filename + "'!");
+    }
+
+    width = size_t(naxis1);
+    height = size_t(naxis2);
+
+    // data (big-endian)
+    size_t n = width*height;
+    size_t pix_size = std::abs(bp)/8;
+
+    std::vector<AT_U8> raw(n*pix_size);
+    if ( std::fread(raw.data(), 1, raw.size(), file) != raw.size() ) {
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_FORMAT, "Unexpected end of FITS data in '" + filename + "'!");
+    }
+
+    data.resize(n);
+
+    for ( size_t i = 0; i < n; ++i ) {
+        const AT_U8* p = raw.data() + i*pix_size;
+        uint64_t v = 0;
+        for ( size_t k = 0; k < pix_size; ++k ) v = (v << 8) | p[k];
+
+        double val;
+        switch ( bp ) {
+            case 8:
+                val = double(v);
+                break;
+            case 16:
+                val = double(int16_t(uint16_t(v)));
+                break;
+            case 32:
+                val = double(int32_t(uint32_t(v)));
+                break;
+            case -32: {
+                uint32_t u = uint32_t(v);
+                float f;
+                std::memcpy(&f, &u, 4);
+                val = f;
+                break;
+            }
+            default: {
+                double d;
+                std::memcpy(&d, &v, 8);
+                val = d;
+            }
+        }
+
+        data[i] = float(bzero + bscale*val);
+    }
+}
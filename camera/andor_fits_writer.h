@@ -0,0 +1,150 @@
+#ifndef ANDOR_FITS_WRITER_H
+#define ANDOR_FITS_WRITER_H
+
+#include "../export_decl.h"
+#include "andor_camera.h"
+#include "andor_frame.h"
+#include "andor_ring_queue.h"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <map>
+
+// for MS compilers: disable multiple warnings about DLL-exports for the STL containers
+#ifdef _MSC_VER
+#pragma warning( disable: 4251 )
+#endif
+
+
+#define ANDOR_FITS_WRITER_DEFAULT_ENCODERS_NUMBER 2   // number of threads converting frames to FITS data
+#define ANDOR_FITS_WRITER_DEFAULT_QUEUE_LENGTH 16     // maximal number of frames waiting for encoding
+#define ANDOR_FITS_BLOCK_SIZE 2880                    // FITS logical record length
+#define ANDOR_FITS_CARD_SIZE 80
+
+
+            /*   STREAMING FITS WRITER   */
+
+//
+//  Frames are written either as one data cube in the primary HDU (NAXIS3 is the number
+//  of frames, it is fixed up on close) or as an IMAGE extension per frame (with frame number
+//  and UTC time of frame arrival in the header).
+//  Pixels are stored as BITPIX = 16 (Mono12, Mono12Packed, Mono16) or BITPIX = 32 (Mono32)
+//  signed big-endian integers with BZERO offset, so the values are kept unchanged.
+//
+//  Encoder threads unpack frames and convert them to big-endian (SIMD kernels) in parallel, and
+//  append the results to the file in the order of frames. A frame buffer is re-queued to SDK
+//  as soon as its conversion is completed (before the data are written).
+//
+
+class ANDOR_API_WRAPPER_EXPORT ANDOR_FITSWriter
+{
+public:
+    enum FITSLayout {DataCube, ImagePerHDU};
+
+    explicit ANDOR_FITSWriter(const size_t encoders_number = ANDOR_FITS_WRITER_DEFAULT_ENCODERS_NUMBER,
+                              const size_t queue_length = ANDOR_FITS_WRITER_DEFAULT_QUEUE_LENGTH);
+
+    ANDOR_FITSWriter(const ANDOR_FITSWriter &other) = delete;
+    ANDOR_FITSWriter & operator = (const ANDOR_FITSWriter &other) = delete;
+
+    ~ANDOR_FITSWriter();
+
+    // header keywords are taken from camera info and the current values of camera features,
+    // image geometry is the one of the current acquisition (call it after ANDOR_Camera::acquisitionStart).
+    // Throws AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO) if the file cannot be created
+    void open(const std::string &filename, ANDOR_Camera &camera, const FITSLayout layout = DataCube);
+
+    void open(const std::string &filename, const ANDOR_FrameGeometry &geometry, const ANDOR_CameraInfo &info,
+              const ANDOR_Camera::AndorFeatureSnapshot &features, const FITSLayout layout = DataCube);
+
+    // enqueue frame for writing (push from a single thread). Returns false (and leaves
+    // the frame untouched) if the queue is full or the writer is not opened
+    bool push(ANDOR_Frame &&frame);
+
+    // wait for all frames, complete the file and close it.
+    // Throws AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO) if any write failed
+    void close();
+
+    bool isOpen() const;
+
+    size_t framesNumber() const;   // number of frames accepted by push
+    size_t framesWritten() const;
+    size_t failedWrites() const;
+
+    // names of camera features used for header keywords
+    static std::vector<andor_string_t> headerFeatures();
+
+private:
+    struct EncoderItem {
+        ANDOR_Frame frame;
+        size_t sequence;
+    };
+
+    std::FILE* fitsFile;
+    std::string fileName;
+    FITSLayout fitsLayout;
+    ANDOR_FrameGeometry fitsGeometry;
+    int fitsBitpix;
+    size_t frameDataSize;    // bytes of encoded image
+    long naxis3CardPos;      // file position of NAXIS3 card (data cube)
+
+    std::string cameraCards; // keywords from camera info and features (common for all HDUs)
+
+    // to convert host time of frame arrival to UTC
+    std::chrono::system_clock::time_point utcOrigin;
+    std::chrono::steady_clock::time_point steadyOrigin;
+
+    size_t encodersNumber;
+    std::vector<std::thread> encoderThreads;
+
+    ANDOR_RingQueue<EncoderItem> encodeQueue;
+    std::mutex encodeQueueMutex;
+    std::condition_variable encodeQueueCond;
+
+    // encoded frames are appended to the file in the order of sequence numbers
+    std::mutex writeMutex;
+    std::condition_variable writeTurnCond;
+    size_t nextWriteSequence;
+
+    std::atomic<bool> writerActive;
+    std::atomic<size_t> nextSequence;
+    std::atomic<size_t> writtenFrames;
+    std::atomic<size_t> failedFrames;
+    int lastErrno;
+
+    void encoderFunc();
+
+    // convert frame to FITS data (and extension header) into 'buff'
+    void encodeFrame(const ANDOR_Frame &frame, std::vector<AT_U8> &buff);
+
+    std::string imageCards(const size_t naxis3) const; // BITPIX, NAXISn, BZERO ...
+    bool writeData(const void* data, const size_t size);
+};
+
+
+            /*   SINGLE-IMAGE FITS FILES   */
+
+//
+//  Plain 2D images in the primary HDU (e.g. master calibration frames, see ANDOR_MasterFrame).
+//  Images are written as BITPIX = -32; reader accepts BITPIX = 8, 16, 32, -32 and -64 (BSCALE and BZERO
+//  are applied) and takes the first plane of a cube. Keyword values are kept as text: on writing,
+//  a value which is a number is written as numeric one, otherwise as a string.
+//  Functions throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO or ANDOR_WRAPPER_ERR_FILE_FORMAT)
+//
+
+typedef std::map<std::string, std::string> ANDOR_FITSKeywords;
+
+ANDOR_API_WRAPPER_EXPORT void andor_fits_write_image(const std::string &filename, const float* data,
+                                                     const size_t width, const size_t height,
+                                                     const ANDOR_FITSKeywords &keywords = ANDOR_FITSKeywords());
+
+ANDOR_API_WRAPPER_EXPORT void andor_fits_read_image(const std::string &filename, std::vector<float> &data,
+                                                    size_t &width, size_t &height, ANDOR_FITSKeywords &keywords);
+
+#endif // ANDOR_FITS_WRITER_H
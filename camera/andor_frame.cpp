@@ -0,0 +1,281 @@
+                        /*****************************************
+                         *                                       *
+                         *  IMPLEMENTATION OF ANDOR_Frame CLASS  *
+                         *                                       *
+                         *****************************************/
+
+
+#include "andor_frame.h"
+#include "andor_frame_stats.h"
+
+#include <utility>
+
+
+// serials of recyclers (0 is never used, see ANDOR_CapturedBuffer::generation)
+static std::atomic<uint64_t> frame_recycler_generation(0);
+
+
+                /*  ANDOR_FrameRecycler CLASS IMPLEMENTATION  */
+
+ANDOR_FrameRecycler::ANDOR_FrameRecycler(const std::shared_ptr<ANDOR_ImageBufferPool> &pool,
+                                         const ANDOR_FrameGeometry &geometry, const bool with_statistics,
+                                         const size_t calibrated_size,
+                                         const std::shared_ptr<std::vector<float>> &calibrated_images):
+    bufferPool(pool), recyclerGeneration(++frame_recycler_generation), releasedBuffers(pool->buffersNumber()), active(true), outstandingBuffers(0),
+    heldBuffers(new std::atomic<bool>[pool->buffersNumber()]), frameGeometry(geometry), bufferStatistics(),
+    calibratedSize(calibrated_size), calibratedImages(calibrated_images), calibratedSlots(0), nextCalibratedSlot(0),
+    busyCalibratedSlots(), bufferCalibratedSlot()
+{
+    for ( size_t i = 0; i < pool->buffersNumber(); ++i ) heldBuffers[i].store(false, std::memory_order_relaxed);
+
+    if ( with_statistics ) bufferStatistics.reset(new ANDOR_FrameStatistics[pool->buffersNumber()]);
+
+    if ( calibratedSize && calibratedImages ) calibratedSlots = calibratedImages->size()/calibratedSize;
+    if ( calibratedSlots ) {
+        busyCalibratedSlots.reset(new std::atomic<bool>[calibratedSlots]);
+        for ( size_t i = 0; i < calibratedSlots; ++i ) busyCalibratedSlots[i].store(false, std::memory_order_relaxed);
+
+        bufferCalibratedSlot.reset(new size_t[pool->buffersNumber()]);
+        for ( size_t i = 0; i < pool->buffersNumber(); ++i ) bufferCalibratedSlot[i] = calibratedSlots;
+    }
+}
+
+
+ANDOR_FrameRecycler::~ANDOR_FrameRecycler()
+{
+}
+
+
+const ANDOR_FrameGeometry & ANDOR_FrameRecycler::geometry() const
+{
+    return frameGeometry;
+}
+
+
+uint64_t ANDOR_FrameRecycler::generation() const
+{
+    return recyclerGeneration;
+}
+
+
+ANDOR_FrameStatistics* ANDOR_FrameRecycler::statistics(const AT_U8 *ptr)
+{
+    if ( !bufferStatistics ) return nullptr;
+
+    size_t idx = bufferPool->bufferIndex(ptr);
+
+    return idx < bufferPool->buffersNumber() ? &bufferStatistics[idx] : nullptr;
+}
+
+
+float* ANDOR_FrameRecycler::takeCalibrated(const AT_U8 *ptr)
+{
+    if ( !calibratedSlots ) return nullptr;
+
+    size_t idx = bufferPool->bufferIndex(ptr);
+    if ( idx >= bufferPool->buffersNumber() ) return nullptr;
+
+    if ( bufferCalibratedSlot[idx] < calibratedSlots ) { // it should not happen, but do not leak the image
+        return calibratedImages->data() + bufferCalibratedSlot[idx]*calibratedSize;
+    }
+
+    // images are usually given back in order of frames, so the search starts after the last taken one
+    for ( size_t i = 0; i < calibratedSlots; ++i ) {
+        size_t slot = (nextCalibratedSlot + i) % calibratedSlots;
+        if ( !busyCalibratedSlots[slot].load(std::memory_order_acquire) ) { // only this thread sets the flag
+            busyCalibratedSlots[slot].store(true, std::memory_order_relaxed);
+            bufferCalibratedSlot[idx] = slot;
+            nextCalibratedSlot = (slot + 1) % calibratedSlots;
+            return calibratedImages->data() + slot*calibratedSize;
+        }
+    }
+
+    return nullptr;
+}
+
+
+void ANDOR_FrameRecycler::dropCalibrated(const AT_U8 *ptr)
+{
+    size_t idx = bufferPool->bufferIndex(ptr);
+    if ( idx < bufferPool->buffersNumber() ) freeCalibrated(idx);
+}
+
+
+void ANDOR_FrameRecycler::freeCalibrated(const size_t buffer_idx)
+{
+    if ( !calibratedSlots ) return;
+
+    // the slot index was written by acquisition thread before the buffer was handed off
+    size_t slot = bufferCalibratedSlot[buffer_idx];
+    if ( slot >= calibratedSlots ) return;
+
+    bufferCalibratedSlot[buffer_idx] = calibratedSlots;
+    busyCalibratedSlots[slot].store(false, std::memory_order_release); // the image is not read after this
+}
+
+
+void ANDOR_FrameRecycler::acquire(const AT_U8 *ptr)
+{
+    size_t idx = bufferPool->bufferIndex(ptr);
+    if ( idx < bufferPool->buffersNumber() ) heldBuffers[idx].store(true, std::memory_order_relaxed);
+
+    ++outstandingBuffers;
+}
+
+
+bool ANDOR_FrameRecycler::release(AT_U8 *ptr)
+{
+    // a foreign pointer or a second release must not be queued to SDK
+    size_t idx = bufferPool->bufferIndex(ptr);
+    if ( idx >= bufferPool->buffersNumber() || !heldBuffers[idx].exchange(false) ) return false;
+
+    freeCalibrated(idx); // before the buffer can be taken by acquisition thread again
+
+    // buffers of finished acquisition are not re-queued (SDK queue was already flushed)
+    if ( active ) releasedBuffers.push(ptr); // never fails: queue capacity is not less than number of buffers
+
+    --outstandingBuffers;
+
+    return true;
+}
+
+
+bool ANDOR_FrameRecycler::popReleased(AT_U8* &ptr)
+{
+    return releasedBuffers.pop(ptr);
+}
+
+
+void ANDOR_FrameRecycler::deactivate()
+{
+    active = false;
+}
+
+
+size_t ANDOR_FrameRecycler::outstanding() const
+{
+    return outstandingBuffers;
+}
+
+
+
+                /*  ANDOR_Frame CLASS IMPLEMENTATION  */
+
+ANDOR_Frame::ANDOR_Frame():
+    frameRecycler(), frameBuffer()
+{
+    frameBuffer.ptr = nullptr;
+    frameBuffer.size = 0;
+    frameBuffer.number = 0;
+    frameBuffer.statistics = nullptr;
+    frameBuffer.calibrated = nullptr;
+    frameBuffer.generation = 0;
+}
+
+
+ANDOR_Frame::ANDOR_Frame(const std::shared_ptr<ANDOR_FrameRecycler> &recycler, const ANDOR_CapturedBuffer &buffer):
+    frameRecycler(recycler), frameBuffer(buffer)
+{
+}
+
+
+ANDOR_Frame::ANDOR_Frame(ANDOR_Frame &&other):
+    ANDOR_Frame()
+{
+    swap(other);
+}
+
+
+ANDOR_Frame & ANDOR_Frame::operator = (ANDOR_Frame &&other)
+{
+    if ( this == &other ) return *this;
+
+    release();
+    swap(other);
+
+    return *this;
+}
+
+
+ANDOR_Frame::~ANDOR_Frame()
+{
+    release();
+}
+
+
+bool ANDOR_Frame::isValid() const
+{
+    return frameBuffer.ptr != nullptr;
+}
+
+
+ANDOR_Frame::operator bool() const
+{
+    return isValid();
+}
+
+
+AT_U8* ANDOR_Frame::data() const
+{
+    return frameBuffer.ptr;
+}
+
+
+int ANDOR_Frame::size() const
+{
+    return frameBuffer.size;
+}
+
+
+size_t ANDOR_Frame::number() const
+{
+    return frameBuffer.number;
+}
+
+
+std::chrono::steady_clock::time_point ANDOR_Frame::timestamp() const
+{
+    return frameBuffer.timestamp;
+}
+
+
+const ANDOR_FrameStatistics* ANDOR_Frame::statistics() const
+{
+    return frameBuffer.statistics;
+}
+
+
+const float* ANDOR_Frame::calibrated() const
+{
+    return frameBuffer.calibrated;
+}
+
+
+ANDOR_FrameGeometry ANDOR_Frame::geometry() const
+{
+    if ( frameRecycler ) return frameRecycler->geometry();
+
+    ANDOR_FrameGeometry geom = {0, 0, 0, PIXEL_ENCODING_UNKNOWN};
+    return geom;
+}
+
+
+void ANDOR_Frame::release()
+{
+    if ( frameBuffer.ptr == nullptr ) return;
+
+    if ( frameRecycler ) frameRecycler->release(frameBuffer.ptr);
+
+    frameRecycler.reset();
+    frameBuffer.ptr = nullptr;
+    frameBuffer.size = 0;
+    frameBuffer.statistics = nullptr;
+    frameBuffer.calibrated = nullptr;
+}
+
+
+void ANDOR_Frame::swap(ANDOR_Frame &other)
+{
+    std::swap(frameRecycler, other.frameRecycler);
+    std::swap(frameBuffer, other.frameBuffer);
+}
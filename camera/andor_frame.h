@@ -0,0 +1,150 @@
+#ifndef ANDOR_FRAME_H
+#define ANDOR_FRAME_H
+
+#include "../export_decl.h"
+#include "andor_ring_queue.h"
+#include "andor_buffer_pool.h"
+#include "andor_pixel_unpack.h"
+
+#include <atcore.h>
+
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+
+struct ANDOR_FrameStatistics; // see andor_frame_stats.h
+
+
+            /*   IMAGE BUFFER DESCRIPTION PASSED FROM ACQUISITION THREAD TO CONSUMERS  */
+
+struct ANDOR_CapturedBuffer
+{
+    AT_U8* ptr;
+    int size;
+    size_t number; // sequential number of frame within acquisition (starting from 0)
+    std::chrono::steady_clock::time_point timestamp; // host time when AT_WaitBuffer returned
+    const ANDOR_FrameStatistics* statistics; // computed by acquisition thread (nullptr if it is disabled)
+    const float* calibrated; // calibrated image of width*height floats (nullptr if calibration is disabled)
+    uint64_t generation; // serial of the recycler of the acquisition (buffers of another one are rejected)
+};
+
+
+            /*   SHARED STATE TO RETURN IMAGE BUFFERS BACK TO ACQUISITION THREAD  */
+
+//
+//  A new recycler is created for each acquisition. Frames keep a reference to it, so
+//  a frame released after acquisitionStop() does not touch the queue of the next acquisition.
+//  The recycler also keeps the buffer pool alive while any frame still refers to it.
+//  If frame statistics are enabled, it also keeps one statistics slot per image buffer: it is rewritten
+//  only after the buffer is re-queued to SDK.
+//  Calibrated images are a small ring (its storage is allocated by the camera and reused by acquisitions).
+//  An image is taken for a buffer by acquisition thread and it is owned by the buffer until the buffer
+//  is released, so the number of images bounds the number of calibrated frames in flight: if all of them
+//  are held, the frame is handed off without calibrated image.
+//
+
+class ANDOR_FrameRecycler
+{
+public:
+    ANDOR_FrameRecycler(const std::shared_ptr<ANDOR_ImageBufferPool> &pool, const ANDOR_FrameGeometry &geometry,
+                        const bool with_statistics = false, const size_t calibrated_size = 0,
+                        const std::shared_ptr<std::vector<float>> &calibrated_images = nullptr);
+    ~ANDOR_FrameRecycler();
+
+    const ANDOR_FrameGeometry & geometry() const; // image geometry of the acquisition
+    uint64_t generation() const; // unique serial of the recycler (see ANDOR_CapturedBuffer)
+
+    // statistics slot of the buffer (nullptr if statistics are disabled or the buffer is not from the pool)
+    ANDOR_FrameStatistics* statistics(const AT_U8* ptr);
+
+    // take a free calibrated image ('calibrated_size' floats) for the buffer. nullptr if calibration is disabled,
+    // the buffer is not from the pool or all the images are owned by other buffers (acquisition thread only).
+    // The image is given back by release(ptr) or dropCalibrated(ptr)
+    float* takeCalibrated(const AT_U8* ptr);
+    void dropCalibrated(const AT_U8* ptr); // the buffer is not handed off (e.g. the frame was dropped)
+
+    void acquire(const AT_U8* ptr); // a buffer is handed off to a consumer
+    // a consumer returns the buffer. Returns false (and ignores the pointer) if it is not a buffer
+    // of the pool or it is not held by a consumer (e.g. it was already released)
+    bool release(AT_U8* ptr);
+
+    bool popReleased(AT_U8* &ptr); // called by acquisition thread only
+
+    void deactivate();
+    size_t outstanding() const;   // number of buffers currently held by consumers
+
+private:
+    std::shared_ptr<ANDOR_ImageBufferPool> bufferPool;
+    const uint64_t recyclerGeneration;
+    ANDOR_RingQueue<AT_U8*> releasedBuffers;
+    std::atomic<bool> active;
+    std::atomic<size_t> outstandingBuffers;
+    std::unique_ptr<std::atomic<bool>[]> heldBuffers; // the buffer is held by a consumer
+    ANDOR_FrameGeometry frameGeometry;
+    std::unique_ptr<ANDOR_FrameStatistics[]> bufferStatistics;
+    size_t calibratedSize;
+    std::shared_ptr<std::vector<float>> calibratedImages;
+    size_t calibratedSlots;
+    size_t nextCalibratedSlot; // acquisition thread only
+    std::unique_ptr<std::atomic<bool>[]> busyCalibratedSlots;
+    std::unique_ptr<size_t[]> bufferCalibratedSlot; // 'calibratedSlots' if the buffer has no image
+
+    void freeCalibrated(const size_t buffer_idx);
+};
+
+
+            /*   MOVE-ONLY ZERO-COPY HANDLE OF CAPTURED FRAME   */
+
+//
+//  Owns one image buffer of the camera pool. The buffer is returned to the acquisition
+//  thread (and then re-queued to SDK) when the handle is destroyed or release() is called.
+//  Pixels can be processed in place: no copy of data is made.
+//
+
+class ANDOR_API_WRAPPER_EXPORT ANDOR_Frame
+{
+    friend class ANDOR_Camera;
+public:
+    ANDOR_Frame();
+    ANDOR_Frame(ANDOR_Frame &&other);
+    ANDOR_Frame(const ANDOR_Frame &other) = delete;
+
+    ANDOR_Frame & operator = (ANDOR_Frame &&other);
+    ANDOR_Frame & operator = (const ANDOR_Frame &other) = delete;
+
+    ~ANDOR_Frame();
+
+    bool isValid() const;
+    explicit operator bool() const;
+
+    AT_U8* data() const;
+    int size() const;
+
+    size_t number() const;
+    std::chrono::steady_clock::time_point timestamp() const;
+
+    ANDOR_FrameGeometry geometry() const; // AOI geometry and pixel encoding of the image in buffer
+
+    // pixel statistics computed in the acquisition pipeline (see ANDOR_Camera::setFrameStatistics).
+    // nullptr if they are disabled. Valid while the handle owns the buffer
+    const ANDOR_FrameStatistics* statistics() const;
+
+    // calibrated image (width*height floats) computed in the acquisition pipeline
+    // (see ANDOR_Camera::setFrameCalibrator). nullptr if it is disabled. Valid while the handle owns the buffer
+    const float* calibrated() const;
+
+    void release(); // return the buffer right now (the handle becomes invalid)
+
+private:
+    ANDOR_Frame(const std::shared_ptr<ANDOR_FrameRecycler> &recycler, const ANDOR_CapturedBuffer &buffer);
+
+    std::shared_ptr<ANDOR_FrameRecycler> frameRecycler;
+    ANDOR_CapturedBuffer frameBuffer;
+
+    void swap(ANDOR_Frame &other);
+};
+
+#endif // ANDOR_FRAME_H
@@ -0,0 +1,560 @@
+                    /*************************************************
+                     *                                               *
+                     *  IMPLEMENTATION OF FRAME ARCHIVE WRITER AND   *
+                     *        MEMORY-MAPPED ARCHIVE READER           *
+                     *                                               *
+                     *************************************************/
+
+
+#include "andor_frame_archive.h"
+#include "andor_metadata.h"
+#include "andorsdk_exception.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <sstream>
+#include <locale>
+#include <codecvt>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
+
+static const char ARCHIVE_MAGIC[8] = {'A','N','D','O','R','A','R','C'};
+
+
+static inline size_t round_up(const size_t val, const size_t granularity)
+{
+    return (val + granularity - 1) / granularity * granularity;
+}
+
+
+// the format is little-endian (as all of platforms supported by SDK), so values are copied as is
+
+template<typename T>
+static inline void put_value(AT_U8* ptr, const T val)
+{
+    std::memcpy(ptr, &val, sizeof(T));
+}
+
+
+template<typename T>
+static inline T get_value(const AT_U8* ptr)
+{
+    T val;
+    std::memcpy(&val, ptr, sizeof(T));
+    return val;
+}
+
+
+static std::string text_line(const std::string &name, std::string value)
+{
+    for ( size_t i = 0; i < value.size(); ++i ) { // keep one line per value
+        if ( value[i] == '\n' || value[i] == '\r' ) value[i] = ' ';
+    }
+
+    return name + " = " + value + "\n";
+}
+
+
+static std::string text_line(const std::string &name, const andor_string_t &value)
+{
+    std::wstring_convert<std::codecvt_utf8<AT_WC>> cvt;
+
+    return text_line(name, cvt.to_bytes(value));
+}
+
+
+template<typename T>
+static std::string text_line(const std::string &name, const T value)
+{
+    std::ostringstream str;
+    str.precision(15);
+    str << value;
+
+    return text_line(name, str.str());
+}
+
+
+
+                /*******************************************
+                 *  ANDOR_FrameArchiveWriter IMPLEMENTATION  *
+                 *******************************************/
+
+ANDOR_FrameArchiveWriter::ANDOR_FrameArchiveWriter(const size_t writers_number, const size_t queue_length):
+    ANDOR_FrameRecorder(writers_number, queue_length),
+    headerText(), archiveHeaderSize(ANDOR_FRAME_RECORDER_ALIGNMENT), archiveFrameSize(0),
+    archiveGeometry(), frameIndex()
+{
+}
+
+
+ANDOR_FrameArchiveWriter::~ANDOR_FrameArchiveWriter()
+{
+    // must be closed here: hooks of the derived class are not called from the base class destructor
+    try {
+        close();
+    } catch ( AndorSDK_Exception &ex ) { // nothing to do in destructor
+    }
+}
+
+
+void ANDOR_FrameArchiveWriter::open(const std::string &filename, ANDOR_Camera &camera, const size_t frames_number,
+                                    const int flags)
+{
+    AT_64 frame_size = camera["ImageSizeBytes"];
+
+    open(filename, frame_size, frames_number, camera.getFrameGeometry(),
+         camera.getCameraInfo(), camera.getFeatureSnapshot(), flags);
+}
+
+
+void ANDOR_FrameArchiveWriter::open(const std::string &filename, const size_t frame_size, const size_t frames_number,
+                                    const ANDOR_FrameGeometry &geometry, const ANDOR_CameraInfo &info,
+                                    const ANDOR_Camera::AndorFeatureSnapshot &features, const int flags)
+{
+    close();
+
+    std::wstring_convert<std::codecvt_utf8<AT_WC>> cvt;
+
+    headerText = "[CameraInfo]\n";
+    headerText += text_line("CameraName", info.cameraName);
+    headerText += text_line("InterfaceType", info.interfaceType);
+    headerText += text_line("FirmwareVersion", info.firmwareVersion);
+    headerText += text_line("CameraModel", info.cameraModel);
+    headerText += text_line("SerialNumber", info.serialNumber);
+    headerText += text_line("ControllerID", info.controllerID);
+    headerText += text_line("CameraFamily", info.cameraFamily);
+    headerText += text_line("DDR2Type", info.DDR2Type);
+    headerText += text_line("DriverVersion", info.driverVersion);
+    headerText += text_line("MicrocodeVersion", info.microcodeVersion);
+    headerText += text_line("SensorModel", info.sensorModel);
+    headerText += text_line("SensorType", info.sensorType);
+    headerText += text_line("SensorWidth", info.sensorWidth);
+    headerText += text_line("SensorHeight", info.sensorHeight);
+    headerText += text_line("PixelWidth", info.pixelWidth);
+    headerText += text_line("PixelHeight", info.pixelHeight);
+    headerText += text_line("DeviceIndex", info.device_index);
+
+    headerText += "[Features]\n";
+    for ( auto it = features.begin(); it != features.end(); ++it ) {
+        headerText += text_line(cvt.to_bytes(it->first), it->second);
+    }
+
+    archiveHeaderSize = round_up(ANDOR_FRAME_ARCHIVE_FIXED_HEADER_SIZE + headerText.size(), ANDOR_FRAME_RECORDER_ALIGNMENT);
+    archiveFrameSize = frame_size;
+    archiveGeometry = geometry;
+
+    frameIndex.clear();
+    frameIndex.reserve(frames_number);
+
+    ANDOR_FrameRecorder::open(filename, frame_size, frames_number, flags);
+}
+
+
+                /*  PROTECTED METHODS  */
+
+size_t ANDOR_FrameArchiveWriter::headerSize() const
+{
+    return archiveHeaderSize;
+}
+
+
+bool ANDOR_FrameArchiveWriter::initFile()
+{
+    return writeHeader(0, 0);
+}
+
+
+void ANDOR_FrameArchiveWriter::frameQueued(const ANDOR_Frame &frame, const size_t slot)
+{
+    // the slot of a frame which was not enqueued is reused by the next one
+    if ( slot >= frameIndex.size() ) frameIndex.resize(slot + 1);
+
+    IndexEntry &entry = frameIndex[slot];
+
+    entry.offset = archiveHeaderSize + slot*slotSize();
+    entry.number = frame.number();
+    entry.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(frame.timestamp().time_since_epoch()).count();
+
+    ANDOR_FrameMetadata metadata;
+    entry.ticks = (andor_parse_metadata(frame, metadata) && metadata.hasTimestamp) ? metadata.timestamp : 0;
+}
+
+
+bool ANDOR_FrameArchiveWriter::finalizeFile(const size_t data_end, size_t &file_size)
+{
+    size_t n_frames = framesNumber();
+    size_t index_size = n_frames*ANDOR_FRAME_ARCHIVE_INDEX_ENTRY_SIZE;
+
+    file_size = data_end + index_size;
+
+    if ( n_frames ) {
+        // slots are page-aligned, so the index is written by one aligned write (suitable for direct I/O)
+        try {
+            ANDOR_ImageBufferPool buff(1, round_up(index_size, ANDOR_FRAME_RECORDER_ALIGNMENT));
+            AT_U8* ptr = buff.buffer(0);
+
+            std::memset(ptr, 0, buff.slotSize());
+            for ( size_t i = 0; i < n_frames; ++i, ptr += ANDOR_FRAME_ARCHIVE_INDEX_ENTRY_SIZE ) {
+                put_value<uint64_t>(ptr, frameIndex[i].offset);
+                put_value<uint64_t>(ptr + 8, frameIndex[i].number);
+                put_value<int64_t>(ptr + 16, frameIndex[i].timestamp);
+                put_value<uint64_t>(ptr + 24, frameIndex[i].ticks);
+            }
+
+            if ( !writeAt(buff.buffer(0), buff.slotSize(), data_end) ) return false;
+        } catch ( AndorSDK_Exception &ex ) {
+            lastErrno = ENOMEM;
+            return false;
+        }
+    }
+
+    return writeHeader(n_frames, data_end);
+}
+
+
+                /*  PRIVATE METHODS  */
+
+bool ANDOR_FrameArchiveWriter::writeHeader(const size_t frames_number, const size_t index_offset)
+{
+    try {
+        ANDOR_ImageBufferPool buff(1, archiveHeaderSize);
+        AT_U8* ptr = buff.buffer(0);
+
+        std::memset(ptr, 0, archiveHeaderSize);
+
+        std::memcpy(ptr, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+        put_value<uint32_t>(ptr + 8, ANDOR_FRAME_ARCHIVE_VERSION);
+        put_value<uint32_t>(ptr + 12, archiveHeaderSize);
+        put_value<uint64_t>(ptr + 16, archiveFrameSize);
+        put_value<uint64_t>(ptr + 24, slotSize());
+        put_value<uint64_t>(ptr + 32, frames_number);
+        put_value<uint64_t>(ptr + 40, index_offset);
+        put_value<uint64_t>(ptr + 48, archiveGeometry.width);
+        put_value<uint64_t>(ptr + 56, archiveGeometry.height);
+        put_value<uint64_t>(ptr + 64, archiveGeometry.stride);
+        put_value<int32_t>(ptr + 72, archiveGeometry.encoding);
+        put_value<uint32_t>(ptr + 76, headerText.size());
+
+        std::memcpy(ptr + ANDOR_FRAME_ARCHIVE_FIXED_HEADER_SIZE, headerText.data(), headerText.size());
+
+        return writeAt(ptr, archiveHeaderSize, 0);
+    } catch ( AndorSDK_Exception &ex ) {
+        lastErrno = ENOMEM;
+        return false;
+    }
+}
+
+
+
+                /*******************************************
+                 *  ANDOR_FrameArchiveReader IMPLEMENTATION  *
+                 *******************************************/
+
+ANDOR_FrameArchiveReader::ANDOR_FrameArchiveReader():
+    mapAddr(nullptr), mapSize(0),
+#ifdef _WIN32
+    fileHndl(INVALID_HANDLE_VALUE), mappingHndl(NULL),
+#endif
+    archiveHeaderSize(0), archiveFrameSize(0), archiveSlotSize(0), archiveFramesNumber(0),
+    archiveIndex(nullptr), archiveGeometry(), archiveCameraInfo(), archiveFeatures()
+{
+}
+
+
+ANDOR_FrameArchiveReader::ANDOR_FrameArchiveReader(const std::string &filename):
+    ANDOR_FrameArchiveReader()
+{
+    open(filename);
+}
+
+
+ANDOR_FrameArchiveReader::~ANDOR_FrameArchiveReader()
+{
+    close();
+}
+
+
+void ANDOR_FrameArchiveReader::open(const std::string &filename)
+{
+    close();
+
+#ifdef _WIN32
+    LARGE_INTEGER file_size;
+
+    fileHndl = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+    if ( fileHndl == INVALID_HANDLE_VALUE || !GetFileSizeEx(fileHndl, &file_size) ) {
+        std::string err = "Cannot open archive '" + filename + "' (system error code: " + std::to_string(GetLastError()) + ")";
+        close();
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO, err);
+    }
+    mapSize = file_size.QuadPart;
+
+    if ( mapSize ) {
+        mappingHndl = CreateFileMappingA(fileHndl, NULL, PAGE_READONLY, 0, 0, NULL);
+        if ( mappingHndl ) mapAddr = static_cast<const AT_U8*>(MapViewOfFile(mappingHndl, FILE_MAP_READ, 0, 0, 0));
+        if ( mapAddr == nullptr ) {
+            std::string err = "Cannot map archive '" + filename + "' (system error code: " + std::to_string(GetLastError()) + ")";
+            close();
+            throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO, err);
+        }
+    }
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    struct stat st;
+
+    if ( fd < 0 || fstat(fd, &st) ) {
+        std::string err = "Cannot open archive '" + filename + "' (" + std::strerror(errno) + ")";
+        if ( fd >= 0 ) ::close(fd);
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO, err);
+    }
+    mapSize = st.st_size;
+
+    if ( mapSize ) {
+        void* addr = mmap(nullptr, mapSize, PROT_READ, MAP_SHARED, fd, 0);
+        if ( addr == MAP_FAILED ) {
+            std::string err = "Cannot map archive '" + filename + "' (" + std::strerror(errno) + ")";
+            ::close(fd);
+            mapSize = 0;
+            throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO, err);
+        }
+        mapAddr = static_cast<const AT_U8*>(addr);
+    }
+
+    ::close(fd); // the mapping keeps the file
+#endif
+
+    try {
+        parseHeader(filename);
+    } catch ( AndorSDK_Exception &ex ) {
+        close();
+        throw;
+    }
+}
+
+
+void ANDOR_FrameArchiveReader::close()
+{
+#ifdef _WIN32
+    if ( mapAddr ) UnmapViewOfFile(mapAddr);
+    if ( mappingHndl ) CloseHandle(mappingHndl);
+    if ( fileHndl != INVALID_HANDLE_VALUE ) CloseHandle(fileHndl);
+    mappingHndl = NULL;
+    fileHndl = INVALID_HANDLE_VALUE;
+#else
+    if ( mapAddr ) munmap(const_cast<AT_U8*>(mapAddr), mapSize);
+#endif
+
+    mapAddr = nullptr;
+    mapSize = 0;
+    archiveHeaderSize = 0;
+    archiveFrameSize = 0;
+    archiveSlotSize = 0;
+    archiveFramesNumber = 0;
+    archiveIndex = nullptr;
+    archiveGeometry = ANDOR_FrameGeometry();
+    archiveCameraInfo = ANDOR_CameraInfo();
+    archiveFeatures.clear();
+}
+
+
+bool ANDOR_FrameArchiveReader::isOpen() const
+{
+    return mapAddr != nullptr;
+}
+
+
+bool ANDOR_FrameArchiveReader::isFinalized() const
+{
+    return archiveIndex != nullptr;
+}
+
+
+size_t ANDOR_FrameArchiveReader::framesNumber() const
+{
+    return archiveFramesNumber;
+}
+
+
+size_t ANDOR_FrameArchiveReader::frameSize() const
+{
+    return archiveFrameSize;
+}
+
+
+ANDOR_FrameGeometry ANDOR_FrameArchiveReader::geometry() const
+{
+    return archiveGeometry;
+}
+
+
+ANDOR_CameraInfo ANDOR_FrameArchiveReader::cameraInfo() const
+{
+    return archiveCameraInfo;
+}
+
+
+ANDOR_Camera::AndorFeatureSnapshot ANDOR_FrameArchiveReader::features() const
+{
+    return archiveFeatures;
+}
+
+
+ANDOR_FrameView ANDOR_FrameArchiveReader::frame(const size_t index) const
+{
+    if ( index >= archiveFramesNumber ) {
+        throw AndorSDK_Exception(AT_ERR_OUTOFRANGE, "Frame index is out of range!");
+    }
+
+    ANDOR_FrameView view;
+
+    view.size = archiveFrameSize;
+    view.geometry = archiveGeometry;
+
+    if ( archiveIndex ) {
+        const AT_U8* entry = archiveIndex + index*ANDOR_FRAME_ARCHIVE_INDEX_ENTRY_SIZE;
+        uint64_t offset = get_value<uint64_t>(entry);
+
+        // the index is not trusted: the frame must be inside the data part of the file
+        if ( offset < archiveHeaderSize || offset > mapSize || archiveFrameSize > mapSize - offset ) {
+            throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_FORMAT,
+                                     "Corrupted index entry of frame " + std::to_string(index) + "!");
+        }
+
+        view.data = mapAddr + offset;
+        view.number = get_value<uint64_t>(entry + 8);
+        view.timestamp = get_value<int64_t>(entry + 16);
+        view.ticks = get_value<uint64_t>(entry + 24);
+    } else {
+        view.data = mapAddr + archiveHeaderSize + index*archiveSlotSize;
+        view.number = index;
+        view.timestamp = 0;
+        view.ticks = 0;
+    }
+
+    return view;
+}
+
+
+void ANDOR_FrameArchiveReader::prefetch(const size_t first, const size_t count) const
+{
+    if ( first >= archiveFramesNumber || !count ) return;
+
+    size_t n = (count < archiveFramesNumber - first) ? count : archiveFramesNumber - first;
+
+    size_t start = archiveHeaderSize + first*archiveSlotSize;
+    size_t len = n*archiveSlotSize;
+
+    if ( start >= mapSize ) return; // e.g. the index of a corrupted archive
+    if ( len > mapSize - start ) len = mapSize - start;
+
+#ifdef _WIN32
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = const_cast<AT_U8*>(mapAddr) + start;
+    range.NumberOfBytes = len;
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+    madvise(const_cast<AT_U8*>(mapAddr) + start, len, MADV_WILLNEED); // slots are page-aligned
+#endif
+}
+
+
+                /*  PRIVATE METHODS  */
+
+void ANDOR_FrameArchiveReader::parseHeader(const std::string &filename)
+{
+    if ( mapSize < ANDOR_FRAME_ARCHIVE_FIXED_HEADER_SIZE || std::memcmp(mapAddr, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) ) {
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_FORMAT, "'" + filename + "' is not a frame archive!");
+    }
+
+    uint32_t version = get_value<uint32_t>(mapAddr + 8);
+    if ( version != ANDOR_FRAME_ARCHIVE_VERSION ) {
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_FORMAT,
+                                 "Unsupported version (" + std::to_string(version) + ") of frame archive '" + filename + "'!");
+    }
+
+    archiveHeaderSize = get_value<uint32_t>(mapAddr + 12);
+    archiveFrameSize = get_value<uint64_t>(mapAddr + 16);
+    archiveSlotSize = get_value<uint64_t>(mapAddr + 24);
+    archiveFramesNumber = get_value<uint64_t>(mapAddr + 32);
+    size_t index_offset = get_value<uint64_t>(mapAddr + 40);
+    archiveGeometry.width = get_value<uint64_t>(mapAddr + 48);
+    archiveGeometry.height = get_value<uint64_t>(mapAddr + 56);
+    archiveGeometry.stride = get_value<uint64_t>(mapAddr + 64);
+    archiveGeometry.encoding = static_cast<ANDOR_PixelEncoding>(get_value<int32_t>(mapAddr + 72));
+    size_t text_size = get_value<uint32_t>(mapAddr + 76);
+
+    if ( archiveHeaderSize > mapSize || ANDOR_FRAME_ARCHIVE_FIXED_HEADER_SIZE + text_size > archiveHeaderSize ||
+         archiveFrameSize > archiveSlotSize || !archiveSlotSize ) {
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_FORMAT, "Corrupted header of frame archive '" + filename + "'!");
+    }
+
+    if ( index_offset ) {
+        if ( index_offset < archiveHeaderSize || index_offset > mapSize ||
+             archiveFramesNumber > (mapSize - index_offset)/ANDOR_FRAME_ARCHIVE_INDEX_ENTRY_SIZE ) {
+            throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_FORMAT, "Corrupted index of frame archive '" + filename + "'!");
+        }
+        archiveIndex = mapAddr + index_offset;
+    } else { // recording was interrupted: take all of complete slots (the file ends at the last written one)
+        archiveFramesNumber = (mapSize - archiveHeaderSize)/archiveSlotSize;
+    }
+
+    parseHeaderText(std::string(reinterpret_cast<const char*>(mapAddr) + ANDOR_FRAME_ARCHIVE_FIXED_HEADER_SIZE, text_size));
+}
+
+
+void ANDOR_FrameArchiveReader::parseHeaderText(const std::string &text)
+{
+    std::wstring_convert<std::codecvt_utf8<AT_WC>> cvt;
+    std::istringstream lines(text);
+    std::string line, section;
+
+    while ( std::getline(lines, line) ) {
+        if ( line.empty() ) continue;
+
+        if ( line[0] == '[' ) {
+            section = line;
+            continue;
+        }
+
+        size_t pos = line.find(" = ");
+        if ( pos == std::string::npos ) continue;
+
+        std::string name = line.substr(0, pos);
+        std::string value = line.substr(pos + 3);
+
+        if ( section == "[Features]" ) {
+            archiveFeatures.push_back(std::make_pair(cvt.from_bytes(name), cvt.from_bytes(value)));
+            continue;
+        }
+
+        if ( section != "[CameraInfo]" ) continue;
+
+        if ( name == "CameraName" ) archiveCameraInfo.cameraName = cvt.from_bytes(value);
+        else if ( name == "InterfaceType" ) archiveCameraInfo.interfaceType = cvt.from_bytes(value);
+        else if ( name == "FirmwareVersion" ) archiveCameraInfo.firmwareVersion = cvt.from_bytes(value);
+        else if ( name == "CameraModel" ) archiveCameraInfo.cameraModel = cvt.from_bytes(value);
+        else if ( name == "SerialNumber" ) archiveCameraInfo.serialNumber = cvt.from_bytes(value);
+        else if ( name == "ControllerID" ) archiveCameraInfo.controllerID = cvt.from_bytes(value);
+        else if ( name == "CameraFamily" ) archiveCameraInfo.cameraFamily = cvt.from_bytes(value);
+        else if ( name == "DDR2Type" ) archiveCameraInfo.DDR2Type = cvt.from_bytes(value);
+        else if ( name == "DriverVersion" ) archiveCameraInfo.driverVersion = cvt.from_bytes(value);
+        else if ( name == "MicrocodeVersion" ) archiveCameraInfo.microcodeVersion = cvt.from_bytes(value);
+        else if ( name == "SensorModel" ) archiveCameraInfo.sensorModel = cvt.from_bytes(value);
+        else if ( name == "SensorType" ) archiveCameraInfo.sensorType = cvt.from_bytes(value);
+        else if ( name == "SensorWidth" ) archiveCameraInfo.sensorWidth = std::strtoll(value.c_str(), nullptr, 10);
+        else if ( name == "SensorHeight" ) archiveCameraInfo.sensorHeight = std::strtoll(value.c_str(), nullptr, 10);
+        else if ( name == "PixelWidth" ) archiveCameraInfo.pixelWidth = std::strtod(value.c_str(), nullptr);
+        else if ( name == "PixelHeight" ) archiveCameraInfo.pixelHeight = std::strtod(value.c_str(), nullptr);
+        else if ( name == "DeviceIndex" ) archiveCameraInfo.device_index = std::atoi(value.c_str());
+    }
+}
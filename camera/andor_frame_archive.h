@@ -0,0 +1,178 @@
+#ifndef ANDOR_FRAME_ARCHIVE_H
+#define ANDOR_FRAME_ARCHIVE_H
+
+#include "../export_decl.h"
+#include "andor_camera.h"
+#include "andor_frame_recorder.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// for MS compilers: disable multiple warnings about DLL-exports for the STL containers
+#ifdef _MSC_VER
+#pragma warning( disable: 4251 )
+#endif
+
+
+            /*   FRAME ARCHIVE FORMAT   */
+
+//
+//  | HEADER | FRAME SLOT 0 | FRAME SLOT 1 | ... | FRAME SLOT N-1 | INDEX |
+//
+//  HEADER occupies a whole number of pages. It starts with a fixed binary part
+//  (ANDOR_FRAME_ARCHIVE_FIXED_HEADER_SIZE bytes, little-endian):
+//
+//      offset  size
+//         0     8    magic "ANDORARC"
+//         8     4    format version
+//        12     4    header size
+//        16     8    frame size (SDK image buffer size)
+//        24     8    slot size (frame size rounded up to page size)
+//        32     8    number of frames
+//        40     8    offset of INDEX (0 if the archive was not finalized)
+//        48     8    AOI width
+//        56     8    AOI height
+//        64     8    AOI stride
+//        72     4    pixel encoding (see ANDOR_PixelEncoding)
+//        76     4    length of text part
+//
+//  followed by UTF-8 text in INI-format: [CameraInfo] and [Features] sections
+//  of "NAME = VALUE" lines (ANDOR_CameraInfo and the feature snapshot).
+//
+//  INDEX is an array of ANDOR_FRAME_ARCHIVE_INDEX_ENTRY_SIZE-byte records:
+//      file offset of frame (8), frame number (8), host timestamp in nanosecs (8),
+//      metadata timestamp in ticks of camera clock (8, 0 if metadata is not enabled)
+//
+//  Frame N starts at HEADER SIZE + N*SLOT SIZE, so an archive which was not finalized
+//  (e.g. a crash during recording) is still readable (without timestamps): preallocation
+//  does not change the file size, so the file ends at the last written slot. Slots are
+//  written concurrently, so the last slots (up to the number of writers) may be incomplete.
+//
+
+#define ANDOR_FRAME_ARCHIVE_VERSION 1
+#define ANDOR_FRAME_ARCHIVE_FIXED_HEADER_SIZE 128
+#define ANDOR_FRAME_ARCHIVE_INDEX_ENTRY_SIZE 32
+
+
+            /*   WRITER OF FRAME ARCHIVE   */
+
+class ANDOR_API_WRAPPER_EXPORT ANDOR_FrameArchiveWriter: public ANDOR_FrameRecorder
+{
+public:
+    explicit ANDOR_FrameArchiveWriter(const size_t writers_number = ANDOR_FRAME_RECORDER_DEFAULT_WRITERS_NUMBER,
+                                      const size_t queue_length = ANDOR_FRAME_RECORDER_DEFAULT_QUEUE_LENGTH);
+
+    ~ANDOR_FrameArchiveWriter();
+
+    // camera info, feature snapshot and image geometry are taken from the camera
+    // (call it after ANDOR_Camera::acquisitionStart)
+    void open(const std::string &filename, ANDOR_Camera &camera, const size_t frames_number,
+              const int flags = DirectIO | Preallocate);
+
+    void open(const std::string &filename, const size_t frame_size, const size_t frames_number,
+              const ANDOR_FrameGeometry &geometry, const ANDOR_CameraInfo &info,
+              const ANDOR_Camera::AndorFeatureSnapshot &features,
+              const int flags = DirectIO | Preallocate);
+
+protected:
+    size_t headerSize() const;
+    bool initFile();
+    void frameQueued(const ANDOR_Frame &frame, const size_t slot);
+    bool finalizeFile(const size_t data_end, size_t &file_size);
+
+private:
+    struct IndexEntry {
+        uint64_t offset;
+        uint64_t number;
+        int64_t timestamp;
+        uint64_t ticks;
+    };
+
+    std::string headerText;
+    size_t archiveHeaderSize;
+    size_t archiveFrameSize;
+    ANDOR_FrameGeometry archiveGeometry;
+
+    std::vector<IndexEntry> frameIndex;
+
+    bool writeHeader(const size_t frames_number, const size_t index_offset);
+};
+
+
+            /*   ZERO-COPY VIEW OF ARCHIVED FRAME   */
+
+// valid while the archive is opened
+
+struct ANDOR_FrameView
+{
+    const AT_U8* data;
+    size_t size;
+    size_t number;
+    int64_t timestamp;  // host time of frame arrival in nanosecs (steady clock) or 0
+    uint64_t ticks;     // metadata timestamp or 0
+    ANDOR_FrameGeometry geometry;
+};
+
+
+            /*   MEMORY-MAPPED READER OF FRAME ARCHIVE   */
+
+//
+//  The whole file is mapped at once: opening does not depend on the size of the archive
+//  and pages of frames are read by OS on the first access.
+//
+
+class ANDOR_API_WRAPPER_EXPORT ANDOR_FrameArchiveReader
+{
+public:
+    ANDOR_FrameArchiveReader();
+    explicit ANDOR_FrameArchiveReader(const std::string &filename);
+
+    ANDOR_FrameArchiveReader(const ANDOR_FrameArchiveReader &other) = delete;
+    ANDOR_FrameArchiveReader & operator = (const ANDOR_FrameArchiveReader &other) = delete;
+
+    ~ANDOR_FrameArchiveReader();
+
+    // throws AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO or ANDOR_WRAPPER_ERR_FILE_FORMAT)
+    void open(const std::string &filename);
+    void close();
+
+    bool isOpen() const;
+    bool isFinalized() const; // archive has index
+
+    size_t framesNumber() const;
+    size_t frameSize() const;
+    ANDOR_FrameGeometry geometry() const;
+
+    ANDOR_CameraInfo cameraInfo() const;
+    ANDOR_Camera::AndorFeatureSnapshot features() const;
+
+    // throws AndorSDK_Exception(AT_ERR_OUTOFRANGE) for invalid index
+    ANDOR_FrameView frame(const size_t index) const;
+
+    // hint to OS to read frames in advance (e.g. before sequential replay)
+    void prefetch(const size_t first, const size_t count) const;
+
+private:
+    const AT_U8* mapAddr;
+    size_t mapSize;
+#ifdef _WIN32
+    void* fileHndl;
+    void* mappingHndl;
+#endif
+
+    size_t archiveHeaderSize;
+    size_t archiveFrameSize;
+    size_t archiveSlotSize;
+    size_t archiveFramesNumber;
+    const AT_U8* archiveIndex;
+    ANDOR_FrameGeometry archiveGeometry;
+
+    ANDOR_CameraInfo archiveCameraInfo;
+    ANDOR_Camera::AndorFeatureSnapshot archiveFeatures;
+
+    void parseHeader(const std::string &filename);
+    void parseHeaderText(const std::string &text);
+};
+
+#endif // ANDOR_FRAME_ARCHIVE_H
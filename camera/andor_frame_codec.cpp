@@ -0,0 +1,512 @@
+                    /*************************************************
+                     *                                               *
+                     *   LOSSLESS FRAME COMPRESSION (DELTA + RICE)   *
+                     *                                               *
+                     *************************************************/
+
+
+#include "andor_frame_codec.h"
+#include "andorsdk_exception.h"
+
+#include <cstring>
+#include <chrono>
+#include <atomic>
+#include <type_traits>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+static const char CODEC_MAGIC[4] = {'A','N','D','Z'};
+
+static const size_t RICE_BLOCK_SIZE = 32;
+static const unsigned RICE_ESCAPE = 24; // unary part of this length is followed by raw residual
+
+
+                /*  PIXEL-TYPE DEPENDENT PARAMETERS  */
+
+template<typename T> struct RiceTraits;
+
+template<> struct RiceTraits<uint16_t> {
+    typedef uint32_t residual_t;
+    static const unsigned K_BITS = 5;     // bits of Rice parameter field (k <= 16)
+    static const unsigned K_MAX = 16;
+    static const unsigned RAW_BITS = 17;  // zigzag-mapped 16-bit difference
+};
+
+template<> struct RiceTraits<uint32_t> {
+    typedef uint64_t residual_t;
+    static const unsigned K_BITS = 6;
+    static const unsigned K_MAX = 32;
+    static const unsigned RAW_BITS = 33;
+};
+
+
+template<typename T>
+static inline void put_value(AT_U8* ptr, const T val)
+{
+    std::memcpy(ptr, &val, sizeof(T));
+}
+
+
+template<typename T>
+static inline T get_value(const AT_U8* ptr)
+{
+    T val;
+    std::memcpy(&val, ptr, sizeof(T));
+    return val;
+}
+
+
+static inline unsigned count_trailing_zeros(const uint64_t v) // v != 0
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward64(&idx, v);
+    return idx;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+
+static inline unsigned floor_log2(const uint64_t v) // v != 0
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanReverse64(&idx, v);
+    return idx;
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+}
+
+
+                /*  BIT STREAMS (LSB-FIRST)  */
+
+class BitWriter
+{
+public:
+    explicit BitWriter(AT_U8* out): ptr(out), start(out), acc(0), fill(0) {}
+
+    inline void put(const uint64_t val, const unsigned n_bits) // n_bits <= 32
+    {
+        acc |= val << fill;
+        fill += n_bits;
+        if ( fill >= 32 ) {
+            put_value<uint32_t>(ptr, uint32_t(acc));
+            ptr += 4;
+            acc >>= 32;
+            fill -= 32;
+        }
+    }
+
+    size_t flush()
+    {
+        for ( ; fill > 0; fill = fill > 8 ? fill - 8 : 0 ) {
+            *ptr++ = uint8_t(acc);
+            acc >>= 8;
+        }
+        return ptr - start;
+    }
+
+private:
+    AT_U8* ptr;
+    AT_U8* start;
+    uint64_t acc;
+    unsigned fill;
+};
+
+
+class BitReader
+{
+public:
+    BitReader(const AT_U8* in, const size_t size): ptr(in), end(in + size), acc(0), avail(0), overrun(0) {}
+
+    // after refill at least 56 bits are available (zeros past the end of stream)
+    inline void refill()
+    {
+        if ( end - ptr >= 8 ) {
+            acc |= get_value<uint64_t>(ptr) << avail;
+            ptr += (63 - avail) >> 3;
+            avail |= 56;
+        } else {
+            while ( avail <= 56 ) {
+                if ( ptr < end ) {
+                    acc |= uint64_t(*ptr++) << avail;
+                } else {
+                    ++overrun;
+                }
+                avail += 8;
+            }
+        }
+    }
+
+    inline uint64_t peek() const { return acc; }
+
+    inline void skip(const unsigned n_bits)
+    {
+        acc >>= n_bits;
+        avail -= n_bits;
+    }
+
+    inline uint64_t get(const unsigned n_bits) // n_bits <= available bits
+    {
+        uint64_t v = n_bits < 64 ? acc & ((uint64_t(1) << n_bits) - 1) : acc;
+        acc >>= n_bits;
+        avail -= n_bits;
+        return v;
+    }
+
+    // true if the stream was read beyond its end (corrupted data)
+    bool isOverrun() const { return overrun*8 > avail; }
+
+private:
+    const AT_U8* ptr;
+    const AT_U8* end;
+    uint64_t acc;
+    unsigned avail;
+    size_t overrun; // number of zero bytes added past the end
+};
+
+
+                /*  TILE CODING  */
+
+template<typename T>
+static inline typename RiceTraits<T>::residual_t zigzag(const T cur, const T pred)
+{
+    typedef typename RiceTraits<T>::residual_t R;
+    typedef typename std::make_signed<R>::type S;
+
+    S d = S(cur) - S(pred);
+    return (R(d) << 1) ^ R(d >> (sizeof(S)*8 - 1));
+}
+
+
+template<typename T>
+static inline T unzigzag(const typename RiceTraits<T>::residual_t z, const T pred)
+{
+    typedef typename RiceTraits<T>::residual_t R;
+
+    R d = (z >> 1) ^ (R(0) - (z & 1));
+    return T(R(pred) + d);
+}
+
+
+template<typename T>
+static size_t max_tile_size(const size_t n_pixels)
+{
+    typedef RiceTraits<T> tr;
+
+    size_t n_blocks = (n_pixels + RICE_BLOCK_SIZE - 1) / RICE_BLOCK_SIZE;
+    size_t n_bits = n_pixels*(RICE_ESCAPE + tr::RAW_BITS) + n_blocks*tr::K_BITS;
+
+    return (n_bits + 7) / 8;
+}
+
+
+// unpack one row of source buffer
+static inline void read_row(const AT_U8* src, const size_t width, const ANDOR_PixelEncoding encoding, uint16_t* row)
+{
+    andor_unpack_row(src, width, encoding, row);
+}
+
+
+static inline void read_row(const AT_U8* src, const size_t width, const ANDOR_PixelEncoding, uint32_t* row)
+{
+    std::memcpy(row, src, width*4); // Mono32
+}
+
+
+template<typename T>
+static void encode_rice_block(BitWriter &bits, const typename RiceTraits<T>::residual_t* res, const size_t n)
+{
+    typedef RiceTraits<T> tr;
+    typedef typename tr::residual_t R;
+
+    uint64_t sum = 0;
+    for ( size_t i = 0; i < n; ++i ) sum += res[i];
+
+    unsigned k = (sum >= n) ? floor_log2(sum/n) : 0;
+    if ( k > tr::K_MAX ) k = tr::K_MAX;
+
+    bits.put(k, tr::K_BITS);
+
+    for ( size_t i = 0; i < n; ++i ) {
+        R q = res[i] >> k;
+        if ( q < RICE_ESCAPE ) {
+            uint64_t unary = (uint64_t(1) << q) - 1;
+            uint64_t rem = res[i] & ((uint64_t(1) << k) - 1);
+            if ( q + 1 + k <= 32 ) { // usual case: one write
+                bits.put(unary | (rem << (q + 1)), unsigned(q) + 1 + k);
+            } else {
+                bits.put(unary, unsigned(q) + 1);
+                bits.put(rem, k);
+            }
+        } else {
+            bits.put((uint64_t(1) << RICE_ESCAPE) - 1, RICE_ESCAPE);
+            bits.put(res[i] & 0xFFFF, 16);
+            bits.put(uint64_t(res[i]) >> 16, tr::RAW_BITS - 16);
+        }
+    }
+}
+
+
+template<typename T>
+static size_t encode_tile(const AT_U8* src, const ANDOR_FrameGeometry &geometry, const size_t first_row,
+                          const size_t n_rows, AT_U8* out)
+{
+    typedef typename RiceTraits<T>::residual_t R;
+
+    std::vector<T> row(geometry.width);
+    R res[RICE_BLOCK_SIZE];
+    size_t n_res = 0;
+
+    BitWriter bits(out);
+
+    T above = 0; // the first pixel of the previous row
+
+    for ( size_t y = 0; y < n_rows; ++y ) {
+        read_row(src + (first_row + y)*geometry.stride, geometry.width, geometry.encoding, row.data());
+
+        T pred = above;
+        for ( size_t x = 0; x < geometry.width; ++x ) {
+            res[n_res++] = zigzag<T>(row[x], pred);
+            pred = row[x];
+
+            if ( n_res == RICE_BLOCK_SIZE ) {
+                encode_rice_block<T>(bits, res, n_res);
+                n_res = 0;
+            }
+        }
+        above = row[0];
+    }
+
+    if ( n_res ) encode_rice_block<T>(bits, res, n_res);
+
+    return bits.flush();
+}
+
+
+template<typename T>
+static bool decode_tile(const AT_U8* in, const size_t size, const size_t width, const size_t n_rows, T* dst)
+{
+    typedef RiceTraits<T> tr;
+    typedef typename tr::residual_t R;
+
+    BitReader bits(in, size);
+
+    size_t n_pixels = width*n_rows;
+    size_t block_left = 0;
+    unsigned k = 0;
+
+    T above = 0;
+    T pred = 0;
+
+    for ( size_t i = 0, x = 0; i < n_pixels; ++i ) {
+        bits.refill();
+
+        if ( !block_left ) {
+            k = unsigned(bits.get(tr::K_BITS));
+            if ( k > tr::K_MAX ) return false;
+            block_left = RICE_BLOCK_SIZE;
+            bits.refill();
+        }
+
+        R z;
+        unsigned q = count_trailing_zeros(~bits.peek()); // bits above available ones are zeros
+        if ( q < RICE_ESCAPE ) { // q + 1 + k <= 56: no refill is needed
+            bits.skip(q + 1);
+            z = (R(q) << k) | R(bits.get(k));
+        } else {
+            bits.skip(RICE_ESCAPE);
+            bits.refill();
+            z = R(bits.get(tr::RAW_BITS));
+        }
+        --block_left;
+
+        if ( x == 0 ) pred = above;
+        dst[i] = unzigzag<T>(z, pred);
+        pred = dst[i];
+        if ( x == 0 ) above = dst[i];
+
+        if ( ++x == width ) x = 0;
+    }
+
+    return !bits.isOverrun();
+}
+
+
+
+                /*  ANDOR_FrameCompressor CLASS IMPLEMENTATION  */
+
+ANDOR_FrameCompressor::ANDOR_FrameCompressor(const std::shared_ptr<ANDOR_WorkerPool> &pool, const size_t tile_rows):
+    workerPool(pool), tileRows(tile_rows ? tile_rows : ANDOR_FRAME_CODEC_DEFAULT_TILE_ROWS)
+{
+}
+
+
+size_t ANDOR_FrameCompressor::compress(const ANDOR_Frame &frame, std::vector<AT_U8> &record)
+{
+    const ANDOR_FrameGeometry &geom = frame.geometry();
+
+    if ( size_t(frame.size()) < geom.stride*geom.height ) {
+        throw AndorSDK_Exception(AT_ERR_OUTOFRANGE, "Frame buffer is smaller than image!");
+    }
+
+    int64_t ts = std::chrono::duration_cast<std::chrono::nanoseconds>(frame.timestamp().time_since_epoch()).count();
+
+    return compress(frame.data(), geom, record, frame.number(), ts);
+}
+
+
+size_t ANDOR_FrameCompressor::compress(const AT_U8 *buffer, const ANDOR_FrameGeometry &geometry, std::vector<AT_U8> &record,
+                                       const size_t number, const int64_t timestamp)
+{
+    if ( geometry.encoding == PIXEL_ENCODING_UNKNOWN ) {
+        throw AndorSDK_Exception(AT_ERR_NOTIMPLEMENTED, "Cannot compress frame: unknown pixel encoding!");
+    }
+
+    bool is32 = geometry.encoding == PIXEL_ENCODING_MONO32;
+
+    size_t n_tiles = (geometry.height + tileRows - 1) / tileRows;
+    size_t table_size = ANDOR_FRAME_CODEC_HEADER_SIZE + 4*n_tiles;
+    size_t max_tile = is32 ? max_tile_size<uint32_t>(geometry.width*tileRows) : max_tile_size<uint16_t>(geometry.width*tileRows);
+
+    record.resize(table_size + n_tiles*max_tile);
+    AT_U8* rec = record.data();
+
+    std::memcpy(rec, CODEC_MAGIC, sizeof(CODEC_MAGIC));
+    put_value<uint16_t>(rec + 4, ANDOR_FRAME_CODEC_VERSION);
+    put_value<uint16_t>(rec + 6, is32 ? 32 : 16);
+    put_value<uint32_t>(rec + 8, geometry.width);
+    put_value<uint32_t>(rec + 12, geometry.height);
+    put_value<uint32_t>(rec + 16, tileRows);
+    put_value<uint32_t>(rec + 20, n_tiles);
+    put_value<int32_t>(rec + 24, geometry.encoding);
+    put_value<uint32_t>(rec + 28, 0);
+    put_value<uint64_t>(rec + 32, number);
+    put_value<int64_t>(rec + 40, timestamp);
+
+    // each tile is compressed into its own worst-case region, then the regions are compacted
+    std::vector<size_t> tile_size(n_tiles);
+
+    workerPool->parallelFor(n_tiles, [&](size_t i) {
+        size_t first_row = i*tileRows;
+        size_t n_rows = (geometry.height - first_row < tileRows) ? geometry.height - first_row : tileRows;
+        AT_U8* out = rec + table_size + i*max_tile;
+
+        tile_size[i] = is32 ? encode_tile<uint32_t>(buffer, geometry, first_row, n_rows, out) :
+                              encode_tile<uint16_t>(buffer, geometry, first_row, n_rows, out);
+    });
+
+    size_t pos = table_size;
+    for ( size_t i = 0; i < n_tiles; ++i ) {
+        put_value<uint32_t>(rec + ANDOR_FRAME_CODEC_HEADER_SIZE + 4*i, tile_size[i]);
+        std::memmove(rec + pos, rec + table_size + i*max_tile, tile_size[i]);
+        pos += tile_size[i];
+    }
+
+    record.resize(pos);
+
+    return pos;
+}
+
+
+size_t ANDOR_FrameCompressor::maxRecordSize(const ANDOR_FrameGeometry &geometry, const size_t tile_rows)
+{
+    size_t rows = tile_rows ? tile_rows : ANDOR_FRAME_CODEC_DEFAULT_TILE_ROWS;
+    size_t n_tiles = (geometry.height + rows - 1) / rows;
+    size_t n_pixels = geometry.width*geometry.height;
+
+    size_t n = (geometry.encoding == PIXEL_ENCODING_MONO32) ? max_tile_size<uint32_t>(n_pixels) : max_tile_size<uint16_t>(n_pixels);
+
+    return ANDOR_FRAME_CODEC_HEADER_SIZE + n_tiles*(4 + 1) + n; // +1: byte rounding of each tile
+}
+
+
+
+                /*  ANDOR_FrameDecompressor CLASS IMPLEMENTATION  */
+
+ANDOR_FrameDecompressor::ANDOR_FrameDecompressor(const std::shared_ptr<ANDOR_WorkerPool> &pool):
+    workerPool(pool)
+{
+}
+
+
+bool ANDOR_FrameDecompressor::info(const AT_U8 *record, const size_t size, ANDOR_CompressedFrameInfo &info)
+{
+    if ( record == nullptr || size < ANDOR_FRAME_CODEC_HEADER_SIZE ) return false;
+    if ( std::memcmp(record, CODEC_MAGIC, sizeof(CODEC_MAGIC)) ) return false;
+    if ( get_value<uint16_t>(record + 4) != ANDOR_FRAME_CODEC_VERSION ) return false;
+
+    info.bitsPerPixel = get_value<uint16_t>(record + 6);
+    info.width = get_value<uint32_t>(record + 8);
+    info.height = get_value<uint32_t>(record + 12);
+    info.tileRows = get_value<uint32_t>(record + 16);
+    info.tilesNumber = get_value<uint32_t>(record + 20);
+    info.encoding = static_cast<ANDOR_PixelEncoding>(get_value<int32_t>(record + 24));
+    info.number = get_value<uint64_t>(record + 32);
+    info.timestamp = get_value<int64_t>(record + 40);
+
+    if ( info.bitsPerPixel != 16 && info.bitsPerPixel != 32 ) return false;
+    if ( !info.tileRows || info.tilesNumber != (info.height + info.tileRows - 1) / info.tileRows ) return false;
+
+    return ANDOR_FRAME_CODEC_HEADER_SIZE + 4*info.tilesNumber <= size;
+}
+
+
+void ANDOR_FrameDecompressor::decompress(const AT_U8 *record, const size_t size, uint16_t *dst)
+{
+    decompressTiles(record, size, dst);
+}
+
+
+void ANDOR_FrameDecompressor::decompress(const AT_U8 *record, const size_t size, uint32_t *dst)
+{
+    decompressTiles(record, size, dst);
+}
+
+
+template<typename T>
+void ANDOR_FrameDecompressor::decompressTiles(const AT_U8 *record, const size_t size, T *dst)
+{
+    ANDOR_CompressedFrameInfo inf;
+
+    if ( !info(record, size, inf) ) {
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_FORMAT, "Invalid compressed frame record!");
+    }
+
+    if ( inf.bitsPerPixel != sizeof(T)*8 ) {
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_FORMAT,
+                                 "Pixel size of compressed frame (" + std::to_string(inf.bitsPerPixel) +
+                                 " bits) differs from the output one!");
+    }
+
+    // offsets of tiles
+    std::vector<size_t> offset(inf.tilesNumber + 1);
+    offset[0] = ANDOR_FRAME_CODEC_HEADER_SIZE + 4*inf.tilesNumber;
+    for ( size_t i = 0; i < inf.tilesNumber; ++i ) {
+        offset[i + 1] = offset[i] + get_value<uint32_t>(record + ANDOR_FRAME_CODEC_HEADER_SIZE + 4*i);
+    }
+
+    if ( offset[inf.tilesNumber] > size ) {
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_FORMAT, "Compressed frame record is truncated!");
+    }
+
+    std::atomic<bool> ok(true);
+
+    workerPool->parallelFor(inf.tilesNumber, [&](size_t i) {
+        size_t first_row = i*inf.tileRows;
+        size_t n_rows = (inf.height - first_row < inf.tileRows) ? inf.height - first_row : inf.tileRows;
+
+        if ( !decode_tile<T>(record + offset[i], offset[i + 1] - offset[i], inf.width, n_rows, dst + first_row*inf.width) ) {
+            ok = false;
+        }
+    });
+
+    if ( !ok ) {
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_FORMAT, "Compressed frame record is corrupted!");
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef ANDOR_FRAME_CODEC_H
+#define ANDOR_FRAME_CODEC_H
+
+#include "../export_decl.h"
+#include "andor_frame.h"
+#include "andor_worker_pool.h"
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+
+#define ANDOR_FRAME_CODEC_DEFAULT_TILE_ROWS 32 // height of independently compressed image band
+
+
+            /*   LOSSLESS FRAME COMPRESSION   */
+
+//
+//  An image is split into bands of rows (tiles) which are compressed independently on
+//  the worker pool. Pixels are predicted from the left neighbour (the first pixel of a row
+//  from the pixel above), residuals are zigzag-mapped and Rice-coded with the parameter
+//  adapted for each block of 32 residuals (as FITS Rice compression does).
+//
+//  Compressed frame record (little-endian):
+//
+//      offset  size
+//         0     4    magic "ANDZ"
+//         4     2    format version
+//         6     2    bits per pixel of decompressed image (16 or 32, the latter for Mono32)
+//         8     4    image width
+//        12     4    image height
+//        16     4    rows per tile
+//        20     4    number of tiles
+//        24     4    pixel encoding of source buffer (see ANDOR_PixelEncoding)
+//        28     4    reserved
+//        32     8    frame number
+//        40     8    host timestamp in nanosecs (steady clock)
+//        48   4*N    compressed sizes of tiles
+//                    compressed tiles
+//
+//  Decompressed image is unpacked (no row padding, Mono12Packed pixels are 16-bit words).
+//
+
+#define ANDOR_FRAME_CODEC_VERSION 1
+#define ANDOR_FRAME_CODEC_HEADER_SIZE 48
+
+
+struct ANDOR_CompressedFrameInfo
+{
+    size_t width;
+    size_t height;
+    size_t bitsPerPixel;
+    ANDOR_PixelEncoding encoding;
+    size_t number;
+    int64_t timestamp;
+    size_t tileRows;
+    size_t tilesNumber;
+};
+
+
+class ANDOR_API_WRAPPER_EXPORT ANDOR_FrameCompressor
+{
+public:
+    explicit ANDOR_FrameCompressor(const std::shared_ptr<ANDOR_WorkerPool> &pool = ANDOR_WorkerPool::defaultPool(),
+                                   const size_t tile_rows = ANDOR_FRAME_CODEC_DEFAULT_TILE_ROWS);
+
+    // compress frame into 'record' (it is resized to the record size). The frame may be
+    // released right after the call. Returns size of the record
+    size_t compress(const ANDOR_Frame &frame, std::vector<AT_U8> &record);
+    size_t compress(const AT_U8* buffer, const ANDOR_FrameGeometry &geometry, std::vector<AT_U8> &record,
+                    const size_t number = 0, const int64_t timestamp = 0);
+
+    // the worst case size of record
+    static size_t maxRecordSize(const ANDOR_FrameGeometry &geometry,
+                                const size_t tile_rows = ANDOR_FRAME_CODEC_DEFAULT_TILE_ROWS);
+
+private:
+    std::shared_ptr<ANDOR_WorkerPool> workerPool;
+    size_t tileRows;
+};
+
+
+class ANDOR_API_WRAPPER_EXPORT ANDOR_FrameDecompressor
+{
+public:
+    explicit ANDOR_FrameDecompressor(const std::shared_ptr<ANDOR_WorkerPool> &pool = ANDOR_WorkerPool::defaultPool());
+
+    // read record header. Returns false if it is not a compressed frame record
+    static bool info(const AT_U8* record, const size_t size, ANDOR_CompressedFrameInfo &info);
+
+    // decompress into 'dst' (width*height pixels). Throws AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_FORMAT)
+    // if the record is corrupted or its pixel size differs from the output one
+    void decompress(const AT_U8* record, const size_t size, uint16_t* dst);
+    void decompress(const AT_U8* record, const size_t size, uint32_t* dst);
+
+private:
+    std::shared_ptr<ANDOR_WorkerPool> workerPool;
+
+    template<typename T>
+    void decompressTiles(const AT_U8* record, const size_t size, T* dst);
+};
+
+#endif // ANDOR_FRAME_CODEC_H
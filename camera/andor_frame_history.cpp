@@ -0,0 +1,189 @@
+                    /*************************************************
+                     *                                               *
+                     *  IMPLEMENTATION OF ANDOR_FrameHistory CLASS   *
+                     *                                               *
+                     *************************************************/
+
+
+#include "andor_frame_history.h"
+#include "andorsdk_exception.h"
+
+
+ANDOR_FrameHistory::ANDOR_FrameHistory(const history_sink_t &sink, const size_t max_frames,
+                                       const std::chrono::milliseconds max_age):
+    historySink(sink), maxFrames(max_frames), maxAge(max_age),
+    historyMutex(), historyFrames(), postTriggerFrames(0), eventsNumber(0), evictedFramesNumber(0),
+    pendingQueue(), inSink(0), sinkErrorsNumber(0),
+    pendingCond(), flushedCond(), stopFlush(false), flushThread()
+{
+    if ( !historySink ) {
+        throw AndorSDK_Exception(AT_ERR_NULL_VALUE, "Cannot create frame history! Empty sink function!");
+    }
+
+    if ( !maxFrames && maxAge.count() <= 0 ) {
+        throw AndorSDK_Exception(AT_ERR_OUTOFRANGE, "Cannot create frame history! No bound of the window is given!");
+    }
+
+    flushThread = std::thread(&ANDOR_FrameHistory::flushFunc, this);
+}
+
+
+ANDOR_FrameHistory::~ANDOR_FrameHistory()
+{
+    {
+        std::lock_guard<std::mutex> lock(historyMutex);
+        stopFlush = true;
+    }
+    pendingCond.notify_all();
+
+    flushThread.join();
+}
+
+
+void ANDOR_FrameHistory::push(ANDOR_Frame &&frame)
+{
+    if ( !frame.isValid() ) return;
+
+    std::lock_guard<std::mutex> lock(historyMutex);
+
+    if ( postTriggerFrames ) {
+        --postTriggerFrames;
+        pendingQueue.push_back({eventsNumber, std::move(frame)});
+        pendingCond.notify_one();
+        return;
+    }
+
+    historyFrames.push_back(std::move(frame));
+
+    evict();
+}
+
+
+size_t ANDOR_FrameHistory::trigger(const size_t post_frames)
+{
+    std::lock_guard<std::mutex> lock(historyMutex);
+
+    ++eventsNumber;
+
+    // the window is moved as a whole, so acquisition goes on with other pool buffers
+    while ( !historyFrames.empty() ) {
+        pendingQueue.push_back({eventsNumber, std::move(historyFrames.front())});
+        historyFrames.pop_front();
+    }
+    postTriggerFrames = post_frames;
+
+    pendingCond.notify_one();
+
+    return eventsNumber;
+}
+
+
+void ANDOR_FrameHistory::clear()
+{
+    std::deque<ANDOR_Frame> frames;
+
+    {
+        std::lock_guard<std::mutex> lock(historyMutex);
+        frames.swap(historyFrames);
+    }
+}
+
+
+void ANDOR_FrameHistory::flush()
+{
+    std::unique_lock<std::mutex> lock(historyMutex);
+    flushedCond.wait(lock, [this]() { return pendingQueue.empty() && !inSink; });
+}
+
+
+size_t ANDOR_FrameHistory::framesNumber() const
+{
+    std::lock_guard<std::mutex> lock(historyMutex);
+    return historyFrames.size();
+}
+
+
+std::chrono::nanoseconds ANDOR_FrameHistory::timeSpan() const
+{
+    std::lock_guard<std::mutex> lock(historyMutex);
+
+    if ( historyFrames.size() < 2 ) return std::chrono::nanoseconds(0);
+
+    return historyFrames.back().timestamp() - historyFrames.front().timestamp();
+}
+
+
+size_t ANDOR_FrameHistory::pendingFrames() const
+{
+    std::lock_guard<std::mutex> lock(historyMutex);
+    return pendingQueue.size() + inSink;
+}
+
+
+size_t ANDOR_FrameHistory::evictedFrames() const
+{
+    std::lock_guard<std::mutex> lock(historyMutex);
+    return evictedFramesNumber;
+}
+
+
+size_t ANDOR_FrameHistory::sinkErrors() const
+{
+    std::lock_guard<std::mutex> lock(historyMutex);
+    return sinkErrorsNumber;
+}
+
+
+                /*  PRIVATE METHODS  */
+
+void ANDOR_FrameHistory::evict()
+{
+    // frames are released under the lock, but it is just a push into lock-free queue of the recycler
+
+    if ( maxFrames ) {
+        while ( historyFrames.size() > maxFrames ) {
+            historyFrames.pop_front();
+            ++evictedFramesNumber;
+        }
+    }
+
+    if ( maxAge.count() > 0 ) {
+        auto newest = historyFrames.back().timestamp();
+        while ( historyFrames.size() > 1 && (newest - historyFrames.front().timestamp()) > maxAge ) {
+            historyFrames.pop_front();
+            ++evictedFramesNumber;
+        }
+    }
+}
+
+
+void ANDOR_FrameHistory::flushFunc()
+{
+    std::unique_lock<std::mutex> lock(historyMutex);
+
+    for (;;) {
+        pendingCond.wait(lock, [this]() { return stopFlush || !pendingQueue.empty(); });
+
+        if ( pendingQueue.empty() ) return; // stopped and nothing to persist
+
+        PendingFrame item = std::move(pendingQueue.front());
+        pendingQueue.pop_front();
+        ++inSink;
+
+        lock.unlock();
+
+        bool ok = true;
+        try {
+            historySink(item.event, item.frame);
+        } catch ( ... ) {
+            ok = false;
+        }
+        item.frame.release(); // no-op if the sink took the frame
+
+        lock.lock();
+
+        --inSink;
+        if ( !ok ) ++sinkErrorsNumber;
+        if ( pendingQueue.empty() ) flushedCond.notify_all();
+    }
+}
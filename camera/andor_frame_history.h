@@ -0,0 +1,104 @@
+#ifndef ANDOR_FRAME_HISTORY_H
+#define ANDOR_FRAME_HISTORY_H
+
+#include "../export_decl.h"
+#include "andor_frame.h"
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+
+// for MS compilers: disable multiple warnings about DLL-exports for the STL containers
+#ifdef _MSC_VER
+#pragma warning( disable: 4251 )
+#endif
+
+
+            /*   PRE-TRIGGER HISTORY OF CAPTURED FRAMES   */
+
+//
+//  Keeps a rolling window of the last frames (bounded by number of frames and/or by
+//  time span) without copying: the history holds frame handles, i.e. buffers of
+//  the camera image pool. The oldest frame is released (its buffer is re-queued to SDK)
+//  when the window is exceeded.
+//
+//  trigger() freezes the current window and passes its frames (and, optionally, a number
+//  of post-trigger frames) to the sink function on a background thread, while the
+//  history is refilled with new frames. A buffer is re-queued to SDK as soon as the sink
+//  is done with the frame.
+//
+//  Held frames are not available to SDK, so the camera pool must be larger than the
+//  window: ANDOR_Camera::setMaxBuffersNumber(max_frames + <number of frames captured
+//  while the sink is persisting the window> + a few buffers for acquisition).
+//
+
+class ANDOR_API_WRAPPER_EXPORT ANDOR_FrameHistory
+{
+public:
+    // sink is called in the flush thread with trigger event number (starting from 1) and the frame.
+    // The frame may be moved out of the reference (e.g. into ANDOR_FrameRecorder::push), otherwise
+    // it is released after the call
+    typedef std::function<void(size_t, ANDOR_Frame &)> history_sink_t;
+
+    // 'max_frames' or 'max_age' of 0 means no bound of this kind (but at least one bound must be given)
+    ANDOR_FrameHistory(const history_sink_t &sink, const size_t max_frames,
+                       const std::chrono::milliseconds max_age = std::chrono::milliseconds(0));
+
+    ANDOR_FrameHistory(const ANDOR_FrameHistory &other) = delete;
+    ANDOR_FrameHistory & operator = (const ANDOR_FrameHistory &other) = delete;
+
+    ~ANDOR_FrameHistory(); // waits for the flush thread to persist pending frames
+
+    // put the next captured frame into the history (or pass it to the sink if post-trigger
+    // frames are expected). Call it from a single (consumer) thread
+    void push(ANDOR_Frame &&frame);
+
+    // freeze the current window and persist it together with the next 'post_frames' frames.
+    // Can be called from any thread (e.g. from a feature callback signalling an external event).
+    // Returns the trigger event number
+    size_t trigger(const size_t post_frames = 0);
+
+    void clear(); // release all frames of the window
+
+    void flush(); // wait until all triggered frames are passed to the sink
+
+    size_t framesNumber() const;                 // current number of frames in the window
+    std::chrono::nanoseconds timeSpan() const;   // time span of the current window
+    size_t pendingFrames() const;                // number of frames waiting for the sink
+    size_t evictedFrames() const;                // number of frames dropped from the window
+    size_t sinkErrors() const;                   // number of frames for which sink threw an exception
+
+private:
+    history_sink_t historySink;
+    size_t maxFrames;
+    std::chrono::nanoseconds maxAge;
+
+    mutable std::mutex historyMutex;
+    std::deque<ANDOR_Frame> historyFrames;
+    size_t postTriggerFrames;
+    size_t eventsNumber;
+    size_t evictedFramesNumber;
+
+    struct PendingFrame {
+        size_t event;
+        ANDOR_Frame frame;
+    };
+
+    std::deque<PendingFrame> pendingQueue;
+    size_t inSink;   // frames taken by the flush thread but not yet returned from sink
+    size_t sinkErrorsNumber;
+
+    std::condition_variable pendingCond;
+    std::condition_variable flushedCond;
+    bool stopFlush;
+    std::thread flushThread;
+
+    void evict();  // must be called with historyMutex locked
+    void flushFunc();
+};
+
+#endif // ANDOR_FRAME_HISTORY_H
@@ -0,0 +1,481 @@
+                    /*************************************************
+                     *                                               *
+                     *  IMPLEMENTATION OF ANDOR_FrameRecorder CLASS  *
+                     *                                               *
+                     *************************************************/
+
+
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // O_DIRECT (it must be defined before any system header)
+#endif
+
+#include "andor_frame_recorder.h"
+#include "andorsdk_exception.h"
+#include "andor_buffer_pool.h"
+
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <chrono>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+
+static inline size_t round_up(const size_t val, const size_t granularity)
+{
+    return (val + granularity - 1) / granularity * granularity;
+}
+
+
+static inline bool is_aligned(const void* ptr, const size_t alignment)
+{
+    return (reinterpret_cast<uintptr_t>(ptr) % alignment) == 0;
+}
+
+
+#ifdef _WIN32
+static const HANDLE INVALID_FILE_HNDL = INVALID_HANDLE_VALUE;
+#else
+static const int INVALID_FILE_HNDL = -1;
+#endif
+
+
+ANDOR_FrameRecorder::ANDOR_FrameRecorder(const size_t writers_number, const size_t queue_length):
+    lastErrno(0),
+    fileHndl(INVALID_FILE_HNDL), fileName(), recorderFlags(DefaultIO), directIO(false),
+    frameSize(0), frameSlotSize(0),
+    writersNumber(writers_number ? writers_number : 1), writerThreads(),
+    writeQueue(queue_length), writeQueueMutex(), writeQueueCond(), writeDoneCond(),
+    recorderActive(false), nextSlot(0), pendingWrites(0),
+    writtenFrames(0), writtenBytes(0), failedFrames(0)
+{
+}
+
+
+ANDOR_FrameRecorder::~ANDOR_FrameRecorder()
+{
+    try {
+        close();
+    } catch ( AndorSDK_Exception &ex ) { // nothing to do in destructor
+    }
+}
+
+
+                /*  PUBLIC METHODS  */
+
+void ANDOR_FrameRecorder::open(const std::string &filename, const size_t frame_size, const size_t frames_number,
+                               const int flags)
+{
+    close();
+
+    if ( !frame_size ) {
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO, "Cannot open frame recorder! Frame size is 0!");
+    }
+
+    fileName = filename;
+    recorderFlags = flags;
+    frameSize = frame_size;
+    frameSlotSize = round_up(frame_size, ANDOR_FRAME_RECORDER_ALIGNMENT);
+
+    openFile(filename, (flags & DirectIO) != 0);
+
+    if ( (flags & Preallocate) && frames_number ) {
+        if ( !preallocate(headerSize() + frames_number*frameSlotSize) ) {
+            std::string err = errorString("Cannot preallocate file '" + filename + "'");
+            closeFile();
+            throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO, err);
+        }
+    }
+
+    if ( !initFile() ) {
+        std::string err = errorString("Cannot initialize file '" + filename + "'");
+        closeFile();
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO, err);
+    }
+
+    nextSlot = 0;
+    pendingWrites = 0;
+    writtenFrames = 0;
+    writtenBytes = 0;
+    failedFrames = 0;
+    lastErrno = 0;
+
+    recorderActive = true;
+
+    for ( size_t i = 0; i < writersNumber; ++i ) {
+        writerThreads.push_back(std::thread(&ANDOR_FrameRecorder::writerFunc, this));
+    }
+}
+
+
+bool ANDOR_FrameRecorder::push(ANDOR_Frame &&frame)
+{
+    if ( !recorderActive || !frame.isValid() ) return false;
+
+    RecorderItem item;
+    item.frame = std::move(frame);
+
+    ++pendingWrites;
+    item.slot = nextSlot++;
+
+    frameQueued(item.frame, item.slot);
+
+    if ( !writeQueue.push(std::move(item)) ) { // queue is full: give the frame back
+        --nextSlot; // the only producer is the caller
+        --pendingWrites;
+        frame = std::move(item.frame);
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(writeQueueMutex);
+    }
+    writeQueueCond.notify_one();
+
+    return true;
+}
+
+
+void ANDOR_FrameRecorder::close()
+{
+    if ( fileHndl == INVALID_FILE_HNDL ) return;
+
+    waitPendingWrites();
+
+    recorderActive = false;
+    {
+        std::lock_guard<std::mutex> lock(writeQueueMutex);
+    }
+    writeQueueCond.notify_all();
+
+    for ( size_t i = 0; i < writerThreads.size(); ++i ) writerThreads[i].join();
+    writerThreads.clear();
+
+    std::string err;
+    size_t file_size;
+
+    bool ok = finalizeFile(headerSize() + nextSlot*frameSlotSize, file_size);
+    if ( !ok ) {
+        err = errorString("Cannot finalize file '" + fileName + "'");
+    } else {
+        ok = truncate(file_size); // drop unused preallocated space
+        if ( !ok ) err = errorString("Cannot truncate file '" + fileName + "'");
+    }
+
+    closeFile();
+
+    if ( failedFrames ) {
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO,
+                                 errorString(std::to_string(failedFrames) + " frames were not written to '" + fileName + "'"));
+    }
+
+    if ( !ok ) throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO, err);
+}
+
+
+bool ANDOR_FrameRecorder::isOpen() const
+{
+    return fileHndl != INVALID_FILE_HNDL;
+}
+
+
+bool ANDOR_FrameRecorder::isDirectIO() const
+{
+    return directIO;
+}
+
+
+size_t ANDOR_FrameRecorder::slotSize() const
+{
+    return frameSlotSize;
+}
+
+
+size_t ANDOR_FrameRecorder::framesNumber() const
+{
+    return nextSlot;
+}
+
+
+size_t ANDOR_FrameRecorder::framesWritten() const
+{
+    return writtenFrames;
+}
+
+
+size_t ANDOR_FrameRecorder::bytesWritten() const
+{
+    return writtenBytes;
+}
+
+
+size_t ANDOR_FrameRecorder::failedWrites() const
+{
+    return failedFrames;
+}
+
+
+                /*  PROTECTED METHODS  */
+
+size_t ANDOR_FrameRecorder::headerSize() const
+{
+    return 0; // raw stream of frames
+}
+
+
+bool ANDOR_FrameRecorder::initFile()
+{
+    return true;
+}
+
+
+void ANDOR_FrameRecorder::frameQueued(const ANDOR_Frame & /*frame*/, const size_t /*slot*/)
+{
+}
+
+
+bool ANDOR_FrameRecorder::finalizeFile(const size_t data_end, size_t &file_size)
+{
+    file_size = data_end;
+    return true;
+}
+
+
+                /*  PRIVATE METHODS  */
+
+void ANDOR_FrameRecorder::writerFunc()
+{
+    RecorderItem item;
+    std::unique_ptr<ANDOR_ImageBufferPool> bounce_buffer; // for frames which are not suitable for direct I/O
+
+    for (;;) {
+        if ( !writeQueue.pop(item) ) {
+            std::unique_lock<std::mutex> lock(writeQueueMutex);
+            writeQueueCond.wait(lock, [this, &item]() { return writeQueue.pop(item) || !recorderActive; });
+            if ( !item.frame.isValid() ) break; // recorder is closed and queue is empty
+        }
+
+        const AT_U8* data = item.frame.data();
+        size_t n_bytes = frameSlotSize;
+
+        // direct I/O needs page-aligned memory of whole slot (SDK buffers from ANDOR_ImageBufferPool are)
+        if ( !is_aligned(data, ANDOR_FRAME_RECORDER_ALIGNMENT) || (size_t)item.frame.size() > frameSlotSize ) {
+            if ( !bounce_buffer ) bounce_buffer.reset(new ANDOR_ImageBufferPool(1, frameSlotSize));
+            size_t n = (size_t)item.frame.size() < frameSlotSize ? item.frame.size() : frameSlotSize;
+            std::memcpy(bounce_buffer->buffer(0), data, n);
+            // the padding of the slot must not keep bytes of the previous frame
+            std::memset(bounce_buffer->buffer(0) + n, 0, frameSlotSize - n);
+            data = bounce_buffer->buffer(0);
+        }
+
+        if ( writeAt(data, n_bytes, headerSize() + item.slot*frameSlotSize) ) {
+            ++writtenFrames;
+            writtenBytes += n_bytes;
+        } else {
+            ++failedFrames;
+        }
+
+        item.frame.release(); // re-queue SDK buffer right now
+
+        if ( --pendingWrites == 0 ) {
+            {
+                std::lock_guard<std::mutex> lock(writeQueueMutex);
+            }
+            writeDoneCond.notify_all();
+        }
+    }
+}
+
+
+void ANDOR_FrameRecorder::waitPendingWrites()
+{
+    std::unique_lock<std::mutex> lock(writeQueueMutex);
+    writeDoneCond.wait(lock, [this]() { return pendingWrites == 0; });
+}
+
+
+std::string ANDOR_FrameRecorder::errorString(const std::string &context) const
+{
+    int err = lastErrno;
+#ifdef _WIN32
+    return context + " (system error code: " + std::to_string(err) + ")";
+#else
+    return context + " (" + std::strerror(err) + ")";
+#endif
+}
+
+
+                /*  OS-SPECIFIC FILE OPERATIONS  */
+
+#ifdef _WIN32
+
+void ANDOR_FrameRecorder::openFile(const std::string &filename, const bool direct_io)
+{
+    directIO = direct_io;
+
+    DWORD attr = FILE_ATTRIBUTE_NORMAL;
+    if ( direct_io ) attr |= FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH;
+
+    HANDLE hndl = CreateFileA(filename.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, attr, NULL);
+    if ( hndl == INVALID_HANDLE_VALUE && direct_io ) { // fall back to buffered I/O
+        hndl = CreateFileA(filename.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL, NULL);
+        directIO = false;
+    }
+
+    if ( hndl == INVALID_HANDLE_VALUE ) {
+        lastErrno = GetLastError();
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO, errorString("Cannot create file '" + filename + "'"));
+    }
+
+    fileHndl = hndl;
+}
+
+
+void ANDOR_FrameRecorder::closeFile()
+{
+    CloseHandle(fileHndl);
+    fileHndl = INVALID_FILE_HNDL;
+}
+
+
+bool ANDOR_FrameRecorder::writeAt(const void *buff, const size_t size, const size_t offset)
+{
+    OVERLAPPED ov;
+    std::memset(&ov, 0, sizeof(ov));
+    ov.Offset = (DWORD)(offset & 0xFFFFFFFF);
+    ov.OffsetHigh = (DWORD)((unsigned long long)offset >> 32);
+
+    DWORD n;
+    if ( !WriteFile(fileHndl, buff, (DWORD)size, &n, &ov) || n != size ) {
+        lastErrno = GetLastError();
+        return false;
+    }
+
+    return true;
+}
+
+
+bool ANDOR_FrameRecorder::preallocate(const size_t size)
+{
+    FILE_ALLOCATION_INFO info;
+    info.AllocationSize.QuadPart = size;
+
+    if ( !SetFileInformationByHandle(fileHndl, FileAllocationInfo, &info, sizeof(info)) ) {
+        lastErrno = GetLastError();
+        return false;
+    }
+
+    return true;
+}
+
+
+bool ANDOR_FrameRecorder::truncate(const size_t size)
+{
+    FILE_END_OF_FILE_INFO info;
+    info.EndOfFile.QuadPart = size;
+
+    if ( !SetFileInformationByHandle(fileHndl, FileEndOfFileInfo, &info, sizeof(info)) ) {
+        lastErrno = GetLastError();
+        return false;
+    }
+
+    return true;
+}
+
+#else
+
+void ANDOR_FrameRecorder::openFile(const std::string &filename, const bool direct_io)
+{
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    int fd = -1;
+
+#ifdef O_DIRECT
+    if ( direct_io ) {
+        fd = ::open(filename.c_str(), flags | O_DIRECT, 0644);
+        directIO = fd >= 0;
+    }
+#endif
+
+    if ( fd < 0 ) { // direct I/O is not requested or not supported by filesystem (e.g. tmpfs)
+        fd = ::open(filename.c_str(), flags, 0644);
+        directIO = false;
+    }
+
+    if ( fd < 0 ) {
+        lastErrno = errno;
+        throw AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO, errorString("Cannot create file '" + filename + "'"));
+    }
+
+#ifdef __APPLE__
+    if ( direct_io ) directIO = fcntl(fd, F_NOCACHE, 1) == 0;
+#endif
+
+    fileHndl = fd;
+}
+
+
+void ANDOR_FrameRecorder::closeFile()
+{
+    ::close(fileHndl);
+    fileHndl = INVALID_FILE_HNDL;
+}
+
+
+bool ANDOR_FrameRecorder::writeAt(const void *buff, const size_t size, const size_t offset)
+{
+    const char* ptr = static_cast<const char*>(buff);
+    size_t n_left = size;
+    off_t pos = offset;
+
+    while ( n_left ) {
+        ssize_t n = ::pwrite(fileHndl, ptr, n_left, pos);
+        if ( n < 0 ) {
+            if ( errno == EINTR ) continue;
+            lastErrno = errno;
+            return false;
+        }
+        ptr += n;
+        pos += n;
+        n_left -= n;
+    }
+
+    return true;
+}
+
+
+bool ANDOR_FrameRecorder::preallocate(const size_t size)
+{
+#if defined(__linux__)
+    // blocks are reserved, but the file size is kept: it grows with written slots only, so a file
+    // which was not finalized (e.g. a crash during recording) has no tail of never written slots.
+    // (posix_fallocate is not used: it extends the file, and it writes zeros if fallocate is not supported)
+    if ( ::fallocate(fileHndl, FALLOC_FL_KEEP_SIZE, 0, size) ) {
+        if ( errno == EOPNOTSUPP || errno == ENOSYS || errno == EINVAL ) return true; // not supported: not an error
+        lastErrno = errno;
+        return false;
+    }
+#else
+    (void)size;
+#endif
+    return true;
+}
+
+
+bool ANDOR_FrameRecorder::truncate(const size_t size)
+{
+    if ( ::ftruncate(fileHndl, size) ) {
+        lastErrno = errno;
+        return false;
+    }
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef ANDOR_FRAME_RECORDER_H
+#define ANDOR_FRAME_RECORDER_H
+
+#include "../export_decl.h"
+#include "andor_frame.h"
+#include "andor_ring_queue.h"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+// for MS compilers: disable multiple warnings about DLL-exports for the STL containers
+#ifdef _MSC_VER
+#pragma warning( disable: 4251 )
+#endif
+
+
+#define ANDOR_FRAME_RECORDER_DEFAULT_WRITERS_NUMBER 4   // number of in-flight writes
+#define ANDOR_FRAME_RECORDER_DEFAULT_QUEUE_LENGTH 64    // maximal number of frames waiting for writing
+#define ANDOR_FRAME_RECORDER_ALIGNMENT 4096             // alignment of file offsets and sizes of writes
+
+
+            /*   HIGH-THROUGHPUT RAW FRAME RECORDER   */
+
+//
+//  Frames are written straight from SDK buffers (no intermediate copy): each frame
+//  occupies a page-aligned slot of the file and several writer threads keep
+//  positional writes (pwrite) in flight. The file is opened for direct I/O (O_DIRECT,
+//  or FILE_FLAG_NO_BUFFERING on Windows) and preallocated, so the page cache and block
+//  allocation do not stall the stream. A frame buffer is re-queued to SDK as soon as
+//  its write is completed.
+//
+//  Frames from ANDOR_Camera::waitFrame are always suitable for direct I/O (see ANDOR_ImageBufferPool),
+//  other ones are written through an aligned bounce buffer.
+//
+
+class ANDOR_API_WRAPPER_EXPORT ANDOR_FrameRecorder
+{
+public:
+    enum RecorderFlags {DefaultIO = 0, DirectIO = 1, Preallocate = 2};
+
+    explicit ANDOR_FrameRecorder(const size_t writers_number = ANDOR_FRAME_RECORDER_DEFAULT_WRITERS_NUMBER,
+                                 const size_t queue_length = ANDOR_FRAME_RECORDER_DEFAULT_QUEUE_LENGTH);
+
+    ANDOR_FrameRecorder(const ANDOR_FrameRecorder &other) = delete;
+    ANDOR_FrameRecorder & operator = (const ANDOR_FrameRecorder &other) = delete;
+
+    virtual ~ANDOR_FrameRecorder();
+
+    // 'frame_size' is size of SDK buffer (ImageSizeBytes), 'frames_number' is expected number of
+    // frames (used for file preallocation only: the file grows if more frames are recorded).
+    // Preallocation does not change the file size (the size covers written slots only).
+    // Throws AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO) if the file cannot be created
+    void open(const std::string &filename, const size_t frame_size, const size_t frames_number,
+              const int flags = DirectIO | Preallocate);
+
+    // enqueue frame for writing (frames are stored in the order of calls, so
+    // push from a single thread). Returns false (and leaves the frame untouched) if
+    // the queue is full or the recorder is not opened
+    bool push(ANDOR_Frame &&frame);
+
+    // wait for all pending writes and close the file.
+    // Throws AndorSDK_Exception(ANDOR_WRAPPER_ERR_FILE_IO) if any write failed
+    void close();
+
+    bool isOpen() const;
+    bool isDirectIO() const;
+
+    size_t slotSize() const;        // size of file slot of one frame
+    size_t framesNumber() const;    // number of frames accepted by push
+    size_t framesWritten() const;
+    size_t bytesWritten() const;
+    size_t failedWrites() const;
+
+protected:
+                /*  hooks for file formats built on top of raw frame stream  */
+
+    // size of file header (offset of the first frame slot, must be a multiple of ANDOR_FRAME_RECORDER_ALIGNMENT)
+    virtual size_t headerSize() const;
+
+    // called by 'open' after the file was created (e.g. to write header). Must return false on error
+    virtual bool initFile();
+
+    // called by 'push' (before the frame is enqueued) in the caller thread
+    virtual void frameQueued(const ANDOR_Frame &frame, const size_t slot);
+
+    // called by 'close' after all frames were written, 'data_end' is the end of the last frame slot.
+    // Must return false on error and set 'file_size' to the final size of the file
+    virtual bool finalizeFile(const size_t data_end, size_t &file_size);
+
+    // positional write of 'size' bytes (all of arguments must be aligned for direct I/O)
+    bool writeAt(const void* buff, const size_t size, const size_t offset);
+
+    std::string errorString(const std::string &context) const;
+
+    std::atomic<int> lastErrno;
+
+private:
+    struct RecorderItem {
+        ANDOR_Frame frame;
+        size_t slot;
+    };
+
+#ifdef _WIN32
+    void* fileHndl;
+#else
+    int fileHndl;
+#endif
+    std::string fileName;
+    int recorderFlags;
+    bool directIO;
+
+    size_t frameSize;
+    size_t frameSlotSize;
+
+    size_t writersNumber;
+    std::vector<std::thread> writerThreads;
+
+    ANDOR_RingQueue<RecorderItem> writeQueue;
+    std::mutex writeQueueMutex;
+    std::condition_variable writeQueueCond;
+    std::condition_variable writeDoneCond;
+
+    std::atomic<bool> recorderActive;
+    std::atomic<size_t> nextSlot;
+    std::atomic<size_t> pendingWrites;
+    std::atomic<size_t> writtenFrames;
+    std::atomic<size_t> writtenBytes;
+    std::atomic<size_t> failedFrames;
+
+    void writerFunc();
+
+    bool preallocate(const size_t size);
+    bool truncate(const size_t size);
+
+    void openFile(const std::string &filename, const bool direct_io);
+    void closeFile();
+
+    // wait for completion of all writes enqueued so far
+    void waitPendingWrites();
+};
+
+#endif // ANDOR_FRAME_RECORDER_H
@@ -0,0 +1,215 @@
+                /*****************************************************
+                 *                                                   *
+                 *  IMPLEMENTATION OF FRAME STATISTICS COMPUTATION   *
+                 *                                                   *
+                 *****************************************************/
+
+
+#include "andor_frame_stats.h"
+#include "andorsdk_exception.h"
+
+#include <cstring>
+#include <algorithm>
+#include <limits>
+
+
+                /*  ANDOR_FrameStatistics STRUCTURE  */
+
+ANDOR_FrameStatistics::ANDOR_FrameStatistics():
+    number(0), timestamp(), pixels(0), min(0), max(0), mean(0.0), histogram()
+{
+}
+
+
+uint32_t ANDOR_FrameStatistics::percentile(const double p) const
+{
+    if ( histogram.size() != ANDOR_FRAME_STATS_HISTOGRAM_BINS ) {
+        throw AndorSDK_Exception(AT_ERR_NOTIMPLEMENTED, "Cannot compute percentile! No histogram!");
+    }
+
+    if ( !pixels ) return 0;
+
+    double q = std::min(std::max(p, 0.0), 100.0);
+
+    // nearest rank: the smallest value with cumulative count >= q% of pixels
+    uint64_t rank = uint64_t(q/100.0*pixels + 0.5);
+    if ( rank < 1 ) rank = 1;
+    if ( rank > pixels ) rank = pixels;
+
+    uint64_t count = 0;
+    for ( uint32_t v = min > 0xFFFF ? 0xFFFF : min; v < ANDOR_FRAME_STATS_HISTOGRAM_BINS; ++v ) {
+        count += histogram[v];
+        if ( count >= rank ) return v;
+    }
+
+    return ANDOR_FRAME_STATS_HISTOGRAM_BINS - 1;
+}
+
+
+                /*  ANDOR_FrameStatisticsEngine CLASS  */
+
+ANDOR_FrameStatisticsEngine::ANDOR_FrameStatisticsEngine(const int flags, const std::shared_ptr<ANDOR_WorkerPool> &pool):
+    statsFlags(flags), workerPool(pool), bandResults()
+{
+    if ( !workerPool ) workerPool = ANDOR_WorkerPool::defaultPool();
+}
+
+
+void ANDOR_FrameStatisticsEngine::compute(const ANDOR_Frame &frame, ANDOR_FrameStatistics &stats)
+{
+    compute(frame.data(), frame.geometry(), stats);
+
+    stats.number = frame.number();
+    stats.timestamp = frame.timestamp();
+}
+
+
+void ANDOR_FrameStatisticsEngine::compute(const AT_U8 *buffer, const ANDOR_FrameGeometry &geometry, ANDOR_FrameStatistics &stats)
+{
+    if ( geometry.encoding == PIXEL_ENCODING_UNKNOWN ) {
+        throw AndorSDK_Exception(AT_ERR_NOTIMPLEMENTED, "Cannot compute frame statistics! Unknown pixel encoding!");
+    }
+
+    bool hist = statsFlags & Histogram;
+
+    stats.number = 0;
+    stats.timestamp = std::chrono::steady_clock::time_point();
+    stats.pixels = geometry.width*geometry.height;
+
+    if ( hist ) {
+        stats.histogram.assign(ANDOR_FRAME_STATS_HISTOGRAM_BINS, 0);
+    } else {
+        stats.histogram.clear();
+    }
+
+    if ( !stats.pixels ) {
+        stats.min = stats.max = 0;
+        stats.mean = 0.0;
+        return;
+    }
+
+    size_t n_bands = 1;
+    if ( stats.pixels >= ANDOR_FRAME_STATS_MIN_PARALLEL_PIXELS ) {
+        n_bands = std::min(workerPool->threadsNumber(), geometry.height);
+    }
+
+    if ( bandResults.size() < n_bands ) bandResults.resize(n_bands);
+
+    size_t band_rows = (geometry.height + n_bands - 1)/n_bands;
+
+    // bands are static (one per thread) since every band needs its own histogram
+    workerPool->parallelFor(n_bands, [&](size_t i) {
+        size_t first = i*band_rows;
+        size_t last = std::min(first + band_rows, geometry.height);
+
+        uint32_t* h = nullptr;
+        if ( hist ) {
+            if ( i == 0 ) {
+                h = stats.histogram.data();
+            } else {
+                bandResults[i].histogram.assign(ANDOR_FRAME_STATS_HISTOGRAM_BINS, 0);
+                h = bandResults[i].histogram.data();
+            }
+        }
+
+        computeBand(buffer, geometry, first, last, bandResults[i], h);
+    });
+
+    uint32_t vmin = std::numeric_limits<uint32_t>::max();
+    uint32_t vmax = 0;
+    uint64_t sum = 0;
+
+    for ( size_t i = 0; i < n_bands; ++i ) {
+        vmin = std::min(vmin, bandResults[i].min);
+        vmax = std::max(vmax, bandResults[i].max);
+        sum += bandResults[i].sum;
+    }
+
+    stats.min = vmin;
+    stats.max = vmax;
+    stats.mean = double(sum)/stats.pixels;
+
+    if ( hist && n_bands > 1 ) { // merge partial histograms by chunks of bins
+        const size_t chunk = 4096;
+
+        workerPool->parallelFor(ANDOR_FRAME_STATS_HISTOGRAM_BINS/chunk, [&](size_t k) {
+            uint32_t* dst = stats.histogram.data() + k*chunk;
+            for ( size_t i = 1; i < n_bands; ++i ) {
+                const uint32_t* src = bandResults[i].histogram.data() + k*chunk;
+                for ( size_t j = 0; j < chunk; ++j ) dst[j] += src[j];
+            }
+        });
+    }
+}
+
+
+int ANDOR_FrameStatisticsEngine::flags() const
+{
+    return statsFlags;
+}
+
+
+                /*  PRIVATE METHODS  */
+
+void ANDOR_FrameStatisticsEngine::computeBand(const AT_U8 *buffer, const ANDOR_FrameGeometry &geometry,
+                                              const size_t first_row, const size_t last_row,
+                                              BandResult &result, uint32_t *histogram)
+{
+    const size_t width = geometry.width;
+
+    uint64_t sum = 0;
+
+    if ( geometry.encoding == PIXEL_ENCODING_MONO32 ) {
+        uint32_t vmin = std::numeric_limits<uint32_t>::max();
+        uint32_t vmax = 0;
+
+        for ( size_t y = first_row; y < last_row; ++y ) {
+            const uint32_t* row = reinterpret_cast<const uint32_t*>(buffer + y*geometry.stride);
+
+            andor_row_statistics(row, width, vmin, vmax, sum);
+
+            if ( histogram ) {
+                for ( size_t i = 0; i < width; ++i ) {
+                    uint32_t v;
+                    std::memcpy(&v, row + i, 4);
+                    ++histogram[v > 0xFFFF ? 0xFFFF : v];
+                }
+            }
+        }
+
+        result.min = vmin;
+        result.max = vmax;
+        result.sum = sum;
+
+        return;
+    }
+
+    uint16_t vmin = 0xFFFF;
+    uint16_t vmax = 0;
+
+    if ( geometry.encoding == PIXEL_ENCODING_MONO12PACKED && result.rowBuffer.size() < width ) {
+        result.rowBuffer.resize(width);
+    }
+
+    for ( size_t y = first_row; y < last_row; ++y ) {
+        const AT_U8* src = buffer + y*geometry.stride;
+        const uint16_t* row;
+
+        if ( geometry.encoding == PIXEL_ENCODING_MONO12PACKED ) {
+            andor_unpack_row(src, width, geometry.encoding, result.rowBuffer.data());
+            row = result.rowBuffer.data();
+        } else { // Mono12 and Mono16 are little-endian 16-bit words
+            row = reinterpret_cast<const uint16_t*>(src);
+        }
+
+        andor_row_statistics(row, width, vmin, vmax, sum);
+
+        if ( histogram ) {
+            for ( size_t i = 0; i < width; ++i ) ++histogram[row[i]];
+        }
+    }
+
+    result.min = vmin;
+    result.max = vmax;
+    result.sum = sum;
+}
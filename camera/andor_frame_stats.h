@@ -0,0 +1,97 @@
+#ifndef ANDOR_FRAME_STATS_H
+#define ANDOR_FRAME_STATS_H
+
+#include "../export_decl.h"
+#include "andor_frame.h"
+#include "andor_worker_pool.h"
+
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+
+// for MS compilers: disable multiple warnings about DLL-exports for the STL containers
+#ifdef _MSC_VER
+#pragma warning( disable: 4251 )
+#endif
+
+
+#define ANDOR_FRAME_STATS_HISTOGRAM_BINS 65536
+#define ANDOR_FRAME_STATS_MIN_PARALLEL_PIXELS (512*512) // smaller images are processed by the calling thread
+
+
+            /*   STATISTICS OF FRAME PIXELS   */
+
+//
+//  Result of ANDOR_FrameStatisticsEngine::compute. Frame number and timestamp are copied
+//  from the frame handle, so the statistics can be passed along with the frame
+//  (or outlive it) and matched with archived/recorded data.
+//
+
+struct ANDOR_API_WRAPPER_EXPORT ANDOR_FrameStatistics
+{
+    ANDOR_FrameStatistics();
+
+    size_t number;
+    std::chrono::steady_clock::time_point timestamp;
+
+    size_t pixels;   // number of pixels (AOIWidth*AOIHeight)
+    uint32_t min;
+    uint32_t max;
+    double mean;
+
+    // one bin per ADU. Empty if the histogram was not requested.
+    // Mono32 values above 65535 are counted in the last bin
+    std::vector<uint32_t> histogram;
+
+    // value of p-th percentile (0 <= p <= 100) computed from the histogram (nearest rank).
+    // Throws AndorSDK_Exception(AT_ERR_NOTIMPLEMENTED) if there is no histogram
+    uint32_t percentile(const double p) const;
+};
+
+
+            /*   ONE-PASS FRAME STATISTICS   */
+
+//
+//  Min/max/mean and histogram are computed in one pass over SDK buffer (AOIStride is honored):
+//  each row is reduced by SIMD kernel (see andor_row_statistics) and histogrammed while it is
+//  still in L1 cache. Mono12Packed rows are unpacked into a per-thread row buffer first.
+//
+//  Large images are split into bands of rows processed on the worker pool, each band with
+//  its own partial histogram (they are summed up in parallel afterwards). Buffers are allocated
+//  once, so an engine should be reused for all frames of a stream (one engine per thread).
+//
+
+class ANDOR_API_WRAPPER_EXPORT ANDOR_FrameStatisticsEngine
+{
+public:
+    enum StatisticsFlags {MinMaxMean = 0, Histogram = 1};
+
+    explicit ANDOR_FrameStatisticsEngine(const int flags = Histogram,
+                                         const std::shared_ptr<ANDOR_WorkerPool> &pool = ANDOR_WorkerPool::defaultPool());
+
+    // 'stats' may be reused for the next frame (its histogram is not reallocated).
+    // Throws AndorSDK_Exception(AT_ERR_NOTIMPLEMENTED) for unknown pixel encoding
+    void compute(const ANDOR_Frame &frame, ANDOR_FrameStatistics &stats);
+    void compute(const AT_U8* buffer, const ANDOR_FrameGeometry &geometry, ANDOR_FrameStatistics &stats);
+
+    int flags() const;
+
+private:
+    struct BandResult {
+        uint32_t min;
+        uint32_t max;
+        uint64_t sum;
+        std::vector<uint32_t> histogram;  // unused for the first band (it goes to the result)
+        std::vector<uint16_t> rowBuffer;  // unpacked Mono12Packed row
+    };
+
+    int statsFlags;
+    std::shared_ptr<ANDOR_WorkerPool> workerPool;
+    std::vector<BandResult> bandResults;
+
+    void computeBand(const AT_U8* buffer, const ANDOR_FrameGeometry &geometry,
+                     const size_t first_row, const size_t last_row, BandResult &result, uint32_t* histogram);
+};
+
+#endif // ANDOR_FRAME_STATS_H
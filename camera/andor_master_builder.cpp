@@ -0,0 +1,388 @@
+                    /*************************************************
+                     *                                               *
+                     *   IMPLEMENTATION OF ANDOR_MasterFrameBuilder  *
+                     *                                               *
+                     *************************************************/
+
+
+#include "andor_master_builder.h"
+#include "andorsdk_exception.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+#define BUILDER_BAND_ROWS 16 // rows per task of frame unpacking
+
+
+                /*  AUXILIARY NON-MEMBER CLASS  */
+
+// restores acquisition settings changed by ANDOR_MasterFrameBuilder::acquire
+class AcquisitionSettingsGuard
+{
+public:
+    explicit AcquisitionSettingsGuard(ANDOR_Camera &camera):
+        guardedCamera(camera), cycleMode(camera.getIndex<AndorFeature::CycleMode>()),
+        frameCount(camera.get<AndorFeature::FrameCount>())
+    {
+    }
+
+    ~AcquisitionSettingsGuard()
+    {
+        try { // FrameCount first: it may be not writable in the restored mode
+            guardedCamera.set<AndorFeature::FrameCount>(frameCount);
+        } catch ( ... ) {
+        }
+
+        try {
+            guardedCamera.setIndex<AndorFeature::CycleMode>(cycleMode);
+        } catch ( ... ) {
+        }
+    }
+
+private:
+    ANDOR_Camera &guardedCamera;
+    andor_enum_index_t cycleMode;
+    AT_64 frameCount;
+};
+
+
+
+                /*  ANDOR_MasterFrameBuilder CLASS  */
+
+ANDOR_MasterFrameBuilder::ANDOR_MasterFrameBuilder(const std::shared_ptr<ANDOR_WorkerPool> &pool):
+    workerPool(pool), imageWidth(0), imageHeight(0), stackFrames(0), stackExposure(0.0), reservedFrames(0),
+    stackTiles(), frameSums(),
+    kappaLow(ANDOR_MASTER_BUILDER_DEFAULT_KAPPA), kappaHigh(ANDOR_MASTER_BUILDER_DEFAULT_KAPPA),
+    clipIterations(ANDOR_MASTER_BUILDER_DEFAULT_CLIP_ITERATIONS),
+    biasFrame(), darkFrame()
+{
+    if ( !workerPool ) workerPool = ANDOR_WorkerPool::defaultPool();
+}
+
+
+void ANDOR_MasterFrameBuilder::reset()
+{
+    std::vector<std::vector<uint16_t>>().swap(stackTiles);
+    std::vector<uint64_t>().swap(frameSums);
+
+    imageWidth = imageHeight = 0;
+    stackFrames = 0;
+    stackExposure = 0.0;
+    reservedFrames = 0;
+}
+
+
+void ANDOR_MasterFrameBuilder::reserve(const size_t frames_number)
+{
+    reservedFrames = frames_number;
+
+    // image size is known after the first frame, otherwise tiles are allocated by push
+    for ( size_t t = 0; t < stackTiles.size(); ++t ) {
+        stackTiles[t].reserve(reservedFrames*ANDOR_MASTER_BUILDER_TILE_PIXELS);
+    }
+    frameSums.reserve(reservedFrames);
+}
+
+
+void ANDOR_MasterFrameBuilder::push(const ANDOR_Frame &frame)
+{
+    push(frame.data(), frame.geometry());
+}
+
+
+void ANDOR_MasterFrameBuilder::push(const AT_U8 *buffer, const ANDOR_FrameGeometry &geometry)
+{
+    if ( geometry.encoding == PIXEL_ENCODING_UNKNOWN ) {
+        throw AndorSDK_Exception(AT_ERR_NOTIMPLEMENTED, "Cannot push frame to master builder! Unknown pixel encoding!");
+    }
+
+    if ( geometry.encoding == PIXEL_ENCODING_MONO32 ) {
+        throw AndorSDK_Exception(AT_ERR_NOTIMPLEMENTED, "Cannot push frame to master builder! Mono32 values do not fit into 16-bit stack!");
+    }
+
+    if ( !geometry.width || !geometry.height ) {
+        throw AndorSDK_Exception(AT_ERR_INVALIDSIZE, "Cannot push frame to master builder! Empty image!");
+    }
+
+    if ( !stackFrames ) {
+        imageWidth = geometry.width;
+        imageHeight = geometry.height;
+
+        size_t n_tiles = (imageWidth*imageHeight + ANDOR_MASTER_BUILDER_TILE_PIXELS - 1)/ANDOR_MASTER_BUILDER_TILE_PIXELS;
+        stackTiles.assign(n_tiles, std::vector<uint16_t>());
+        frameSums.clear();
+
+        reserve(std::max(reservedFrames, size_t(1)));
+    } else if ( geometry.width != imageWidth || geometry.height != imageHeight ) {
+        throw AndorSDK_Exception(AT_ERR_INVALIDSIZE, "Image size " + std::to_string(geometry.width) + "x" +
+                                 std::to_string(geometry.height) + " differs from the stacked frames one (" +
+                                 std::to_string(imageWidth) + "x" + std::to_string(imageHeight) + ")!");
+    }
+
+    // slot of the new frame in every tile (within the reserved capacity, so no reallocation)
+    const size_t slot = stackFrames*ANDOR_MASTER_BUILDER_TILE_PIXELS;
+    for ( size_t t = 0; t < stackTiles.size(); ++t ) stackTiles[t].resize(slot + ANDOR_MASTER_BUILDER_TILE_PIXELS);
+
+    const size_t n_bands = (imageHeight + BUILDER_BAND_ROWS - 1)/BUILDER_BAND_ROWS;
+    std::vector<uint64_t> band_sums(n_bands, 0);
+
+    workerPool->parallelFor(n_bands, [&](size_t band) {
+        std::vector<uint16_t> row(imageWidth);
+        uint64_t sum = 0;
+
+        size_t last = std::min((band + 1)*BUILDER_BAND_ROWS, imageHeight);
+
+        for ( size_t y = band*BUILDER_BAND_ROWS; y < last; ++y ) {
+            andor_unpack_row(buffer + y*geometry.stride, imageWidth, geometry.encoding, row.data());
+
+            for ( size_t x = 0; x < imageWidth; ++x ) sum += row[x];
+
+            // scatter the row over tiles
+            size_t pix = y*imageWidth;
+            for ( size_t x = 0; x < imageWidth; ) {
+                size_t tile = pix/ANDOR_MASTER_BUILDER_TILE_PIXELS;
+                size_t offset = pix % ANDOR_MASTER_BUILDER_TILE_PIXELS;
+                size_t n = std::min(ANDOR_MASTER_BUILDER_TILE_PIXELS - offset, imageWidth - x);
+
+                std::memcpy(stackTiles[tile].data() + slot + offset, row.data() + x, n*sizeof(uint16_t));
+
+                x += n;
+                pix += n;
+            }
+        }
+
+        band_sums[band] = sum;
+    });
+
+    uint64_t frame_sum = 0;
+    for ( uint64_t sum: band_sums ) frame_sum += sum;
+    frameSums.push_back(frame_sum);
+
+    ++stackFrames;
+}
+
+
+size_t ANDOR_MasterFrameBuilder::acquire(ANDOR_Camera &camera, const size_t frames_number)
+{
+    if ( !frames_number ) return 0;
+
+    AcquisitionSettingsGuard guard(camera);
+
+    camera.set<AndorFeature::CycleMode>(L"Fixed");
+    camera.set<AndorFeature::FrameCount>(AT_64(frames_number));
+
+    double exp_time = camera.get<AndorFeature::ExposureTime>();
+    stackExposure = exp_time;
+
+    const unsigned int timeout = static_cast<unsigned int>(exp_time*1000.0) + ANDOR_MASTER_BUILDER_FRAME_TIMEOUT;
+
+    reserve(stackFrames + frames_number);
+
+    camera.acquisitionStart();
+
+    size_t n = 0;
+    ANDOR_Frame frame;
+
+    try {
+        while ( n < frames_number && camera.waitFrame(frame, timeout) ) {
+            push(frame);
+            frame.release(); // the buffer is not needed anymore
+            ++n;
+        }
+    } catch ( ... ) {
+        frame.release();
+        camera.acquisitionStop();
+        throw;
+    }
+
+    camera.acquisitionStop();
+
+    return n;
+}
+
+
+size_t ANDOR_MasterFrameBuilder::framesNumber() const
+{
+    return stackFrames;
+}
+
+
+size_t ANDOR_MasterFrameBuilder::width() const
+{
+    return imageWidth;
+}
+
+
+size_t ANDOR_MasterFrameBuilder::height() const
+{
+    return imageHeight;
+}
+
+
+void ANDOR_MasterFrameBuilder::setExposure(const double exposure)
+{
+    stackExposure = exposure;
+}
+
+
+double ANDOR_MasterFrameBuilder::exposure() const
+{
+    return stackExposure;
+}
+
+
+void ANDOR_MasterFrameBuilder::setSigmaClipping(const double kappa_low, const double kappa_high, const size_t max_iterations)
+{
+    kappaLow = kappa_low;
+    kappaHigh = kappa_high;
+    clipIterations = max_iterations;
+}
+
+
+void ANDOR_MasterFrameBuilder::setBiasFrame(const ANDOR_MasterFrame &bias)
+{
+    biasFrame = bias;
+}
+
+
+void ANDOR_MasterFrameBuilder::setDarkFrame(const ANDOR_MasterFrame &dark)
+{
+    darkFrame = dark;
+}
+
+
+ANDOR_MasterFrame ANDOR_MasterFrameBuilder::combine(const ANDOR_MasterFrame::MasterType type, const CombineMethod method)
+{
+    if ( !stackFrames ) {
+        throw AndorSDK_Exception(AT_ERR_NODATA, "Cannot combine master frame! No frames!");
+    }
+
+    const bool sub_bias = biasFrame.isValid();
+    const bool sub_dark = darkFrame.isValid();
+
+    if ( (sub_bias && (biasFrame.width != imageWidth || biasFrame.height != imageHeight)) ||
+         (sub_dark && (darkFrame.width != imageWidth || darkFrame.height != imageHeight)) ) {
+        throw AndorSDK_Exception(AT_ERR_INVALIDSIZE, "Cannot combine master frame! Size of bias or dark frame differs from the stacked frames one!");
+    }
+
+    const float dark_scale = (sub_dark && darkFrame.exposure > 0.0) ? float(stackExposure/darkFrame.exposure) : 1.0f;
+
+    ANDOR_MasterFrame master(type, imageWidth, imageHeight, stackExposure);
+    master.framesNumber = stackFrames;
+
+    const size_t n_pixels = imageWidth*imageHeight;
+
+    // flats: every frame is scaled to the mean level of the stack
+    std::vector<float> frame_scale(stackFrames, 1.0f);
+
+    if ( type == ANDOR_MasterFrame::MasterFlat ) {
+        double offset_sum = 0.0;
+        for ( size_t i = 0; i < n_pixels; ++i ) {
+            if ( sub_bias ) offset_sum += biasFrame.data[i];
+            if ( sub_dark ) offset_sum += darkFrame.data[i]*dark_scale;
+        }
+
+        std::vector<double> levels(stackFrames);
+        double mean_level = 0.0;
+
+        for ( size_t f = 0; f < stackFrames; ++f ) {
+            levels[f] = (double(frameSums[f]) - offset_sum)/n_pixels;
+            if ( levels[f] <= 0.0 ) {
+                throw AndorSDK_Exception(AT_ERR_OUTOFRANGE, "Cannot combine master flat! Non-positive level of frame " +
+                                         std::to_string(f) + "!");
+            }
+            mean_level += levels[f];
+        }
+        mean_level /= stackFrames;
+
+        for ( size_t f = 0; f < stackFrames; ++f ) frame_scale[f] = float(mean_level/levels[f]);
+    }
+
+    workerPool->parallelFor(stackTiles.size(), [&](size_t t) {
+        std::vector<float> values(stackFrames);
+
+        const uint16_t* tile = stackTiles[t].data();
+        const size_t first = t*ANDOR_MASTER_BUILDER_TILE_PIXELS;
+        const size_t n = std::min(size_t(ANDOR_MASTER_BUILDER_TILE_PIXELS), n_pixels - first);
+
+        for ( size_t p = 0; p < n; ++p ) {
+            float offset = 0.0f;
+            if ( sub_bias ) offset += biasFrame.data[first + p];
+            if ( sub_dark ) offset += darkFrame.data[first + p]*dark_scale;
+
+            for ( size_t f = 0; f < stackFrames; ++f ) {
+                values[f] = (tile[f*ANDOR_MASTER_BUILDER_TILE_PIXELS + p] - offset)*frame_scale[f];
+            }
+
+            master.data[first + p] = combinePixel(values, method);
+        }
+    });
+
+    return master;
+}
+
+
+                /*  PRIVATE METHODS  */
+
+static inline float median_of_sorted(const float* v, const size_t n)
+{
+    return (n % 2) ? v[n/2] : 0.5f*(v[n/2 - 1] + v[n/2]);
+}
+
+
+float ANDOR_MasterFrameBuilder::combinePixel(std::vector<float> &values, const CombineMethod method) const
+{
+    const size_t n = values.size();
+
+    switch ( method ) {
+        case CombineMean: {
+            double sum = 0.0;
+            for ( size_t i = 0; i < n; ++i ) sum += values[i];
+            return float(sum/n);
+        }
+        case CombineMedian: {
+            auto mid = values.begin() + n/2;
+            std::nth_element(values.begin(), mid, values.end());
+            float m = *mid;
+            if ( !(n % 2) ) m = 0.5f*(m + *std::max_element(values.begin(), mid));
+            return m;
+        }
+        case CombineSigmaClip: {
+            // kept values always form a contiguous range of the sorted array
+            std::sort(values.begin(), values.end());
+
+            size_t lo = 0, hi = n;
+            double sum = 0.0;
+
+            for ( size_t iter = 0; iter < clipIterations && hi - lo > 2; ++iter ) {
+                double s = 0.0, s2 = 0.0;
+                for ( size_t i = lo; i < hi; ++i ) {
+                    s += values[i];
+                    s2 += double(values[i])*values[i];
+                }
+                double mean = s/(hi - lo);
+                double sigma = std::sqrt(std::max(s2/(hi - lo) - mean*mean, 0.0));
+
+                double center = median_of_sorted(values.data() + lo, hi - lo);
+                float low_lim = float(center - kappaLow*sigma);
+                float high_lim = float(center + kappaHigh*sigma);
+
+                size_t new_lo = std::lower_bound(values.begin() + lo, values.begin() + hi, low_lim) - values.begin();
+                size_t new_hi = std::upper_bound(values.begin() + lo, values.begin() + hi, high_lim) - values.begin();
+
+                if ( new_lo == lo && new_hi == hi ) break;
+                if ( new_hi <= new_lo ) break; // degenerate case: keep the previous set
+
+                lo = new_lo;
+                hi = new_hi;
+            }
+
+            for ( size_t i = lo; i < hi; ++i ) sum += values[i];
+            return float(sum/(hi - lo));
+        }
+    }
+
+    return 0.0f;
+}
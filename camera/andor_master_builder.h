@@ -0,0 +1,113 @@
+#ifndef ANDOR_MASTER_BUILDER_H
+#define ANDOR_MASTER_BUILDER_H
+
+#include "../export_decl.h"
+#include "andor_camera.h"
+#include "andor_frame.h"
+#include "andor_calibration.h"
+#include "andor_worker_pool.h"
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+// for MS compilers: disable multiple warnings about DLL-exports for the STL containers
+#ifdef _MSC_VER
+#pragma warning( disable: 4251 )
+#endif
+
+
+#define ANDOR_MASTER_BUILDER_TILE_PIXELS 256          // pixels of image tile (combined by one task)
+#define ANDOR_MASTER_BUILDER_FRAME_TIMEOUT 5000       // extra wait for a frame (millisecs) in acquire()
+#define ANDOR_MASTER_BUILDER_DEFAULT_KAPPA 3.0
+#define ANDOR_MASTER_BUILDER_DEFAULT_CLIP_ITERATIONS 5
+
+
+            /*   BUILDER OF MASTER CALIBRATION FRAMES   */
+
+//
+//  Frames are unpacked into a tiled stack of 16-bit values as they arrive (the frame
+//  can be released right after push), so the stack takes 2 bytes per pixel and frame
+//  and no float copy of it is ever made. A tile keeps the values of
+//  ANDOR_MASTER_BUILDER_TILE_PIXELS consecutive pixels of all frames, so combining
+//  a tile touches one contiguous block (it fits into L2 cache for hundreds of frames).
+//  Tiles are combined in parallel on the worker pool. Tiles are allocated once for
+//  the expected number of frames (see reserve), so push does not reallocate the stack.
+//
+//  Mono32 frames are rejected (their values do not fit into the 16-bit stack).
+//
+//  Bias (and scaled dark) masters, if given, are subtracted from the frame values before
+//  combining, i.e. one gets bias-subtracted darks and bias/dark-subtracted flats as
+//  ANDOR_FrameCalibrator expects. Flat frames are also normalized to the mean level of the
+//  stack (the level of every frame is its mean value after the subtraction), so changes of
+//  illumination between frames do not bias the median.
+//
+
+class ANDOR_API_WRAPPER_EXPORT ANDOR_MasterFrameBuilder
+{
+public:
+    enum CombineMethod {CombineMean, CombineMedian, CombineSigmaClip};
+
+    explicit ANDOR_MasterFrameBuilder(const std::shared_ptr<ANDOR_WorkerPool> &pool = ANDOR_WorkerPool::defaultPool());
+
+    void reset(); // drop all frames (and the reservation and the exposure time)
+
+    // expected number of frames in the stack: tiles are allocated once for them
+    // (the stack is reallocated if more frames are pushed)
+    void reserve(const size_t frames_number);
+
+    // add frame to the stack. The first frame defines image size, others must be the same.
+    // Throws AndorSDK_Exception(AT_ERR_INVALIDSIZE) otherwise and
+    // AndorSDK_Exception(AT_ERR_NOTIMPLEMENTED) for Mono32 and unknown pixel encodings
+    void push(const ANDOR_Frame &frame);
+    void push(const AT_U8* buffer, const ANDOR_FrameGeometry &geometry);
+
+    // run 'CycleMode = Fixed' acquisition of 'frames_number' frames and push them.
+    // The exposure time is taken from the camera, CycleMode and FrameCount are restored
+    // on return. Returns number of pushed frames (it is less than requested if a frame
+    // did not arrive in time)
+    size_t acquire(ANDOR_Camera &camera, const size_t frames_number);
+
+    size_t framesNumber() const;
+    size_t width() const;
+    size_t height() const;
+
+    void setExposure(const double exposure); // exposure time of stacked frames
+    double exposure() const;
+
+    // rejection limits are kappa*sigma below and above median of pixel values
+    void setSigmaClipping(const double kappa_low, const double kappa_high,
+                          const size_t max_iterations = ANDOR_MASTER_BUILDER_DEFAULT_CLIP_ITERATIONS);
+
+    // masters subtracted from combined image (dark is scaled by ratio of exposures)
+    void setBiasFrame(const ANDOR_MasterFrame &bias);
+    void setDarkFrame(const ANDOR_MasterFrame &dark);
+
+    // combine stacked frames. Throws AndorSDK_Exception(AT_ERR_NODATA) if the stack is empty,
+    // AndorSDK_Exception(AT_ERR_INVALIDSIZE) if bias/dark size differs from the frames one and
+    // AndorSDK_Exception(AT_ERR_OUTOFRANGE) if a flat frame has non-positive level
+    ANDOR_MasterFrame combine(const ANDOR_MasterFrame::MasterType type, const CombineMethod method = CombineMedian);
+
+private:
+    std::shared_ptr<ANDOR_WorkerPool> workerPool;
+
+    size_t imageWidth;
+    size_t imageHeight;
+    size_t stackFrames;
+    double stackExposure;
+    size_t reservedFrames;
+
+    std::vector<std::vector<uint16_t>> stackTiles; // [tile][frame*TILE_PIXELS + pixel]
+    std::vector<uint64_t> frameSums; // sum of pixel values of every frame (levels of flats)
+
+    double kappaLow;
+    double kappaHigh;
+    size_t clipIterations;
+
+    ANDOR_MasterFrame biasFrame;
+    ANDOR_MasterFrame darkFrame;
+
+    float combinePixel(std::vector<float> &values, const CombineMethod method) const;
+};
+
+#endif // ANDOR_MASTER_BUILDER_H
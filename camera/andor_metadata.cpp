@@ -0,0 +1,100 @@
+                        /************************************************
+                         *                                              *
+                         *  PARSER OF SDK FRAME METADATA BLOCKS         *
+                         *                                              *
+                         ************************************************/
+
+
+#include "andor_metadata.h"
+
+#include <cstring>
+
+
+static inline uint32_t read_u32(const AT_U8* ptr)
+{
+    uint32_t v;
+    std::memcpy(&v, ptr, 4);
+    return v;
+}
+
+
+static inline uint16_t read_u16(const AT_U8* ptr)
+{
+    uint16_t v;
+    std::memcpy(&v, ptr, 2);
+    return v;
+}
+
+
+ANDOR_FrameGeometry ANDOR_FrameMetadata::geometry(const std::vector<std::basic_string<AT_WC>> &encoding_values) const
+{
+    // FrameInfo keeps index of 'PixelEncoding' feature: SDK order of values (e.g. index 3 is 'RGB8Packed')
+    // differs from ANDOR_PixelEncoding one, so the index is mapped by name (as ANDOR_Camera::readFrameGeometry does)
+    ANDOR_FrameGeometry geom = {aoiWidth, aoiHeight, aoiStride, PIXEL_ENCODING_UNKNOWN};
+
+    if ( pixelEncodingIndex >= 0 && (size_t)pixelEncodingIndex < encoding_values.size() ) {
+        geom.encoding = andor_pixel_encoding(encoding_values[pixelEncodingIndex].c_str());
+    }
+
+    return geom;
+}
+
+
+bool andor_parse_metadata(const AT_U8 *buffer, const size_t size, ANDOR_FrameMetadata &metadata)
+{
+    metadata.imageData = nullptr;
+    metadata.imageDataSize = 0;
+    metadata.hasTimestamp = false;
+    metadata.timestamp = 0;
+    metadata.hasFrameInfo = false;
+    metadata.aoiWidth = 0;
+    metadata.aoiHeight = 0;
+    metadata.aoiStride = 0;
+    metadata.pixelEncodingIndex = -1;
+
+    if ( buffer == nullptr ) return false;
+
+    size_t end = size; // end of the current block
+
+    while ( end >= 8 ) {
+        uint32_t length = read_u32(buffer + end - 4);
+        uint32_t cid = read_u32(buffer + end - 8);
+
+        if ( length < 4 || length > end - 4 ) return false; // corrupted block
+
+        size_t data_size = length - 4;
+        const AT_U8* data = buffer + end - 8 - data_size;
+
+        switch ( cid ) {
+            case ANDOR_METADATA_CID_FRAME_DATA:
+                metadata.imageData = data;
+                metadata.imageDataSize = data_size;
+                return true; // image is always the first block
+            case ANDOR_METADATA_CID_TICKS:
+                if ( data_size < 8 ) return false;
+                std::memcpy(&metadata.timestamp, data, 8);
+                metadata.hasTimestamp = true;
+                break;
+            case ANDOR_METADATA_CID_FRAME_INFO: // AOIStride(2), PixelEncoding(1), padding(1), AOIWidth(2), AOIHeight(2)
+                if ( data_size < 8 ) return false;
+                metadata.aoiStride = read_u16(data);
+                metadata.pixelEncodingIndex = data[2];
+                metadata.aoiWidth = read_u16(data + 4);
+                metadata.aoiHeight = read_u16(data + 6);
+                metadata.hasFrameInfo = true;
+                break;
+            default: // unknown block: just skip it
+                break;
+        }
+
+        end -= 4 + length;
+    }
+
+    return false; // no image data block
+}
+
+
+bool andor_parse_metadata(const ANDOR_Frame &frame, ANDOR_FrameMetadata &metadata)
+{
+    return andor_parse_metadata(frame.data(), frame.size(), metadata);
+}
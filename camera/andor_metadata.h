@@ -0,0 +1,58 @@
+#ifndef ANDOR_METADATA_H
+#define ANDOR_METADATA_H
+
+#include "../export_decl.h"
+#include "andor_frame.h"
+
+#include <atcore.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+            /*   SDK FRAME METADATA   */
+
+//
+//  If 'MetadataEnable' is set, SDK appends blocks to each image buffer. The blocks
+//  must be read from the end of the buffer:
+//
+//      ... | DATA | CID (4 bytes) | LENGTH (4 bytes) |
+//
+//  where LENGTH is the size of CID plus DATA. The parser walks the blocks in place:
+//  no copy of data and no allocation is made.
+//
+
+#define ANDOR_METADATA_CID_FRAME_DATA 0  // image data (with row padding)
+#define ANDOR_METADATA_CID_TICKS      1  // 'MetadataTimestamp': 64-bit value of TimestampClock at exposure start
+#define ANDOR_METADATA_CID_FRAME_INFO 7  // AOI geometry and pixel encoding
+
+
+struct ANDOR_FrameMetadata
+{
+    const AT_U8* imageData; // start of image data (CID 0 block) or nullptr
+    size_t imageDataSize;
+
+    bool hasTimestamp;
+    uint64_t timestamp;     // ticks of 'TimestampClock' (see 'TimestampClockFrequency')
+
+    bool hasFrameInfo;
+    size_t aoiWidth;
+    size_t aoiHeight;
+    size_t aoiStride;
+    int pixelEncodingIndex; // index of 'PixelEncoding' enumerated feature
+
+    // valid if 'hasFrameInfo' is true. The order of 'PixelEncoding' values depends on the camera,
+    // so the index is mapped through the strings of the feature ('encoding_values', strings by index,
+    // e.g. ANDOR_EnumFeatureInfo::values() of the camera 'PixelEncoding' feature)
+    ANDOR_FrameGeometry geometry(const std::vector<std::basic_string<AT_WC>> &encoding_values) const;
+};
+
+
+// parse metadata blocks of SDK buffer. Returns false if blocks are corrupted
+// (or metadata was not enabled for acquisition)
+ANDOR_API_WRAPPER_EXPORT bool andor_parse_metadata(const AT_U8* buffer, const size_t size, ANDOR_FrameMetadata &metadata);
+ANDOR_API_WRAPPER_EXPORT bool andor_parse_metadata(const ANDOR_Frame &frame, ANDOR_FrameMetadata &metadata);
+
+#endif // ANDOR_METADATA_H
@@ -0,0 +1,587 @@
+                    /*************************************************
+                     *                                               *
+                     *  IMPLEMENTATION OF ANDOR_MultiCamera CLASS    *
+                     *                                               *
+                     *************************************************/
+
+
+#include "andor_multi_camera.h"
+#include "andor_metadata.h"
+#include "andorsdk_exception.h"
+
+#include "andor_worker_pool.h"
+
+#include <algorithm>
+
+
+                /*  AUXILIARY NON-MEMBER FUNCTIONS  */
+
+static inline bool keys_match(const uint64_t key1, const uint64_t key2, const uint64_t tolerance)
+{
+    return (key1 > key2 ? key1 - key2 : key2 - key1) <= tolerance;
+}
+
+
+
+            /*  ANDOR_FrameSet  */
+
+ANDOR_FrameSet::ANDOR_FrameSet():
+    number(0), key(0), frames()
+{
+}
+
+
+ANDOR_FrameSet::ANDOR_FrameSet(ANDOR_FrameSet &&other):
+    number(other.number), key(other.key), frames(std::move(other.frames))
+{
+}
+
+
+ANDOR_FrameSet & ANDOR_FrameSet::operator = (ANDOR_FrameSet &&other)
+{
+    if ( this == &other ) return *this;
+
+    number = other.number;
+    key = other.key;
+    frames = std::move(other.frames); // the held frames are released
+
+    return *this;
+}
+
+
+void ANDOR_FrameSet::release()
+{
+    for ( ANDOR_Frame &frame: frames ) frame.release();
+}
+
+
+
+            /*  statistics  */
+
+ANDOR_CameraSyncStats::ANDOR_CameraSyncStats():
+    framesCaptured(0), framesMatched(0), framesUnmatched(0), missingFrames(0), droppedFrames(0), metadataErrors(0),
+    lastLag(0), maxLag(0), meanLag(0), pinned(false)
+{
+}
+
+
+ANDOR_MultiCameraStats::ANDOR_MultiCameraStats():
+    completeSets(0), incompleteSets(0), overflowSets(0), cameras()
+{
+}
+
+
+
+            /*  ANDOR_MultiCamera  */
+
+ANDOR_MultiCamera::PendingSet::PendingSet():
+    key(0), framesNumber(0), frames()
+{
+}
+
+
+ANDOR_MultiCamera::PendingSet::PendingSet(PendingSet &&other):
+    key(other.key), framesNumber(other.framesNumber), frames(std::move(other.frames))
+{
+}
+
+
+ANDOR_MultiCamera::PendingSet & ANDOR_MultiCamera::PendingSet::operator = (PendingSet &&other)
+{
+    key = other.key;
+    framesNumber = other.framesNumber;
+    frames = std::move(other.frames);
+
+    return *this;
+}
+
+
+ANDOR_MultiCamera::CameraState::CameraState():
+    cpu(-1), ticksToNanosecs(0.0), hasEpoch(false), epochTimestamp(0), epochOffset(0), hasKey(false), lastKey(0),
+    stats(), lagSamples(0), lagSum(0)
+{
+}
+
+
+ANDOR_MultiCamera::ANDOR_MultiCamera(const size_t cameras_number, const size_t queue_length):
+    cameras(), matchMode(MatchFrameNumber), matchTolerance(0), maxPendingSets(ANDOR_MULTI_CAMERA_DEFAULT_PENDING_SETS),
+    captureThreads(), running(false), captureError(AT_SUCCESS),
+    matchMutex(), pendingSets(), cameraStates(cameras_number), emittedSets(0), setStats(),
+    readySets(queue_length), readySetsMutex(), readySetsCond()
+{
+    if ( !cameras_number ) {
+        throw AndorSDK_Exception(AT_ERR_INVALIDSIZE, "Number of cameras of synchronized acquisition must be positive!");
+    }
+
+    for ( size_t i = 0; i < cameras_number; ++i ) cameras.push_back(std::unique_ptr<ANDOR_Camera>(new ANDOR_Camera()));
+}
+
+
+ANDOR_MultiCamera::~ANDOR_MultiCamera()
+{
+    stop();
+
+    // frames of not taken sets must be released before the cameras are destroyed
+    ANDOR_FrameSet set;
+    while ( readySets.pop(set) ) set.release();
+}
+
+
+size_t ANDOR_MultiCamera::camerasNumber() const
+{
+    return cameras.size();
+}
+
+
+ANDOR_Camera & ANDOR_MultiCamera::camera(const size_t idx)
+{
+    if ( idx >= cameras.size() ) {
+        throw AndorSDK_Exception(AT_ERR_INDEXNOTAVAILABLE, "Invalid camera index of synchronized acquisition!");
+    }
+
+    return *cameras[idx];
+}
+
+
+void ANDOR_MultiCamera::setMatchMode(const MATCH_MODE mode, const std::chrono::nanoseconds tolerance)
+{
+    matchMode = mode;
+    matchTolerance = mode == MatchTimestamp && tolerance.count() > 0 ? tolerance.count() : 0;
+}
+
+
+ANDOR_MultiCamera::MATCH_MODE ANDOR_MultiCamera::getMatchMode() const
+{
+    return matchMode;
+}
+
+
+void ANDOR_MultiCamera::setCaptureCpu(const size_t idx, const int cpu)
+{
+    if ( idx >= cameras.size() ) {
+        throw AndorSDK_Exception(AT_ERR_INDEXNOTAVAILABLE, "Invalid camera index of synchronized acquisition!");
+    }
+
+    std::lock_guard<std::mutex> lock(matchMutex);
+
+    cameraStates[idx].cpu = cpu < 0 ? -1 : cpu;
+    cameras[idx]->setAcquisitionThreadCpu(cameraStates[idx].cpu);
+}
+
+
+void ANDOR_MultiCamera::setMaxPendingSets(const size_t sets_number)
+{
+    std::lock_guard<std::mutex> lock(matchMutex);
+
+    maxPendingSets = sets_number ? sets_number : 1;
+}
+
+
+void ANDOR_MultiCamera::start()
+{
+    stop();
+
+    // held buffers cannot be given to SDK again (see ANDOR_Camera::acquisitionStart)
+    ANDOR_FrameSet set;
+    while ( readySets.pop(set) ) set.release();
+
+    for ( size_t i = 0; i < cameras.size(); ++i ) {
+        CameraState &cs = cameraStates[i];
+
+        cs.hasEpoch = false;
+        cs.hasKey = false;
+
+        if ( matchMode != MatchTimestamp ) continue;
+
+        ANDOR_Camera &cam = *cameras[i];
+
+        cam.set<AndorFeature::MetadataEnable>(true);
+        cam.set<AndorFeature::MetadataTimestamp>(true);
+
+        AT_64 freq = cam.get<AndorFeature::TimestampClockFrequency>();
+        if ( freq <= 0 ) {
+            throw AndorSDK_Exception(AT_ERR_NOTIMPLEMENTED, "Invalid frequency of camera timestamp clock!");
+        }
+
+        cs.ticksToNanosecs = 1.0E9 / freq;
+    }
+
+    if ( matchMode == MatchTimestamp ) setClockEpochs();
+
+    {
+        std::lock_guard<std::mutex> lock(matchMutex);
+        pendingSets.clear();
+        emittedSets = 0;
+    }
+
+    captureError = AT_SUCCESS;
+
+    size_t started = 0;
+
+    try {
+        for ( ; started < cameras.size(); ++started ) cameras[started]->acquisitionStart();
+    } catch ( AndorSDK_Exception & ) {
+        for ( size_t i = 0; i < started; ++i ) {
+            try {
+                cameras[i]->acquisitionStop();
+            } catch ( AndorSDK_Exception & ) {
+            }
+        }
+        throw;
+    }
+
+    running = true;
+
+    for ( size_t i = 0; i < cameras.size(); ++i ) {
+        captureThreads.push_back(std::thread(&ANDOR_MultiCamera::captureFunc, this, i));
+
+        // the acquisition thread was pinned by acquisitionStart
+        bool pinned = andor_pin_thread(captureThreads.back(), cameraStates[i].cpu) &&
+                      cameras[i]->isAcquisitionThreadPinned();
+
+        std::lock_guard<std::mutex> lock(matchMutex);
+        cameraStates[i].stats.pinned = pinned;
+    }
+}
+
+
+void ANDOR_MultiCamera::stop()
+{
+    running = false;
+
+    // waitFrame of capture threads returns as soon as acquisition is stopped
+    for ( std::unique_ptr<ANDOR_Camera> &cam: cameras ) {
+        try {
+            cam->acquisitionStop();
+        } catch ( AndorSDK_Exception & ) { // the capture thread exits by 'running' flag anyway
+        }
+    }
+
+    for ( std::thread &th: captureThreads ) th.join();
+    captureThreads.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(matchMutex);
+
+        for ( PendingSet &pending: pendingSets ) dropSet(pending);
+        pendingSets.clear();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(readySetsMutex);
+    }
+    readySetsCond.notify_all();
+}
+
+
+bool ANDOR_MultiCamera::isRunning() const
+{
+    return running;
+}
+
+
+bool ANDOR_MultiCamera::popFrameSet(ANDOR_FrameSet &set)
+{
+    return readySets.pop(set);
+}
+
+
+bool ANDOR_MultiCamera::waitFrameSet(ANDOR_FrameSet &set, const unsigned int timeout)
+{
+    if ( readySets.pop(set) ) return true;
+
+    std::unique_lock<std::mutex> lock(readySetsMutex);
+
+    bool popped = false;
+    auto ready = [this, &set, &popped]() { popped = readySets.pop(set); return popped || !running; };
+
+    if ( timeout == AT_INFINITE ) {
+        readySetsCond.wait(lock, ready);
+    } else {
+        if ( !readySetsCond.wait_for(lock, std::chrono::milliseconds(timeout), ready) ) return false;
+    }
+
+    // acquisition was stopped, but there still may be emitted sets
+    return popped || readySets.pop(set);
+}
+
+
+ANDOR_MultiCameraStats ANDOR_MultiCamera::getStats() const
+{
+    std::lock_guard<std::mutex> lock(matchMutex);
+
+    ANDOR_MultiCameraStats stats = setStats;
+
+    for ( size_t i = 0; i < cameras.size(); ++i ) {
+        stats.cameras.push_back(cameraStates[i].stats);
+        stats.cameras.back().droppedFrames = cameras[i]->getDroppedFramesNumber();
+    }
+
+    return stats;
+}
+
+
+void ANDOR_MultiCamera::resetStats()
+{
+    std::lock_guard<std::mutex> lock(matchMutex);
+
+    setStats = ANDOR_MultiCameraStats();
+
+    for ( CameraState &cs: cameraStates ) {
+        bool pinned = cs.stats.pinned;
+
+        cs.stats = ANDOR_CameraSyncStats();
+        cs.stats.pinned = pinned;
+        cs.lagSamples = 0;
+        cs.lagSum = std::chrono::nanoseconds(0);
+    }
+}
+
+
+int ANDOR_MultiCamera::getCaptureError() const
+{
+    return captureError;
+}
+
+
+                /*  PRIVATE METHODS  */
+
+void ANDOR_MultiCamera::captureFunc(const size_t idx)
+{
+    ANDOR_Camera &cam = *cameras[idx];
+    ANDOR_Frame frame;
+    uint64_t key;
+
+    while ( running ) {
+        if ( !cam.waitFrame(frame, ANDOR_MULTI_CAMERA_CAPTURE_TIMEOUT) ) {
+            if ( !cam.isAcquiring() ) { // acquisition thread was stopped (e.g. by SDK error)
+                if ( cam.getAcquisitionError() != AT_SUCCESS ) captureError = cam.getAcquisitionError();
+                break;
+            }
+            continue;
+        }
+
+        bool has_key = frameKey(idx, frame, key); // metadata is parsed out of the lock
+
+        std::lock_guard<std::mutex> lock(matchMutex);
+
+        if ( !has_key ) {
+            ++cameraStates[idx].stats.framesCaptured;
+            ++cameraStates[idx].stats.metadataErrors;
+            frame.release();
+            continue;
+        }
+
+        matchFrame(idx, std::move(frame), key);
+    }
+}
+
+
+// the clocks are reset (or read) in a tight loop: the epoch of every camera is taken as the middle of
+// its SDK call, and the keys of later cameras are shifted by the host time elapsed since the first one
+
+void ANDOR_MultiCamera::setClockEpochs()
+{
+    std::vector<std::chrono::steady_clock::time_point> epochs(cameras.size());
+
+    for ( size_t i = 0; i < cameras.size(); ++i ) {
+        ANDOR_Camera &cam = *cameras[i];
+        CameraState &cs = cameraStates[i];
+
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+        try {
+            cam("TimestampClockReset");
+            cs.epochTimestamp = 0;
+        } catch ( AndorSDK_Exception & ) {
+            try {
+                t0 = std::chrono::steady_clock::now();
+                cs.epochTimestamp = cam.get<AndorFeature::TimestampClock>();
+            } catch ( AndorSDK_Exception & ) { // no epoch: keys count from the first frame
+                continue;
+            }
+        }
+
+        epochs[i] = t0 + (std::chrono::steady_clock::now() - t0) / 2;
+        cs.hasEpoch = true;
+    }
+
+    std::chrono::steady_clock::time_point first = std::chrono::steady_clock::time_point::max();
+    for ( size_t i = 0; i < cameras.size(); ++i ) {
+        if ( cameraStates[i].hasEpoch ) first = std::min(first, epochs[i]);
+    }
+
+    for ( size_t i = 0; i < cameras.size(); ++i ) {
+        CameraState &cs = cameraStates[i];
+        cs.epochOffset = cs.hasEpoch ? std::chrono::duration_cast<std::chrono::nanoseconds>(epochs[i] - first).count() : 0;
+    }
+}
+
+
+// the epoch fields are touched by the capture thread of the camera only (and by start())
+
+bool ANDOR_MultiCamera::frameKey(const size_t idx, const ANDOR_Frame &frame, uint64_t &key)
+{
+    if ( matchMode == MatchFrameNumber ) {
+        key = frame.number();
+        return true;
+    }
+
+    ANDOR_FrameMetadata metadata;
+
+    if ( !andor_parse_metadata(frame, metadata) || !metadata.hasTimestamp ) return false;
+
+    CameraState &cs = cameraStates[idx];
+
+    if ( !cs.hasEpoch ) {
+        cs.epochTimestamp = metadata.timestamp;
+        cs.epochOffset = 0;
+        cs.hasEpoch = true;
+    }
+
+    if ( metadata.timestamp < cs.epochTimestamp ) return false; // the clock was reset
+
+    key = static_cast<uint64_t>((metadata.timestamp - cs.epochTimestamp) * cs.ticksToNanosecs + 0.5) + cs.epochOffset;
+
+    return true;
+}
+
+
+void ANDOR_MultiCamera::matchFrame(const size_t idx, ANDOR_Frame &&frame, const uint64_t key)
+{
+    CameraState &cs = cameraStates[idx];
+
+    ++cs.stats.framesCaptured;
+
+    // the window is short and sorted by key
+    auto it = pendingSets.begin();
+    for ( ; it != pendingSets.end(); ++it ) {
+        if ( keys_match(it->key, key, matchTolerance) ) break;
+        if ( it->key > key ) break;
+    }
+
+    if ( it == pendingSets.end() || !keys_match(it->key, key, matchTolerance) ) {
+        PendingSet pending;
+        pending.key = key;
+        pending.frames.resize(cameras.size());
+
+        it = pendingSets.insert(it, std::move(pending));
+    }
+
+    if ( it->frames[idx] ) { // the camera has already delivered a frame with the key
+        ++cs.stats.framesUnmatched;
+        frame.release();
+    } else {
+        it->frames[idx] = std::move(frame);
+        ++it->framesNumber;
+    }
+
+    if ( !cs.hasKey || key > cs.lastKey ) cs.lastKey = key;
+    cs.hasKey = true;
+
+    flushPendingSets();
+}
+
+
+void ANDOR_MultiCamera::flushPendingSets()
+{
+    while ( !pendingSets.empty() ) {
+        PendingSet &front = pendingSets.front();
+
+        if ( front.framesNumber == cameras.size() ) {
+            emitSet(front);
+        } else if ( isStale(front) || pendingSets.size() > maxPendingSets ) {
+            dropSet(front);
+        } else {
+            break;
+        }
+
+        pendingSets.pop_front();
+    }
+}
+
+
+// frames of a camera arrive in the key order, so the set cannot be completed if every
+// missing camera has already delivered a later frame
+
+bool ANDOR_MultiCamera::isStale(const PendingSet &set) const
+{
+    for ( size_t i = 0; i < cameras.size(); ++i ) {
+        if ( set.frames[i] ) continue;
+
+        const CameraState &cs = cameraStates[i];
+        if ( !cs.hasKey || cs.lastKey <= set.key + matchTolerance ) return false;
+    }
+
+    return true;
+}
+
+
+void ANDOR_MultiCamera::emitSet(PendingSet &set)
+{
+    updateLags(set);
+
+    for ( CameraState &cs: cameraStates ) ++cs.stats.framesMatched;
+
+    ANDOR_FrameSet ready;
+
+    ready.number = emittedSets++; // a gap in numbers of taken sets means an overflow
+    ready.key = set.key;
+    ready.frames = std::move(set.frames);
+
+    if ( !readySets.push(std::move(ready)) ) { // consumers are too slow: drop the set
+        ++setStats.overflowSets;
+        ready.release();
+        return;
+    }
+
+    ++setStats.completeSets;
+
+    {
+        std::lock_guard<std::mutex> lock(readySetsMutex);
+    }
+    readySetsCond.notify_one();
+}
+
+
+void ANDOR_MultiCamera::dropSet(PendingSet &set)
+{
+    updateLags(set);
+
+    for ( size_t i = 0; i < cameras.size(); ++i ) {
+        if ( set.frames[i] ) {
+            ++cameraStates[i].stats.framesUnmatched;
+            set.frames[i].release();
+        } else {
+            ++cameraStates[i].stats.missingFrames;
+        }
+    }
+
+    ++setStats.incompleteSets;
+}
+
+
+void ANDOR_MultiCamera::updateLags(const PendingSet &set)
+{
+    if ( set.framesNumber < 2 ) return;
+
+    std::chrono::steady_clock::time_point earliest = std::chrono::steady_clock::time_point::max();
+
+    for ( const ANDOR_Frame &frame: set.frames ) {
+        if ( frame ) earliest = std::min(earliest, frame.timestamp());
+    }
+
+    for ( size_t i = 0; i < cameras.size(); ++i ) {
+        if ( !set.frames[i] ) continue;
+
+        CameraState &cs = cameraStates[i];
+        std::chrono::nanoseconds lag = std::chrono::duration_cast<std::chrono::nanoseconds>(set.frames[i].timestamp() - earliest);
+
+        cs.stats.lastLag = lag;
+        if ( lag > cs.stats.maxLag ) cs.stats.maxLag = lag;
+
+        cs.lagSum += lag;
+        ++cs.lagSamples;
+        cs.stats.meanLag = cs.lagSum / cs.lagSamples;
+    }
+}
@@ -0,0 +1,216 @@
+#ifndef ANDOR_MULTI_CAMERA_H
+#define ANDOR_MULTI_CAMERA_H
+
+#include "../export_decl.h"
+#include "andor_camera.h"
+#include "andor_frame.h"
+#include "andor_ring_queue.h"
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+
+// for MS compilers: disable multiple warnings about DLL-exports for the STL containers
+#ifdef _MSC_VER
+#pragma warning( disable: 4251 )
+#endif
+
+
+#define ANDOR_MULTI_CAMERA_DEFAULT_QUEUE_LENGTH 64    // maximal number of complete sets waiting for consumers
+#define ANDOR_MULTI_CAMERA_DEFAULT_PENDING_SETS 16    // maximal number of incomplete sets waiting for frames
+#define ANDOR_MULTI_CAMERA_CAPTURE_TIMEOUT 100        // millisecs, period of checking of stop request by capture threads
+
+
+// frames of all cameras captured at the same trigger
+
+struct ANDOR_API_WRAPPER_EXPORT ANDOR_FrameSet
+{
+    ANDOR_FrameSet();
+    ANDOR_FrameSet(ANDOR_FrameSet &&other);
+    ANDOR_FrameSet(const ANDOR_FrameSet &other) = delete;
+
+    ANDOR_FrameSet & operator = (ANDOR_FrameSet &&other);
+    ANDOR_FrameSet & operator = (const ANDOR_FrameSet &other) = delete;
+
+    size_t number;                    // sequential number of emitted set (starting from 0)
+    uint64_t key;                     // frame number, or timestamp in nanosecs (see ANDOR_MultiCamera::MATCH_MODE)
+    std::vector<ANDOR_Frame> frames;  // one frame per camera (index of camera in the manager)
+
+    void release(); // return all buffers right now
+};
+
+
+// synchronization statistics of a camera
+
+struct ANDOR_API_WRAPPER_EXPORT ANDOR_CameraSyncStats
+{
+    ANDOR_CameraSyncStats();
+
+    size_t framesCaptured;   // frames taken from the camera by its capture thread
+    size_t framesMatched;    // frames emitted in complete sets
+    size_t framesUnmatched;  // frames released without a complete set (the set was dropped or the key was repeated)
+    size_t missingFrames;    // dropped sets without a frame of the camera
+    size_t droppedFrames;    // frames dropped by the camera acquisition thread (see ANDOR_Camera::getDroppedFramesNumber)
+    size_t metadataErrors;   // frames without metadata timestamp (timestamp matching only)
+
+    // lag: host time of the frame arrival (AT_WaitBuffer return) after the earliest frame of the set
+    std::chrono::nanoseconds lastLag;
+    std::chrono::nanoseconds maxLag;
+    std::chrono::nanoseconds meanLag;
+
+    bool pinned;             // the camera acquisition thread and the capture thread are pinned to the requested CPU
+};
+
+
+struct ANDOR_API_WRAPPER_EXPORT ANDOR_MultiCameraStats
+{
+    ANDOR_MultiCameraStats();
+
+    size_t completeSets;     // sets passed to consumers
+    size_t incompleteSets;   // sets dropped because a camera missed the trigger (or the pending window is exceeded)
+    size_t overflowSets;     // complete sets dropped because consumers are too slow (the queue is full)
+
+    std::vector<ANDOR_CameraSyncStats> cameras;
+};
+
+
+            /*   SYNCHRONIZED ACQUISITION FROM SEVERAL CAMERAS   */
+
+//
+//  The manager owns N cameras (connect and configure them through camera(i), e.g. for
+//  a shared external trigger) and captures frames of every camera in its own thread.
+//  Both the acquisition thread of the camera (see ANDOR_Camera::setAcquisitionThreadCpu) and
+//  the capture thread can be pinned to a CPU. Frames are aligned into sets by a key:
+//
+//    MatchFrameNumber - sequential number of frame within acquisition (cameras must not miss triggers),
+//    MatchTimestamp   - metadata timestamp (it is enabled by start()) converted to nanosecs since
+//                       a shared epoch: frames match if their keys differ by no more than the tolerance
+//                       (e.g. a half of the trigger period). start() resets the timestamp clocks
+//                       (TimestampClockReset) or reads them (TimestampClock) one after another and
+//                       compensates the host time between the calls, so a camera may miss any trigger.
+//                       If a camera has neither feature, its keys count from its first frame (it must
+//                       not miss the first trigger). All cameras must be armed (start() is returned)
+//                       before the first trigger.
+//
+//  Incomplete sets are kept in a small window sorted by key. A set is dropped (its frames are
+//  released and reported as mismatches) as soon as every missing camera has delivered a frame
+//  with a later key, or if the window is exceeded. Complete sets are emitted in the key order
+//  into a lock-free queue: consumers take them by popFrameSet/waitFrameSet from any thread.
+//
+//  Capture threads share only the matching window (a short critical section without SDK calls).
+//  Held sets keep camera buffers, so the pool of every camera must be large enough
+//  (see ANDOR_Camera::setMaxBuffersNumber).
+//
+
+class ANDOR_API_WRAPPER_EXPORT ANDOR_MultiCamera
+{
+public:
+    enum MATCH_MODE {MatchFrameNumber, MatchTimestamp};
+
+    explicit ANDOR_MultiCamera(const size_t cameras_number,
+                               const size_t queue_length = ANDOR_MULTI_CAMERA_DEFAULT_QUEUE_LENGTH);
+
+    ANDOR_MultiCamera(const ANDOR_MultiCamera &other) = delete;
+    ANDOR_MultiCamera & operator = (const ANDOR_MultiCamera &other) = delete;
+
+    virtual ~ANDOR_MultiCamera(); // stop acquisition
+
+    size_t camerasNumber() const;
+    ANDOR_Camera & camera(const size_t idx);
+
+    // 'tolerance' is in nanosecs (timestamp matching only). It must be set before start()
+    void setMatchMode(const MATCH_MODE mode, const std::chrono::nanoseconds tolerance = std::chrono::nanoseconds(0));
+    MATCH_MODE getMatchMode() const;
+
+    // CPU of the camera acquisition thread (AT_WaitBuffer, statistics, calibration) and of its capture thread
+    // (matching). -1 - no pinning (the default). It must be set before start()
+    void setCaptureCpu(const size_t idx, const int cpu);
+    void setMaxPendingSets(const size_t sets_number);
+
+    // start acquisition of all cameras (sets which were not taken by consumers are released).
+    // Throws AndorSDK_Exception if a camera cannot be started (the others are stopped)
+    void start();
+    void stop();
+
+    bool isRunning() const;
+
+    bool popFrameSet(ANDOR_FrameSet &set); // non-blocking
+    // returns false if no set is ready within 'timeout' millisecs or acquisition was stopped
+    bool waitFrameSet(ANDOR_FrameSet &set, const unsigned int timeout = AT_INFINITE);
+
+    ANDOR_MultiCameraStats getStats() const;
+    void resetStats();
+
+    int getCaptureError() const; // the last SDK error of capture threads (AT_SUCCESS if there was no error)
+
+private:
+    struct PendingSet {
+        PendingSet();
+        PendingSet(PendingSet &&other); // VS2013 does not generate move operations
+        PendingSet & operator = (PendingSet &&other);
+
+        uint64_t key;
+        size_t framesNumber;
+        std::vector<ANDOR_Frame> frames;
+    };
+
+    struct CameraState {
+        CameraState();
+
+        int cpu;
+        double ticksToNanosecs;  // metadata timestamp clock period (timestamp matching)
+        bool hasEpoch;
+        uint64_t epochTimestamp; // clock value at the shared epoch (or the first timestamp if there is no epoch)
+        uint64_t epochOffset;    // nanosecs between the shared epoch and the epoch of the camera clock
+        bool hasKey;
+        uint64_t lastKey;        // key of the last delivered frame
+        ANDOR_CameraSyncStats stats;
+        uint64_t lagSamples;
+        std::chrono::nanoseconds lagSum;
+    };
+
+    std::vector<std::unique_ptr<ANDOR_Camera>> cameras;
+
+    MATCH_MODE matchMode;
+    uint64_t matchTolerance;
+    size_t maxPendingSets;
+
+    std::vector<std::thread> captureThreads;
+    std::atomic<bool> running;
+    std::atomic<int> captureError;
+
+    // matching window and statistics (guarded by matchMutex)
+    mutable std::mutex matchMutex;
+    std::deque<PendingSet> pendingSets;
+    std::vector<CameraState> cameraStates;
+    size_t emittedSets;
+    ANDOR_MultiCameraStats setStats;
+
+    ANDOR_RingQueue<ANDOR_FrameSet> readySets;
+    std::mutex readySetsMutex;
+    std::condition_variable readySetsCond;
+
+    void captureFunc(const size_t idx);
+
+    void setClockEpochs(); // timestamp matching: anchor the camera clocks to a shared epoch
+
+    bool frameKey(const size_t idx, const ANDOR_Frame &frame, uint64_t &key); // false if the frame has no key
+
+    // the methods below must be called with matchMutex locked
+    void matchFrame(const size_t idx, ANDOR_Frame &&frame, const uint64_t key);
+    void flushPendingSets();
+    bool isStale(const PendingSet &set) const;
+    void emitSet(PendingSet &set);
+    void dropSet(PendingSet &set);
+    void updateLags(const PendingSet &set);
+
+    void notifyConsumers();
+};
+
+#endif // ANDOR_MULTI_CAMERA_H
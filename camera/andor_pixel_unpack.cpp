@@ -0,0 +1,987 @@
+                        /**************************************************
+                         *                                                *
+                         *  SIMD KERNELS TO UNPACK SDK IMAGE BUFFERS      *
+                         *                                                *
+                         **************************************************/
+
+
+#include "andor_pixel_unpack.h"
+
+#include <cstring>
+#include <cwchar>
+#include <atomic>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ANDOR_X86_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang compile intrinsics only for enabled instruction sets, so
+// kernels are compiled per function to be selected at runtime
+#if defined(ANDOR_X86_SIMD) && defined(__GNUC__)
+#define ANDOR_TARGET_SSE2 __attribute__((target("sse2")))
+#define ANDOR_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define ANDOR_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define ANDOR_TARGET_SSE2
+#define ANDOR_TARGET_SSSE3
+#define ANDOR_TARGET_AVX2
+#endif
+
+
+                /*  ENCODING HELPERS  */
+
+ANDOR_PixelEncoding andor_pixel_encoding(const AT_WC *name)
+{
+    if ( name == nullptr ) return PIXEL_ENCODING_UNKNOWN;
+
+    if ( !wcscmp(name, L"Mono12") ) return PIXEL_ENCODING_MONO12;
+    if ( !wcscmp(name, L"Mono12Packed") ) return PIXEL_ENCODING_MONO12PACKED;
+    if ( !wcscmp(name, L"Mono16") ) return PIXEL_ENCODING_MONO16;
+    if ( !wcscmp(name, L"Mono32") ) return PIXEL_ENCODING_MONO32;
+
+    return PIXEL_ENCODING_UNKNOWN;
+}
+
+
+size_t andor_row_bytes(const size_t width, const ANDOR_PixelEncoding encoding)
+{
+    switch ( encoding ) {
+        case PIXEL_ENCODING_MONO12:
+        case PIXEL_ENCODING_MONO16:
+            return width*2;
+        case PIXEL_ENCODING_MONO12PACKED:
+            return (width*3 + 1)/2;
+        case PIXEL_ENCODING_MONO32:
+            return width*4;
+        default:
+            return 0;
+    }
+}
+
+
+                /*  CPU CAPABILITIES  */
+
+static ANDOR_SIMDLevel detect_simd_level()
+{
+#ifdef ANDOR_X86_SIMD
+#ifdef _MSC_VER
+    int info[4];
+
+    __cpuid(info, 0);
+    int n_ids = info[0];
+
+    bool avx2 = false;
+    if ( n_ids >= 7 ) {
+        __cpuid(info, 1);
+        bool os_avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6); // OSXSAVE, AVX, YMM state
+        __cpuidex(info, 7, 0);
+        avx2 = os_avx && (info[1] & (1 << 5));
+    }
+    if ( avx2 ) return SIMD_LEVEL_AVX2;
+
+    __cpuid(info, 1);
+    if ( info[2] & (1 << 9) ) return SIMD_LEVEL_SSSE3;
+    if ( info[3] & (1 << 26) ) return SIMD_LEVEL_SSE2;
+#else
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("avx2") ) return SIMD_LEVEL_AVX2;
+    if ( __builtin_cpu_supports("ssse3") ) return SIMD_LEVEL_SSSE3;
+    if ( __builtin_cpu_supports("sse2") ) return SIMD_LEVEL_SSE2;
+#endif
+#endif
+    return SIMD_LEVEL_SCALAR;
+}
+
+
+static std::atomic<int> current_simd_level(-1);
+
+ANDOR_SIMDLevel andor_cpu_simd_level()
+{
+    static const ANDOR_SIMDLevel cpu_level = detect_simd_level();
+
+    return cpu_level;
+}
+
+
+ANDOR_SIMDLevel andor_simd_level()
+{
+    int level = current_simd_level.load(std::memory_order_relaxed);
+    if ( level < 0 ) {
+        level = andor_cpu_simd_level();
+        current_simd_level.store(level, std::memory_order_relaxed);
+    }
+
+    return static_cast<ANDOR_SIMDLevel>(level);
+}
+
+
+void andor_set_simd_level(const ANDOR_SIMDLevel level)
+{
+    ANDOR_SIMDLevel cpu_level = andor_cpu_simd_level();
+
+    current_simd_level.store(level > cpu_level ? cpu_level : level, std::memory_order_relaxed);
+}
+
+
+                /*  SCALAR KERNELS  */
+
+static void unpack12p_scalar(const AT_U8* src, const size_t width, uint16_t* dst)
+{
+    size_t i = 0;
+
+    for ( ; i + 1 < width; i += 2, src += 3 ) {
+        dst[i] = (uint16_t(src[0]) << 4) | (src[1] & 0xF);
+        dst[i+1] = (uint16_t(src[2]) << 4) | (src[1] >> 4);
+    }
+
+    if ( i < width ) dst[i] = (uint16_t(src[0]) << 4) | (src[1] & 0xF); // odd width
+}
+
+
+static void mono32_to_u16_scalar(const AT_U8* src, const size_t width, uint16_t* dst)
+{
+    uint32_t v;
+    for ( size_t i = 0; i < width; ++i ) {
+        std::memcpy(&v, src + 4*i, 4);
+        dst[i] = v > 0xFFFF ? 0xFFFF : uint16_t(v);
+    }
+}
+
+
+static void u16_to_float_scalar(const uint16_t* src, const size_t width, float* dst)
+{
+    for ( size_t i = 0; i < width; ++i ) dst[i] = src[i];
+}
+
+
+static void mono16_to_float_scalar(const AT_U8* src, const size_t width, float* dst)
+{
+    uint16_t v;
+    for ( size_t i = 0; i < width; ++i ) {
+        std::memcpy(&v, src + 2*i, 2);
+        dst[i] = v;
+    }
+}
+
+
+static void mono32_to_float_scalar(const AT_U8* src, const size_t width, float* dst)
+{
+    uint32_t v;
+    for ( size_t i = 0; i < width; ++i ) {
+        std::memcpy(&v, src + 4*i, 4);
+        dst[i] = float(v);
+    }
+}
+
+
+// values are loaded before stores, so in-place conversion is safe
+
+static void encode_be16_scalar(const uint16_t* src, const size_t n, AT_U8* dst)
+{
+    for ( size_t i = 0; i < n; ++i ) {
+        uint16_t v = src[i] ^ 0x8000;
+        dst[2*i] = v >> 8;
+        dst[2*i + 1] = v & 0xFF;
+    }
+}
+
+
+static void encode_be32_scalar(const uint32_t* src, const size_t n, AT_U8* dst)
+{
+    for ( size_t i = 0; i < n; ++i ) {
+        uint32_t v;
+        std::memcpy(&v, src + i, 4);
+        v ^= 0x80000000;
+        dst[4*i] = v >> 24;
+        dst[4*i + 1] = (v >> 16) & 0xFF;
+        dst[4*i + 2] = (v >> 8) & 0xFF;
+        dst[4*i + 3] = v & 0xFF;
+    }
+}
+
+
+// min/max/sum accumulate into the passed values
+
+static void row_stats16_scalar(const uint16_t* src, const size_t n, uint16_t &vmin, uint16_t &vmax, uint64_t &sum)
+{
+    uint16_t mn = vmin, mx = vmax;
+    uint64_t s = 0;
+
+    for ( size_t i = 0; i < n; ++i ) {
+        uint16_t v = src[i];
+        if ( v < mn ) mn = v;
+        if ( v > mx ) mx = v;
+        s += v;
+    }
+
+    vmin = mn;
+    vmax = mx;
+    sum += s;
+}
+
+
+static void row_stats32_scalar(const uint32_t* src, const size_t n, uint32_t &vmin, uint32_t &vmax, uint64_t &sum)
+{
+    uint32_t mn = vmin, mx = vmax;
+    uint64_t s = 0;
+
+    for ( size_t i = 0; i < n; ++i ) {
+        uint32_t v;
+        std::memcpy(&v, src + i, 4);
+        if ( v < mn ) mn = v;
+        if ( v > mx ) mx = v;
+        s += v;
+    }
+
+    vmin = mn;
+    vmax = mx;
+    sum += s;
+}
+
+
+
+// calibration: dst = (src - offset)*gain ('gain' may be nullptr), in-place for float source
+
+static void calibrate16_scalar(const uint16_t* src, const size_t n, const float* offset, const float* gain, float* dst)
+{
+    if ( gain ) {
+        for ( size_t i = 0; i < n; ++i ) dst[i] = (float(src[i]) - offset[i])*gain[i];
+    } else {
+        for ( size_t i = 0; i < n; ++i ) dst[i] = float(src[i]) - offset[i];
+    }
+}
+
+
+static void calibrate_float_scalar(const float* src, const size_t n, const float* offset, const float* gain, float* dst)
+{
+    if ( gain ) {
+        for ( size_t i = 0; i < n; ++i ) dst[i] = (src[i] - offset[i])*gain[i];
+    } else {
+        for ( size_t i = 0; i < n; ++i ) dst[i] = src[i] - offset[i];
+    }
+}
+
+#ifdef ANDOR_X86_SIMD
+
+                /*  SSE2/SSSE3 KERNELS  */
+
+// Mono12Packed: 3 bytes (b0,b1,b2) hold 2 pixels: p0 = b0<<4 | b1&0xF, p1 = b2<<4 | b1>>4.
+// Shuffle 12 bytes into 8 words: even word = (b0<<8 | b1), odd word = (b2<<8 | b1), then
+// even pixel = (w>>4)&0xFF0 | w&0xF, odd pixel = w>>4
+
+ANDOR_TARGET_SSSE3
+static inline __m128i unpack12p_8px_ssse3(const __m128i bytes)
+{
+    const __m128i shuffle = _mm_setr_epi8(1,0, 1,2, 4,3, 4,5, 7,6, 7,8, 10,9, 10,11);
+    const __m128i mask_hi = _mm_setr_epi16(0x0FF0,0x0FFF,0x0FF0,0x0FFF,0x0FF0,0x0FFF,0x0FF0,0x0FFF);
+    const __m128i mask_lo = _mm_setr_epi16(0x000F,0,0x000F,0,0x000F,0,0x000F,0);
+
+    __m128i w = _mm_shuffle_epi8(bytes, shuffle);
+
+    return _mm_or_si128(_mm_and_si128(_mm_srli_epi16(w, 4), mask_hi), _mm_and_si128(w, mask_lo));
+}
+
+
+ANDOR_TARGET_SSSE3
+static void unpack12p_ssse3(const AT_U8* src, const size_t width, uint16_t* dst)
+{
+    size_t i = 0;
+
+    // 16-byte loads consume 12 bytes: stop while there are less than 16 bytes left in the row
+    for ( ; i + 11 <= width; i += 8, src += 12 ) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), unpack12p_8px_ssse3(v));
+    }
+
+    unpack12p_scalar(src, width - i, dst + i);
+}
+
+
+ANDOR_TARGET_SSE2
+static void mono32_to_u16_sse2(const AT_U8* src, const size_t width, uint16_t* dst)
+{
+    // unsigned saturation by signed pack instructions: shift range by 32768 and back
+    const __m128i bias32 = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16(short(0x8000));
+
+    size_t i = 0;
+
+    for ( ; i + 8 <= width; i += 8 ) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4*i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4*i + 16));
+        a = _mm_sub_epi32(a, bias32);
+        b = _mm_sub_epi32(b, bias32);
+        __m128i r = _mm_xor_si128(_mm_packs_epi32(a, b), bias16);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), r);
+    }
+
+    mono32_to_u16_scalar(src + 4*i, width - i, dst + i);
+}
+
+
+ANDOR_TARGET_SSE2
+static void mono16_to_float_sse2(const AT_U8* src, const size_t width, float* dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t i = 0;
+
+    for ( ; i + 8 <= width; i += 8 ) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2*i));
+        _mm_storeu_ps(dst + i, _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero)));
+        _mm_storeu_ps(dst + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero)));
+    }
+
+    mono16_to_float_scalar(src + 2*i, width - i, dst + i);
+}
+
+
+ANDOR_TARGET_SSE2
+static void mono32_to_float_sse2(const AT_U8* src, const size_t width, float* dst)
+{
+    size_t i = 0;
+
+    // pixel values never reach 2^31, so signed conversion is exact
+    for ( ; i + 4 <= width; i += 4 ) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4*i));
+        _mm_storeu_ps(dst + i, _mm_cvtepi32_ps(v));
+    }
+
+    mono32_to_float_scalar(src + 4*i, width - i, dst + i);
+}
+
+
+ANDOR_TARGET_SSSE3
+static void unpack12p_float_ssse3(const AT_U8* src, const size_t width, float* dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t i = 0;
+
+    for ( ; i + 11 <= width; i += 8, src += 12 ) {
+        __m128i v = unpack12p_8px_ssse3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+        _mm_storeu_ps(dst + i, _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero)));
+        _mm_storeu_ps(dst + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero)));
+    }
+
+    uint16_t tail[16];
+    size_t n = width - i;
+    for ( size_t k = 0; k < n; k += 16, src += 24 ) { // at most 10 pixels are left
+        size_t m = n - k < 16 ? n - k : 16;
+        unpack12p_scalar(src, m, tail);
+        u16_to_float_scalar(tail, m, dst + i + k);
+    }
+}
+
+
+                /*  AVX2 KERNELS  */
+
+ANDOR_TARGET_AVX2
+static inline __m256i unpack12p_16px_avx2(const AT_U8* src)
+{
+    // each 128-bit lane gets its own 12 source bytes (vpshufb does not cross lanes)
+    const __m256i shuffle = _mm256_setr_epi8(1,0, 1,2, 4,3, 4,5, 7,6, 7,8, 10,9, 10,11,
+                                             1,0, 1,2, 4,3, 4,5, 7,6, 7,8, 10,9, 10,11);
+    const __m256i mask_hi = _mm256_setr_epi16(0x0FF0,0x0FFF,0x0FF0,0x0FFF,0x0FF0,0x0FFF,0x0FF0,0x0FFF,
+                                              0x0FF0,0x0FFF,0x0FF0,0x0FFF,0x0FF0,0x0FFF,0x0FF0,0x0FFF);
+    const __m256i mask_lo = _mm256_setr_epi16(0x000F,0,0x000F,0,0x000F,0,0x000F,0,
+                                              0x000F,0,0x000F,0,0x000F,0,0x000F,0);
+
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 12));
+
+    __m256i w = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1), shuffle);
+
+    return _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(w, 4), mask_hi), _mm256_and_si256(w, mask_lo));
+}
+
+
+ANDOR_TARGET_AVX2
+static void unpack12p_avx2(const AT_U8* src, const size_t width, uint16_t* dst)
+{
+    size_t i = 0;
+
+    // the last load reads bytes [12, 28) of 24 consumed ones
+    for ( ; i + 19 <= width; i += 16, src += 24 ) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), unpack12p_16px_avx2(src));
+    }
+
+    unpack12p_ssse3(src, width - i, dst + i);
+}
+
+
+ANDOR_TARGET_AVX2
+static void unpack12p_float_avx2(const AT_U8* src, const size_t width, float* dst)
+{
+    size_t i = 0;
+
+    for ( ; i + 19 <= width; i += 16, src += 24 ) {
+        __m256i v = unpack12p_16px_avx2(src);
+        _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(v))));
+        _mm256_storeu_ps(dst + i + 8, _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(v, 1))));
+    }
+
+    unpack12p_float_ssse3(src, width - i, dst + i);
+}
+
+
+ANDOR_TARGET_AVX2
+static void mono32_to_u16_avx2(const AT_U8* src, const size_t width, uint16_t* dst)
+{
+    const __m256i max_val = _mm256_set1_epi32(0xFFFF);
+
+    size_t i = 0;
+
+    for ( ; i + 16 <= width; i += 16 ) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 4*i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 4*i + 32));
+        a = _mm256_min_epu32(a, max_val);
+        b = _mm256_min_epu32(b, max_val);
+        // packus works within 128-bit lanes: restore order of 64-bit quarters
+        __m256i r = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), r);
+    }
+
+    mono32_to_u16_sse2(src + 4*i, width - i, dst + i);
+}
+
+
+ANDOR_TARGET_AVX2
+static void mono16_to_float_avx2(const AT_U8* src, const size_t width, float* dst)
+{
+    size_t i = 0;
+
+    for ( ; i + 16 <= width; i += 16 ) {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2*i));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2*i + 16));
+        _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(lo)));
+        _mm256_storeu_ps(dst + i + 8, _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(hi)));
+    }
+
+    mono16_to_float_sse2(src + 2*i, width - i, dst + i);
+}
+
+
+ANDOR_TARGET_AVX2
+static void mono32_to_float_avx2(const AT_U8* src, const size_t width, float* dst)
+{
+    size_t i = 0;
+
+    for ( ; i + 8 <= width; i += 8 ) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 4*i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(v));
+    }
+
+    mono32_to_float_sse2(src + 4*i, width - i, dst + i);
+}
+
+                /*  BIG-ENDIAN ENCODING KERNELS  */
+
+ANDOR_TARGET_SSE2
+static void encode_be16_sse2(const uint16_t* src, const size_t n, AT_U8* dst)
+{
+    const __m128i sign = _mm_set1_epi16((short)0x8000);
+
+    size_t i = 0;
+
+    for ( ; i + 8 <= n; i += 8 ) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), sign);
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2*i), v);
+    }
+
+    encode_be16_scalar(src + i, n - i, dst + 2*i);
+}
+
+
+ANDOR_TARGET_SSSE3
+static void encode_be32_ssse3(const uint32_t* src, const size_t n, AT_U8* dst)
+{
+    const __m128i sign = _mm_set1_epi32((int)0x80000000);
+    const __m128i swap = _mm_setr_epi8(3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12);
+
+    size_t i = 0;
+
+    for ( ; i + 4 <= n; i += 4 ) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), sign);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4*i), _mm_shuffle_epi8(v, swap));
+    }
+
+    encode_be32_scalar(src + i, n - i, dst + 4*i);
+}
+
+
+ANDOR_TARGET_AVX2
+static void encode_be16_avx2(const uint16_t* src, const size_t n, AT_U8* dst)
+{
+    const __m256i sign = _mm256_set1_epi16((short)0x8000);
+
+    size_t i = 0;
+
+    for ( ; i + 16 <= n; i += 16 ) {
+        __m256i v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)), sign);
+        v = _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 2*i), v);
+    }
+
+    encode_be16_sse2(src + i, n - i, dst + 2*i);
+}
+
+
+ANDOR_TARGET_AVX2
+static void encode_be32_avx2(const uint32_t* src, const size_t n, AT_U8* dst)
+{
+    const __m256i sign = _mm256_set1_epi32((int)0x80000000);
+    const __m256i swap = _mm256_setr_epi8(3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12,
+                                          3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12);
+
+    size_t i = 0;
+
+    for ( ; i + 8 <= n; i += 8 ) {
+        __m256i v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)), sign);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 4*i), _mm256_shuffle_epi8(v, swap));
+    }
+
+    encode_be32_ssse3(src + i, n - i, dst + 4*i);
+}
+
+
+                /*  ROW STATISTICS KERNELS  */
+
+// 32-bit partial sums are flushed to 64-bit accumulator every ROW_STATS_BLOCK vectors
+// (each 32-bit lane gets at most 2*65535 per vector, so it cannot overflow)
+#define ROW_STATS_BLOCK 16384
+
+ANDOR_TARGET_SSE2
+static void row_stats16_sse2(const uint16_t* src, const size_t n, uint16_t &vmin, uint16_t &vmax, uint64_t &sum)
+{
+    // SSE2 has signed 16-bit min/max only: values are shifted by 0x8000
+    const __m128i sign = _mm_set1_epi16((short)0x8000);
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i mn = _mm_set1_epi16((short)(vmin ^ 0x8000));
+    __m128i mx = _mm_set1_epi16((short)(vmax ^ 0x8000));
+
+    size_t i = 0;
+    uint64_t s = 0;
+
+    while ( i + 8 <= n ) {
+        __m128i acc = _mm_setzero_si128();
+
+        for ( size_t k = 0; k < ROW_STATS_BLOCK && i + 8 <= n; ++k, i += 8 ) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            __m128i sv = _mm_xor_si128(v, sign);
+            mn = _mm_min_epi16(mn, sv);
+            mx = _mm_max_epi16(mx, sv);
+            acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_unpacklo_epi16(v, zero), _mm_unpackhi_epi16(v, zero)));
+        }
+
+        uint32_t a[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(a), acc);
+        s += uint64_t(a[0]) + a[1] + a[2] + a[3];
+    }
+
+    int16_t amn[8], amx[8];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(amn), mn);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(amx), mx);
+
+    for ( int k = 0; k < 8; ++k ) {
+        uint16_t v = uint16_t(amn[k]) ^ 0x8000;
+        if ( v < vmin ) vmin = v;
+        v = uint16_t(amx[k]) ^ 0x8000;
+        if ( v > vmax ) vmax = v;
+    }
+    sum += s;
+
+    row_stats16_scalar(src + i, n - i, vmin, vmax, sum);
+}
+
+
+ANDOR_TARGET_AVX2
+static void row_stats16_avx2(const uint16_t* src, const size_t n, uint16_t &vmin, uint16_t &vmax, uint64_t &sum)
+{
+    const __m256i zero = _mm256_setzero_si256();
+
+    __m256i mn = _mm256_set1_epi16((short)vmin);
+    __m256i mx = _mm256_set1_epi16((short)vmax);
+
+    size_t i = 0;
+    uint64_t s = 0;
+
+    while ( i + 16 <= n ) {
+        __m256i acc = _mm256_setzero_si256();
+
+        for ( size_t k = 0; k < ROW_STATS_BLOCK && i + 16 <= n; ++k, i += 16 ) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+            mn = _mm256_min_epu16(mn, v);
+            mx = _mm256_max_epu16(mx, v);
+            acc = _mm256_add_epi32(acc, _mm256_add_epi32(_mm256_unpacklo_epi16(v, zero), _mm256_unpackhi_epi16(v, zero)));
+        }
+
+        uint32_t a[8];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(a), acc);
+        for ( int k = 0; k < 8; ++k ) s += a[k];
+    }
+
+    uint16_t amn[16], amx[16];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(amn), mn);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(amx), mx);
+
+    for ( int k = 0; k < 16; ++k ) {
+        if ( amn[k] < vmin ) vmin = amn[k];
+        if ( amx[k] > vmax ) vmax = amx[k];
+    }
+    sum += s;
+
+    row_stats16_scalar(src + i, n - i, vmin, vmax, sum);
+}
+
+
+ANDOR_TARGET_AVX2
+static void row_stats32_avx2(const uint32_t* src, const size_t n, uint32_t &vmin, uint32_t &vmax, uint64_t &sum)
+{
+    const __m256i zero = _mm256_setzero_si256();
+
+    __m256i mn = _mm256_set1_epi32((int)vmin);
+    __m256i mx = _mm256_set1_epi32((int)vmax);
+    __m256i acc = _mm256_setzero_si256(); // 64-bit lanes
+
+    size_t i = 0;
+
+    for ( ; i + 8 <= n; i += 8 ) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        mn = _mm256_min_epu32(mn, v);
+        mx = _mm256_max_epu32(mx, v);
+        acc = _mm256_add_epi64(acc, _mm256_add_epi64(_mm256_unpacklo_epi32(v, zero), _mm256_unpackhi_epi32(v, zero)));
+    }
+
+    uint32_t amn[8], amx[8];
+    uint64_t a[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(amn), mn);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(amx), mx);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(a), acc);
+
+    for ( int k = 0; k < 8; ++k ) {
+        if ( amn[k] < vmin ) vmin = amn[k];
+        if ( amx[k] > vmax ) vmax = amx[k];
+    }
+    sum += a[0] + a[1] + a[2] + a[3];
+
+    row_stats32_scalar(src + i, n - i, vmin, vmax, sum);
+}
+
+
+                /*  CALIBRATION KERNELS  */
+
+ANDOR_TARGET_SSE2
+static void calibrate16_sse2(const uint16_t* src, const size_t n, const float* offset, const float* gain, float* dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t i = 0;
+
+    for ( ; i + 8 <= n; i += 8 ) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128 lo = _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero)), _mm_loadu_ps(offset + i));
+        __m128 hi = _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero)), _mm_loadu_ps(offset + i + 4));
+        if ( gain ) {
+            lo = _mm_mul_ps(lo, _mm_loadu_ps(gain + i));
+            hi = _mm_mul_ps(hi, _mm_loadu_ps(gain + i + 4));
+        }
+        _mm_storeu_ps(dst + i, lo);
+        _mm_storeu_ps(dst + i + 4, hi);
+    }
+
+    calibrate16_scalar(src + i, n - i, offset + i, gain ? gain + i : nullptr, dst + i);
+}
+
+
+ANDOR_TARGET_SSE2
+static void calibrate_float_sse2(const float* src, const size_t n, const float* offset, const float* gain, float* dst)
+{
+    size_t i = 0;
+
+    for ( ; i + 4 <= n; i += 4 ) {
+        __m128 v = _mm_sub_ps(_mm_loadu_ps(src + i), _mm_loadu_ps(offset + i));
+        if ( gain ) v = _mm_mul_ps(v, _mm_loadu_ps(gain + i));
+        _mm_storeu_ps(dst + i, v);
+    }
+
+    calibrate_float_scalar(src + i, n - i, offset + i, gain ? gain + i : nullptr, dst + i);
+}
+
+
+ANDOR_TARGET_AVX2
+static void calibrate16_avx2(const uint16_t* src, const size_t n, const float* offset, const float* gain, float* dst)
+{
+    size_t i = 0;
+
+    for ( ; i + 8 <= n; i += 8 ) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m256 f = _mm256_sub_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(v)), _mm256_loadu_ps(offset + i));
+        if ( gain ) f = _mm256_mul_ps(f, _mm256_loadu_ps(gain + i));
+        _mm256_storeu_ps(dst + i, f);
+    }
+
+    calibrate16_scalar(src + i, n - i, offset + i, gain ? gain + i : nullptr, dst + i);
+}
+
+
+ANDOR_TARGET_AVX2
+static void calibrate_float_avx2(const float* src, const size_t n, const float* offset, const float* gain, float* dst)
+{
+    size_t i = 0;
+
+    for ( ; i + 8 <= n; i += 8 ) {
+        __m256 v = _mm256_sub_ps(_mm256_loadu_ps(src + i), _mm256_loadu_ps(offset + i));
+        if ( gain ) v = _mm256_mul_ps(v, _mm256_loadu_ps(gain + i));
+        _mm256_storeu_ps(dst + i, v);
+    }
+
+    calibrate_float_sse2(src + i, n - i, offset + i, gain ? gain + i : nullptr, dst + i);
+}
+
+#endif // ANDOR_X86_SIMD
+
+
+                /*  ROW UNPACKING (DISPATCHERS)  */
+
+void andor_unpack_row(const AT_U8 *src, const size_t width, const ANDOR_PixelEncoding encoding, uint16_t *dst)
+{
+#ifdef ANDOR_X86_SIMD
+    ANDOR_SIMDLevel level = andor_simd_level();
+#endif
+
+    switch ( encoding ) {
+        case PIXEL_ENCODING_MONO12:
+        case PIXEL_ENCODING_MONO16: // already 16-bit little-endian words
+            std::memcpy(dst, src, width*2);
+            break;
+        case PIXEL_ENCODING_MONO12PACKED:
+#ifdef ANDOR_X86_SIMD
+            if ( level >= SIMD_LEVEL_AVX2 ) {
+                unpack12p_avx2(src, width, dst);
+                break;
+            }
+            if ( level >= SIMD_LEVEL_SSSE3 ) {
+                unpack12p_ssse3(src, width, dst);
+                break;
+            }
+#endif
+            unpack12p_scalar(src, width, dst);
+            break;
+        case PIXEL_ENCODING_MONO32:
+#ifdef ANDOR_X86_SIMD
+            if ( level >= SIMD_LEVEL_AVX2 ) {
+                mono32_to_u16_avx2(src, width, dst);
+                break;
+            }
+            if ( level >= SIMD_LEVEL_SSE2 ) {
+                mono32_to_u16_sse2(src, width, dst);
+                break;
+            }
+#endif
+            mono32_to_u16_scalar(src, width, dst);
+            break;
+        default:
+            break;
+    }
+}
+
+
+void andor_unpack_row(const AT_U8 *src, const size_t width, const ANDOR_PixelEncoding encoding, float *dst)
+{
+#ifdef ANDOR_X86_SIMD
+    ANDOR_SIMDLevel level = andor_simd_level();
+#endif
+
+    switch ( encoding ) {
+        case PIXEL_ENCODING_MONO12:
+        case PIXEL_ENCODING_MONO16:
+#ifdef ANDOR_X86_SIMD
+            if ( level >= SIMD_LEVEL_AVX2 ) {
+                mono16_to_float_avx2(src, width, dst);
+                break;
+            }
+            if ( level >= SIMD_LEVEL_SSE2 ) {
+                mono16_to_float_sse2(src, width, dst);
+                break;
+            }
+#endif
+            mono16_to_float_scalar(src, width, dst);
+            break;
+        case PIXEL_ENCODING_MONO12PACKED:
+#ifdef ANDOR_X86_SIMD
+            if ( level >= SIMD_LEVEL_AVX2 ) {
+                unpack12p_float_avx2(src, width, dst);
+                break;
+            }
+            if ( level >= SIMD_LEVEL_SSSE3 ) {
+                unpack12p_float_ssse3(src, width, dst);
+                break;
+            }
+#endif
+            {
+                uint16_t tail[16];
+                for ( size_t i = 0; i < width; i += 16, src += 24 ) {
+                    size_t m = width - i < 16 ? width - i : 16;
+                    unpack12p_scalar(src, m, tail);
+                    u16_to_float_scalar(tail, m, dst + i);
+                }
+            }
+            break;
+        case PIXEL_ENCODING_MONO32:
+#ifdef ANDOR_X86_SIMD
+            if ( level >= SIMD_LEVEL_AVX2 ) {
+                mono32_to_float_avx2(src, width, dst);
+                break;
+            }
+            if ( level >= SIMD_LEVEL_SSE2 ) {
+                mono32_to_float_sse2(src, width, dst);
+                break;
+            }
+#endif
+            mono32_to_float_scalar(src, width, dst);
+            break;
+        default:
+            break;
+    }
+}
+
+
+                /*  FRAME UNPACKING  */
+
+void andor_unpack_frame(const AT_U8 *src, const ANDOR_FrameGeometry &geometry, uint16_t *dst, size_t dst_stride)
+{
+    if ( !dst_stride ) dst_stride = geometry.width;
+
+    for ( size_t y = 0; y < geometry.height; ++y ) {
+        andor_unpack_row(src + y*geometry.stride, geometry.width, geometry.encoding, dst + y*dst_stride);
+    }
+}
+
+
+void andor_unpack_frame(const AT_U8 *src, const ANDOR_FrameGeometry &geometry, float *dst, size_t dst_stride)
+{
+    if ( !dst_stride ) dst_stride = geometry.width;
+
+    for ( size_t y = 0; y < geometry.height; ++y ) {
+        andor_unpack_row(src + y*geometry.stride, geometry.width, geometry.encoding, dst + y*dst_stride);
+    }
+}
+
+
+                /*  BIG-ENDIAN SIGNED ENCODING  */
+
+void andor_encode_be_signed(const uint16_t *src, const size_t n, AT_U8 *dst)
+{
+#ifdef ANDOR_X86_SIMD
+    ANDOR_SIMDLevel level = andor_simd_level();
+
+    if ( level >= SIMD_LEVEL_AVX2 ) {
+        encode_be16_avx2(src, n, dst);
+        return;
+    }
+    if ( level >= SIMD_LEVEL_SSE2 ) {
+        encode_be16_sse2(src, n, dst);
+        return;
+    }
+#endif
+    encode_be16_scalar(src, n, dst);
+}
+
+
+void andor_encode_be_signed(const uint32_t *src, const size_t n, AT_U8 *dst)
+{
+#ifdef ANDOR_X86_SIMD
+    ANDOR_SIMDLevel level = andor_simd_level();
+
+    if ( level >= SIMD_LEVEL_AVX2 ) {
+        encode_be32_avx2(src, n, dst);
+        return;
+    }
+    if ( level >= SIMD_LEVEL_SSSE3 ) {
+        encode_be32_ssse3(src, n, dst);
+        return;
+    }
+#endif
+    encode_be32_scalar(src, n, dst);
+}
+
+
+                /*  ROW STATISTICS  */
+
+void andor_row_statistics(const uint16_t *src, const size_t n, uint16_t &vmin, uint16_t &vmax, uint64_t &sum)
+{
+#ifdef ANDOR_X86_SIMD
+    ANDOR_SIMDLevel level = andor_simd_level();
+
+    if ( level >= SIMD_LEVEL_AVX2 ) {
+        row_stats16_avx2(src, n, vmin, vmax, sum);
+        return;
+    }
+    if ( level >= SIMD_LEVEL_SSE2 ) {
+        row_stats16_sse2(src, n, vmin, vmax, sum);
+        return;
+    }
+#endif
+    row_stats16_scalar(src, n, vmin, vmax, sum);
+}
+
+
+void andor_row_statistics(const uint32_t *src, const size_t n, uint32_t &vmin, uint32_t &vmax, uint64_t &sum)
+{
+#ifdef ANDOR_X86_SIMD
+    if ( andor_simd_level() >= SIMD_LEVEL_AVX2 ) {
+        row_stats32_avx2(src, n, vmin, vmax, sum);
+        return;
+    }
+#endif
+    row_stats32_scalar(src, n, vmin, vmax, sum);
+}
+
+
+                /*  ROW CALIBRATION  */
+
+void andor_calibrate_row(const AT_U8 *src, const size_t width, const ANDOR_PixelEncoding encoding,
+                         const float *offset, const float *gain, float *dst)
+{
+#ifdef ANDOR_X86_SIMD
+    ANDOR_SIMDLevel level = andor_simd_level();
+#endif
+
+    if ( encoding == PIXEL_ENCODING_MONO12 || encoding == PIXEL_ENCODING_MONO16 ) { // fused conversion
+        const uint16_t* src16 = reinterpret_cast<const uint16_t*>(src);
+#ifdef ANDOR_X86_SIMD
+        if ( level >= SIMD_LEVEL_AVX2 ) {
+            calibrate16_avx2(src16, width, offset, gain, dst);
+            return;
+        }
+        if ( level >= SIMD_LEVEL_SSE2 ) {
+            calibrate16_sse2(src16, width, offset, gain, dst);
+            return;
+        }
+#endif
+        calibrate16_scalar(src16, width, offset, gain, dst);
+        return;
+    }
+
+    // Mono12Packed and Mono32: unpack into output row and calibrate it in place (while it is in L1)
+    andor_unpack_row(src, width, encoding, dst);
+
+#ifdef ANDOR_X86_SIMD
+    if ( level >= SIMD_LEVEL_AVX2 ) {
+        calibrate_float_avx2(dst, width, offset, gain, dst);
+        return;
+    }
+    if ( level >= SIMD_LEVEL_SSE2 ) {
+        calibrate_float_sse2(dst, width, offset, gain, dst);
+        return;
+    }
+#endif
+    calibrate_float_scalar(dst, width, offset, gain, dst);
+}
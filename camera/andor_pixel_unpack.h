@@ -0,0 +1,94 @@
+#ifndef ANDOR_PIXEL_UNPACK_H
+#define ANDOR_PIXEL_UNPACK_H
+
+#include "../export_decl.h"
+
+#include <atcore.h>
+
+#include <cstddef>
+#include <cstdint>
+
+
+            /*   PIXEL ENCODINGS OF SDK IMAGE BUFFERS   */
+
+enum ANDOR_PixelEncoding {PIXEL_ENCODING_UNKNOWN = -1, PIXEL_ENCODING_MONO12, PIXEL_ENCODING_MONO12PACKED,
+                          PIXEL_ENCODING_MONO16, PIXEL_ENCODING_MONO32};
+
+// convert value of 'PixelEncoding' SDK feature (e.g. L"Mono12Packed") to enumeration
+ANDOR_API_WRAPPER_EXPORT ANDOR_PixelEncoding andor_pixel_encoding(const AT_WC* name);
+
+// number of bytes needed to store 'width' pixels in given encoding (without row padding)
+ANDOR_API_WRAPPER_EXPORT size_t andor_row_bytes(const size_t width, const ANDOR_PixelEncoding encoding);
+
+
+            /*   GEOMETRY OF IMAGE IN SDK BUFFER   */
+
+struct ANDOR_FrameGeometry
+{
+    size_t width;   // AOIWidth
+    size_t height;  // AOIHeight
+    size_t stride;  // AOIStride (bytes per row including padding)
+    ANDOR_PixelEncoding encoding;
+};
+
+
+            /*   SIMD DISPATCH   */
+
+//
+//  Kernels are selected at runtime according to CPU capabilities.
+//  The level can be lowered explicitly (e.g. for benchmarking) but never raised above
+//  the one supported by CPU. Note: Mono12Packed SSE kernel needs SSSE3 (pshufb), on SSE2-only
+//  CPUs it falls back to scalar code.
+//
+
+enum ANDOR_SIMDLevel {SIMD_LEVEL_SCALAR, SIMD_LEVEL_SSE2, SIMD_LEVEL_SSSE3, SIMD_LEVEL_AVX2};
+
+ANDOR_API_WRAPPER_EXPORT ANDOR_SIMDLevel andor_simd_level();
+ANDOR_API_WRAPPER_EXPORT ANDOR_SIMDLevel andor_cpu_simd_level();
+ANDOR_API_WRAPPER_EXPORT void andor_set_simd_level(const ANDOR_SIMDLevel level);
+
+
+            /*   UNPACKING FUNCTIONS   */
+
+// unpack one row of 'width' pixels
+ANDOR_API_WRAPPER_EXPORT void andor_unpack_row(const AT_U8* src, const size_t width, const ANDOR_PixelEncoding encoding,
+                                               uint16_t* dst);
+ANDOR_API_WRAPPER_EXPORT void andor_unpack_row(const AT_U8* src, const size_t width, const ANDOR_PixelEncoding encoding,
+                                               float* dst);
+
+// unpack the whole image honoring the row stride of source buffer (Mono32 values are saturated to 65535
+// for uint16 output). 'dst_stride' is output row length in pixels (0 means image width)
+ANDOR_API_WRAPPER_EXPORT void andor_unpack_frame(const AT_U8* src, const ANDOR_FrameGeometry &geometry,
+                                                 uint16_t* dst, size_t dst_stride = 0);
+ANDOR_API_WRAPPER_EXPORT void andor_unpack_frame(const AT_U8* src, const ANDOR_FrameGeometry &geometry,
+                                                 float* dst, size_t dst_stride = 0);
+
+
+
+            /*   BIG-ENDIAN SIGNED ENCODING (FITS)   */
+
+// convert unsigned pixels to big-endian signed integers with offset (FITS convention
+// BZERO = 32768 or 2147483648): dst = bswap(src ^ 0x8000) (or ^ 0x80000000 for 32-bit values).
+// The conversion may be done in place ('dst' is the same memory as 'src')
+ANDOR_API_WRAPPER_EXPORT void andor_encode_be_signed(const uint16_t* src, const size_t n, AT_U8* dst);
+ANDOR_API_WRAPPER_EXPORT void andor_encode_be_signed(const uint32_t* src, const size_t n, AT_U8* dst);
+
+
+            /*   ROW STATISTICS   */
+
+// accumulate minimum, maximum and sum of 'n' values: 'vmin', 'vmax' and 'sum' are updated
+// (start from vmin = max. value of the type, vmax = 0, sum = 0). 32-bit version is vectorized for AVX2 only
+ANDOR_API_WRAPPER_EXPORT void andor_row_statistics(const uint16_t* src, const size_t n,
+                                                   uint16_t &vmin, uint16_t &vmax, uint64_t &sum);
+ANDOR_API_WRAPPER_EXPORT void andor_row_statistics(const uint32_t* src, const size_t n,
+                                                   uint32_t &vmin, uint32_t &vmax, uint64_t &sum);
+
+
+            /*   ROW CALIBRATION   */
+
+// dst = (src - offset)*gain for 'width' pixels of SDK buffer row (unpacked on the fly).
+// 'gain' may be nullptr (no multiplication)
+ANDOR_API_WRAPPER_EXPORT void andor_calibrate_row(const AT_U8* src, const size_t width, const ANDOR_PixelEncoding encoding,
+                                                  const float* offset, const float* gain, float* dst);
+
+#endif // ANDOR_PIXEL_UNPACK_H
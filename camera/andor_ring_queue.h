@@ -0,0 +1,143 @@
+#ifndef ANDOR_RING_QUEUE_H
+#define ANDOR_RING_QUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <cstddef>
+
+
+            /*   BOUNDED LOCK-FREE QUEUE   */
+
+//
+//  A bounded multi-producer/multi-consumer queue based on a ring of cells
+//  with per-cell sequence numbers (D. Vyukov's algorithm). Neither push nor pop
+//  ever blocks or allocates: push returns false if the queue is full, pop returns
+//  false if it is empty. The capacity is rounded up to the nearest power of 2.
+//
+//  T must be default constructible and move-assignable.
+//
+
+template<typename T>
+class ANDOR_RingQueue
+{
+public:
+    explicit ANDOR_RingQueue(const size_t capacity):
+        cells(), queueMask(0), enqueuePos(0), dequeuePos(0)
+    {
+        size_t n = 2;
+        while ( n < capacity ) n <<= 1;
+
+        queueMask = n - 1;
+        cells = std::unique_ptr<Cell[]>(new Cell[n]);
+
+        for ( size_t i = 0; i < n; ++i ) cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    ANDOR_RingQueue(const ANDOR_RingQueue &other) = delete;
+    ANDOR_RingQueue & operator = (const ANDOR_RingQueue &other) = delete;
+
+
+    bool push(const T &val)
+    {
+        return emplace(val);
+    }
+
+    bool push(T &&val) // 'val' is left untouched if the queue is full
+    {
+        return emplace(std::move(val));
+    }
+
+    bool pop(T &val)
+    {
+        Cell *cell;
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+
+        for (;;) {
+            cell = &cells[pos & queueMask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)(pos + 1);
+
+            if ( diff == 0 ) {
+                if ( dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed) ) break;
+            } else if ( diff < 0 ) { // empty
+                return false;
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        val = std::move(cell->data);
+        cell->seq.store(pos + queueMask + 1, std::memory_order_release);
+
+        return true;
+    }
+
+
+    size_t capacity() const
+    {
+        return queueMask + 1;
+    }
+
+    // approximate number of elements (exact only if the queue is not concurrently accessed)
+    size_t size() const
+    {
+        size_t head = dequeuePos.load(std::memory_order_relaxed);
+        size_t tail = enqueuePos.load(std::memory_order_relaxed);
+
+        return tail > head ? tail - head : 0;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T data;
+    };
+
+    // padding to keep producer and consumer positions in different cache lines
+    static const size_t CACHE_LINE_SIZE = 64;
+
+    std::unique_ptr<Cell[]> cells;
+    size_t queueMask;
+
+    char pad0[CACHE_LINE_SIZE];
+    std::atomic<size_t> enqueuePos;
+    char pad1[CACHE_LINE_SIZE];
+    std::atomic<size_t> dequeuePos;
+    char pad2[CACHE_LINE_SIZE];
+
+
+    template<typename U>
+    bool emplace(U &&val)
+    {
+        Cell *cell;
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+
+        for (;;) {
+            cell = &cells[pos & queueMask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)pos;
+
+            if ( diff == 0 ) {
+                if ( enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed) ) break;
+            } else if ( diff < 0 ) { // full
+                return false;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->data = std::forward<U>(val);
+        cell->seq.store(pos + 1, std::memory_order_release);
+
+        return true;
+    }
+};
+
+
+#endif // ANDOR_RING_QUEUE_H
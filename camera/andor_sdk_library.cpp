@@ -0,0 +1,103 @@
+                    /*************************************************
+                     *                                               *
+                     *    IMPLEMENTATION OF ANDOR_SdkLibrary CLASS   *
+                     *                                               *
+                     *************************************************/
+
+
+#include "andor_sdk_library.h"
+
+#include <atcore.h>
+
+#include <mutex>
+#include <atomic>
+
+
+// function-local statics: the state is valid for static objects of other translation units too
+
+static std::mutex & library_mutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+static size_t library_ref_counter = 0;
+static std::atomic<bool> library_initialised(false);
+static std::atomic<int> library_init_mode(ANDOR_SdkLibrary::INIT_IMMEDIATE);
+
+
+void ANDOR_SdkLibrary::setInitMode(const INIT_MODE mode)
+{
+    library_init_mode = mode;
+}
+
+
+ANDOR_SdkLibrary::INIT_MODE ANDOR_SdkLibrary::getInitMode()
+{
+    return static_cast<INIT_MODE>(library_init_mode.load());
+}
+
+
+int ANDOR_SdkLibrary::acquire()
+{
+    std::lock_guard<std::mutex> lock(library_mutex());
+
+    ++library_ref_counter;
+
+    if ( library_init_mode == INIT_DEFERRED ) return AT_SUCCESS;
+
+    return initialiseLocked();
+}
+
+
+void ANDOR_SdkLibrary::release()
+{
+    std::lock_guard<std::mutex> lock(library_mutex());
+
+    if ( !library_ref_counter ) return;
+
+    if ( --library_ref_counter ) return;
+
+    if ( library_initialised ) {
+        AT_FinaliseLibrary();
+        library_initialised = false;
+    }
+}
+
+
+int ANDOR_SdkLibrary::ensureInitialised()
+{
+    if ( library_initialised.load(std::memory_order_acquire) ) return AT_SUCCESS; // no lock after initialization
+
+    std::lock_guard<std::mutex> lock(library_mutex());
+
+    return initialiseLocked();
+}
+
+
+bool ANDOR_SdkLibrary::isInitialised()
+{
+    return library_initialised;
+}
+
+
+size_t ANDOR_SdkLibrary::refCount()
+{
+    std::lock_guard<std::mutex> lock(library_mutex());
+
+    return library_ref_counter;
+}
+
+
+                /*  PRIVATE METHODS  */
+
+int ANDOR_SdkLibrary::initialiseLocked()
+{
+    if ( library_initialised ) return AT_SUCCESS;
+
+    int err = AT_InitialiseLibrary();
+
+    if ( err == AT_SUCCESS ) library_initialised.store(true, std::memory_order_release);
+
+    return err;
+}
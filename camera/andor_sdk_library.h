@@ -0,0 +1,61 @@
+#ifndef ANDOR_SDK_LIBRARY_H
+#define ANDOR_SDK_LIBRARY_H
+
+#include "../export_decl.h"
+
+#include <cstddef>
+
+
+            /*   LIFETIME OF ANDOR SDK LIBRARY   */
+
+//
+//  AT_InitialiseLibrary/AT_FinaliseLibrary are called according to a reference counter
+//  (all methods are thread-safe): every ANDOR_Camera object (and background camera discovery)
+//  holds a reference, the library is finalized when the last reference is released.
+//
+//  In deferred mode acquire() does not initialize the library: it is initialized at the first
+//  real need (connection to a camera, camera discovery or reading of a global feature), so
+//  a process which never talks to a device does not pay for the initialization.
+//  ensureInitialised() without any reference initializes the library too, but then it is
+//  finalized only after a reference is acquired and released.
+//
+
+class ANDOR_API_WRAPPER_EXPORT ANDOR_SdkLibrary
+{
+public:
+    enum INIT_MODE {INIT_IMMEDIATE, INIT_DEFERRED};
+
+    static void setInitMode(const INIT_MODE mode); // it affects the next initialization only
+    static INIT_MODE getInitMode();
+
+    static int acquire();   // returns SDK error code of the initialization (AT_SUCCESS in deferred mode)
+    static void release();
+
+    static int ensureInitialised(); // returns SDK error code of the initialization
+    static bool isInitialised();
+
+    static size_t refCount();
+
+private:
+    static int initialiseLocked();
+};
+
+
+// RAII holder of a library reference
+
+class ANDOR_API_WRAPPER_EXPORT ANDOR_SdkLibraryRef
+{
+public:
+    ANDOR_SdkLibraryRef(): initError(ANDOR_SdkLibrary::acquire()) {}
+    ~ANDOR_SdkLibraryRef() { ANDOR_SdkLibrary::release(); }
+
+    ANDOR_SdkLibraryRef(const ANDOR_SdkLibraryRef &other) = delete;
+    ANDOR_SdkLibraryRef & operator = (const ANDOR_SdkLibraryRef &other) = delete;
+
+    int error() const { return initError; }
+
+private:
+    int initError;
+};
+
+#endif // ANDOR_SDK_LIBRARY_H
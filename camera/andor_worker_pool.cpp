@@ -0,0 +1,174 @@
+                    /*************************************************
+                     *                                               *
+                     *   IMPLEMENTATION OF ANDOR_WorkerPool CLASS    *
+                     *                                               *
+                     *************************************************/
+
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // pthread_setaffinity_np (it must be defined before any system header)
+#endif
+
+#include "andor_worker_pool.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+ANDOR_WorkerPool::Job::Job(const std::function<void(size_t)> &task, const size_t size):
+    jobTask(&task), jobSize(size), nextTask(0), activeWorkers(0), jobError()
+{
+}
+
+
+ANDOR_WorkerPool::ANDOR_WorkerPool(const size_t threads_number):
+    workerThreads(),
+    jobMutex(), jobStartCond(), jobDoneCond(), activeJobs(), stopWorkers(false),
+    errorMutex()
+{
+    size_t n = threads_number;
+    if ( !n ) n = std::thread::hardware_concurrency();
+    if ( !n ) n = 1;
+
+    for ( size_t i = 1; i < n; ++i ) { // the calling thread is a worker too
+        workerThreads.push_back(std::thread(&ANDOR_WorkerPool::workerFunc, this));
+    }
+}
+
+
+ANDOR_WorkerPool::~ANDOR_WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        stopWorkers = true;
+    }
+    jobStartCond.notify_all();
+
+    for ( size_t i = 0; i < workerThreads.size(); ++i ) workerThreads[i].join();
+}
+
+
+size_t ANDOR_WorkerPool::threadsNumber() const
+{
+    return workerThreads.size() + 1;
+}
+
+
+void ANDOR_WorkerPool::parallelFor(const size_t n, const std::function<void(size_t)> &task)
+{
+    if ( !n ) return;
+
+    if ( n == 1 || workerThreads.empty() ) {
+        for ( size_t i = 0; i < n; ++i ) task(i);
+        return;
+    }
+
+    Job job(task, n);
+    std::list<Job*>::iterator job_it;
+
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        job_it = activeJobs.insert(activeJobs.end(), &job);
+    }
+    jobStartCond.notify_all();
+
+    runTasks(job); // returns when all the tasks are taken
+
+    {   // workers still running tasks of the job refer to it, so it cannot leave the stack before them
+        std::unique_lock<std::mutex> lock(jobMutex);
+        jobDoneCond.wait(lock, [&job]() { return job.activeWorkers == 0; });
+        activeJobs.erase(job_it);
+    }
+
+    if ( job.jobError ) std::rethrow_exception(job.jobError);
+}
+
+
+std::shared_ptr<ANDOR_WorkerPool> ANDOR_WorkerPool::defaultPool()
+{
+    static std::shared_ptr<ANDOR_WorkerPool> pool = std::make_shared<ANDOR_WorkerPool>();
+
+    return pool;
+}
+
+
+                /*  PRIVATE METHODS  */
+
+void ANDOR_WorkerPool::workerFunc()
+{
+    Job* job;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(jobMutex);
+            jobStartCond.wait(lock, [this, &job]() { return stopWorkers || (job = pendingJob()) != nullptr; });
+            if ( stopWorkers ) return;
+            ++job->activeWorkers;
+        }
+
+        runTasks(*job);
+
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            --job->activeWorkers;
+        }
+        jobDoneCond.notify_all(); // several callers may wait for their jobs
+    }
+}
+
+
+void ANDOR_WorkerPool::runTasks(Job &job)
+{
+    for (;;) {
+        size_t i = job.nextTask++;
+        if ( i >= job.jobSize ) break;
+
+        try {
+            (*job.jobTask)(i);
+        } catch ( ... ) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if ( !job.jobError ) job.jobError = std::current_exception();
+        }
+    }
+}
+
+
+ANDOR_WorkerPool::Job* ANDOR_WorkerPool::pendingJob()
+{
+    for ( Job* job: activeJobs ) {
+        if ( job->nextTask.load() < job->jobSize ) return job;
+    }
+
+    return nullptr;
+}
+
+
+
+                /*  AUXILIARY NON-MEMBER FUNCTIONS  */
+
+bool andor_pin_thread(std::thread &thread, const int cpu)
+{
+    if ( cpu < 0 || !thread.joinable() ) return false;
+
+#ifdef _WIN32
+    if ( cpu >= (int)(sizeof(DWORD_PTR)*8) ) return false;
+    return SetThreadAffinityMask((HANDLE)thread.native_handle(), (DWORD_PTR)1 << cpu) != 0;
+#elif defined(__linux__)
+    if ( cpu >= CPU_SETSIZE ) return false;
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+
+    return pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set), &cpu_set) == 0;
+#else // no hard affinity (e.g. macOS)
+    return false;
+#endif
+}
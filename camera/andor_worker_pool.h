@@ -0,0 +1,86 @@
+#ifndef ANDOR_WORKER_POOL_H
+#define ANDOR_WORKER_POOL_H
+
+#include "../export_decl.h"
+
+#include <vector>
+#include <list>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <exception>
+
+// for MS compilers: disable multiple warnings about DLL-exports for the STL containers
+#ifdef _MSC_VER
+#pragma warning( disable: 4251 )
+#endif
+
+
+            /*   POOL OF WORKER THREADS FOR DATA-PARALLEL FRAME PROCESSING   */
+
+//
+//  parallelFor(n, task) calls task(0) ... task(n-1) on the pool threads and the calling
+//  thread and returns when all of them are completed. Tasks are taken dynamically, so
+//  it is better to split the work into more tasks than threads (e.g. image tiles or row bands).
+//  Calls from several threads run concurrently: free pool threads take tasks of the oldest
+//  unfinished job, and each calling thread works on its own job, so a call never waits for
+//  jobs of other threads (e.g. the acquisition thread of a camera and a user compress() call
+//  sharing the default pool). The first exception thrown by a task is rethrown in the calling thread.
+//
+
+class ANDOR_API_WRAPPER_EXPORT ANDOR_WorkerPool
+{
+public:
+    explicit ANDOR_WorkerPool(const size_t threads_number = 0); // 0 means number of CPU cores
+
+    ANDOR_WorkerPool(const ANDOR_WorkerPool &other) = delete;
+    ANDOR_WorkerPool & operator = (const ANDOR_WorkerPool &other) = delete;
+
+    ~ANDOR_WorkerPool();
+
+    size_t threadsNumber() const; // including the calling thread
+
+    void parallelFor(const size_t n, const std::function<void(size_t)> &task);
+
+    // pool shared by processing stages (created on the first call)
+    static std::shared_ptr<ANDOR_WorkerPool> defaultPool();
+
+private:
+    struct Job {
+        Job(const std::function<void(size_t)> &task, const size_t size);
+
+        const std::function<void(size_t)>* jobTask;
+        size_t jobSize;
+        std::atomic<size_t> nextTask;
+        size_t activeWorkers; // pool threads running tasks of the job (guarded by jobMutex)
+        std::exception_ptr jobError; // guarded by errorMutex
+    };
+
+    std::vector<std::thread> workerThreads;
+
+    std::mutex jobMutex;
+    std::condition_variable jobStartCond;
+    std::condition_variable jobDoneCond;
+    std::list<Job*> activeJobs; // jobs of calling threads in order of calls (they live on the callers stacks)
+    bool stopWorkers;
+
+    std::mutex errorMutex;
+
+    void workerFunc();
+    void runTasks(Job &job);
+
+    Job* pendingJob(); // the oldest job with tasks to take (under jobMutex), nullptr if there is none
+};
+
+
+
+            /*   CPU AFFINITY OF PIPELINE THREADS   */
+
+// pin the thread to the CPU (cpu < 0 means no pinning). Returns false if the thread is not pinned
+// (e.g. invalid CPU index or there is no hard affinity on the platform, like macOS)
+ANDOR_API_WRAPPER_EXPORT bool andor_pin_thread(std::thread &thread, const int cpu);
+
+#endif // ANDOR_WORKER_POOL_H
@@ -5,6 +5,10 @@
 #include <exception>
 #include "atcore.h"
 
+// error codes of wrapper-level (non-SDK) failures (do not intersect with SDK ones)
+#define ANDOR_WRAPPER_ERR_FILE_IO 1001
+#define ANDOR_WRAPPER_ERR_FILE_FORMAT 1002
+
 class AndorSDK_Exception : public std::exception
 {
 public: